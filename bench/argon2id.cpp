@@ -0,0 +1,165 @@
+#include "../tools/argon2.hpp"
+#include "../tools/autotune.hpp"
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <iomanip>
+#include <iostream>
+
+#ifdef CTHASH_BENCH_ARGON2
+#include <argon2.h>
+#endif
+
+// Measures Argon2id with common parameter sets for each available BlaMka kernel, with lanes on one thread and on
+// a thread pool, next to the reference implementation (libargon2) when it's found. All tags of a parameter set
+// must be same. Output is CSV.
+
+struct parameter_set {
+	std::string_view name;
+	uint32_t memory_kib;
+	uint32_t passes;
+	uint32_t lanes;
+};
+
+// RFC 9106 second recommended option, OWASP minimum (19 MiB, t=2, p=1) and a larger memory-bound one
+static constexpr auto parameter_sets = std::array{
+	parameter_set{"m=64MiB,t=3,p=4", 64u * 1024u, 3u, 4u},
+	parameter_set{"m=19MiB,t=2,p=1", 19u * 1024u, 2u, 1u},
+	parameter_set{"m=256MiB,t=2,p=8", 256u * 1024u, 2u, 8u},
+};
+
+struct options {
+	std::string filter{};
+	size_t runs{3u};
+	size_t threads{std::max(std::thread::hardware_concurrency(), 1u)};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options]\n";
+	std::cerr << "measures Argon2id for each BlaMka kernel, sequential and parallel lanes and reference implementation\n";
+	std::cerr << "options:\n";
+	std::cerr << "  --filter=TEXT         only parameter sets containing TEXT (like m=64MiB)\n";
+	std::cerr << "  --runs=N              the fastest of N runs is reported (default 3)\n";
+	std::cerr << "  --threads=N           threads for parallel lanes (default is number of CPUs)\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("--filter=")) {
+			opts.filter = std::string(arg.substr(9));
+		} else if (arg.starts_with("--runs=")) {
+			opts.runs = std::strtoull(std::string(arg.substr(7)).c_str(), nullptr, 10);
+		} else if (arg.starts_with("--threads=")) {
+			opts.threads = std::strtoull(std::string(arg.substr(10)).c_str(), nullptr, 10);
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.runs == 0u || opts.threads == 0u) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+int main(int argc, char ** argv) {
+	using cthash::argon2::kernel;
+
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	constexpr auto password = std::string_view{"correct horse battery staple"};
+	constexpr auto salt = std::string_view{"cthash-bench-salt"};
+
+	const auto password_bytes = std::as_bytes(std::span(password));
+	const auto salt_bytes = std::as_bytes(std::span(salt));
+
+	auto sequential = cthash::tools::argon2_context{1u};
+	auto parallel = cthash::tools::argon2_context{opts->threads};
+
+	std::cout << "parameters,implementation,kernel,threads,memory,seconds,gib_per_second\n";
+	bool same = true;
+
+	for (const auto & set: parameter_sets) {
+		if (set.name.find(opts->filter) == std::string_view::npos) {
+			continue;
+		}
+
+		const auto params = cthash::argon2::parameters{.passes = set.passes, .memory_kib = set.memory_kib, .lanes = set.lanes, .tag_length = 32u};
+		// bytes of memory filled in all passes
+		const double filled = static_cast<double>(set.memory_kib) * 1024.0 * set.passes;
+
+		std::optional<std::array<std::byte, 32>> expected{};
+
+		const auto report = [&](std::string_view implementation, std::string_view kernel_name, size_t threads, std::string_view memory, double seconds, const std::array<std::byte, 32> & tag) {
+			if (not expected) {
+				expected = tag;
+			} else if (*expected != tag) {
+				std::cerr << set.name << ": tag of " << implementation << " (" << kernel_name << ", " << threads << " threads) differs!\n";
+				same = false;
+			}
+
+			std::cout << '"' << set.name << "\"," << implementation << ',' << kernel_name << ',' << threads << ',' << memory << ',' << std::setprecision(4) << seconds << ',' << filled / seconds / (1024.0 * 1024.0 * 1024.0) << '\n';
+		};
+
+		for (const auto k: {kernel::portable, kernel::avx2, kernel::avx512}) {
+			if (not cthash::argon2::kernel_available(k)) {
+				continue;
+			}
+
+			for (auto * context: {&sequential, &parallel}) {
+				if (context == &parallel && parallel.threads() == 1u) {
+					continue;
+				}
+
+				context->compression = k;
+				std::array<std::byte, 32> tag{};
+				bool derived = true;
+
+				const double seconds = cthash::tools::fastest_of(opts->runs, [&] { derived = context->derive(tag, password_bytes, salt_bytes, params); });
+
+				if (not derived) {
+					std::cerr << set.name << ": memory can't be mapped!\n";
+					return 1;
+				}
+
+				report("cthash", cthash::argon2::name_of(k), std::min<size_t>(context->threads(), set.lanes), cthash::tools::huge_page_memory::name_of(context->memory.kind), seconds, tag);
+			}
+		}
+
+#ifdef CTHASH_BENCH_ARGON2
+		{
+			// the reference implementation runs a thread per lane and allocates memory in each call
+			std::array<std::byte, 32> tag{};
+			int result = ARGON2_OK;
+
+			const double seconds = cthash::tools::fastest_of(opts->runs, [&] {
+				result = argon2id_hash_raw(set.passes, set.memory_kib, set.lanes, password.data(), password.size(), salt.data(), salt.size(), tag.data(), tag.size());
+			});
+
+			if (result != ARGON2_OK) {
+				std::cerr << set.name << ": libargon2 failed: " << argon2_error_message(result) << "\n";
+				return 1;
+			}
+
+			report("libargon2", "reference", set.lanes, "malloc", seconds, tag);
+		}
+#endif
+	}
+
+	return same ? 0 : 1;
+}
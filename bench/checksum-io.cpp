@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Measures `checksum` end to end on synthetic corpora (many tiny files, a few huge files, sparse files and a mix
+// of sizes from bytes to tens of megabytes) in each I/O mode (mmap, chunked mmap and read with a syscall per
+// operation, and read with small files batched through io_uring), with page cache which is warm (after a run which
+// is not measured) or dropped before each run. Files per second, GB/s of file content and CPU utilization
+// (user and system time of `checksum` divided by wall time) are printed as CSV.
+
+extern char ** environ;
+
+struct options {
+	std::string checksum{CTHASH_CHECKSUM_PATH};
+	std::string hash{"xxhash64"};
+	size_t jobs{0u};
+	size_t mib{1024u};
+	size_t tiny_files{20'000u};
+	size_t runs{3u};
+	std::filesystem::path directory{std::filesystem::temp_directory_path()};
+	std::string_view filter{};
+	bool keep{false};
+	bool generate_only{false};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options]\n";
+	std::cerr << "measures checksum on synthetic corpora in each I/O mode with warm and dropped page cache\n";
+	std::cerr << "options:\n";
+	std::cerr << "  --checksum=PATH       checksum binary to measure (default the one built with this benchmark)\n";
+	std::cerr << "  --hash=NAME           hash function passed to checksum (default xxhash64)\n";
+	std::cerr << "  -j N                  number of checksum's worker threads (default is its own default)\n";
+	std::cerr << "  --mib=N               size of huge, sparse and mixed corpora (default 1024)\n";
+	std::cerr << "  --tiny-files=N        number of files in tiny corpus (default 20000)\n";
+	std::cerr << "  --runs=N              measured runs, the fastest one is reported (default 3)\n";
+	std::cerr << "  --dir=PATH            where corpora are generated\n";
+	std::cerr << "  --filter=TEXT         only measurements whose corpus/mode/cache contains TEXT\n";
+	std::cerr << "  --keep                don't remove corpora at the end\n";
+	std::cerr << "  --generate-only       only generate corpora, print their directory and keep them\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	const auto number = [](std::string_view value) {
+		return static_cast<size_t>(std::strtoull(std::string(value).c_str(), nullptr, 10));
+	};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("--checksum=")) {
+			opts.checksum = std::string(arg.substr(11));
+		} else if (arg.starts_with("--hash=")) {
+			opts.hash = std::string(arg.substr(7));
+		} else if (arg.starts_with("-j")) {
+			opts.jobs = number((arg.size() > 2u) ? arg.substr(2) : ((i + 1 != argc) ? std::string_view(argv[++i]) : std::string_view{}));
+		} else if (arg.starts_with("--mib=")) {
+			opts.mib = number(arg.substr(6));
+		} else if (arg.starts_with("--tiny-files=")) {
+			opts.tiny_files = number(arg.substr(13));
+		} else if (arg.starts_with("--runs=")) {
+			opts.runs = number(arg.substr(7));
+		} else if (arg.starts_with("--dir=")) {
+			opts.directory = std::string(arg.substr(6));
+		} else if (arg.starts_with("--filter=")) {
+			opts.filter = arg.substr(9);
+		} else if (arg == "--keep") {
+			opts.keep = true;
+		} else if (arg == "--generate-only") {
+			opts.generate_only = true;
+			opts.keep = true;
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.mib == 0u || opts.runs == 0u) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+static auto splitmix(uint64_t & state) noexcept -> uint64_t {
+	uint64_t z = (state += 0x9E3779B97F4A7C15u);
+	z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9u;
+	z = (z ^ (z >> 27u)) * 0x94D049BB133111EBu;
+	return z ^ (z >> 31u);
+}
+
+struct corpus {
+	std::string name;
+	std::filesystem::path path;
+	size_t files{0u};
+	uint64_t bytes{0u}; // apparent size, holes included
+};
+
+// files are written from a block of random bytes (at varying offsets, so no two files are the same)
+struct corpus_writer {
+	static constexpr size_t noise_size = 16u * 1024u * 1024u;
+
+	std::vector<std::byte> noise = std::vector<std::byte>(noise_size);
+	uint64_t rng{42u};
+
+	corpus_writer() {
+		uint64_t state = 1u;
+		for (size_t i = 0; i < noise.size(); i += sizeof(uint64_t)) {
+			const uint64_t v = splitmix(state);
+			std::copy_n(reinterpret_cast<const std::byte *>(&v), sizeof(v), noise.data() + i);
+		}
+	}
+
+	// writes `length` bytes at `offset`, it returns false when the file can't be written
+	auto write_at(int fd, uint64_t offset, uint64_t length) -> bool {
+		size_t from = static_cast<size_t>(splitmix(rng) % (noise_size / 2u));
+
+		while (length != 0u) {
+			const size_t n = static_cast<size_t>(std::min<uint64_t>(length, noise_size - from));
+			const auto r = pwrite(fd, noise.data() + from, n, static_cast<off_t>(offset));
+
+			if (r <= 0) {
+				return false;
+			}
+
+			offset += static_cast<uint64_t>(r);
+			length -= static_cast<uint64_t>(r);
+			from = 0u;
+		}
+
+		return true;
+	}
+
+	// with `data_every` data are only in first `data_length` bytes of each such block, the rest are holes
+	auto file(const std::filesystem::path & path, uint64_t size, uint64_t data_every = 0u, uint64_t data_length = 0u) -> bool {
+		const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+		if (fd < 0) {
+			return false;
+		}
+
+		bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0;
+
+		if (data_every == 0u) {
+			ok = ok && write_at(fd, 0u, size);
+		} else {
+			for (uint64_t pos = 0u; ok && pos < size; pos += data_every) {
+				ok = write_at(fd, pos, std::min(data_length, size - pos));
+			}
+		}
+
+		return (close(fd) == 0) && ok;
+	}
+
+	// files are spread into directories of 1000 files
+	auto path_in(corpus & c, size_t index) -> std::filesystem::path {
+		const auto dir = c.path / std::to_string(index / 1000u);
+		std::filesystem::create_directories(dir);
+		return dir / std::to_string(index);
+	}
+
+	auto add(corpus & c, uint64_t size, uint64_t data_every = 0u, uint64_t data_length = 0u) -> bool {
+		if (not file(path_in(c, c.files), size, data_every, data_length)) {
+			return false;
+		}
+
+		++c.files;
+		c.bytes += size;
+		return true;
+	}
+};
+
+static auto generate(const options & opts, const std::filesystem::path & root) -> std::optional<std::vector<corpus>> {
+	constexpr uint64_t mib = 1024u * 1024u;
+	const uint64_t total = opts.mib * mib;
+
+	corpus_writer writer{};
+	std::vector<corpus> out{{"tiny", root / "tiny"}, {"huge", root / "huge"}, {"sparse", root / "sparse"}, {"mixed", root / "mixed"}};
+	bool ok = true;
+
+	// 0 to 4 KiB, below checksum's limit for batched reading
+	for (size_t i = 0; ok && i != opts.tiny_files; ++i) {
+		ok = writer.add(out[0], splitmix(writer.rng) % 4097u);
+	}
+
+	for (size_t i = 0; ok && i != 4u; ++i) {
+		ok = writer.add(out[1], total / 4u);
+	}
+
+	// 1 MiB of data in each 16 MiB
+	for (size_t i = 0; ok && i != 4u; ++i) {
+		ok = writer.add(out[2], total / 4u, 16u * mib, mib);
+	}
+
+	// sizes are uniform on logarithmic scale from 1 B to 64 MiB, so there are files of every magnitude
+	for (uint64_t left = total; ok && left != 0u;) {
+		const double exponent = static_cast<double>(splitmix(writer.rng) >> 11u) / static_cast<double>(uint64_t{1} << 53u) * 26.0;
+		const uint64_t size = std::min(left, static_cast<uint64_t>(std::exp2(exponent)));
+		ok = writer.add(out[3], size);
+		left -= size;
+	}
+
+	if (not ok) {
+		return std::nullopt;
+	}
+
+	return out;
+}
+
+// page cache (and dentries and inodes) are dropped when it's permitted, otherwise only cached pages of corpus files
+// are dropped with `posix_fadvise`, it returns which way was used
+static auto drop_caches(const corpus & c) -> std::string_view {
+	sync();
+
+	if (std::ofstream out{"/proc/sys/vm/drop_caches"}; out && (out << "3" << std::flush)) {
+		return "drop_caches";
+	}
+
+	for (const auto & entry: std::filesystem::recursive_directory_iterator(c.path)) {
+		if (entry.is_regular_file()) {
+			if (const int fd = open(entry.path().c_str(), O_RDONLY | O_CLOEXEC); fd >= 0) {
+				posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+				close(fd);
+			}
+		}
+	}
+
+	return "fadvise";
+}
+
+struct measurement {
+	bool ok{false};
+	double seconds{0.0};
+	double user{0.0};
+	double system{0.0};
+	long major_faults{0};
+};
+
+// runs checksum with digests going to /dev/null and errors to `log`
+static auto run(const std::vector<std::string> & args, const std::filesystem::path & log) -> measurement {
+	std::vector<char *> argv;
+	for (const auto & a: args) {
+		argv.push_back(const_cast<char *>(a.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+	posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	measurement out{};
+	const auto start = std::chrono::steady_clock::now();
+	pid_t pid;
+
+	const int spawned = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (spawned != 0) {
+		return out;
+	}
+
+	int status = 0;
+	struct rusage usage { };
+	wait4(pid, &status, 0, &usage);
+
+	const auto seconds = [](const timeval & tv) {
+		return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+	};
+
+	out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	out.user = seconds(usage.ru_utime);
+	out.system = seconds(usage.ru_stime);
+	out.major_faults = usage.ru_majflt;
+	out.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	return out;
+}
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	const auto root = opts->directory / ("cthash-checksum-io-" + std::to_string(::getpid()));
+	std::filesystem::create_directories(root);
+
+	const auto generation = std::chrono::steady_clock::now();
+	const auto corpora = generate(*opts, root);
+
+	if (not corpora) {
+		std::cerr << "can't generate corpora in " << root << "!\n";
+		std::filesystem::remove_all(root);
+		return 1;
+	}
+
+	std::cerr << "corpora generated in " << root << " in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - generation).count() << " s\n";
+
+	if (opts->generate_only) {
+		std::cout << root.string() << "\n";
+		return 0;
+	}
+
+	const auto log = root / "checksum.log";
+	std::string_view drop_method{};
+	bool failed = false;
+
+	// small files are read in batches through io_uring only in the last mode, the others use a syscall per operation
+	const std::pair<std::string_view, std::vector<std::string>> io_modes[] = {
+		{"mmap", {"--io=mmap", "--no-io-uring"}},
+		{"mmap-chunked", {"--io=mmap-chunked", "--no-io-uring"}},
+		{"read", {"--io=read", "--no-io-uring"}},
+		{"io_uring", {"--io=read"}},
+	};
+
+	std::cout << "corpus,io,cache,files,bytes,seconds,files_per_second,gb_per_second,cpu_utilization,user_seconds,system_seconds,major_faults,status\n";
+
+	for (const auto & c: *corpora) {
+		for (const auto & [io, io_args]: io_modes) {
+			for (const bool dropped: {false, true}) {
+				const auto cache = dropped ? "dropped" : "warm";
+				const auto name = c.name + "/" + std::string(io) + "/" + cache;
+
+				if (not opts->filter.empty() && name.find(opts->filter) == std::string::npos) {
+					continue;
+				}
+
+				std::vector<std::string> args{opts->checksum};
+				args.insert(args.end(), io_args.begin(), io_args.end());
+				args.insert(args.end(), {opts->hash, "-r", c.path.string()});
+				if (opts->jobs != 0u) {
+					args.insert(args.begin() + 1, "-j" + std::to_string(opts->jobs));
+				}
+
+				// run which brings the corpus into page cache (as far as it fits) isn't measured
+				if (not dropped) {
+					run(args, log);
+				}
+
+				measurement best{};
+				for (size_t r = 0; r != opts->runs; ++r) {
+					if (dropped) {
+						drop_method = drop_caches(c);
+					}
+
+					const auto m = run(args, log);
+					best = (r == 0u || not m.ok || (best.ok && m.seconds < best.seconds)) ? m : best;
+
+					if (not m.ok) {
+						break;
+					}
+				}
+
+				failed = failed || not best.ok;
+
+				const double cpu = (best.user + best.system) / best.seconds;
+				std::cout << c.name << "," << io << "," << cache << "," << c.files << "," << c.bytes << "," << best.seconds << "," << (static_cast<double>(c.files) / best.seconds) << "," << (static_cast<double>(c.bytes) / best.seconds / 1e9) << "," << cpu << "," << best.user << "," << best.system << "," << best.major_faults << "," << (best.ok ? "ok" : "error") << std::endl;
+			}
+		}
+	}
+
+	if (not drop_method.empty()) {
+		std::cerr << "caches were dropped with " << drop_method << "\n";
+	}
+
+	if (failed) {
+		std::cerr << "checksum failed, see " << log << "\n";
+	} else if (not opts->keep) {
+		std::filesystem::remove_all(root);
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+#include "../tools/compact-streams.hpp"
+#include <cthash/cthash.hpp>
+#include <chrono>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+// Memory and time of many concurrently open streams kept as full hashers and as compact streams
+// (state only, unprocessed bytes in a shared slab). Each stream gets several updates of random size, in "aligned"
+// workload sizes are whole blocks of 64 bytes so streams are mostly idle without pending bytes. Output is CSV.
+
+static auto now() {
+	return std::chrono::steady_clock::now();
+}
+
+static auto seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(now() - start).count();
+}
+
+template <typename Hasher> static bool run(std::string_view name, size_t streams, unsigned rounds, bool aligned) {
+	std::vector<std::byte> data(4096u);
+	for (size_t i = 0; i != data.size(); ++i) {
+		data[i] = static_cast<std::byte>(i * 13u);
+	}
+
+	// same sizes of updates for both variants (splitmix64 of stream and round)
+	const auto size_of = [aligned](size_t stream, unsigned round) {
+		uint64_t x = stream * 0x9E3779B97F4A7C15ull + round;
+		x = (x ^ (x >> 30u)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27u)) * 0x94D049BB133111EBull;
+		x ^= x >> 31u;
+		return aligned ? static_cast<size_t>(x % 5u) * 64u : static_cast<size_t>(x % 300u);
+	};
+
+	const auto full_start = now();
+	std::vector<Hasher> full(streams);
+	for (unsigned r = 0; r != rounds; ++r) {
+		for (size_t s = 0; s != streams; ++s) {
+			full[s].update(std::span<const std::byte>(data).first(size_of(s, r)));
+		}
+	}
+	const double full_seconds = seconds_since(full_start);
+
+	const auto compact_start = now();
+	cthash::tools::compact_streams<Hasher> compact;
+	std::vector<typename cthash::tools::compact_streams<Hasher>::handle> handles(streams);
+	for (auto & h: handles) {
+		h = compact.open();
+	}
+	for (unsigned r = 0; r != rounds; ++r) {
+		for (size_t s = 0; s != streams; ++s) {
+			compact.update(handles[s], std::span<const std::byte>(data).first(size_of(s, r)));
+		}
+	}
+	const double compact_seconds = seconds_since(compact_start);
+	const size_t compact_bytes = compact.bytes();
+
+	for (size_t s = 0; s != streams; ++s) {
+		if (compact.finish(handles[s]).final() != full[s].final()) {
+			std::cerr << name << ": digest of stream " << s << " differs!\n";
+			return false;
+		}
+	}
+
+	const auto per_stream = [&](size_t bytes) { return static_cast<double>(bytes) / static_cast<double>(streams); };
+	std::cout << name << "," << (aligned ? "aligned" : "random") << "," << streams << "," << per_stream(sizeof(Hasher) * streams) << "," << per_stream(compact_bytes) << "," << full_seconds << "," << compact_seconds << "\n";
+	return true;
+}
+
+int main(int argc, char ** argv) {
+	const size_t streams = (argc > 1) ? static_cast<size_t>(std::atoi(argv[1])) : size_t{1'000'000};
+	const unsigned rounds = (argc > 2) ? static_cast<unsigned>(std::atoi(argv[2])) : 4u;
+
+	if (streams == 0u || rounds == 0u) {
+		std::cerr << argv[0] << " [streams [updates-per-stream]]\n";
+		return 1;
+	}
+
+	std::cout << "hash,workload,streams,hasher_bytes_per_stream,compact_bytes_per_stream,hasher_seconds,compact_seconds\n";
+
+	bool ok = true;
+	for (const bool aligned: {false, true}) {
+		ok &= run<cthash::sha256>("sha-256", streams, rounds, aligned);
+		ok &= run<cthash::sha512>("sha-512", streams, rounds, aligned);
+		ok &= run<cthash::sha3_256>("sha3-256", streams, rounds, aligned);
+		ok &= run<cthash::xxhash64>("xxhash64", streams, rounds, aligned);
+	}
+	return ok ? 0 : 1;
+}
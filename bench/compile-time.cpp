@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Measures what constexpr hashing costs in builds: wall time and peak memory of the compiler for a translation unit
+// which includes one header, instantiates one hasher or hashes an input in `static_assert`, next to an empty unit.
+// GCC reports its phases with `-ftime-report` and Clang with `-ftime-trace`, the largest ones are aggregated
+// into `breakdown`. Output is CSV.
+
+extern char ** environ;
+
+struct options {
+	std::vector<std::string> compilers{};
+	std::vector<size_t> sizes{1u, 10u, 100u};
+	std::string_view filter{};
+	std::filesystem::path include{CTHASH_INCLUDE_DIR};
+	double timeout{600.0};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options]\n";
+	std::cerr << "measures compile time and memory of including cthash headers, instantiating hashers and constexpr hashing\n";
+	std::cerr << "options:\n";
+	std::cerr << "  --compiler=PATH       compiler to measure, can be repeated (default g++ and clang++ which are found)\n";
+	std::cerr << "  --sizes=KB,...        inputs hashed in static_assert in kilobytes (default 1,10,100)\n";
+	std::cerr << "  --filter=TEXT         only cases containing TEXT\n";
+	std::cerr << "  --timeout=SECONDS     longest compilation before it's stopped (default 600)\n";
+}
+
+static bool in_path(const std::string & program) {
+	const char * path = std::getenv("PATH");
+	std::istringstream dirs{path ? path : ""};
+
+	for (std::string dir; std::getline(dirs, dir, ':');) {
+		if (access((std::filesystem::path(dir) / program).c_str(), X_OK) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("--compiler=")) {
+			opts.compilers.emplace_back(arg.substr(11));
+		} else if (arg.starts_with("--sizes=")) {
+			opts.sizes.clear();
+			std::istringstream list{std::string(arg.substr(8))};
+			for (std::string item; std::getline(list, item, ',');) {
+				opts.sizes.push_back(std::strtoull(item.c_str(), nullptr, 10));
+			}
+		} else if (arg.starts_with("--filter=")) {
+			opts.filter = arg.substr(9);
+		} else if (arg.starts_with("--timeout=")) {
+			opts.timeout = std::atof(std::string(arg.substr(10)).c_str());
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.compilers.empty()) {
+		for (const char * candidate: {"g++", "clang++"}) {
+			if (in_path(candidate)) {
+				opts.compilers.emplace_back(candidate);
+			}
+		}
+	}
+
+	if (opts.compilers.empty()) {
+		std::cerr << "no compiler found!\n";
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+struct compilation {
+	bool ok{false};
+	bool timed_out{false};
+	double seconds{0.0};
+	double peak_mib{0.0};
+};
+
+// runs the compiler with stdout and stderr going into `log`, peak memory is maximal RSS of the child
+static auto run(const std::vector<std::string> & args, const std::filesystem::path & log, double timeout) -> compilation {
+	std::vector<char *> argv;
+	for (const auto & a: args) {
+		argv.push_back(const_cast<char *>(a.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+	compilation out{};
+	const auto start = std::chrono::steady_clock::now();
+	pid_t pid;
+
+	const int spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (spawned != 0) {
+		return out;
+	}
+
+	int status = 0;
+	struct rusage usage { };
+
+	while (wait4(pid, &status, WNOHANG, &usage) == 0) {
+		if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeout) {
+			kill(pid, SIGKILL);
+			wait4(pid, &status, 0, &usage);
+			out.timed_out = true;
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{5});
+	}
+
+	out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	out.peak_mib = static_cast<double>(usage.ru_maxrss) / 1024.0; // kilobytes on Linux
+	out.ok = not out.timed_out && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	return out;
+}
+
+static auto read_file(const std::filesystem::path & path) -> std::string {
+	std::ifstream in{path};
+	std::ostringstream out;
+	out << in.rdbuf();
+	return out.str();
+}
+
+// phases from GCC's `-ftime-report`: lines as ` name   :   usr (  %)   sys (  %)   wall (  %)  ggc`
+static auto gcc_phases(const std::string & report) -> std::vector<std::pair<std::string, double>> {
+	std::vector<std::pair<std::string, double>> out;
+	std::istringstream lines{report};
+
+	for (std::string line; std::getline(lines, line);) {
+		const auto colon = line.find(" : ");
+		if (colon == std::string::npos || line.starts_with(" TOTAL") || not line.starts_with(" ")) {
+			continue;
+		}
+
+		// the third time is wall clock
+		std::istringstream values{line.substr(colon + 3u)};
+		std::string token;
+		double wall = 0.0;
+		for (int column = 0; column != 3 && values >> wall; ++column) {
+			values >> token >> token; // "(" and "xx%)"
+			if (token.back() != ')') {
+				values >> token;
+			}
+		}
+
+		// nested items start with '|'
+		const size_t first = line.find_first_not_of(" |");
+		const auto name = line.substr(first, colon - first);
+		out.emplace_back(name.substr(0u, name.find_last_not_of(' ') + 1u), wall);
+	}
+
+	return out;
+}
+
+// totals from Clang's `-ftime-trace`: events named "Total ..." with their duration in microseconds
+static auto clang_phases(const std::string & trace) -> std::vector<std::pair<std::string, double>> {
+	std::vector<std::pair<std::string, double>> out;
+	constexpr auto key = std::string_view{"\"name\":\"Total "};
+
+	for (size_t pos = trace.find(key); pos != std::string::npos; pos = trace.find(key, pos + 1u)) {
+		const size_t object = trace.rfind('{', pos);
+		const size_t dur = trace.find("\"dur\":", object);
+		if (dur == std::string::npos || dur > trace.find('}', pos)) {
+			continue;
+		}
+
+		const size_t name_start = pos + key.size();
+		out.emplace_back(trace.substr(name_start, trace.find('"', name_start) - name_start), std::atof(trace.c_str() + dur + 6u) / 1e6);
+	}
+
+	return out;
+}
+
+// the largest phases as `name=seconds;...` (phases are nested, so they don't sum to the total)
+static auto breakdown(std::vector<std::pair<std::string, double>> phases) -> std::string {
+	std::ranges::sort(phases, std::greater{}, &std::pair<std::string, double>::second);
+	std::ostringstream out;
+
+	for (size_t i = 0; i != std::min<size_t>(phases.size(), 5u); ++i) {
+		out << (i == 0u ? "" : ";") << phases[i].first << "=" << phases[i].second;
+	}
+
+	return out.str();
+}
+
+struct test_case {
+	std::string kind;
+	std::string subject;
+	size_t kilobytes;
+	std::string source;
+};
+
+struct hasher_expression {
+	std::string_view name;
+	std::string_view type;
+	std::string_view final;
+};
+
+static constexpr auto hashers = std::array{
+	hasher_expression{"sha-1", "cthash::sha1", "final()"},
+	hasher_expression{"sha-256", "cthash::sha256", "final()"},
+	hasher_expression{"sha-512", "cthash::sha512", "final()"},
+	hasher_expression{"sha3-256", "cthash::sha3_256", "final()"},
+	hasher_expression{"shake-128", "cthash::shake128", "final<256>()"},
+	hasher_expression{"xxhash32", "cthash::xxhash32", "final()"},
+	hasher_expression{"xxhash64", "cthash::xxhash64", "final()"},
+};
+
+static auto cases(const options & opts) -> std::vector<test_case> {
+	std::vector<test_case> out;
+	out.push_back({"baseline", "empty", 0u, "int unused;\n"});
+
+	std::vector<std::string> headers;
+	for (const auto & entry: std::filesystem::recursive_directory_iterator(opts.include / "cthash")) {
+		if (entry.path().extension() == ".hpp") {
+			headers.push_back(std::filesystem::relative(entry.path(), opts.include).generic_string());
+		}
+	}
+	std::ranges::sort(headers);
+
+	for (const auto & header: headers) {
+		out.push_back({"include", header, 0u, "#include <" + header + ">\n"});
+	}
+
+	for (const auto & h: hashers) {
+		std::ostringstream source;
+		source << "#include <cthash/cthash.hpp>\n";
+		source << "auto hash(std::span<const std::byte> in) {\n\treturn " << h.type << "{}.update(in)." << h.final << ";\n}\n";
+		out.push_back({"instantiate", std::string(h.name), 0u, source.str()});
+	}
+
+	for (const auto & h: hashers) {
+		for (const size_t kb: opts.sizes) {
+			std::ostringstream source;
+			source << "#include <cthash/cthash.hpp>\n";
+			source << "consteval auto make_input() {\n\tstd::array<std::byte, " << kb * 1000u << "> out{};\n";
+			source << "\tfor (size_t i = 0; i != out.size(); ++i) {\n\t\tout[i] = static_cast<std::byte>(i * 31u);\n\t}\n\treturn out;\n}\n";
+			source << "constexpr auto input = make_input();\n";
+			source << "constexpr auto digest = " << h.type << "{}.update(std::span<const std::byte>(input))." << h.final << ";\n";
+			source << "static_assert(digest.size() != 0u);\n";
+			out.push_back({"constexpr", std::string(h.name), kb, source.str()});
+		}
+	}
+
+	return out;
+}
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	const auto directory = std::filesystem::temp_directory_path() / ("cthash-compile-time-" + std::to_string(::getpid()));
+	std::filesystem::create_directories(directory);
+
+	const auto source = directory / "unit.cpp";
+	const auto object = directory / "unit.o";
+	const auto log = directory / "unit.log";
+	const auto trace = directory / "unit.json";
+
+	std::cout << "compiler,kind,subject,input_kb,seconds,peak_mib,status,breakdown\n";
+
+	for (const auto & compiler: opts->compilers) {
+		// clang writes its trace next to the object file
+		const bool clang = compiler.find("clang") != std::string::npos;
+
+		for (const auto & c: cases(*opts)) {
+			if (not opts->filter.empty() && (c.kind + "/" + c.subject).find(opts->filter) == std::string::npos) {
+				continue;
+			}
+
+			std::ofstream{source} << c.source;
+
+			std::vector<std::string> args{compiler, "-std=c++20", "-O2", "-I" + opts->include.string(), "-c", source.string(), "-o", object.string()};
+			if (clang) {
+				args.insert(args.end(), {"-fconstexpr-steps=2147483647", "-ftime-trace"});
+			} else {
+				args.insert(args.end(), {"-fconstexpr-ops-limit=4294967296", "-fconstexpr-loop-limit=2147483647", "-ftime-report"});
+			}
+
+			// a failed or timed out compilation doesn't write its trace, so the one of the previous case must not stay
+			std::filesystem::remove(trace);
+
+			const auto r = run(args, log, opts->timeout);
+			const auto phases = clang ? clang_phases(read_file(trace)) : gcc_phases(read_file(log));
+			const auto status = r.ok ? "ok" : (r.timed_out ? "timeout" : "error");
+
+			std::cout << compiler << "," << c.kind << "," << c.subject << "," << c.kilobytes << "," << r.seconds << "," << r.peak_mib << "," << status << "," << breakdown(phases) << std::endl;
+		}
+	}
+
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,361 @@
+#include "../tools/cpu.hpp"
+#include "../tools/json.hpp"
+#include "../tools/perf-counters.hpp"
+#include "implementations.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <iostream>
+
+// Throughput of every algorithm (and of OpenSSL and reference xxHash when they are available) for inputs from 1 B
+// to 1 GiB, at aligned and misaligned addresses. Output is JSON with one result per line, it can be stored and
+// later used as a baseline for `--compare`. With `--counters` hardware counters of one more run are reported
+// per byte and per block (one call of compression function).
+
+struct options {
+	std::string_view filter{};
+	size_t max_size{size_t{1} << 30u};
+	double min_time{0.2};
+	const char * output{nullptr};
+	const char * baseline{nullptr};
+	double threshold{5.0};
+	bool counters{false};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options]\n";
+	std::cerr << "measures throughput of all hash functions for inputs from 1 B to 1 GiB, aligned and misaligned\n";
+	std::cerr << "options:\n";
+	std::cerr << "  --filter=TEXT         only algorithms or implementations containing TEXT\n";
+	std::cerr << "  --max-size=BYTES      largest input (default 1G, suffixes K, M and G are accepted)\n";
+	std::cerr << "  --min-time=SECONDS    time spent measuring each input (default 0.2)\n";
+	std::cerr << "  --output=FILE         write JSON into FILE instead of standard output\n";
+	std::cerr << "  --compare=FILE        compare with results stored in FILE and fail when something is slower\n";
+	std::cerr << "  --threshold=PERCENT   slowdown which is reported as regression (default 5)\n";
+	std::cerr << "  --counters            add hardware counters (cycles, instructions, IPC, cache, branch and TLB misses)\n";
+}
+
+static auto parse_size(std::string_view in) -> size_t {
+	const auto value = std::string(in);
+	char * end = nullptr;
+	size_t out = std::strtoull(value.c_str(), &end, 10);
+
+	switch (*end) {
+	case 'G': out *= 1024u; [[fallthrough]];
+	case 'M': out *= 1024u; [[fallthrough]];
+	case 'K': out *= 1024u; break;
+	default: break;
+	}
+
+	return out;
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("--filter=")) {
+			opts.filter = arg.substr(9);
+		} else if (arg.starts_with("--max-size=")) {
+			opts.max_size = parse_size(arg.substr(11));
+		} else if (arg.starts_with("--min-time=")) {
+			opts.min_time = std::atof(std::string(arg.substr(11)).c_str());
+		} else if (arg.starts_with("--output=")) {
+			opts.output = argv[i] + 9;
+		} else if (arg.starts_with("--compare=")) {
+			opts.baseline = argv[i] + 10;
+		} else if (arg.starts_with("--threshold=")) {
+			opts.threshold = std::atof(std::string(arg.substr(12)).c_str());
+		} else if (arg == "--counters") {
+			opts.counters = true;
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.max_size == 0u || opts.min_time <= 0.0) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+struct result {
+	std::string algorithm;
+	std::string implementation;
+	size_t size;
+	std::string alignment;
+	double gb_per_second;
+	double cycles_per_byte; // zero without cycle counter
+	size_t blocks{1u}; // calls of compression function for one message
+	cthash::tools::perf_counters::values counters{}; // per byte
+
+	auto key() const {
+		return std::tie(algorithm, implementation, size, alignment);
+	}
+};
+
+// number of iterations is doubled until a batch takes a fraction of `min_time`, then the best batch of several is kept
+// (the fastest run is the one least disturbed by the rest of the system)
+struct measurement {
+	double gb_per_second;
+	double cycles_per_byte;
+	size_t iterations;
+};
+
+static auto measure(const implementation & impl, std::span<const std::byte> in, double min_time) -> measurement {
+	using clock = std::chrono::steady_clock;
+	constexpr unsigned batches = 5u;
+
+	const auto batch = [&](size_t iterations) {
+		const auto start = clock::now();
+		const uint64_t start_cycles = cthash::tools::cycle_counter::now();
+		impl.run(in, iterations);
+		const uint64_t end_cycles = cthash::tools::cycle_counter::now_serialized();
+		const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+		return std::pair{seconds / static_cast<double>(iterations), static_cast<double>(end_cycles - start_cycles) / static_cast<double>(iterations)};
+	};
+
+	size_t iterations = 1u;
+	auto best = batch(iterations);
+
+	while (best.first * static_cast<double>(iterations) < min_time / batches) {
+		iterations *= 2u;
+		best = std::min(best, batch(iterations));
+	}
+
+	// large inputs which already take long enough are not repeated that many times
+	const unsigned repeat = (iterations == 1u) ? std::min(batches, static_cast<unsigned>(min_time / best.first) + 1u) : batches;
+
+	for (unsigned r = 1u; r < repeat; ++r) {
+		best = std::min(best, batch(iterations));
+	}
+
+	const double bytes = static_cast<double>(std::max<size_t>(in.size(), 1u));
+	return {bytes / best.first / 1e9, best.second / bytes, iterations};
+}
+
+// counters of one batch of the same size as was measured, normalized per byte
+static auto count_events(cthash::tools::perf_counters & counters, const implementation & impl, std::span<const std::byte> in, size_t iterations) -> cthash::tools::perf_counters::values {
+	counters.start();
+	impl.run(in, iterations);
+	auto out = counters.stop();
+
+	const double bytes = static_cast<double>(std::max<size_t>(in.size(), 1u) * iterations);
+	for (auto & value: out) {
+		if (value) {
+			*value /= bytes;
+		}
+	}
+
+	return out;
+}
+
+static void write_result(std::ostream & os, const result & r) {
+	os << "{\"algorithm\": ";
+	cthash::tools::write_json_string(os, r.algorithm);
+	os << ", \"implementation\": ";
+	cthash::tools::write_json_string(os, r.implementation);
+	os << ", \"size\": " << r.size << ", \"alignment\": ";
+	cthash::tools::write_json_string(os, r.alignment);
+	os << ", \"gb_per_second\": " << r.gb_per_second << ", \"cycles_per_byte\": " << r.cycles_per_byte;
+
+	// counters are per byte of message (at least one), its padding is hashed too
+	const double blocks_per_byte = static_cast<double>(r.blocks) / static_cast<double>(std::max<size_t>(r.size, 1u));
+
+	using counters = cthash::tools::perf_counters;
+	for (size_t i = 0; i != counters::count; ++i) {
+		if (r.counters[i]) {
+			os << ", \"" << counters::names[i] << "_per_byte\": " << *r.counters[i] << ", \"" << counters::names[i] << "_per_block\": " << *r.counters[i] / blocks_per_byte;
+		}
+	}
+
+	if (r.counters[counters::cycles] && r.counters[counters::instructions]) {
+		os << ", \"ipc\": " << *r.counters[counters::instructions] / *r.counters[counters::cycles];
+	}
+
+	os << "}";
+}
+
+// value of `"key": value` from one line written by `write_result`
+static auto field(std::string_view line, std::string_view key) -> std::optional<std::string_view> {
+	std::string name = "\"";
+	name.append(key).append("\": ");
+	const auto pos = line.find(name);
+
+	if (pos == std::string_view::npos) {
+		return std::nullopt;
+	}
+
+	auto value = line.substr(pos + name.size());
+
+	if (value.starts_with('"')) {
+		return value.substr(1u, value.find('"', 1u) - 1u);
+	}
+
+	return value.substr(0u, value.find_first_of(",}"));
+}
+
+static auto load_baseline(const char * path) -> std::optional<std::vector<result>> {
+	std::ifstream in{path};
+
+	if (not in) {
+		return std::nullopt;
+	}
+
+	std::vector<result> out;
+	std::string line;
+
+	while (std::getline(in, line)) {
+		const auto algorithm = field(line, "algorithm");
+		const auto impl = field(line, "implementation");
+		const auto size = field(line, "size");
+		const auto alignment = field(line, "alignment");
+		const auto gbps = field(line, "gb_per_second");
+
+		if (algorithm && impl && size && alignment && gbps) {
+			out.push_back({std::string(*algorithm), std::string(*impl), std::strtoull(std::string(*size).c_str(), nullptr, 10), std::string(*alignment), std::atof(std::string(*gbps).c_str()), 0.0});
+		}
+	}
+
+	return out;
+}
+
+// prints results which differ from the baseline more than `threshold` and returns number of regressions
+static auto compare(std::span<const result> baseline, std::span<const result> current, double threshold) -> size_t {
+	std::map<decltype(std::declval<const result &>().key()), const result *> previous;
+	for (const auto & r: baseline) {
+		previous.emplace(r.key(), &r);
+	}
+
+	size_t regressions = 0u;
+
+	for (const auto & r: current) {
+		const auto it = previous.find(r.key());
+
+		if (it == previous.end() || it->second->gb_per_second <= 0.0) {
+			continue;
+		}
+
+		const double change = (r.gb_per_second / it->second->gb_per_second - 1.0) * 100.0;
+
+		if (change < -threshold) {
+			++regressions;
+			std::cerr << "REGRESSION ";
+		} else if (change > threshold) {
+			std::cerr << "improvement ";
+		} else {
+			continue;
+		}
+
+		std::cerr << r.algorithm << " (" << r.implementation << ") " << r.size << " B " << r.alignment << ": " << it->second->gb_per_second << " -> " << r.gb_per_second << " GB/s (" << change << " %)\n";
+	}
+
+	return regressions;
+}
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	std::optional<std::vector<result>> baseline;
+
+	if (opts->baseline != nullptr) {
+		baseline = load_baseline(opts->baseline);
+
+		if (not baseline) {
+			std::cerr << opts->baseline << ": can't read baseline\n";
+			return 1;
+		}
+	}
+
+	// sizes are spread over the range with more of them among short messages, where constant costs dominate
+	std::vector<size_t> sizes;
+	for (const size_t size: {1u, 16u, 64u, 256u, 1024u, 4096u, 65536u, 1u << 20u, 16u << 20u, 1u << 30u}) {
+		if (size <= opts->max_size) {
+			sizes.push_back(size);
+		}
+	}
+
+	// misaligned input starts one byte after a cache line boundary
+	constexpr size_t line = 64u;
+	const auto storage = std::make_unique_for_overwrite<std::byte[]>(sizes.back() + 2u * line);
+	auto * const aligned = storage.get() + (line - reinterpret_cast<uintptr_t>(storage.get()) % line);
+
+	for (size_t i = 0; i != sizes.back() + line; ++i) {
+		aligned[i] = static_cast<std::byte>(i * 31u + (i >> 8u));
+	}
+
+	std::ofstream file;
+	if (opts->output != nullptr) {
+		file.open(opts->output);
+	}
+	std::ostream & out = (opts->output != nullptr) ? file : std::cout;
+
+	out << "{\"cpu\": ";
+	cthash::tools::write_json_string(out, cthash::tools::cpu_model());
+	out << ", \"cycle_counter\": " << (cthash::tools::cycle_counter::available ? "true" : "false") << ", \"results\": [\n";
+
+	std::vector<result> results;
+	std::optional<cthash::tools::perf_counters> counters;
+
+	if (opts->counters) {
+		counters.emplace();
+		if (not counters->error.empty()) {
+			std::cerr << "some hardware counters are not available: " << counters->error << "\n";
+		}
+	}
+
+	for (const auto & impl: implementations) {
+		if (not opts->filter.empty() && impl.algorithm.find(opts->filter) == std::string_view::npos && impl.name.find(opts->filter) == std::string_view::npos) {
+			continue;
+		}
+
+		for (const size_t size: sizes) {
+			for (const size_t offset: {size_t{0}, size_t{1}}) {
+				const auto in = std::span<const std::byte>(aligned + offset, size);
+				const auto [gbps, cpb, iterations] = measure(impl, in, opts->min_time);
+				results.push_back({std::string(impl.algorithm), std::string(impl.name), size, (offset == 0u) ? "aligned" : "misaligned", gbps, cpb, impl.blocks(size)});
+
+				if (counters && counters->available()) {
+					results.back().counters = count_events(*counters, impl, in, iterations);
+				}
+
+				out << (results.size() == 1u ? "" : ",\n");
+				write_result(out, results.back());
+				out.flush();
+
+				std::cerr << impl.algorithm << " (" << impl.name << ") " << size << " B " << results.back().alignment << ": " << gbps << " GB/s, " << cpb << " cycles/B";
+				if (const auto & c = results.back().counters; c[0] && c[1]) {
+					std::cerr << ", IPC " << *c[1] / *c[0];
+				}
+				std::cerr << "\n";
+			}
+		}
+	}
+
+	out << "\n]}\n";
+
+	if (baseline) {
+		const size_t regressions = compare(*baseline, results, opts->threshold);
+		std::cerr << regressions << " regression(s) against " << opts->baseline << "\n";
+		return (regressions == 0u) ? 0 : 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef CTHASH_BENCH_IMPLEMENTATIONS_HPP
+#define CTHASH_BENCH_IMPLEMENTATIONS_HPP
+
+#include <cthash/cthash.hpp>
+#include <array>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+#ifdef CTHASH_BENCH_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+#ifdef CTHASH_BENCH_XXHASH
+#include <xxhash.h>
+#endif
+
+// hash functions measured by benchmarks: all algorithms of cthash and the same algorithms of OpenSSL
+// and reference xxHash when they are available
+
+// keeps the digest alive, so the hashing isn't optimized away
+template <typename T> inline void keep(const T & value) {
+	asm volatile("" : : "r"(&value) : "memory");
+}
+
+// each implementation hashes the same input `iterations` times, it's one call so there is no indirect call per message
+struct implementation {
+	std::string_view algorithm;
+	std::string_view name;
+	std::string_view family; // implementations of one family share their code
+	size_t (*blocks)(size_t size); // calls of compression (or permutation) function for one message with its padding
+	void (*run)(std::span<const std::byte>, size_t iterations);
+};
+
+// Merkle-Damgård: at least one byte of padding and the length fill the last block (or spill into the next one)
+template <size_t Block, size_t LengthBytes> constexpr auto padded_blocks(size_t size) noexcept -> size_t {
+	return (size + 1u + LengthBytes + Block - 1u) / Block;
+}
+
+// sponge: padding takes at least one byte, so a full last block is followed by one more, digests fit into one squeeze
+template <size_t Rate> constexpr auto sponge_blocks(size_t size) noexcept -> size_t {
+	return size / Rate + 1u;
+}
+
+// xxhash: full stripes and one finalization of the remaining bytes
+template <size_t Stripe> constexpr auto stripe_blocks(size_t size) noexcept -> size_t {
+	return size / Stripe + 1u;
+}
+
+template <typename Hasher> void run_cthash(std::span<const std::byte> in, size_t iterations) {
+	for (size_t i = 0; i != iterations; ++i) {
+		keep(Hasher{}.update(in).final());
+	}
+}
+
+template <typename Hasher, size_t Bits> void run_cthash_xof(std::span<const std::byte> in, size_t iterations) {
+	for (size_t i = 0; i != iterations; ++i) {
+		keep(Hasher{}.update(in).template final<Bits>());
+	}
+}
+
+#ifdef CTHASH_BENCH_OPENSSL
+template <const EVP_MD * (*Md)(), size_t XofBytes = 0u> void run_openssl(std::span<const std::byte> in, size_t iterations) {
+	const auto ctx = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+	const EVP_MD * md = Md();
+	std::array<unsigned char, EVP_MAX_MD_SIZE> out;
+
+	for (size_t i = 0; i != iterations; ++i) {
+		EVP_DigestInit_ex(ctx.get(), md, nullptr);
+		EVP_DigestUpdate(ctx.get(), in.data(), in.size());
+		if constexpr (XofBytes != 0u) {
+			EVP_DigestFinalXOF(ctx.get(), out.data(), XofBytes);
+		} else {
+			EVP_DigestFinal_ex(ctx.get(), out.data(), nullptr);
+		}
+		keep(out);
+	}
+}
+#endif
+
+#ifdef CTHASH_BENCH_XXHASH
+inline void run_xxhash32(std::span<const std::byte> in, size_t iterations) {
+	for (size_t i = 0; i != iterations; ++i) {
+		keep(XXH32(in.data(), in.size(), 0u));
+	}
+}
+
+inline void run_xxhash64(std::span<const std::byte> in, size_t iterations) {
+	for (size_t i = 0; i != iterations; ++i) {
+		keep(XXH64(in.data(), in.size(), 0u));
+	}
+}
+#endif
+
+inline const auto implementations = std::vector<implementation>{
+	{"sha-1", "cthash", "cthash-sha-1", padded_blocks<64u, 8u>, run_cthash<cthash::sha1>},
+	{"sha-224", "cthash", "cthash-sha-256", padded_blocks<64u, 8u>, run_cthash<cthash::sha224>},
+	{"sha-256", "cthash", "cthash-sha-256", padded_blocks<64u, 8u>, run_cthash<cthash::sha256>},
+	{"sha-384", "cthash", "cthash-sha-512", padded_blocks<128u, 16u>, run_cthash<cthash::sha384>},
+	{"sha-512", "cthash", "cthash-sha-512", padded_blocks<128u, 16u>, run_cthash<cthash::sha512>},
+	{"sha-512/224", "cthash", "cthash-sha-512", padded_blocks<128u, 16u>, run_cthash<cthash::sha512t<224>>},
+	{"sha-512/256", "cthash", "cthash-sha-512", padded_blocks<128u, 16u>, run_cthash<cthash::sha512t<256>>},
+	{"sha3-224", "cthash", "cthash-keccak", sponge_blocks<144u>, run_cthash<cthash::sha3_224>},
+	{"sha3-256", "cthash", "cthash-keccak", sponge_blocks<136u>, run_cthash<cthash::sha3_256>},
+	{"sha3-384", "cthash", "cthash-keccak", sponge_blocks<104u>, run_cthash<cthash::sha3_384>},
+	{"sha3-512", "cthash", "cthash-keccak", sponge_blocks<72u>, run_cthash<cthash::sha3_512>},
+	{"shake-128/256", "cthash", "cthash-keccak", sponge_blocks<168u>, run_cthash_xof<cthash::shake128, 256>},
+	{"shake-256/512", "cthash", "cthash-keccak", sponge_blocks<136u>, run_cthash_xof<cthash::shake256, 512>},
+	{"xxhash32", "cthash", "cthash-xxhash", stripe_blocks<16u>, run_cthash<cthash::xxhash32>},
+	{"xxhash64", "cthash", "cthash-xxhash", stripe_blocks<32u>, run_cthash<cthash::xxhash64>},
+	{"xxhash64-seg", "cthash", "cthash-xxhash", stripe_blocks<32u>, run_cthash<cthash::segmented_xxhash64<>>},
+#ifdef CTHASH_BENCH_OPENSSL
+	{"sha-1", "openssl", "openssl-sha-1", padded_blocks<64u, 8u>, run_openssl<EVP_sha1>},
+	{"sha-224", "openssl", "openssl-sha-256", padded_blocks<64u, 8u>, run_openssl<EVP_sha224>},
+	{"sha-256", "openssl", "openssl-sha-256", padded_blocks<64u, 8u>, run_openssl<EVP_sha256>},
+	{"sha-384", "openssl", "openssl-sha-512", padded_blocks<128u, 16u>, run_openssl<EVP_sha384>},
+	{"sha-512", "openssl", "openssl-sha-512", padded_blocks<128u, 16u>, run_openssl<EVP_sha512>},
+	{"sha-512/224", "openssl", "openssl-sha-512", padded_blocks<128u, 16u>, run_openssl<EVP_sha512_224>},
+	{"sha-512/256", "openssl", "openssl-sha-512", padded_blocks<128u, 16u>, run_openssl<EVP_sha512_256>},
+	{"sha3-224", "openssl", "openssl-keccak", sponge_blocks<144u>, run_openssl<EVP_sha3_224>},
+	{"sha3-256", "openssl", "openssl-keccak", sponge_blocks<136u>, run_openssl<EVP_sha3_256>},
+	{"sha3-384", "openssl", "openssl-keccak", sponge_blocks<104u>, run_openssl<EVP_sha3_384>},
+	{"sha3-512", "openssl", "openssl-keccak", sponge_blocks<72u>, run_openssl<EVP_sha3_512>},
+	{"shake-128/256", "openssl", "openssl-keccak", sponge_blocks<168u>, run_openssl<EVP_shake128, 32u>},
+	{"shake-256/512", "openssl", "openssl-keccak", sponge_blocks<136u>, run_openssl<EVP_shake256, 64u>},
+#endif
+#ifdef CTHASH_BENCH_XXHASH
+	{"xxhash32", "xxhash", "xxhash-xxhash", stripe_blocks<16u>, run_xxhash32},
+	{"xxhash64", "xxhash", "xxhash-xxhash", stripe_blocks<32u>, run_xxhash64},
+#endif
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "../tools/cpu.hpp"
+#include "../tools/histogram.hpp"
+#include "implementations.hpp"
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// Latency of hashing a single short message, each call is timed separately, so percentiles and the first call
+// (cost of touching code and constant tables for the first time) are visible. In cold mode caches are evicted
+// before each call: other families of hash functions are run to push out instructions and branch history
+// and a buffer larger than the last level cache is written to push out data (input and tables).
+
+struct options {
+	std::string_view filter{};
+	size_t iterations{100'000u};
+	size_t cold_iterations{1000u};
+	size_t evict_size{0u};
+	bool hot{true};
+	bool cold{true};
+	bool histogram{false};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options]\n";
+	std::cerr << "measures latency percentiles of hashing single messages of 16 to 1024 bytes with hot and cold caches\n";
+	std::cerr << "options:\n";
+	std::cerr << "  --filter=TEXT         only algorithms or implementations containing TEXT\n";
+	std::cerr << "  --mode=hot|cold|both  which caches to measure with (default both)\n";
+	std::cerr << "  --iterations=N        calls measured with hot caches (default 100000)\n";
+	std::cerr << "  --cold-iterations=N   calls measured with cold caches (default 1000)\n";
+	std::cerr << "  --evict-size=BYTES    size of buffer written between cold calls (default 2x last level cache)\n";
+	std::cerr << "  --histogram           print whole distribution of each measurement instead of CSV summary\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("--filter=")) {
+			opts.filter = arg.substr(9);
+		} else if (arg == "--mode=hot" || arg == "--mode=cold" || arg == "--mode=both") {
+			opts.hot = (arg != "--mode=cold");
+			opts.cold = (arg != "--mode=hot");
+		} else if (arg.starts_with("--iterations=")) {
+			opts.iterations = std::strtoull(std::string(arg.substr(13)).c_str(), nullptr, 10);
+		} else if (arg.starts_with("--cold-iterations=")) {
+			opts.cold_iterations = std::strtoull(std::string(arg.substr(18)).c_str(), nullptr, 10);
+		} else if (arg.starts_with("--evict-size=")) {
+			opts.evict_size = std::strtoull(std::string(arg.substr(13)).c_str(), nullptr, 10);
+		} else if (arg == "--histogram") {
+			opts.histogram = true;
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.iterations == 0u || opts.cold_iterations == 0u) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+static auto last_level_cache() -> size_t {
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+	if (const long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE); l3 > 0) {
+		return static_cast<size_t>(l3);
+	}
+	if (const long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE); l2 > 0) {
+		return static_cast<size_t>(l2);
+	}
+#endif
+	return 32u * 1024u * 1024u;
+}
+
+// time of one call in ticks of the timestamp counter (or in nanoseconds without it)
+struct call_timer {
+	uint64_t overhead{0u};
+
+	template <typename Fn> static auto raw(Fn && fn) -> uint64_t {
+		if constexpr (cthash::tools::cycle_counter::available) {
+			const uint64_t start = cthash::tools::cycle_counter::begin();
+			fn();
+			return cthash::tools::cycle_counter::end() - start;
+		} else {
+			const auto start = std::chrono::steady_clock::now();
+			fn();
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+	}
+
+	// cost of timing itself (the smallest of many empty measurements) is subtracted from each call
+	call_timer() {
+		overhead = UINT64_MAX;
+		for (int i = 0; i != 10'000; ++i) {
+			overhead = std::min(overhead, raw([] {}));
+		}
+	}
+
+	template <typename Fn> auto operator()(Fn && fn) const -> uint64_t {
+		const uint64_t t = raw(fn);
+		return (t > overhead) ? t - overhead : 0u;
+	}
+
+	static auto nanoseconds_per_tick() -> double {
+		if constexpr (cthash::tools::cycle_counter::available) {
+			return 1e9 / cthash::tools::cycle_counter::ticks_per_second();
+		} else {
+			return 1.0;
+		}
+	}
+};
+
+struct evictor {
+	std::unique_ptr<std::byte[]> buffer;
+	size_t size;
+	std::vector<std::byte> other_input = std::vector<std::byte>(4096u, std::byte{0x5A});
+
+	explicit evictor(size_t s): buffer{std::make_unique<std::byte[]>(s)}, size{s} { }
+
+	void operator()(const implementation & measured) {
+		// code of other families goes through L1i, L2 and branch predictors
+		for (const auto & other: implementations) {
+			if (other.family != measured.family) {
+				other.run(other_input, 1u);
+			}
+		}
+
+		// each line is written, so also dirty lines are evicted
+		for (size_t i = 0; i < size; i += 64u) {
+			buffer[i] = static_cast<std::byte>(static_cast<unsigned>(buffer[i]) + 1u);
+		}
+		keep(buffer[0]);
+	}
+};
+
+static void print_distribution(std::string_view title, const cthash::tools::latency_histogram & h, double ns_per_tick) {
+	std::cout << "# " << title << "\n";
+	std::cout << "value_ns,percentile,count\n";
+
+	h.for_each_bucket([&](uint64_t value, uint64_t count, double cumulative) {
+		std::cout << static_cast<double>(value) * ns_per_tick << "," << std::setprecision(6) << cumulative * 100.0 << "," << count << "\n";
+	});
+
+	std::cout << "\n";
+}
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	const call_timer timer{};
+	const double ns_per_tick = call_timer::nanoseconds_per_tick();
+	evictor evict{(opts->evict_size != 0u) ? opts->evict_size : 2u * last_level_cache()};
+
+	std::cerr << "timer overhead: " << static_cast<double>(timer.overhead) * ns_per_tick << " ns, eviction buffer: " << evict.size << " B\n";
+
+	// input is in its own allocation of the largest size, so the smaller ones don't share lines with anything else
+	constexpr size_t largest = 1024u;
+	const auto input = std::make_unique<std::byte[]>(largest);
+	for (size_t i = 0; i != largest; ++i) {
+		input[i] = static_cast<std::byte>(i * 7u);
+	}
+
+	if (not opts->histogram) {
+		std::cout << "algorithm,implementation,size,mode,count,first_ns,min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n";
+	}
+
+	for (const auto & impl: implementations) {
+		if (not opts->filter.empty() && impl.algorithm.find(opts->filter) == std::string_view::npos && impl.name.find(opts->filter) == std::string_view::npos) {
+			continue;
+		}
+
+		for (const size_t size: {16u, 32u, 64u, 128u, 256u, 512u, 1024u}) {
+			const auto message = std::span<const std::byte>(input.get(), size);
+
+			// cold mode goes first, so the very first call of each implementation is its real first call
+			for (const bool cold: {true, false}) {
+				if ((cold && not opts->cold) || (not cold && not opts->hot)) {
+					continue;
+				}
+
+				cthash::tools::latency_histogram h;
+				uint64_t first = 0u;
+				const size_t count = cold ? opts->cold_iterations : opts->iterations;
+
+				for (size_t i = 0; i != count; ++i) {
+					if (cold) {
+						evict(impl);
+					}
+
+					const uint64_t t = timer([&] { impl.run(message, 1u); });
+					first = (i == 0u) ? t : first;
+					h.record(t);
+				}
+
+				const auto ns = [&](uint64_t ticks) { return static_cast<double>(ticks) * ns_per_tick; };
+				const auto mode = cold ? "cold" : "hot";
+
+				if (opts->histogram) {
+					print_distribution(std::string(impl.algorithm) + " (" + std::string(impl.name) + ") " + std::to_string(size) + " B " + mode, h, ns_per_tick);
+				} else {
+					std::cout << impl.algorithm << "," << impl.name << "," << size << "," << mode << "," << h.total << "," << ns(first) << "," << ns(h.minimum) << "," << ns(h.percentile(50.0)) << "," << ns(h.percentile(90.0)) << "," << ns(h.percentile(99.0)) << "," << ns(h.percentile(99.9)) << "," << ns(h.maximum) << "\n";
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,146 @@
+#include "../tools/algorithms.hpp"
+#include "../tools/autotune.hpp"
+#include "../tools/numa.hpp"
+#include "../tools/thread-pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Measures how hashing on `thread_pool` scales with number of workers. Data is split into chunks which live on
+// different nodes (like page cache of files from devices attached to different nodes) and each chunk is hashed by
+// a task submitted with its node, as `checksum -j` does. NUMA-aware pool (workers pinned to nodes, per-node queues)
+// is compared with a pool without topology (same as `checksum --no-numa`). Output is CSV.
+
+enum class pool_kind { numa, plain };
+
+struct chunk {
+	std::unique_ptr<std::byte[]> data;
+	size_t node;
+};
+
+struct run_result {
+	double seconds;
+	uint64_t bytes;
+	double local_fraction;
+};
+
+// chunks are spread over nodes round robin, each is first touched by a thread pinned to its node
+static auto place_chunks(const cthash::tools::numa_topology & topology, size_t count, size_t chunk_size) -> std::vector<chunk> {
+	std::vector<chunk> chunks(count);
+	std::vector<std::thread> touchers;
+
+	for (size_t node = 0; node != topology.size(); ++node) {
+		touchers.emplace_back([&, node] {
+			if (topology.size() > 1u) {
+				cthash::tools::pin_current_thread(topology.nodes[node].cpus);
+			}
+
+			for (size_t i = node; i < count; i += topology.size()) {
+				chunks[i].node = node;
+				chunks[i].data = std::make_unique_for_overwrite<std::byte[]>(chunk_size);
+
+				for (size_t j = 0; j != chunk_size; ++j) {
+					chunks[i].data[j] = static_cast<std::byte>(j * 31u + i);
+				}
+			}
+		});
+	}
+
+	for (auto & t: touchers) {
+		t.join();
+	}
+
+	return chunks;
+}
+
+// node of the CPU which runs the calling thread
+static auto current_node(const cthash::tools::numa_topology & topology) -> size_t {
+#ifdef __linux__
+	const int cpu = sched_getcpu();
+
+	for (size_t node = 0; node != topology.size(); ++node) {
+		if (std::ranges::find(topology.nodes[node].cpus, static_cast<unsigned>(cpu)) != topology.nodes[node].cpus.end()) {
+			return node;
+		}
+	}
+#endif
+	(void)topology;
+	return 0u;
+}
+
+static auto run(const cthash::tools::algorithm & algorithm, const cthash::tools::numa_topology & topology, const std::vector<chunk> & chunks, size_t chunk_size, size_t threads, pool_kind kind, unsigned rounds) -> run_result {
+	auto pool = cthash::tools::thread_pool{threads, (kind == pool_kind::numa) ? &topology : nullptr};
+	std::atomic<size_t> local{0u};
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned r = 0; r != rounds; ++r) {
+		for (const auto & c: chunks) {
+			const auto task = [&](size_t) {
+				cthash::tools::keep_digest(algorithm.digest_of(std::span<const std::byte>(c.data.get(), chunk_size)));
+
+				if (current_node(topology) == c.node) {
+					++local;
+				}
+			};
+
+			pool.submit(task, (kind == pool_kind::numa) ? c.node : cthash::tools::thread_pool::any_node);
+		}
+	}
+
+	pool.wait();
+
+	const auto end = std::chrono::steady_clock::now();
+	const size_t tasks = chunks.size() * rounds;
+
+	return {std::chrono::duration<double>(end - start).count(), static_cast<uint64_t>(chunk_size) * tasks, static_cast<double>(local.load()) / static_cast<double>(tasks)};
+}
+
+int main(int argc, char ** argv) {
+	constexpr size_t chunk_size = 4u * 1024u * 1024u;
+
+	const auto algorithm_name = std::string_view((argc > 1) ? argv[1] : "xxhash64");
+	const size_t total_size = ((argc > 2) ? static_cast<size_t>(std::atoi(argv[2])) : size_t{256}) * 1024u * 1024u;
+	const unsigned rounds = (argc > 3) ? static_cast<unsigned>(std::atoi(argv[3])) : 4u;
+
+	const auto * algorithm = cthash::tools::find_algorithm(algorithm_name);
+
+	if (algorithm == nullptr || total_size < chunk_size || rounds == 0u) {
+		std::cerr << argv[0] << " [hash [MiB [rounds]]]\n";
+		return 1;
+	}
+
+	const auto topology = cthash::tools::numa_topology::detect();
+	const size_t max_threads = cthash::tools::thread_pool::default_size();
+	const auto chunks = place_chunks(topology, total_size / chunk_size, chunk_size);
+
+	std::cerr << "nodes: " << topology.size() << ", CPUs: " << max_threads << "\n";
+	std::cout << "threads,pool,seconds,gb_per_second,speedup,efficiency,local_tasks\n";
+
+	// powers of two and all CPUs
+	std::vector<size_t> thread_counts;
+	for (size_t threads = 1u; threads < max_threads; threads *= 2u) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+
+	double single = 0.0;
+
+	for (const size_t threads: thread_counts) {
+		for (const auto kind: {pool_kind::numa, pool_kind::plain}) {
+			const auto r = run(*algorithm, topology, chunks, chunk_size, threads, kind, rounds);
+			const double gbps = static_cast<double>(r.bytes) / r.seconds / 1e9;
+
+			if (threads == 1u && kind == pool_kind::numa) {
+				single = gbps;
+			}
+
+			std::cout << threads << "," << ((kind == pool_kind::numa) ? "numa" : "plain") << "," << r.seconds << "," << gbps << "," << (gbps / single) << "," << (gbps / single / static_cast<double>(threads)) << "," << r.local_fraction << "\n";
+		}
+	}
+}
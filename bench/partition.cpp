@@ -0,0 +1,79 @@
+#include "../tools/partition.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Compares hash partitioning of a key column (two-pass and single-pass with write-combining) with a naive loop
+// which hashes each row separately and appends it to its partition. Output is CSV.
+
+static auto naive(std::span<const uint64_t> keys, unsigned bits) -> std::vector<std::vector<uint32_t>> {
+	std::vector<std::vector<uint32_t>> out(size_t{1} << bits);
+
+	for (size_t i = 0; i != keys.size(); ++i) {
+		const auto digest = cthash::xxhash64{}.update(std::span(reinterpret_cast<const std::byte *>(&keys[i]), sizeof(uint64_t))).final();
+		const auto h = cthash::cast_from_bytes<uint64_t>(std::span<const std::byte, 8>(digest.data(), 8u));
+		out[(bits == 0u) ? 0u : static_cast<size_t>(h >> (64u - bits))].push_back(static_cast<uint32_t>(i));
+	}
+
+	return out;
+}
+
+// median of `repeats` runs (the VM or a noisy neighbour easily doubles a single run), result of the last one
+template <typename F> static auto measure(size_t repeats, F && f) {
+	std::vector<double> times;
+	auto result = decltype(f()){};
+
+	for (size_t r = 0; r != repeats; ++r) {
+		result = {};
+		const auto start = std::chrono::steady_clock::now();
+		result = f();
+		times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	std::ranges::sort(times);
+	return std::pair{times[times.size() / 2u], std::move(result)};
+}
+
+int main(int argc, char ** argv) {
+	const size_t rows = ((argc > 1) ? static_cast<size_t>(std::atoi(argv[1])) : size_t{16}) * 1'000'000u;
+	const size_t repeats = (argc > 2) ? static_cast<size_t>(std::atoi(argv[2])) : size_t{5};
+
+	if (rows == 0u || rows > cthash::tools::max_partitioned_rows || repeats == 0u) {
+		std::cerr << argv[0] << " [million-rows [repeats]]\n";
+		return 1;
+	}
+
+	const auto tuning = cthash::tools::partition_tuning::detect();
+	std::cerr << "L1: " << tuning.l1_bytes << ", L2: " << tuning.l2_bytes << ", TLB: " << tuning.tlb_entries << ", STLB: " << tuning.stlb_entries << ", page: " << tuning.page_bytes << ", buffered fanout bits: " << tuning.buffered_bits(rows * sizeof(uint32_t)) << "\n";
+
+	std::vector<uint64_t> keys(rows);
+	auto rng = std::mt19937_64{42u};
+	for (auto & k: keys) {
+		k = rng();
+	}
+
+	std::cout << "bits,method,seconds,mrows_per_second,speedup\n";
+
+	for (const unsigned bits: {4u, 8u, 12u, 16u}) {
+		const auto [naive_time, expected] = measure(repeats, [&] { return naive(keys, bits); });
+		const auto [single_time, single] = measure(repeats, [&] { return cthash::tools::partition_single_pass(keys, bits, tuning); });
+		const auto [two_time, two] = measure(repeats, [&] { return cthash::tools::partition_two_pass(keys, bits, tuning); });
+
+		// all variants keep rows of each partition in order
+		bool same = single == expected;
+		for (size_t p = 0; p != expected.size(); ++p) {
+			same &= std::ranges::equal(two.partition(p), expected[p]);
+		}
+
+		if (not same) {
+			std::cerr << "partitions differ for " << bits << " bits!\n";
+			return 1;
+		}
+
+		for (const auto & [name, seconds]: {std::pair{"naive", naive_time}, std::pair{"single-pass", single_time}, std::pair{"two-pass", two_time}}) {
+			std::cout << bits << "," << name << "," << seconds << "," << (static_cast<double>(rows) / seconds / 1e6) << "," << (naive_time / seconds) << "\n";
+		}
+	}
+}
@@ -0,0 +1,350 @@
+#include "../tools/algorithms.hpp"
+#include "../tools/autotune.hpp"
+#include "../tools/numa.hpp"
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Measures how parallel ways of hashing scale from one thread to all CPUs (each thread pinned to its own CPU, CPUs are
+// taken from nodes in turns): many short messages split between threads (hashed in multi-buffer lanes when the hash
+// function has them), and the built `checksum -j N` hashing one large file as segmented xxhash64 and many files (so its
+// thread pool, I/O and output are measured, process start included). Memory bandwidth of the same number of threads
+// (STREAM-like read and triad) is measured as a baseline. Output is CSV.
+
+extern char ** environ;
+
+struct options {
+	std::string checksum{CTHASH_CHECKSUM_PATH};
+	const cthash::tools::algorithm * algorithm{cthash::tools::find_algorithm("sha-256")};
+	size_t size{256u * 1024u * 1024u};
+	size_t max_threads{std::max(std::thread::hardware_concurrency(), 1u)};
+	std::filesystem::path directory{std::filesystem::temp_directory_path()};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options]\n";
+	std::cerr << "measures throughput of parallel hashing for 1, 2, 4 ... N threads next to memory bandwidth\n";
+	std::cerr << "options:\n";
+	std::cerr << "  --checksum=PATH       checksum binary for segmented and files workloads (default the one built with this benchmark)\n";
+	std::cerr << "  --hash=NAME           hash function for messages and files (default sha-256)\n";
+	std::cerr << "  --mib=N               size of data in each measurement (default 256)\n";
+	std::cerr << "  --max-threads=N       the largest number of threads (default is number of CPUs)\n";
+	std::cerr << "  --dir=PATH            where temporary files for multi-file hashing are written\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("--checksum=")) {
+			opts.checksum = std::string(arg.substr(11));
+		} else if (arg.starts_with("--hash=")) {
+			opts.algorithm = cthash::tools::find_algorithm(arg.substr(7));
+			if (opts.algorithm == nullptr) {
+				std::cerr << "unknown hash function!\n";
+				return std::nullopt;
+			}
+		} else if (arg.starts_with("--mib=")) {
+			opts.size = std::strtoull(std::string(arg.substr(6)).c_str(), nullptr, 10) * 1024u * 1024u;
+		} else if (arg.starts_with("--max-threads=")) {
+			opts.max_threads = std::strtoull(std::string(arg.substr(14)).c_str(), nullptr, 10);
+		} else if (arg.starts_with("--dir=")) {
+			opts.directory = std::string(arg.substr(6));
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.size == 0u || opts.max_threads == 0u) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+// CPUs in order in which threads are pinned: one from each node in turns, so more threads use more memory controllers
+static auto cpu_order(const cthash::tools::numa_topology & topology) -> std::vector<unsigned> {
+	std::vector<unsigned> out;
+	size_t largest = 0u;
+
+	for (const auto & node: topology.nodes) {
+		largest = std::max(largest, node.cpus.size());
+	}
+
+	for (size_t i = 0; i != largest; ++i) {
+		for (const auto & node: topology.nodes) {
+			if (i < node.cpus.size()) {
+				out.push_back(node.cpus[i]);
+			}
+		}
+	}
+
+	return out;
+}
+
+// runs `fn(index)` on `threads` pinned threads and returns time from their common start to the end of the last one
+static auto run_pinned(std::span<const unsigned> cpus, size_t threads, const std::function<void(size_t)> & fn) -> double {
+	using clock = std::chrono::steady_clock;
+	std::barrier start{static_cast<std::ptrdiff_t>(threads + 1u)};
+	std::vector<std::thread> workers;
+
+	for (size_t i = 0; i != threads; ++i) {
+		workers.emplace_back([&, i] {
+			cthash::tools::pin_current_thread({cpus[i % cpus.size()]});
+			start.arrive_and_wait();
+			fn(i);
+		});
+	}
+
+	start.arrive_and_wait();
+	const auto begin = clock::now();
+
+	for (auto & t: workers) {
+		t.join();
+	}
+
+	return std::chrono::duration<double>(clock::now() - begin).count();
+}
+
+// part `i` of `n` equal parts of range [0, size) aligned to `granularity`
+static auto part_of(size_t size, size_t i, size_t n, size_t granularity) -> std::pair<size_t, size_t> {
+	const size_t units = size / granularity;
+	return {units * i / n * granularity, (i + 1u == n) ? size : units * (i + 1u) / n * granularity};
+}
+
+// runs checksum with digests going to `output` and errors to `log`, it returns wall time and printed lines (sorted,
+// as files are finished in any order) or nothing when checksum fails
+static auto run_checksum(const std::vector<std::string> & args, const std::filesystem::path & output, const std::filesystem::path & log) -> std::optional<std::pair<double, std::vector<std::string>>> {
+	std::vector<char *> argv;
+	for (const auto & a: args) {
+		argv.push_back(const_cast<char *>(a.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	const auto start = std::chrono::steady_clock::now();
+	pid_t pid;
+
+	const int spawned = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	if (spawned != 0) {
+		return std::nullopt;
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (not WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		return std::nullopt;
+	}
+
+	std::vector<std::string> lines;
+	std::ifstream in{output};
+	for (std::string line; std::getline(in, line);) {
+		lines.push_back(std::move(line));
+	}
+	std::ranges::sort(lines);
+
+	return std::pair{seconds, std::move(lines)};
+}
+
+struct workload {
+	std::string_view name;
+	std::function<std::pair<double, uint64_t>(size_t threads)> run; // seconds and processed bytes
+};
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	const auto topology = cthash::tools::numa_topology::detect();
+	const auto cpus = cpu_order(topology);
+	const size_t size = opts->size;
+
+	// data is first touched by threads pinned as in measurements, so its pages are spread over nodes
+	const auto data = std::make_unique_for_overwrite<std::byte[]>(size);
+	const auto doubles = std::make_unique_for_overwrite<double[]>(3u * (size / sizeof(double)));
+	const size_t elements = size / sizeof(double);
+	double * const a = doubles.get();
+	double * const b = a + elements;
+	double * const c = b + elements;
+
+	run_pinned(cpus, opts->max_threads, [&](size_t i) {
+		const auto [from, to] = part_of(size, i, opts->max_threads, 4096u);
+		for (size_t j = from; j != to; ++j) {
+			data[j] = static_cast<std::byte>(j * 31u + (j >> 12u));
+		}
+		const auto [first, last] = part_of(elements, i, opts->max_threads, 512u);
+		for (size_t j = first; j != last; ++j) {
+			a[j] = 0.0;
+			b[j] = static_cast<double>(j);
+			c[j] = 1.0;
+		}
+	});
+
+	const auto input = std::span<const std::byte>(data.get(), size);
+
+	// one large file for segmented hashing and files for multi-file hashing, page cache is warm as they were just written
+	constexpr size_t file_count = 64u;
+	const auto directory = opts->directory / ("cthash-scaling-" + std::to_string(::getpid()));
+	const auto files = directory / "files";
+	const auto large = directory / "large";
+	const auto output = directory / "checksum.out";
+	const auto log = directory / "checksum.log";
+	std::filesystem::create_directories(files);
+
+	std::ofstream{large, std::ios::binary}.write(reinterpret_cast<const char *>(data.get()), static_cast<std::streamsize>(size));
+
+	// lines which checksum prints for each workload
+	std::vector<std::string> expected_files;
+	const auto expected_segmented = std::vector<std::string>{(std::ostringstream{} << cthash::segmented_xxhash64<>{}.update(input).final()).str()};
+
+	for (size_t f = 0; f != file_count; ++f) {
+		const auto [from, to] = part_of(size, f, file_count, 4096u);
+		const auto path = files / std::to_string(f);
+		std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char *>(data.get() + from), static_cast<std::streamsize>(to - from));
+		expected_files.push_back((std::ostringstream{} << opts->algorithm->digest_of(input.subspan(from, to - from)) << "  " << path.string()).str());
+	}
+	std::ranges::sort(expected_files);
+
+	const auto checksum = [&](std::vector<std::string> args, const std::vector<std::string> & expected, size_t threads) {
+		args.insert(args.begin(), {opts->checksum, "-j" + std::to_string(threads)});
+		const auto r = run_checksum(args, output, log);
+
+		// files are kept, so the failure can be inspected
+		if (not r || r->second != expected) {
+			std::cerr << (r ? "checksum printed unexpected digests, see " : "checksum failed, see ") << (r ? output : log) << "\n";
+			std::exit(1);
+		}
+
+		return std::pair{r->first, uint64_t{size}};
+	};
+
+	// messages are independent, so batches of them are hashed in lanes of multi-buffer kernel when the algorithm has it
+	constexpr size_t message_size = 4096u;
+	constexpr size_t message_batch = 64u;
+
+	const auto workloads = std::vector<workload>{
+		{"stream-read", [&](size_t threads) {
+			 std::vector<double> sums(threads);
+			 const double t = run_pinned(cpus, threads, [&](size_t i) {
+				 const auto [first, last] = part_of(elements, i, threads, 512u);
+				 double sum = 0.0;
+				 for (size_t j = first; j != last; ++j) {
+					 sum += b[j];
+				 }
+				 sums[i] = sum;
+			 });
+			 asm volatile("" : : "r"(sums.data()) : "memory");
+			 return std::pair{t, uint64_t{elements * sizeof(double)}};
+		 }},
+		{"stream-triad", [&](size_t threads) {
+			 const double t = run_pinned(cpus, threads, [&](size_t i) {
+				 const auto [first, last] = part_of(elements, i, threads, 512u);
+				 for (size_t j = first; j != last; ++j) {
+					 a[j] = b[j] + 3.0 * c[j];
+				 }
+			 });
+			 asm volatile("" : : "r"(a) : "memory");
+			 return std::pair{t, uint64_t{3u * elements * sizeof(double)}};
+		 }},
+		{"messages", [&](size_t threads) {
+			 const double t = run_pinned(cpus, threads, [&](size_t i) {
+				 const auto [from, to] = part_of(size, i, threads, message_size);
+				 std::array<std::span<const std::byte>, message_batch> batch;
+				 std::array<cthash::tools::digest_value, message_batch> digests;
+
+				 for (size_t pos = from; pos < to;) {
+					 size_t count = 0u;
+					 for (; count != message_batch && pos < to; ++count, pos += message_size) {
+						 batch[count] = input.subspan(pos, std::min(message_size, to - pos));
+					 }
+
+					 if (opts->algorithm->hash_many != nullptr) {
+						 opts->algorithm->hash_many(std::span(batch).first(count), std::span(digests).first(count));
+						 cthash::tools::keep_digest(digests[0]);
+					 } else {
+						 for (const auto message: std::span(batch).first(count)) {
+							 cthash::tools::keep_digest(opts->algorithm->digest_of(message));
+						 }
+					 }
+				 }
+			 });
+			 return std::pair{t, uint64_t{size}};
+		 }},
+		{"segmented", [&](size_t threads) {
+			 return checksum({"xxhash64-seg", large.string()}, expected_segmented, threads);
+		 }},
+		{"files", [&](size_t threads) {
+			 return checksum({std::string(opts->algorithm->name), "-r", files.string()}, expected_files, threads);
+		 }},
+	};
+
+	std::vector<size_t> thread_counts;
+	for (size_t threads = 1u; threads < opts->max_threads; threads *= 2u) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(opts->max_threads);
+
+	std::cerr << "nodes: " << topology.size() << ", CPUs: " << cpus.size() << ", hash: " << opts->algorithm->name << "\n";
+	std::cout << "workload,threads,seconds,gb_per_second,speedup,efficiency,read_bandwidth_gb_per_second,fraction_of_bandwidth\n";
+
+	std::vector<double> read_bandwidth(thread_counts.size());
+
+	for (const auto & w: workloads) {
+		double single = 0.0;
+
+		for (size_t idx = 0; idx != thread_counts.size(); ++idx) {
+			const size_t threads = thread_counts[idx];
+
+			// the best of three runs
+			double seconds = 0.0;
+			uint64_t bytes = 0u;
+			for (int r = 0; r != 3; ++r) {
+				const auto [t, processed] = w.run(threads);
+				seconds = (r == 0) ? t : std::min(seconds, t);
+				bytes = processed;
+			}
+
+			const double gbps = static_cast<double>(bytes) / seconds / 1e9;
+			single = (threads == 1u) ? gbps : single;
+
+			if (w.name == "stream-read") {
+				read_bandwidth[idx] = gbps;
+			}
+
+			std::cout << w.name << "," << threads << "," << seconds << "," << gbps << "," << (gbps / single) << "," << (gbps / single / static_cast<double>(threads)) << "," << read_bandwidth[idx] << "," << (gbps / read_bandwidth[idx]) << "\n";
+		}
+	}
+
+	std::filesystem::remove_all(directory);
+}
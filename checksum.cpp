@@ -1,120 +1,1358 @@
-#include <cthash/cthash.hpp>
+#include "tools/algorithms.hpp"
+#include "tools/arguments.hpp"
+#include "tools/autotune.hpp"
+#include "tools/cpu.hpp"
+#include "tools/digest-cache.hpp"
+#include "tools/directory.hpp"
+#include "tools/io-uring.hpp"
+#include "tools/mapped-file.hpp"
+#include "tools/numa.hpp"
+#include "tools/sparse.hpp"
+#include "tools/tar.hpp"
+#include "tools/telemetry.hpp"
+#include "tools/thread-pool.hpp"
+#include "tools/throttle.hpp"
+#include "tools/watcher.hpp"
+#include <atomic>
+#include <charconv>
 #include <chrono>
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <unistd.h>
+#include <cmath>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sys/resource.h>
 #include <iostream>
 
-struct mapped_file {
-	static constexpr int invalid = -1;
+// how content of files which are not read in batches is accessed
+enum class io_mode { mmap, mmap_chunked, read };
 
-	int fd{invalid};
-	size_t sz{0};
-	void * ptr{nullptr};
+struct options {
+	const cthash::tools::algorithm * algorithm{nullptr};
+	std::vector<const char *> files{};
+	std::optional<std::string> cache_path{};
+	double verify_sample{0.0};
+	bool compact_cache{false};
+	bool resume{false};
+	bool recursive{false};
+	size_t jobs{cthash::tools::thread_pool::default_size()};
+	bool stats_json{false};
+	std::optional<std::string> trace_path{};
+	double limit_rate{0.0};
+	double limit_iops{0.0};
+	double adaptive_threshold{0.0};
+	bool idle{false};
+	bool watch{false};
+	std::chrono::milliseconds settle{200};
+	bool tar{false};
+	bool archive_digest{false};
+	bool numa{true};
+	bool io_uring{true};
+	std::optional<io_mode> io{};
+	bool autotune{false};
+	bool recalibrate{false};
+	std::optional<std::string> tuning_path{};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options] hash file...\n";
+	std::cerr << "hash is one of: sha-1, sha-224, sha-256, sha-384, sha-512, sha-512/224, sha-512/256, sha3-224, sha3-256, sha3-384, sha3-512, \n";
+	std::cerr << "  shake-128/n, shake-256/n (where n is 32/64/128/256/512/1024/2048),\n";
+	std::cerr << "  xxhash32, xxhash64, xxhash64-seg (segmented xxhash64, hashed in parallel)\n";
+	std::cerr << "options:\n";
+	std::cerr << "  -r                    hash all regular files in given directories recursively\n";
+	std::cerr << "  -j N                  number of worker threads (default is number of CPUs)\n";
+	std::cerr << "  --cache=FILE          skip files with unchanged (device, inode, size, mtime, ctime) and remember new digests\n";
+	std::cerr << "  --verify-sample=F     rehash fraction F (0..1) of cached files to catch silent corruption\n";
+	std::cerr << "  --compact-cache       drop superseded records from the cache file\n";
+	std::cerr << "  --resume              store hasher midstate in the cache and hash only appended data of grown files\n";
+	std::cerr << "  --stats=json          print statistics (bytes, files, times, per-phase breakdown, page faults) as JSON to stderr\n";
+	std::cerr << "  --trace FILE          write per-file and per-chunk spans of each thread in Chrome trace-event format\n";
+	std::cerr << "  --limit-rate=BYTES    read at most BYTES per second (suffixes K, M, G are accepted)\n";
+	std::cerr << "  --limit-iops=N        do at most N I/O operations (opens and reads of chunks) per second\n";
+	std::cerr << "  --adaptive[=PCT]      slow down while IO or CPU pressure (PSI avg10) is above PCT percent (default 10)\n";
+	std::cerr << "  --idle                run with idle IO priority class and SCHED_IDLE scheduling policy\n";
+	std::cerr << "  --no-numa             don't pin workers to NUMA nodes and don't prefer node local to the device\n";
+	std::cerr << "  --no-io-uring         open, stat and read small files with a syscall each instead of batches through io_uring\n";
+	std::cerr << "  --io=MODE             how larger files are accessed: mmap (whole file, default), mmap-chunked (16 MiB windows), read\n";
+	std::cerr << "  --autotune            use I/O settings tuned for this CPU and hash function, calibrate them at first use\n";
+	std::cerr << "  --autotune=calibrate  calibrate the tuned settings again\n";
+	std::cerr << "  --tuning-file=FILE    where tuned settings are stored (default ~/.cache/cthash/tuning)\n";
+	std::cerr << "  --watch               hash given directories and then keep watching them, print changed digests (implies --io=read)\n";
+	std::cerr << "  --tar                 hash each member of given tar archives (ustar, pax, GNU) without extracting, '-' is stdin\n";
+	std::cerr << "  --archive-digest      with --tar print digest of whole archive too (computed in the same pass)\n";
+	std::cerr << "  --settle=MS           in watch mode wait until file is quiet for MS milliseconds before rehashing (default 200)\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg == "-r") {
+			opts.recursive = true;
+		} else if (arg.starts_with("-j")) {
+			const auto jobs = cthash::tools::jobs_argument(arg, i, argc, argv);
+			if (not jobs) {
+				std::cerr << "number of jobs must be positive number!\n";
+				return std::nullopt;
+			}
+			opts.jobs = *jobs;
+		} else if (arg.starts_with("--cache=")) {
+			opts.cache_path = std::string(arg.substr(8));
+		} else if (arg.starts_with("--verify-sample=")) {
+			const auto value = arg.substr(16);
+			const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), opts.verify_sample);
+			if (error != std::errc{} || end != value.data() + value.size() || not(opts.verify_sample >= 0.0 && opts.verify_sample <= 1.0)) {
+				std::cerr << "verify sample must be between 0 and 1!\n";
+				usage(argv[0]);
+				return std::nullopt;
+			}
+		} else if (arg == "--compact-cache") {
+			opts.compact_cache = true;
+		} else if (arg == "--resume") {
+			opts.resume = true;
+		} else if (arg == "--stats=json") {
+			opts.stats_json = true;
+		} else if (arg == "--trace" && i + 1 != argc) {
+			opts.trace_path = std::string(argv[++i]);
+		} else if (arg.starts_with("--trace=")) {
+			opts.trace_path = std::string(arg.substr(8));
+		} else if (arg.starts_with("--limit-rate=")) {
+			const auto rate = cthash::tools::parse_size(arg.substr(13));
+			if (not rate) {
+				std::cerr << "invalid rate limit!\n";
+				return std::nullopt;
+			}
+			opts.limit_rate = *rate;
+		} else if (arg.starts_with("--limit-iops=")) {
+			const auto iops = cthash::tools::parse_number<double>(arg.substr(13));
+			if (not iops || not(*iops >= 0.0) || std::isinf(*iops)) {
+				std::cerr << "invalid limit of I/O operations!\n";
+				return std::nullopt;
+			}
+			opts.limit_iops = *iops;
+		} else if (arg == "--adaptive") {
+			opts.adaptive_threshold = 10.0;
+		} else if (arg.starts_with("--adaptive=")) {
+			opts.adaptive_threshold = cthash::tools::parse_number<double>(arg.substr(11)).value_or(0.0);
+			if (not(opts.adaptive_threshold > 0.0 && opts.adaptive_threshold <= 100.0)) {
+				std::cerr << "pressure threshold must be between 0 and 100!\n";
+				return std::nullopt;
+			}
+		} else if (arg == "--idle") {
+			opts.idle = true;
+		} else if (arg == "--no-numa") {
+			opts.numa = false;
+		} else if (arg == "--no-io-uring") {
+			opts.io_uring = false;
+		} else if (arg == "--io=mmap" || arg == "--io=mmap-chunked" || arg == "--io=read") {
+			opts.io = (arg == "--io=mmap") ? io_mode::mmap : ((arg == "--io=read") ? io_mode::read : io_mode::mmap_chunked);
+		} else if (arg.starts_with("--io=")) {
+			std::cerr << "unknown I/O mode!\n";
+			return std::nullopt;
+		} else if (arg == "--autotune" || arg == "--autotune=calibrate") {
+			opts.autotune = true;
+			opts.recalibrate = (arg != "--autotune");
+		} else if (arg.starts_with("--tuning-file=")) {
+			opts.tuning_path = std::string(arg.substr(14));
+		} else if (arg == "--watch") {
+			opts.watch = true;
+			opts.recursive = true;
+		} else if (arg == "--tar") {
+			opts.tar = true;
+		} else if (arg == "--archive-digest") {
+			opts.archive_digest = true;
+		} else if (arg.starts_with("--settle=")) {
+			const auto settle = cthash::tools::parse_number<uint32_t>(arg.substr(9));
+			if (not settle) {
+				std::cerr << "settle time must be a number of milliseconds!\n";
+				return std::nullopt;
+			}
+			opts.settle = std::chrono::milliseconds{*settle};
+		} else if (arg.starts_with("-") && arg != "-") {
+			std::cerr << "unknown option '" << arg << "'!\n";
+			return std::nullopt;
+		} else if (opts.algorithm == nullptr) {
+			opts.algorithm = cthash::tools::find_algorithm(arg);
+			if (opts.algorithm == nullptr) {
+				std::cerr << "unknown hash function!\n";
+				return std::nullopt;
+			}
+		} else {
+			opts.files.emplace_back(argv[i]);
+		}
+	}
+
+	if (opts.algorithm == nullptr || (opts.files.empty() && not opts.compact_cache)) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	if ((opts.compact_cache || opts.resume) && not opts.cache_path) {
+		std::cerr << "--compact-cache and --resume need --cache=FILE!\n";
+		return std::nullopt;
+	}
 
-	static size_t get_size(int fd) {
-		if (fd == invalid) {
-			return 0;
+	// watched files are often truncated while they are rehashed, which would kill the watcher with SIGBUS when they
+	// are mapped, so they are read in windows with `pread` (a short read is then only a failure of that file)
+	if (opts.watch) {
+		if (opts.resume || opts.io.value_or(io_mode::read) != io_mode::read) {
+			std::cerr << "--watch reads files, it can't be used with --resume or mapped --io!\n";
+			return std::nullopt;
 		}
 
-		return (size_t)lseek(fd, 0, SEEK_END);
+		opts.io = io_mode::read;
 	}
 
-	mapped_file(const char * path): fd{open(path, O_RDONLY)}, sz{get_size(fd)}, ptr{mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, 0)} { }
+	// old content of grown files is fingerprinted from whole mapping
+	if (opts.resume && opts.io.value_or(io_mode::mmap) != io_mode::mmap) {
+		std::cerr << "--resume needs --io=mmap!\n";
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+// files up to `tuning::small_file_limit` are read (instead of mapped) into worker's arena and hashed in batches,
+// their openat, read and close (and statx of directory entries) are done for whole batch at once with io_uring
+static constexpr size_t batch_max_files = 64u;
+static constexpr size_t batch_max_bytes = 1024u * 1024u;
+
+// mapped files are hashed in chunks (it doesn't change the digest, but each chunk can be traced),
+// with `--io=mmap-chunked` and `--io=read` it's also size of window which is mapped or read at once
+static constexpr size_t chunk_size = 16u * 1024u * 1024u;
+
+struct small_file {
+	std::string name;
+	cthash::tools::file_metadata metadata;
+};
+
+struct worker_state {
+	std::mt19937_64 rng{std::random_device{}()};
+	// it's allocated (and so first touched) by its worker, so with pinned workers its pages are on worker's node
+	std::vector<std::byte> arena{};
+	cthash::tools::worker_telemetry telemetry{};
+	// created at first use (by its worker), it's not `valid()` if the kernel doesn't support it
+	std::unique_ptr<cthash::tools::io_ring> ring{};
+};
+
+struct cache_state {
+	std::optional<cthash::tools::digest_cache::entry> cached{};
+	bool unchanged{false};
+	bool verify{false};
+};
+
+struct checksum_run {
+	const options & opts;
+	const cthash::tools::algorithm & algorithm;
+	cthash::tools::digest_cache * cache;
+	bool print_names;
+	cthash::tools::tuning tuned;
+	// explicit `--io` wins over tuned setting and `--resume` needs whole mappings
+	io_mode io;
 
-	mapped_file(const mapped_file &) = delete;
-	mapped_file(mapped_file &&) = delete;
+	std::mutex output_mutex{};
+	std::atomic<int> result{0};
+	std::vector<worker_state> workers;
+	cthash::tools::throttle throttle;
 
-	~mapped_file() {
-		if (ptr && fd != invalid) {
-			munmap(ptr, sz);
-			close(fd);
+	// in watch mode: last reported digest of each file, after initial scan (`live`) only changes are printed
+	std::unordered_map<std::string, cthash::tools::digest_value> known_digests{};
+	bool live{false};
+	// files seen by rescan after events were lost, the rest of `known_digests` is gone
+	std::optional<std::unordered_set<std::string>> rescanned{};
+
+	cthash::tools::numa_topology topology;
+	cthash::tools::device_nodes device_node{topology};
+
+	// pool is last, so its workers are joined before rest of the state is destroyed
+	cthash::tools::thread_pool pool;
+
+	checksum_run(const options & o, cthash::tools::digest_cache * c, const cthash::tools::tuning & t): opts{o}, algorithm{*o.algorithm}, cache{c}, print_names{o.files.size() > 1u || o.recursive || o.tar}, tuned{t}, io{o.io.value_or((t.read_large && not o.resume) ? io_mode::read : io_mode::mmap)}, workers(o.jobs), throttle{o.limit_rate, o.limit_iops, o.adaptive_threshold}, topology{o.numa ? cthash::tools::numa_topology::detect() : cthash::tools::numa_topology{}}, pool{o.jobs, o.numa ? &topology : nullptr} {
+		const auto origin = cthash::tools::worker_telemetry::clock::now();
+
+		for (auto & w: workers) {
+			w.telemetry.origin = origin;
+			w.telemetry.tracing = o.trace_path.has_value();
 		}
 	}
 
-	auto get_span() const noexcept {
-		return std::span<const std::byte>(reinterpret_cast<std::byte *>(ptr), sz);
+	auto telemetry_of(size_t worker) -> cthash::tools::worker_telemetry & {
+		return workers[worker].telemetry;
+	}
+
+	// nullptr with `--no-io-uring`
+	auto ring_of(size_t worker) -> cthash::tools::io_ring * {
+		if (not opts.io_uring) {
+			return nullptr;
+		}
+
+		auto & ring = workers[worker].ring;
+
+		if (not ring) {
+			ring = std::make_unique<cthash::tools::io_ring>(static_cast<unsigned>(batch_max_files));
+		}
+
+		return ring.get();
+	}
+
+	// node local to device of the file (if it's known), so its page cache and worker's buffers are on same node
+	auto node_for(uint64_t device) -> size_t {
+		return device_node.lookup(device).value_or(cthash::tools::thread_pool::any_node);
+	}
+
+	void report(const std::string & path, const cthash::tools::digest_value & digest, size_t worker) {
+		const auto _ = telemetry_of(worker).measure(cthash::tools::phase::output);
+
+		if (opts.watch) {
+			report_change(path, digest);
+			return;
+		}
+
+		auto line = std::ostringstream{};
+		line << digest;
+
+		if (print_names) {
+			line << "  " << path;
+		}
+
+		line << "\n";
+
+		std::lock_guard lock{output_mutex};
+		std::cout << line.str();
+	}
+
+	void report_change(const std::string & path, const cthash::tools::digest_value & digest) {
+		std::lock_guard lock{output_mutex};
+		const auto [it, added] = known_digests.try_emplace(path, digest);
+
+		if (rescanned) {
+			rescanned->insert(path);
+		}
+
+		if (not live) {
+			std::cout << digest << "  " << path << "\n";
+		} else if (added) {
+			std::cout << "added " << digest << "  " << path << std::endl;
+		} else if (it->second != digest) {
+			std::cout << "changed " << it->second << " " << digest << "  " << path << std::endl;
+			it->second = digest;
+		}
+	}
+
+	// removed file or whole directory
+	void forget(const std::string & path, bool directory) {
+		std::lock_guard lock{output_mutex};
+
+		const auto removed = [&](auto it) {
+			std::cout << "removed " << it->second << "  " << it->first << std::endl;
+			return known_digests.erase(it);
+		};
+
+		if (not directory) {
+			if (const auto it = known_digests.find(path); it != known_digests.end()) {
+				removed(it);
+			}
+			return;
+		}
+
+		const auto prefix = path + '/';
+
+		for (auto it = known_digests.begin(); it != known_digests.end();) {
+			it = it->first.starts_with(prefix) ? removed(it) : std::next(it);
+		}
+	}
+
+	void fail(const std::string & path, std::string_view message) {
+		result = 1;
+
+		std::lock_guard lock{output_mutex};
+		std::cerr << path << ": " << message << "\n";
+
+		// file which exists but can't be read isn't reported as removed
+		if (rescanned) {
+			rescanned->insert(path);
+		}
+	}
+
+	// rescans all roots and forgets files which are not in them anymore (their removal events could be lost)
+	void rescan() {
+		{
+			std::lock_guard lock{output_mutex};
+			rescanned.emplace();
+		}
+
+		for (const char * root: opts.files) {
+			start(root);
+		}
+
+		pool.wait();
+
+		std::lock_guard lock{output_mutex};
+
+		for (auto it = known_digests.begin(); it != known_digests.end();) {
+			if (rescanned->contains(it->first)) {
+				++it;
+				continue;
+			}
+
+			std::cout << "removed " << it->second << "  " << it->first << std::endl;
+			it = known_digests.erase(it);
+		}
+
+		rescanned.reset();
+	}
+
+	auto check_cache(const cthash::tools::file_metadata & md, size_t worker) -> cache_state {
+		if (not cache) {
+			return {};
+		}
+
+		auto cached = cache->find(md, algorithm.name);
+		const bool unchanged = cached && cached->metadata == md;
+		const bool verify = cached && std::bernoulli_distribution(opts.verify_sample)(workers[worker].rng);
+
+		return {std::move(cached), unchanged, verify};
+	}
+
+	// feeds content between `begin` and `end` into `target`, for mapped content (`in_memory` is false)
+	// I/O happens while hashing, so it's throttled here
+	// if `extents` are given, holes are fed from the zero block (so they are neither read nor faulted in)
+	void feed_range(const std::string & path, std::span<const std::byte> content, std::span<const cthash::tools::extent> extents, uint64_t begin, uint64_t end, cthash::tools::streaming_hasher & target, size_t worker, bool in_memory) {
+		auto & telemetry = telemetry_of(worker);
+
+		const auto hash_chunked = [&](std::span<const std::byte> in) {
+			telemetry.bytes += in.size();
+
+			while (not in.empty()) {
+				const auto chunk = in.first(std::min(in.size(), chunk_size));
+
+				if (not in_memory) {
+					telemetry.account(cthash::tools::phase::throttle, throttle.acquire(chunk.size()), path);
+				}
+
+				const auto start = cthash::tools::throttle_clock::now();
+				{
+					const auto _ = telemetry.measure(cthash::tools::phase::hash, path);
+					target.update(chunk);
+				}
+
+				if (not in_memory) {
+					telemetry.account(cthash::tools::phase::throttle, throttle.pause_after(cthash::tools::throttle_clock::now() - start), path);
+				}
+
+				in = in.subspan(chunk.size());
+			}
+		};
+
+		if (extents.empty()) {
+			hash_chunked(content.subspan(static_cast<size_t>(begin), static_cast<size_t>(end - begin)));
+			return;
+		}
+
+		for (const auto & e: extents) {
+			const auto from = std::max(e.offset, begin);
+			const auto to = std::min(e.offset + e.length, end);
+
+			if (from >= to) {
+				continue;
+			} else if (not e.hole) {
+				hash_chunked(content.subspan(static_cast<size_t>(from), static_cast<size_t>(to - from)));
+				continue;
+			}
+
+			telemetry.bytes += to - from;
+			const auto _ = telemetry.measure(cthash::tools::phase::hash, path);
+			cthash::tools::feed_zeros(to - from, [&](std::span<const std::byte> zeros) { target.update(zeros); });
+		}
+	}
+
+	// digest of a segment which is whole in a hole is same for every such segment, so it's computed only once
+	std::once_flag zero_segment_once{};
+	cthash::tools::digest_value zero_segment{};
+
+	static bool inside_hole(std::span<const cthash::tools::extent> extents, uint64_t begin, uint64_t end) noexcept {
+		const auto it = std::ranges::upper_bound(extents, begin, {}, &cthash::tools::extent::offset);
+		return it != extents.begin() && std::prev(it)->hole && std::prev(it)->offset + std::prev(it)->length >= end;
+	}
+
+	// `count` whole segments from `begin` are hashed by this worker and by helpers submitted to other workers
+	// (each takes next segment until there is none), digests are then added in order so result doesn't depend on it
+	void hash_segments(const std::string & path, std::span<const std::byte> content, std::span<const cthash::tools::extent> extents, uint64_t begin, size_t count, cthash::tools::streaming_hasher & h, size_t worker, bool in_memory) {
+		struct shared_segments {
+			std::atomic<size_t> next{0u};
+			std::atomic<size_t> done{0u};
+			std::vector<cthash::tools::digest_value> digests;
+		};
+
+		const auto size = h.segment_size();
+		auto work = std::make_shared<shared_segments>();
+		work->digests.resize(count);
+
+		// helpers which start after all segments were taken don't touch anything but `work`
+		const auto take_segments = [this, work, path, content, extents, begin, count, size, &h, in_memory](size_t w) {
+			for (size_t i; (i = work->next++) < count;) {
+				const uint64_t from = begin + i * size;
+
+				if (inside_hole(extents, from, from + size)) {
+					std::call_once(zero_segment_once, [&] {
+						const auto s = h.create_segment();
+						cthash::tools::feed_zeros(size, [&](std::span<const std::byte> zeros) { s->update(zeros); });
+						zero_segment = s->final();
+					});
+
+					telemetry_of(w).bytes += size;
+					work->digests[i] = zero_segment;
+				} else {
+					const auto s = h.create_segment();
+					feed_range(path, content, extents, from, from + size, *s, w, in_memory);
+					work->digests[i] = s->final();
+				}
+
+				if (++work->done == count) {
+					work->done.notify_all();
+				}
+			}
+		};
+
+		// this worker is one of them (with no whole segment there is nobody to help)
+		const size_t helping = std::min(pool.size(), count);
+		for (size_t i = 1u; i < helping; ++i) {
+			pool.submit(take_segments, pool.node_of(worker));
+		}
+
+		take_segments(worker);
+
+		// segments taken by helpers can still be hashed
+		for (size_t done; (done = work->done.load()) != count;) {
+			work->done.wait(done);
+		}
+
+		for (const auto & digest: work->digests) {
+			h.add_segment(digest);
+		}
+	}
+
+	void hash_content(const std::string & path, const cthash::tools::file_metadata & md, std::span<const std::byte> content, const cache_state & state, size_t worker, bool in_memory = false, std::span<const cthash::tools::extent> extents = {}) {
+		const auto & cached = state.cached;
+		auto h = algorithm.create();
+
+		const auto hash_from = [&](uint64_t offset) {
+			const uint64_t end = content.size();
+			const size_t segment = h->segment_size();
+
+			// rest of unfinished segment, whole segments in parallel and the last partial one
+			const uint64_t aligned = (segment == 0u) ? end : std::min(end, (offset + segment - 1u) / segment * segment);
+			const size_t count = (segment == 0u) ? 0u : static_cast<size_t>((end - aligned) / segment);
+
+			// content shorter than one segment has none, and too few segments are not worth waking other workers
+			if (count == 0u || count < tuned.min_parallel_segments) {
+				feed_range(path, content, extents, offset, end, *h, worker, in_memory);
+				return;
+			}
+
+			feed_range(path, content, extents, offset, aligned, *h, worker, in_memory);
+			hash_segments(path, content, extents, aligned, count, *h, worker, in_memory);
+			feed_range(path, content, extents, aligned + count * segment, end, *h, worker, in_memory);
+		};
+
+		// file only grew since last time, and sampled blocks of old content are still the same
+		const bool can_resume = opts.resume && cached && not state.unchanged && not state.verify && not cached->midstate.empty() && cached->metadata.size < md.size && cthash::tools::sampled_fingerprint(content, cached->metadata.size) == cached->fingerprint;
+
+		if (can_resume && h->restore(cached->midstate)) {
+			hash_from(cached->metadata.size);
+		} else {
+			h = algorithm.create();
+			hash_from(0u);
+		}
+
+		const auto fingerprint = (opts.resume && not state.unchanged) ? cthash::tools::sampled_fingerprint(content, md.size) : uint64_t{0};
+		complete(path, md, *h, state, worker, fingerprint);
+	}
+
+	// finishes the hasher and records its digest
+	void complete(const std::string & path, const cthash::tools::file_metadata & md, cthash::tools::streaming_hasher & h, const cache_state & state, size_t worker, uint64_t fingerprint) {
+		const auto midstate = opts.resume ? h.midstate() : std::vector<std::byte>{};
+		const auto digest = [&] {
+			const auto _ = telemetry_of(worker).measure(cthash::tools::phase::hash, path);
+			return h.final();
+		}();
+
+		record(path, md, digest, midstate, state, worker, fingerprint);
+	}
+
+	// checks the digest against the cache, stores it there and reports it
+	void record(const std::string & path, const cthash::tools::file_metadata & md, const cthash::tools::digest_value & digest, const std::vector<std::byte> & midstate, const cache_state & state, size_t worker, uint64_t fingerprint) {
+		const auto & cached = state.cached;
+		++telemetry_of(worker).files;
+
+		if (state.unchanged && cached->digest != digest) {
+			// metadata didn't change but content did, keep the old record so it's reported again
+			std::ostringstream msg;
+			msg << "digest mismatch with unchanged metadata (cached " << cached->digest << ")";
+			fail(path, msg.str());
+		} else if (cache && not state.unchanged) {
+			cache->store(md, algorithm.name, digest, midstate, fingerprint);
+		}
+
+		report(path, digest, worker);
+	}
+
+	// content is hashed sequentially in windows of `chunk_size` which are mapped one at a time (`--io=mmap-chunked`)
+	// or read into worker's arena (`--io=read`), so only one window is resident and segments aren't hashed in parallel
+	void hash_windows(const std::string & path, const cthash::tools::input_file & f, const cache_state & state, size_t worker, std::span<const cthash::tools::extent> extents) {
+		auto & telemetry = telemetry_of(worker);
+		auto & arena = workers[worker].arena;
+		const uint64_t size = f.metadata.size;
+		auto h = algorithm.create();
+
+		const auto feed_data = [&](uint64_t begin, uint64_t end) {
+			for (uint64_t pos = begin; pos < end;) {
+				const uint64_t window = pos / chunk_size * chunk_size;
+				const uint64_t until = std::min(end, window + chunk_size);
+
+				if (io == io_mode::read) {
+					arena.resize(chunk_size);
+					const auto in = std::span(arena).first(static_cast<size_t>(until - pos));
+					const auto got = [&] {
+						const auto _ = telemetry.measure(cthash::tools::phase::read, path);
+						return read_at(f.fd, in, pos);
+					}();
+
+					if (got != in.size()) {
+						return false;
+					}
+
+					feed_range(path, in, {}, 0u, in.size(), *h, worker, false);
+				} else {
+					const auto m = cthash::tools::mapped_file(f.fd, static_cast<size_t>(std::min(size, window + chunk_size) - window), window);
+
+					if (not m.valid()) {
+						return false;
+					}
+
+					feed_range(path, m.get_span(), {}, pos - window, until - window, *h, worker, false);
+				}
+
+				pos = until;
+			}
+
+			return true;
+		};
+
+		for (const auto & e: extents) {
+			if (not e.hole) {
+				if (not feed_data(e.offset, e.offset + e.length)) {
+					return fail(path, (io == io_mode::read) ? "can't read file!" : "can't map file!");
+				}
+				continue;
+			}
+
+			telemetry.bytes += e.length;
+			const auto _ = telemetry.measure(cthash::tools::phase::hash, path);
+			cthash::tools::feed_zeros(e.length, [&](std::span<const std::byte> zeros) { h->update(zeros); });
+		}
+
+		complete(path, f.metadata, *h, state, worker, uint64_t{0});
+	}
+
+	void report_cached(const std::string & path, const cache_state & state, size_t worker) {
+		++telemetry_of(worker).cached_files;
+		report(path, state.cached->digest, worker);
+	}
+
+	void process_file(int dirfd, const std::string & path, const char * name, std::optional<cthash::tools::file_metadata> known, size_t worker) {
+		auto & telemetry = telemetry_of(worker);
+		const auto _ = telemetry.measure(cthash::tools::phase::file, path);
+		auto state = cache_state{};
+
+		// with metadata from directory walk we don't need to open unchanged files at all
+		if (known) {
+			state = check_cache(*known, worker);
+
+			if (state.unchanged && not state.verify) {
+				report_cached(path, state, worker);
+				return;
+			}
+		}
+
+		telemetry.account(cthash::tools::phase::throttle, throttle.acquire(0u), path);
+
+		auto open_scope = std::optional<cthash::tools::worker_telemetry::scope>{std::in_place, telemetry, cthash::tools::phase::open, path};
+		const auto f = cthash::tools::input_file(dirfd, name);
+
+		if (not f.valid()) {
+			fail(path, "can't open file!");
+			return;
+		}
+
+		if (not known) {
+			state = check_cache(f.metadata, worker);
+
+			if (state.unchanged && not state.verify) {
+				open_scope.reset();
+				report_cached(path, state, worker);
+				return;
+			}
+		}
+
+		if (io != io_mode::mmap) {
+			open_scope.reset();
+			hash_windows(path, f, state, worker, cthash::tools::find_extents(f.fd, f.metadata.size));
+			return;
+		}
+
+		const auto m = cthash::tools::mapped_file(f);
+		open_scope.reset();
+
+		if (not m.valid()) {
+			fail(path, "can't map file!");
+			return;
+		}
+
+		const auto extents = cthash::tools::find_extents(f.fd, f.metadata.size);
+		hash_content(path, f.metadata, m.get_span(), state, worker, false, extents);
+	}
+
+	static auto read_into(int fd, std::span<std::byte> out) noexcept -> std::optional<size_t> {
+		size_t total = 0u;
+
+		while (total != out.size()) {
+			const auto r = read(fd, out.data() + total, out.size() - total);
+
+			if (r < 0) {
+				return std::nullopt;
+			} else if (r == 0) {
+				break;
+			}
+
+			total += static_cast<size_t>(r);
+		}
+
+		return total;
+	}
+
+	// like `read_into` but from `offset` (with `pread`), it returns number of bytes read (less at end of the file)
+	static auto read_at(int fd, std::span<std::byte> out, uint64_t offset) noexcept -> size_t {
+		size_t total = 0u;
+
+		while (total != out.size()) {
+			const auto r = pread(fd, out.data() + total, out.size() - total, static_cast<off_t>(offset + total));
+
+			if (r <= 0) {
+				break;
+			}
+
+			total += static_cast<size_t>(r);
+		}
+
+		return total;
+	}
+
+	void process_batch(int dirfd, const std::string & dir_path, const std::vector<small_file> & files, size_t worker) {
+		struct loaded_file {
+			const small_file * file;
+			cache_state state;
+			std::string path;
+			size_t offset;
+			size_t size{0u};
+			int fd{cthash::tools::input_file::invalid};
+			bool read{false};
+		};
+
+		auto & telemetry = telemetry_of(worker);
+		auto & arena = workers[worker].arena;
+		arena.resize(batch_max_bytes + static_cast<size_t>(tuned.small_file_limit) + batch_max_files);
+
+		std::vector<loaded_file> loaded;
+		loaded.reserve(files.size());
+		size_t used = 0u;
+
+		const auto start = cthash::tools::throttle_clock::now();
+
+		// only files which are needed are read...
+		for (const auto & file: files) {
+			auto state = check_cache(file.metadata, worker);
+			auto path = dir_path + file.name;
+
+			if (state.unchanged && not state.verify) {
+				report_cached(path, state, worker);
+				continue;
+			}
+
+			// open and read are two operations
+			telemetry.account(cthash::tools::phase::throttle, throttle.acquire(file.metadata.size, 2u), path);
+
+			loaded.push_back({&file, std::move(state), std::move(path), used});
+			used += static_cast<size_t>(file.metadata.size) + 1u;
+		}
+
+		// one byte more than size from directory walk, so a file which grew since then is noticed
+		const auto buffer_of = [&](const loaded_file & l) {
+			return std::span(arena).subspan(l.offset, static_cast<size_t>(l.file->metadata.size) + 1u);
+		};
+
+		// ... all of them are opened, read and closed (each step for whole batch with one syscall with io_uring) ...
+		auto * ring = ring_of(worker);
+		{
+			const auto _ = telemetry.measure(cthash::tools::phase::open, dir_path);
+
+			cthash::tools::for_each_operation(
+				ring, loaded.size(),
+				[&](cthash::tools::io_ring & r, size_t i) { r.openat(dirfd, loaded[i].file->name.c_str(), O_RDONLY | O_CLOEXEC, i); },
+				[&](size_t i) { return openat(dirfd, loaded[i].file->name.c_str(), O_RDONLY | O_CLOEXEC); },
+				[&](size_t i, int fd) { loaded[i].fd = std::max(fd, cthash::tools::input_file::invalid); });
+		}
+
+		// indices of opened files
+		std::vector<size_t> opened;
+		for (size_t i = 0; i != loaded.size(); ++i) {
+			if (loaded[i].fd != cthash::tools::input_file::invalid) {
+				opened.push_back(i);
+			}
+		}
+
+		{
+			const auto _ = telemetry.measure(cthash::tools::phase::read, dir_path);
+
+			cthash::tools::for_each_operation(
+				ring, opened.size(),
+				[&](cthash::tools::io_ring & r, size_t i) { r.read(loaded[opened[i]].fd, buffer_of(loaded[opened[i]]), 0u, i); },
+				[&](size_t i) {
+					const auto buffer = buffer_of(loaded[opened[i]]);
+					const auto r = read(loaded[opened[i]].fd, buffer.data(), buffer.size());
+					return (r < 0) ? -errno : static_cast<int>(r);
+				},
+				[&](size_t i, int got) {
+					auto & l = loaded[opened[i]];
+
+					if (got < 0) {
+						return;
+					}
+
+					// rest of a short read (it's not expected from a regular file, but it can happen)
+					l.size = static_cast<size_t>(got);
+					if (l.size != 0u && l.size < l.file->metadata.size) {
+						l.size += read_at(l.fd, buffer_of(l).subspan(l.size), l.size);
+					}
+
+					l.read = true;
+				});
+
+			cthash::tools::for_each_operation(
+				ring, opened.size(),
+				[&](cthash::tools::io_ring & r, size_t i) { r.close(loaded[opened[i]].fd, i); },
+				[&](size_t i) { return close(loaded[opened[i]].fd); },
+				[](size_t, int) {});
+		}
+
+		// files changed since directory walk are hashed again on their own (with their current metadata), but only
+		// after the batch, as `process_file` can read into the same arena
+		std::vector<const small_file *> changed;
+
+		for (const auto & l: loaded) {
+			if (l.fd == cthash::tools::input_file::invalid) {
+				fail(l.path, "can't open file!");
+			} else if (not l.read) {
+				fail(l.path, "can't read file!");
+			} else if (l.size != l.file->metadata.size) {
+				changed.push_back(l.file);
+			}
+		}
+
+		std::erase_if(loaded, [](const loaded_file & l) { return not l.read || l.size != l.file->metadata.size; });
+
+		// ... and then hashed, all at once in lanes of a multi-buffer kernel when the algorithm has it
+		if (algorithm.hash_many != nullptr && not opts.resume && loaded.size() >= tuned.min_multi_buffer_batch) {
+			std::vector<std::span<const std::byte>> inputs;
+			std::vector<cthash::tools::digest_value> digests(loaded.size());
+
+			for (const auto & l: loaded) {
+				inputs.push_back(buffer_of(l).first(l.size));
+				telemetry.bytes += l.size;
+			}
+
+			{
+				const auto _ = telemetry.measure(cthash::tools::phase::hash, dir_path);
+				algorithm.hash_many(inputs, digests);
+			}
+
+			for (size_t i = 0; i != loaded.size(); ++i) {
+				record(loaded[i].path, loaded[i].file->metadata, digests[i], {}, loaded[i].state, worker, uint64_t{0});
+			}
+		} else {
+			for (const auto & l: loaded) {
+				hash_content(l.path, l.file->metadata, buffer_of(l).first(l.size), l.state, worker, true);
+			}
+		}
+
+		for (const auto * file: changed) {
+			process_file(dirfd, dir_path + file->name, file->name.c_str(), std::nullopt, worker);
+		}
+
+		telemetry.account(cthash::tools::phase::throttle, throttle.pause_after(cthash::tools::throttle_clock::now() - start), dir_path);
+	}
+
+	void walk(const std::string & path, size_t worker) {
+		auto & telemetry = telemetry_of(worker);
+		const auto _ = telemetry.measure(cthash::tools::phase::walk, path);
+		const auto dir = std::make_shared<cthash::tools::directory>(AT_FDCWD, path.c_str());
+
+		if (not dir->valid()) {
+			fail(path, "can't open directory!");
+			return;
+		}
+
+		const auto prefix = path.ends_with('/') ? path : (path + '/');
+
+		std::vector<small_file> batch;
+		size_t batch_bytes = 0u;
+
+		const auto submit_batch = [&] {
+			if (batch.empty()) {
+				return;
+			}
+
+			const auto node = node_for(batch.front().metadata.device);
+			pool.submit([this, dir, prefix, files = std::move(batch)](size_t w) { process_batch(dir->fd, prefix, files, w); }, node);
+			batch = {};
+			batch_bytes = 0u;
+		};
+
+		// entries which aren't known to be directories are stat-ed in groups (with one syscall with io_uring)
+		std::vector<std::string> names;
+
+		const auto stat_names = [&] {
+			cthash::tools::stat_all(ring_of(worker), dir->fd, names, [&](size_t i, const std::optional<cthash::tools::entry_status> & status) {
+				const auto & name = names[i];
+				auto child = prefix + name;
+
+				if (not status) {
+					fail(child, "can't stat file!");
+					return;
+				}
+
+				if (status->type == cthash::tools::entry_type::directory) {
+					pool.submit([this, child](size_t w) { walk(child, w); });
+				} else if (status->type != cthash::tools::entry_type::regular) {
+					return;
+				} else if (status->metadata.size <= tuned.small_file_limit) {
+					batch.push_back({name, status->metadata});
+					batch_bytes += static_cast<size_t>(status->metadata.size);
+
+					if (batch.size() >= batch_max_files || batch_bytes >= batch_max_bytes) {
+						submit_batch();
+					}
+				} else {
+					pool.submit([this, dir, child, n = name, md = status->metadata](size_t w) { process_file(dir->fd, child, n.c_str(), md, w); }, node_for(status->metadata.device));
+				}
+			});
+
+			names.clear();
+		};
+
+		const bool ok = cthash::tools::for_each_entry(dir->fd, [&](std::string_view name, cthash::tools::entry_type type) {
+			if (type == cthash::tools::entry_type::directory) {
+				pool.submit([this, child = prefix + std::string(name)](size_t w) { walk(child, w); });
+				return;
+			} else if (type == cthash::tools::entry_type::other) {
+				return;
+			}
+
+			names.emplace_back(name);
+
+			if (names.size() == batch_max_files) {
+				stat_names();
+			}
+		});
+
+		stat_names();
+		submit_batch();
+
+		if (not ok) {
+			fail(path, "can't read directory!");
+		}
+	}
+
+	// members are hashed directly from the mapped archive (or from buffer of stdin) as the archive is parsed
+	void process_archive(const std::string & path, size_t worker) {
+		auto & telemetry = telemetry_of(worker);
+		const auto file_scope = telemetry.measure(cthash::tools::phase::file, path);
+
+		// with more archives members are prefixed by name of their archive
+		const auto prefix = (opts.files.size() > 1u) ? (path + ':') : std::string{};
+		const auto whole = opts.archive_digest ? algorithm.create() : nullptr;
+
+		struct member_handler {
+			checksum_run & run;
+			size_t worker;
+			const std::string & prefix;
+			std::unique_ptr<cthash::tools::streaming_hasher> hasher{};
+			std::string name{};
+			std::string member_path{};
+
+			// digests of regular members by their path in the archive, so hardlinks to them can be reported too
+			std::unordered_map<std::string, cthash::tools::digest_value> digests{};
+
+			void begin(const cthash::tools::tar_member & member) {
+				if (member.regular()) {
+					hasher = run.algorithm.create();
+					name = prefix + member.path;
+					member_path = member.path;
+				} else if (member.hardlink()) {
+					if (const auto it = digests.find(member.link_target); it != digests.end()) {
+						++run.telemetry_of(worker).files;
+						run.report(prefix + member.path, it->second, worker);
+					} else {
+						run.fail(prefix + member.path, "hardlink to '" + member.link_target + "' which isn't earlier in the archive!");
+					}
+				}
+			}
+
+			void data(std::span<const std::byte> in) {
+				if (hasher) {
+					const auto _ = run.telemetry_of(worker).measure(cthash::tools::phase::hash, name);
+					hasher->update(in);
+				}
+			}
+
+			void end() {
+				if (hasher) {
+					++run.telemetry_of(worker).files;
+					const auto digest = hasher->final();
+					run.report(name, digest, worker);
+					digests.insert_or_assign(std::move(member_path), digest);
+					hasher.reset();
+				}
+			}
+		};
+
+		auto reader = cthash::tools::tar_reader{};
+		auto handler = member_handler{*this, worker, prefix};
+
+		const auto feed = [&](std::span<const std::byte> in) {
+			telemetry.bytes += in.size();
+
+			if (whole) {
+				const auto _ = telemetry.measure(cthash::tools::phase::hash, path);
+				whole->update(in);
+			}
+
+			return reader.feed(in, handler);
+		};
+
+		if (path == "-") {
+			auto & arena = workers[worker].arena;
+			arena.resize(chunk_size);
+
+			for (;;) {
+				const auto size = [&] {
+					const auto _ = telemetry.measure(cthash::tools::phase::read, path);
+					return read_into(STDIN_FILENO, arena);
+				}();
+
+				if (not size) {
+					return fail(path, "can't read archive!");
+				}
+
+				telemetry.account(cthash::tools::phase::throttle, throttle.acquire(*size), path);
+
+				if (*size == 0u || not feed(std::span<const std::byte>(arena).first(*size))) {
+					break;
+				}
+			}
+		} else {
+			auto open_scope = std::optional<cthash::tools::worker_telemetry::scope>{std::in_place, telemetry, cthash::tools::phase::open, path};
+			const auto f = cthash::tools::input_file(path.c_str());
+			const auto m = f.valid() ? cthash::tools::mapped_file(f) : cthash::tools::mapped_file(cthash::tools::input_file::invalid, 0u);
+			open_scope.reset();
+
+			if (not f.valid()) {
+				return fail(path, "can't open archive!");
+			} else if (not m.valid() && f.metadata.size != 0u) {
+				return fail(path, "can't map archive!");
+			}
+
+			// parsing is interleaved with hashing of the whole archive, so each piece is read only once
+			for (auto in = m.get_span(); not in.empty();) {
+				const auto chunk = in.first(std::min(in.size(), chunk_size));
+				telemetry.account(cthash::tools::phase::throttle, throttle.acquire(chunk.size()), path);
+
+				if (not feed(chunk)) {
+					break;
+				}
+
+				in = in.subspan(chunk.size());
+			}
+		}
+
+		if (reader.current == cthash::tools::tar_reader::state::error) {
+			return fail(path, reader.error);
+		} else if (not reader.complete()) {
+			return fail(path, "archive is truncated");
+		}
+
+		if (whole) {
+			report(path, whole->final(), worker);
+		}
+	}
+
+	void start(const char * path) {
+		if (opts.tar) {
+			pool.submit([this, p = std::string(path)](size_t w) { process_archive(p, w); });
+			return;
+		}
+
+		struct stat st;
+		const bool exists = stat(path, &st) == 0;
+
+		if (exists && S_ISDIR(st.st_mode)) {
+			if (opts.recursive) {
+				pool.submit([this, p = std::string(path)](size_t w) { walk(p, w); });
+			} else {
+				fail(path, "is a directory (use -r)");
+			}
+			return;
+		}
+
+		pool.submit([this, p = std::string(path)](size_t w) { process_file(AT_FDCWD, p, p.c_str(), std::nullopt, w); }, exists ? node_for(static_cast<uint64_t>(st.st_dev)) : cthash::tools::thread_pool::any_node);
 	}
 };
 
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void request_stop(int) {
+	stop_requested = 1;
+}
+
+// rehashes files after they were closed after write and stayed quiet for `settle` time, until interrupted
+static bool watch_loop(checksum_run & run, cthash::tools::watcher & watcher) {
+	using clock = std::chrono::steady_clock;
+	constexpr auto cache_flush_period = std::chrono::seconds{5};
+
+	std::signal(SIGINT, request_stop);
+	std::signal(SIGTERM, request_stop);
+
+	// don't react on our own writes into the cache file
+	struct stat cache_stat {};
+	const bool has_cache_file = run.opts.cache_path && stat(run.opts.cache_path->c_str(), &cache_stat) == 0;
+
+	std::unordered_map<std::string, clock::time_point> pending;
+	std::vector<cthash::tools::watch_event> events;
+	auto last_flush = clock::now();
+
+	while (not stop_requested) {
+		auto timeout = std::chrono::milliseconds{1000};
+		const auto now = clock::now();
+
+		for (const auto & [path, deadline]: pending) {
+			timeout = std::min(timeout, std::chrono::ceil<std::chrono::milliseconds>(std::max(deadline - now, clock::duration{})));
+		}
+
+		events.clear();
+
+		if (not watcher.poll(events, static_cast<int>(timeout.count()))) {
+			std::cerr << "can't read events!\n";
+			return false;
+		}
+
+		const auto received = clock::now();
+
+		for (auto & ev: events) {
+			switch (ev.what) {
+			case cthash::tools::watch_event::kind::written:
+				// every write in a burst moves the deadline
+				pending.insert_or_assign(std::move(ev.path), received + run.opts.settle);
+				break;
+			case cthash::tools::watch_event::kind::removed:
+				pending.erase(ev.path);
+				run.forget(ev.path, ev.directory);
+				break;
+			case cthash::tools::watch_event::kind::overflow:
+				run.rescan();
+				break;
+			}
+		}
+
+		for (auto it = pending.begin(); it != pending.end();) {
+			if (it->second > received) {
+				++it;
+				continue;
+			}
+
+			struct stat st;
+			const bool is_cache_file = has_cache_file && stat(it->first.c_str(), &st) == 0 && st.st_dev == cache_stat.st_dev && st.st_ino == cache_stat.st_ino;
+
+			if (not is_cache_file) {
+				run.pool.submit([&run, p = it->first](size_t w) { run.process_file(AT_FDCWD, p, p.c_str(), std::nullopt, w); });
+			}
+
+			it = pending.erase(it);
+		}
+
+		if (run.cache && received - last_flush >= cache_flush_period) {
+			run.cache->flush();
+			last_flush = received;
+		}
+	}
+
+	run.pool.wait();
+	return true;
+}
+
+// deep trees keep many directories open
+static void raise_open_files_limit() noexcept {
+	struct rlimit lim;
+
+	if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+}
+
+// settings stored for this CPU, hash function and number of workers, they are calibrated (and stored) when
+// there are none yet, without `--autotune` defaults are used
+static auto tuned_settings(const options & opts) -> cthash::tools::tuning {
+	if (not opts.autotune) {
+		return {};
+	}
+
+	const auto path = opts.tuning_path ? std::optional<std::filesystem::path>{*opts.tuning_path} : cthash::tools::default_tuning_path();
+	const auto file = cthash::tools::tuning_file{path.value_or(std::filesystem::path{})};
+	const auto key = cthash::tools::tuning_file::key{cthash::tools::cpu_model(), std::string(opts.algorithm->name), opts.jobs};
+
+	if (path && not opts.recalibrate) {
+		if (const auto stored = file.load(key)) {
+			return *stored;
+		}
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	// bad $TMPDIR is reported as failed calibration
+	std::error_code ec;
+	const auto scratch = std::filesystem::temp_directory_path(ec);
+	const auto calibrated = ec ? std::nullopt : cthash::tools::calibrate(*opts.algorithm, opts.jobs, scratch);
+
+	if (not calibrated) {
+		std::cerr << "can't calibrate I/O settings, defaults are used!\n";
+		return {};
+	}
+
+	std::cerr << "I/O settings calibrated in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms";
+	std::cerr << " (small files up to " << calibrated->small_file_limit << " B, large files " << (calibrated->read_large ? "read" : "mapped");
+
+	if (opts.algorithm->hash_many != nullptr) {
+		std::cerr << ", multi-buffer hashing ";
+		if (calibrated->min_multi_buffer_batch == UINT64_MAX) {
+			std::cerr << "not used";
+		} else {
+			std::cerr << "from " << calibrated->min_multi_buffer_batch << " files";
+		}
+	}
+
+	std::cerr << ")\n";
+
+	if (path && not file.store(key, *calibrated)) {
+		std::cerr << "can't store tuned settings in " << path->string() << "!\n";
+	}
+
+	return *calibrated;
+}
+
 int main(int argc, char ** argv) {
-	if (argc < 3) {
-		std::cerr << argv[0] << " hash file\n";
-		std::cerr << "hash is one of: sha-224, sha-256, sha-384, sha-512, sha-512/223, sha-512/256, sha3-224, sha3-256, sha3-384, sha3-512, \n";
-		std::cerr << "  shake-128/n, shake-256/n (where n is 32/64/128/256/512/1024/2048),\n";
-		std::cerr << "  xxhash32, xxhash64\n";
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
 		return 1;
 	}
 
-	const auto h = std::string_view(argv[1]);
-	const auto f = mapped_file(argv[2]);
+	raise_open_files_limit();
+
+	if (opts->adaptive_threshold > 0.0 && not cthash::tools::pressure_available()) {
+		std::cerr << "pressure stall information is not available, --adaptive has no effect!\n";
+	}
+
+	// before the pool is created, so its threads inherit it
+	if (opts->idle && not cthash::tools::become_idle()) {
+		std::cerr << "can't switch to idle priority!\n";
+	}
+
+	auto cache = opts->cache_path ? std::make_unique<cthash::tools::digest_cache>(*opts->cache_path) : nullptr;
+	auto run = std::make_unique<checksum_run>(*opts, cache.get(), tuned_settings(*opts));
 
-	if (f.fd == mapped_file::invalid) {
-		std::cerr << "can't open file!\n";
+	// watches are set up before the initial scan, so no change is missed
+	const auto watcher = opts->watch ? cthash::tools::make_watcher(std::vector<std::string>(opts->files.begin(), opts->files.end())) : nullptr;
+
+	if (opts->watch && not watcher) {
+		std::cerr << "can't watch given directories!\n";
 		return 1;
 	}
 
 	const auto start = std::chrono::high_resolution_clock::now();
 
-	if (h == "sha-224") {
-		std::cout << cthash::sha224{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha-256") {
-		std::cout << cthash::sha256{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha-384") {
-		std::cout << cthash::sha384{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha-512") {
-		std::cout << cthash::sha512{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha-512/224") {
-		std::cout << cthash::sha512t<224>{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha-512/256") {
-		std::cout << cthash::sha512t<256>{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha3-224") {
-		std::cout << cthash::sha3_224{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha3-256") {
-		std::cout << cthash::sha3_256{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha3-384") {
-		std::cout << cthash::sha3_384{}.update(f.get_span()).final() << "\n";
-	} else if (h == "sha3-512") {
-		std::cout << cthash::sha3_512{}.update(f.get_span()).final() << "\n";
-	} else if (h == "shake-128/32") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<32>() << "\n";
-	} else if (h == "shake-128/64") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<64>() << "\n";
-	} else if (h == "shake-128/128") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<128>() << "\n";
-	} else if (h == "shake-128/256") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<256>() << "\n";
-	} else if (h == "shake-128/512") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<512>() << "\n";
-	} else if (h == "shake-128/1024") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<1024>() << "\n";
-	} else if (h == "shake-128/2048") {
-		std::cout << cthash::shake128{}.update(f.get_span()).final<2048>() << "\n";
-	} else if (h == "shake-256/32") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<32>() << "\n";
-	} else if (h == "shake-256/64") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<64>() << "\n";
-	} else if (h == "shake-256/128") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<128>() << "\n";
-	} else if (h == "shake-256/256") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<256>() << "\n";
-	} else if (h == "shake-256/512") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<512>() << "\n";
-	} else if (h == "shake-256/1024") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<1024>() << "\n";
-	} else if (h == "shake-256/2048") {
-		std::cout << cthash::shake256{}.update(f.get_span()).final<2048>() << "\n";
-	} else if (h == "xxhash32") {
-		std::cout << cthash::xxhash32{}.update(f.get_span()).final() << "\n";
-	} else if (h == "xxhash64") {
-		std::cout << cthash::xxhash64{}.update(f.get_span()).final() << "\n";
-	} else {
-		std::cerr << "unknown hash function!\n";
-		return 1;
+	for (const char * path: opts->files) {
+		run->start(path);
+	}
+
+	run->pool.wait();
+
+	if (watcher) {
+		std::cerr << "watching for changes (using " << watcher->backend() << ")\n";
+		run->live = true;
+
+		if (not watch_loop(*run, *watcher)) {
+			run->result = 1;
+		}
+	}
+
+	int result = run->result;
+
+	if (cache) {
+		if (not cache->flush()) {
+			std::cerr << "can't write cache file!\n";
+			result = 1;
+		}
+
+		if (opts->compact_cache && not cache->compact()) {
+			std::cerr << "can't compact cache file!\n";
+			result = 1;
+		}
 	}
 
 	const auto end = std::chrono::high_resolution_clock::now();
 	const auto dur = end - start;
 
-	std::cerr << "and it took " << std::chrono::duration_cast<std::chrono::milliseconds>(dur).count() << " ms\n";
-}
\ No newline at end of file
+	std::vector<cthash::tools::worker_telemetry> telemetry;
+	for (auto & w: run->workers) {
+		telemetry.emplace_back(std::move(w.telemetry));
+	}
+
+	if (opts->trace_path) {
+		auto out = std::ofstream(*opts->trace_path);
+		cthash::tools::write_chrome_trace(out, telemetry);
+
+		if (not out) {
+			std::cerr << "can't write trace file!\n";
+			result = 1;
+		}
+	}
+
+	if (opts->stats_json) {
+		cthash::tools::write_stats_json(std::cerr, telemetry, std::chrono::duration<double>(dur).count());
+	} else {
+		std::cerr << "and it took " << std::chrono::duration_cast<std::chrono::milliseconds>(dur).count() << " ms\n";
+	}
+
+	return result;
+}
@@ -0,0 +1,459 @@
+#include "tools/algorithms.hpp"
+#include "tools/arguments.hpp"
+#include "tools/directory.hpp"
+#include "tools/json.hpp"
+#include "tools/mapped-file.hpp"
+#include "tools/sparse.hpp"
+#include "tools/thread-pool.hpp"
+#include <cthash/xxhash.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+
+struct options {
+	const cthash::tools::algorithm * algorithm{cthash::tools::find_algorithm("sha-256")};
+	std::vector<const char *> paths{};
+	size_t jobs{cthash::tools::thread_pool::default_size()};
+	uint64_t min_size{1u};
+	bool csv{false};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options] path...\n";
+	std::cerr << "finds files with same content: files are grouped by size, then by xxhash64 of their first and last 4 KiB\n";
+	std::cerr << "and only then by a strong hash of whole content\n";
+	std::cerr << "options:\n";
+	std::cerr << "  -j N                  number of worker threads (default is number of CPUs)\n";
+	std::cerr << "  --hash=NAME           strong hash for the last stage (default sha-256, see checksum for the list)\n";
+	std::cerr << "  --min-size=BYTES      ignore smaller files (default 1, so empty files are ignored)\n";
+	std::cerr << "  --format=json|csv     format of the report (default json)\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("-j")) {
+			const auto jobs = cthash::tools::jobs_argument(arg, i, argc, argv);
+			if (not jobs) {
+				std::cerr << "number of jobs must be positive number!\n";
+				return std::nullopt;
+			}
+			opts.jobs = *jobs;
+		} else if (arg.starts_with("--hash=")) {
+			opts.algorithm = cthash::tools::find_algorithm(arg.substr(7));
+			if (opts.algorithm == nullptr) {
+				std::cerr << "unknown hash function!\n";
+				return std::nullopt;
+			}
+		} else if (arg.starts_with("--min-size=")) {
+			const auto size = cthash::tools::parse_number<uint64_t>(arg.substr(11));
+			if (not size) {
+				std::cerr << "minimal size must be a number of bytes!\n";
+				usage(argv[0]);
+				return std::nullopt;
+			}
+			opts.min_size = *size;
+		} else if (arg == "--format=json") {
+			opts.csv = false;
+		} else if (arg == "--format=csv") {
+			opts.csv = true;
+		} else if (arg.starts_with("-")) {
+			std::cerr << "unknown option '" << arg << "'!\n";
+			return std::nullopt;
+		} else {
+			opts.paths.emplace_back(argv[i]);
+		}
+	}
+
+	if (opts.paths.empty()) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+// size of the beginning and of the end of a file which are hashed in the second stage
+static constexpr size_t edge_size = 4096u;
+
+struct file_entry {
+	std::string path;
+	cthash::tools::file_metadata metadata;
+};
+
+enum class stage { edges, content };
+
+// members of a group go to the next stage only once there are at least two of them
+struct candidate_group {
+	std::optional<size_t> waiting{};
+	size_t members{0u};
+};
+
+struct duplicate_group {
+	uint64_t size;
+	std::string digest;
+	std::vector<std::string> paths;
+
+	auto wasted() const noexcept -> uint64_t {
+		return size * (paths.size() - 1u);
+	}
+};
+
+struct dupes_run {
+	const options & opts;
+
+	std::mutex mutex{};
+	std::deque<file_entry> files{};
+	std::set<std::pair<uint64_t, uint64_t>> seen_inodes{};
+
+	std::unordered_map<uint64_t, candidate_group> by_size{};
+	std::map<std::pair<uint64_t, uint64_t>, candidate_group> by_edges{};
+	std::map<std::pair<uint64_t, std::string>, std::vector<size_t>> by_digest{};
+
+	// files waiting for I/O of each stage, kept as heaps ordered by inode
+	std::array<std::vector<size_t>, 2> queues{};
+
+	std::atomic<int> result{0};
+	std::atomic<uint64_t> bytes_hashed{0u};
+	std::array<uint64_t, 2> candidates{};
+
+	// pool is last, so its workers are joined before rest of the state is destroyed
+	cthash::tools::thread_pool pool;
+
+	explicit dupes_run(const options & o): opts{o}, pool{o.jobs} { }
+
+	void fail(const std::string & path, std::string_view message) {
+		result = 1;
+
+		std::lock_guard lock{mutex};
+		std::cerr << path << ": " << message << "\n";
+	}
+
+	// lowest inode on top, so reads roughly follow the on-disk layout
+	auto inode_order() const {
+		return [this](size_t lhs, size_t rhs) {
+			const auto & l = files[lhs].metadata;
+			const auto & r = files[rhs].metadata;
+			return std::pair{l.device, l.inode} > std::pair{r.device, r.inode};
+		};
+	}
+
+	// expects locked mutex
+	void enqueue(size_t index, stage s) {
+		auto & queue = queues[static_cast<size_t>(s)];
+		queue.push_back(index);
+		std::push_heap(queue.begin(), queue.end(), inode_order());
+		++candidates[static_cast<size_t>(s)];
+
+		// task takes whichever file is first in the queue at the time it runs
+		pool.submit([this, s](size_t) { process_next(s); });
+	}
+
+	// expects locked mutex
+	void admit(candidate_group & group, size_t index, stage next) {
+		if (++group.members == 1u) {
+			group.waiting = index;
+			return;
+		}
+
+		if (group.waiting) {
+			enqueue(*group.waiting, next);
+			group.waiting.reset();
+		}
+
+		enqueue(index, next);
+	}
+
+	void add_file(std::string path, const cthash::tools::file_metadata & md) {
+		if (md.size < opts.min_size) {
+			return;
+		}
+
+		std::lock_guard lock{mutex};
+
+		// hard links of an already seen file are not duplicates
+		if (not seen_inodes.emplace(md.device, md.inode).second) {
+			return;
+		}
+
+		const size_t index = files.size();
+		files.push_back({std::move(path), md});
+		admit(by_size[md.size], index, stage::edges);
+	}
+
+	void process_next(stage s) {
+		size_t index;
+		file_entry file;
+
+		{
+			std::lock_guard lock{mutex};
+			auto & queue = queues[static_cast<size_t>(s)];
+			std::pop_heap(queue.begin(), queue.end(), inode_order());
+			index = queue.back();
+			queue.pop_back();
+			file = files[index];
+		}
+
+		if (s == stage::edges) {
+			if (const auto edges = hash_edges(file)) {
+				std::lock_guard lock{mutex};
+				admit(by_edges[{file.metadata.size, *edges}], index, stage::content);
+			}
+		} else {
+			if (auto digest = hash_content(file)) {
+				std::lock_guard lock{mutex};
+				by_digest[{file.metadata.size, std::move(*digest)}].push_back(index);
+			}
+		}
+	}
+
+	// the file must be same as when it was found, otherwise comparing it with others makes no sense
+	bool opened_unchanged(const file_entry & file, const cthash::tools::input_file & f) {
+		if (not f.valid()) {
+			fail(file.path, "can't open file!");
+			return false;
+		}
+
+		if (f.metadata.size != file.metadata.size || f.metadata.inode != file.metadata.inode) {
+			fail(file.path, "file changed while searching for duplicates!");
+			return false;
+		}
+
+		return true;
+	}
+
+	auto hash_edges(const file_entry & file) -> std::optional<uint64_t> {
+		const auto f = cthash::tools::input_file(file.path.c_str());
+
+		if (not opened_unchanged(file, f)) {
+			return std::nullopt;
+		}
+
+		std::array<std::byte, 2u * edge_size> buffer;
+		const size_t size = static_cast<size_t>(file.metadata.size);
+
+		// small files are read whole (their edges overlap)
+		const auto read_at = [&](size_t offset, std::span<std::byte> out) {
+			return pread(f.fd, out.data(), out.size(), static_cast<off_t>(offset)) == static_cast<ssize_t>(out.size());
+		};
+
+		const auto content = [&]() -> std::optional<std::span<const std::byte>> {
+			if (size <= buffer.size()) {
+				const auto out = std::span(buffer).first(size);
+				return read_at(0u, out) ? std::optional{std::span<const std::byte>(out)} : std::nullopt;
+			}
+
+			const auto first = std::span(buffer).first(edge_size);
+			const auto last = std::span(buffer).last(edge_size);
+			return (read_at(0u, first) && read_at(size - edge_size, last)) ? std::optional{std::span<const std::byte>(buffer)} : std::nullopt;
+		}();
+
+		if (not content) {
+			fail(file.path, "can't read file!");
+			return std::nullopt;
+		}
+
+		const auto r = cthash::xxhash64{}.update(*content).final();
+		return cthash::cast_from_bytes<uint64_t>(std::span<const std::byte, sizeof(uint64_t)>(r));
+	}
+
+	auto hash_content(const file_entry & file) -> std::optional<std::string> {
+		const auto f = cthash::tools::input_file(file.path.c_str());
+
+		if (not opened_unchanged(file, f)) {
+			return std::nullopt;
+		}
+
+		const auto m = cthash::tools::mapped_file(f);
+
+		if (not m.valid()) {
+			fail(file.path, "can't map file!");
+			return std::nullopt;
+		}
+
+		const auto content = m.get_span();
+		auto h = opts.algorithm->create();
+
+		// holes of sparse files are not read
+		for (const auto & e: cthash::tools::find_extents(f.fd, file.metadata.size)) {
+			if (e.hole) {
+				cthash::tools::feed_zeros(e.length, [&](std::span<const std::byte> zeros) { h->update(zeros); });
+			} else {
+				h->update(content.subspan(static_cast<size_t>(e.offset), static_cast<size_t>(e.length)));
+			}
+		}
+
+		bytes_hashed += file.metadata.size;
+
+		auto out = std::ostringstream{};
+		out << h->final();
+		return out.str();
+	}
+
+	void walk(const std::string & path) {
+		const auto dir = cthash::tools::directory(AT_FDCWD, path.c_str());
+
+		if (not dir.valid()) {
+			fail(path, "can't open directory!");
+			return;
+		}
+
+		const auto prefix = path.ends_with('/') ? path : (path + '/');
+
+		const bool ok = cthash::tools::for_each_entry(dir.fd, [&](std::string_view name, cthash::tools::entry_type type) {
+			auto child = prefix + std::string(name);
+
+			if (type == cthash::tools::entry_type::directory) {
+				pool.submit([this, child](size_t) { walk(child); });
+				return;
+			} else if (type == cthash::tools::entry_type::other) {
+				return;
+			}
+
+			const auto status = cthash::tools::stat_at(dir.fd, std::string(name).c_str());
+
+			if (not status) {
+				fail(child, "can't stat file!");
+			} else if (status->type == cthash::tools::entry_type::directory) {
+				pool.submit([this, child](size_t) { walk(child); });
+			} else if (status->type == cthash::tools::entry_type::regular) {
+				add_file(std::move(child), status->metadata);
+			}
+		});
+
+		if (not ok) {
+			fail(path, "can't read directory!");
+		}
+	}
+
+	void start(const char * path) {
+		struct stat st;
+
+		if (lstat(path, &st) != 0) {
+			fail(path, "can't stat file!");
+		} else if (S_ISDIR(st.st_mode)) {
+			pool.submit([this, p = std::string(path)](size_t) { walk(p); });
+		} else if (S_ISREG(st.st_mode)) {
+			add_file(path, cthash::tools::file_metadata::from_stat(st));
+		}
+	}
+
+	// biggest waste of space first
+	auto duplicates() const -> std::vector<duplicate_group> {
+		std::vector<duplicate_group> out;
+
+		for (const auto & [key, members]: by_digest) {
+			if (members.size() < 2u) {
+				continue;
+			}
+
+			duplicate_group group{key.first, key.second, {}};
+
+			for (const size_t index: members) {
+				group.paths.push_back(files[index].path);
+			}
+
+			std::sort(group.paths.begin(), group.paths.end());
+			out.push_back(std::move(group));
+		}
+
+		std::sort(out.begin(), out.end(), [](const duplicate_group & lhs, const duplicate_group & rhs) {
+			return std::pair{lhs.wasted(), rhs.paths.front()} > std::pair{rhs.wasted(), lhs.paths.front()};
+		});
+
+		return out;
+	}
+
+	void write_json(std::ostream & os, const std::vector<duplicate_group> & groups) const {
+		uint64_t wasted = 0u;
+		for (const auto & g: groups) {
+			wasted += g.wasted();
+		}
+
+		os << "{\n";
+		os << "  \"algorithm\": \"" << opts.algorithm->name << "\",\n";
+		os << "  \"files\": " << files.size() << ",\n";
+		os << "  \"same_size_files\": " << candidates[static_cast<size_t>(stage::edges)] << ",\n";
+		os << "  \"same_edges_files\": " << candidates[static_cast<size_t>(stage::content)] << ",\n";
+		os << "  \"bytes_hashed\": " << bytes_hashed << ",\n";
+		os << "  \"wasted_bytes\": " << wasted << ",\n";
+		os << "  \"groups\": [";
+
+		for (size_t i = 0; i != groups.size(); ++i) {
+			const auto & g = groups[i];
+			os << ((i != 0u) ? ",\n" : "\n") << "    {\"size\": " << g.size << ", \"digest\": \"" << g.digest << "\", \"files\": [";
+
+			for (size_t j = 0; j != g.paths.size(); ++j) {
+				os << ((j != 0u) ? ", " : "");
+				cthash::tools::write_json_string(os, g.paths[j]);
+			}
+
+			os << "]}";
+		}
+
+		os << (groups.empty() ? "]\n" : "\n  ]\n") << "}\n";
+	}
+
+	static void write_csv_field(std::ostream & os, std::string_view in) {
+		os << '"';
+		for (const char c: in) {
+			os << ((c == '"') ? "\"\"" : std::string_view(&c, 1u));
+		}
+		os << '"';
+	}
+
+	void write_csv(std::ostream & os, const std::vector<duplicate_group> & groups) const {
+		os << "group,size,digest,path\n";
+
+		for (size_t i = 0; i != groups.size(); ++i) {
+			for (const auto & path: groups[i].paths) {
+				os << i << "," << groups[i].size << "," << groups[i].digest << ",";
+				write_csv_field(os, path);
+				os << "\n";
+			}
+		}
+	}
+};
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	auto run = std::make_unique<dupes_run>(*opts);
+
+	// stages are pipelined: a file goes to the next stage as soon as it has a partner in its group
+	for (const char * path: opts->paths) {
+		run->start(path);
+	}
+
+	run->pool.wait();
+
+	const auto groups = run->duplicates();
+
+	if (opts->csv) {
+		run->write_csv(std::cout, groups);
+	} else {
+		run->write_json(std::cout, groups);
+	}
+
+	return run->result;
+}
@@ -0,0 +1,315 @@
+#ifndef CTHASH_ARGON2_ARGON2ID_HPP
+#define CTHASH_ARGON2_ARGON2ID_HPP
+
+#include "../blake2/blake2b.hpp"
+#include "../internal/assert.hpp"
+#include "../internal/convert.hpp"
+#include "blamka.hpp"
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <span>
+#include <type_traits>
+#include <cstdint>
+
+namespace cthash {
+
+namespace argon2 {
+
+	static constexpr uint32_t version = 0x13u;
+	static constexpr uint32_t type_id = 2u; // Argon2id
+
+	// each pass is split into slices, all lanes fill one slice (their segments) before any lane starts the next one
+	static constexpr uint32_t slices = 4u;
+
+	static constexpr size_t block_size = 1024u;
+
+	// RFC 9106 section 3.1 recommends 16 bytes (random) for password hashing
+	static constexpr size_t min_salt_size = 8u;
+
+	struct parameters {
+		uint32_t passes{3u};       // t
+		uint32_t memory_kib{65536u}; // m (at least 8 KiB per lane)
+		uint32_t lanes{4u};        // p
+		uint32_t tag_length{32u};  // T
+		std::span<const std::byte> secret{};
+		std::span<const std::byte> associated_data{};
+	};
+
+	// limits from RFC 9106 section 3.1: 1 to 2^24 - 1 lanes, at least 1 pass, tag of at least 4 bytes (and `tag_size`
+	// must be the same as `tag_length`), salt of at least 8 bytes, at least 8 KiB of memory per lane
+	constexpr auto valid(const parameters & p, size_t tag_size, size_t salt_size) noexcept -> bool {
+		return p.lanes >= 1u && p.lanes <= 0xFF'FFFFu && p.passes >= 1u && p.tag_length >= 4u && tag_size == p.tag_length && salt_size >= min_salt_size && p.memory_kib >= 8u * p.lanes;
+	}
+
+	// m' (number of 1 KiB blocks) is m rounded down to multiple of 4p (no memory without lanes)
+	constexpr auto memory_blocks(const parameters & p) noexcept -> size_t {
+		if (p.lanes == 0u) {
+			return 0u;
+		}
+
+		return static_cast<size_t>(p.memory_kib / (slices * p.lanes)) * slices * p.lanes;
+	}
+
+	constexpr auto le32(uint32_t value) noexcept -> std::array<std::byte, 4> {
+		std::array<std::byte, 4> out{};
+		unwrap_littleendian_number<uint32_t>{out} = value;
+		return out;
+	}
+
+	// H' (variable-length hash): BLAKE2b of LE32(length) and `parts` when it fits into 64 bytes, otherwise chain of
+	// BLAKE2b-512 where each step contributes first half of its output and the last one the rest
+	constexpr void long_hash(std::span<std::byte> out, std::initializer_list<std::span<const std::byte>> parts) noexcept {
+		const auto length = le32(static_cast<uint32_t>(out.size()));
+
+		if (out.size() <= 64u) {
+			blake2::blake2b_state h{out.size()};
+			h.update(std::span<const std::byte>(length));
+			for (const auto part: parts) {
+				h.update(part);
+			}
+			h.final(out);
+			return;
+		}
+
+		std::array<std::byte, 64> v{};
+		{
+			blake2::blake2b_state h{64u};
+			h.update(std::span<const std::byte>(length));
+			for (const auto part: parts) {
+				h.update(part);
+			}
+			h.final(v);
+		}
+
+		std::copy_n(v.begin(), 32u, out.begin());
+		size_t position = 32u;
+
+		for (; out.size() - position > 64u; position += 32u) {
+			blake2::blake2b_state h{64u};
+			h.update(std::span<const std::byte>(v));
+			h.final(v);
+			std::copy_n(v.begin(), 32u, out.begin() + static_cast<std::ptrdiff_t>(position));
+		}
+
+		blake2::blake2b_state h{out.size() - position};
+		h.update(std::span<const std::byte>(v));
+		h.final(out.subspan(position));
+	}
+
+	constexpr void load(block & b, std::span<const std::byte, block_size> in) noexcept {
+		for (size_t i = 0; i != b.words.size(); ++i) {
+			b.words[i] = cast_from_le_bytes<uint64_t>(in.subspan(i * 8u).template first<8>());
+		}
+	}
+
+	constexpr void store(std::span<std::byte, block_size> out, const block & b) noexcept {
+		for (size_t i = 0; i != b.words.size(); ++i) {
+			unwrap_littleendian_number<uint64_t>{out.subspan(i * 8u).template first<8>()} = b.words[i];
+		}
+	}
+
+	// runs `fn(lane)` for every lane and returns when all of them finished (they can run in parallel)
+	struct sequential_lanes {
+		template <typename Fn> constexpr void operator()(uint32_t lanes, Fn && fn) const {
+			for (uint32_t lane = 0; lane != lanes; ++lane) {
+				fn(lane);
+			}
+		}
+	};
+
+	// Argon2id (RFC 9106) over memory provided by the caller (`memory_blocks(params)` blocks), so the same code runs
+	// in constant evaluation (with small memory) and with huge pages and threads at runtime; segments of different
+	// lanes in one slice touch disjoint blocks and read only slices already finished, so `fill_segment` can be
+	// called concurrently for them
+	struct instance {
+		parameters params;
+		std::span<block> memory;
+		kernel compression;
+		uint32_t lane_length;
+		uint32_t segment_length;
+
+		// parameters must be `valid` (salt is checked in `initialize`)
+		constexpr instance(const parameters & p, std::span<block> m, kernel k = best_kernel()) noexcept: params{p}, memory{m}, compression{k}, lane_length{static_cast<uint32_t>(memory_blocks(p) / p.lanes)}, segment_length{lane_length / slices} {
+			CTHASH_ASSERT(valid(p, p.tag_length, min_salt_size));
+			CTHASH_ASSERT(m.size() == memory_blocks(p));
+			CTHASH_ASSERT(kernel_available(k) || std::is_constant_evaluated());
+		}
+
+		constexpr auto at(uint32_t lane, uint32_t index) noexcept -> block & {
+			return memory[static_cast<size_t>(lane) * lane_length + index];
+		}
+
+		// H0 and the first two blocks of each lane
+		constexpr void initialize(std::span<const std::byte> password, std::span<const std::byte> salt) noexcept {
+			CTHASH_ASSERT(salt.size() >= min_salt_size);
+
+			std::array<std::byte, 64> h0{};
+			{
+				blake2::blake2b_state h{64u};
+				const auto number = [&](size_t value) {
+					h.update(std::span<const std::byte>(le32(static_cast<uint32_t>(value))));
+				};
+				const auto string = [&](std::span<const std::byte> value) {
+					number(value.size());
+					h.update(value);
+				};
+
+				number(params.lanes);
+				number(params.tag_length);
+				number(params.memory_kib);
+				number(params.passes);
+				number(version);
+				number(type_id);
+				string(password);
+				string(salt);
+				string(params.secret);
+				string(params.associated_data);
+				h.final(h0);
+			}
+
+			std::array<std::byte, block_size> bytes{};
+
+			for (uint32_t lane = 0; lane != params.lanes; ++lane) {
+				for (uint32_t index = 0; index != 2u; ++index) {
+					long_hash(bytes, {h0, le32(index), le32(lane)});
+					load(at(lane, index), bytes);
+				}
+			}
+		}
+
+		// the next block of addresses for data-independent indexing (first half of a pass)
+		constexpr void next_addresses(block & addresses, block & input) const noexcept {
+			constexpr block zero{};
+			++input.words[6];
+			compress(compression, zero, input, addresses, false);
+			compress(compression, zero, addresses, addresses, false);
+		}
+
+		constexpr void fill_segment(uint32_t pass, uint32_t slice, uint32_t lane) noexcept {
+			const bool independent = (pass == 0u && slice < slices / 2u);
+
+			block addresses{};
+			block input{};
+
+			if (independent) {
+				input.words[0] = pass;
+				input.words[1] = lane;
+				input.words[2] = slice;
+				input.words[3] = memory.size();
+				input.words[4] = params.passes;
+				input.words[5] = type_id;
+			}
+
+			uint32_t start = 0u;
+
+			if (pass == 0u && slice == 0u) {
+				// the first two blocks come from H0
+				start = 2u;
+				if (independent) {
+					next_addresses(addresses, input);
+				}
+			}
+
+			for (uint32_t i = start; i != segment_length; ++i) {
+				const uint32_t index = slice * segment_length + i;
+				const uint32_t previous = (index == 0u) ? lane_length - 1u : index - 1u;
+
+				uint64_t pseudo_random;
+				if (independent) {
+					if (i % 128u == 0u) {
+						next_addresses(addresses, input);
+					}
+					pseudo_random = addresses.words[i % 128u];
+				} else {
+					pseudo_random = at(lane, previous).words[0];
+				}
+
+				// the first slice of the first pass references only its own lane
+				const uint32_t reference_lane = (pass == 0u && slice == 0u) ? lane : static_cast<uint32_t>((pseudo_random >> 32u) % params.lanes);
+				const uint32_t reference_index = reference(pass, slice, i, static_cast<uint32_t>(pseudo_random), reference_lane == lane);
+
+				compress(compression, at(lane, previous), at(reference_lane, reference_index), at(lane, index), pass != 0u);
+			}
+		}
+
+		// index of referenced block within its lane, chosen from blocks which are already finished (nonuniformly,
+		// so recent blocks are more likely)
+		constexpr auto reference(uint32_t pass, uint32_t slice, uint32_t i, uint32_t pseudo_random, bool same_lane) const noexcept -> uint32_t {
+			uint32_t area;
+
+			if (pass == 0u) {
+				if (slice == 0u) {
+					area = i - 1u;
+				} else if (same_lane) {
+					area = slice * segment_length + i - 1u;
+				} else {
+					area = slice * segment_length - (i == 0u ? 1u : 0u);
+				}
+			} else {
+				if (same_lane) {
+					area = lane_length - segment_length + i - 1u;
+				} else {
+					area = lane_length - segment_length - (i == 0u ? 1u : 0u);
+				}
+			}
+
+			uint64_t relative = pseudo_random;
+			relative = (relative * relative) >> 32u;
+			relative = area - 1u - ((area * relative) >> 32u);
+
+			// in later passes the area starts after the current segment (wrapping around)
+			const uint32_t start = (pass != 0u && slice != slices - 1u) ? (slice + 1u) * segment_length : 0u;
+
+			return static_cast<uint32_t>((start + relative) % lane_length);
+		}
+
+		template <typename ForEachLane> constexpr void fill(ForEachLane && for_each_lane) {
+			for (uint32_t pass = 0; pass != params.passes; ++pass) {
+				for (uint32_t slice = 0; slice != slices; ++slice) {
+					for_each_lane(params.lanes, [&, pass, slice](uint32_t lane) { fill_segment(pass, slice, lane); });
+				}
+			}
+		}
+
+		// H' of xor of the last blocks of all lanes
+		constexpr void finalize(std::span<std::byte> tag) noexcept {
+			CTHASH_ASSERT(tag.size() == params.tag_length);
+
+			block last = at(0u, lane_length - 1u);
+			for (uint32_t lane = 1; lane < params.lanes; ++lane) {
+				for (size_t i = 0; i != last.words.size(); ++i) {
+					last.words[i] ^= at(lane, lane_length - 1u).words[i];
+				}
+			}
+
+			std::array<std::byte, block_size> bytes{};
+			store(bytes, last);
+			long_hash(tag, {bytes});
+		}
+	};
+
+} // namespace argon2
+
+// Argon2id password hash / key derivation (RFC 9106) with memory from the caller (`argon2::memory_blocks(params)`
+// blocks of 1 KiB), `for_each_lane(lanes, fn)` must call `fn` for each lane and return after all of them finished,
+// it returns false (and in constant evaluation doesn't compile) when parameters aren't `argon2::valid` for `tag`
+// and `salt` or size of `memory` is different, blocks derived from the password stay in `memory`
+template <typename ForEachLane = argon2::sequential_lanes> constexpr bool argon2id(std::span<std::byte> tag, std::span<const std::byte> password, std::span<const std::byte> salt, const argon2::parameters & params, std::span<argon2::block> memory, ForEachLane && for_each_lane = {}, argon2::kernel compression = argon2::best_kernel()) {
+	if (not argon2::valid(params, tag.size(), salt.size()) || memory.size() != argon2::memory_blocks(params)) {
+		if (std::is_constant_evaluated()) {
+			throw "invalid argon2 parameters";
+		}
+		return false;
+	}
+
+	argon2::instance state{params, memory, compression};
+	state.initialize(password, salt);
+	state.fill(for_each_lane);
+	state.finalize(tag);
+	return true;
+}
+
+} // namespace cthash
+
+#endif
@@ -0,0 +1,351 @@
+#ifndef CTHASH_ARGON2_BLAMKA_HPP
+#define CTHASH_ARGON2_BLAMKA_HPP
+
+#include <array>
+#include <bit>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CTHASH_ARGON2_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace cthash::argon2 {
+
+// memory of Argon2 consists of 1 KiB blocks, seen as 128 little-endian 64-bit words
+struct alignas(64) block {
+	std::array<uint64_t, 128> words{};
+};
+
+// implementation of the compression function G, SIMD kernels are selected at runtime by what the CPU supports
+enum class kernel { portable, avx2, avx512 };
+
+// BlaMka: addition with a 32x32 bit product, so each round costs a multiplication (as on any hardware)
+[[gnu::always_inline]] constexpr auto blamka(uint64_t x, uint64_t y) noexcept -> uint64_t {
+	return x + y + 2u * (x & 0xFFFF'FFFFu) * (y & 0xFFFF'FFFFu);
+}
+
+[[gnu::always_inline]] constexpr void blamka_mix(uint64_t & a, uint64_t & b, uint64_t & c, uint64_t & d) noexcept {
+	a = blamka(a, b);
+	d = std::rotr(d xor a, 32);
+	c = blamka(c, d);
+	b = std::rotr(b xor c, 24);
+	a = blamka(a, b);
+	d = std::rotr(d xor a, 16);
+	c = blamka(c, d);
+	b = std::rotr(b xor c, 63);
+}
+
+// permutation P (round of BLAKE2b without message) of 16 words, `at(i)` is index of i-th of them in the block
+template <typename At> [[gnu::always_inline]] constexpr void permutation(std::array<uint64_t, 128> & w, At at) noexcept {
+	const auto mix = [&](size_t a, size_t b, size_t c, size_t d) {
+		blamka_mix(w[at(a)], w[at(b)], w[at(c)], w[at(d)]);
+	};
+
+	mix(0, 4, 8, 12);
+	mix(1, 5, 9, 13);
+	mix(2, 6, 10, 14);
+	mix(3, 7, 11, 15);
+
+	mix(0, 5, 10, 15);
+	mix(1, 6, 11, 12);
+	mix(2, 7, 8, 13);
+	mix(3, 4, 9, 14);
+}
+
+// G(X, Y): R = X xor Y is permuted by rows (16 consecutive words) and then by columns (pairs of words with stride
+// of 16), result is R xor the permuted R (xored also into previous content of `out` in later passes), `out`
+// can be same as `y`
+constexpr void compress_portable(const block & x, const block & y, block & out, bool xor_out) noexcept {
+	block z;
+	block r;
+	for (size_t i = 0; i != r.words.size(); ++i) {
+		z.words[i] = x.words[i] xor y.words[i];
+		r.words[i] = z.words[i] xor (xor_out ? out.words[i] : 0u);
+	}
+
+	for (size_t row = 0; row != 8u; ++row) {
+		permutation(z.words, [row](size_t i) { return row * 16u + i; });
+	}
+
+	for (size_t column = 0; column != 8u; ++column) {
+		permutation(z.words, [column](size_t i) { return column * 2u + (i / 2u) * 16u + (i % 2u); });
+	}
+
+	for (size_t i = 0; i != r.words.size(); ++i) {
+		out.words[i] = z.words[i] xor r.words[i];
+	}
+}
+
+#ifdef CTHASH_ARGON2_X86_KERNELS
+
+// some GCC versions warn about `_mm512_undefined_*` (self-initialized) used inside of AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace x86 {
+
+	// one block is 32 registers: row `r` of 16 words is in registers 4r..4r+3, which are exactly the A, B, C, D
+	// vectors of the permutation; columns 2j and 2j+1 are both in registers j, j+4, ... j+28 (two words of each)
+	// and they are regrouped with cross-lane permutes, so both columns are permuted at once
+	[[gnu::target("avx2")]] inline auto blamka(__m256i x, __m256i y) noexcept -> __m256i {
+		const __m256i product = _mm256_mul_epu32(x, y);
+		return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(product, product));
+	}
+
+	[[gnu::target("avx2")]] inline void mix(__m256i & a, __m256i & b, __m256i & c, __m256i & d) noexcept {
+		const __m256i rotate24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+		const __m256i rotate16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+
+		a = blamka(a, b);
+		d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2, 3, 0, 1));
+		c = blamka(c, d);
+		b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), rotate24);
+		a = blamka(a, b);
+		d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rotate16);
+		c = blamka(c, d);
+		const __m256i t = _mm256_xor_si256(b, c);
+		b = _mm256_xor_si256(_mm256_srli_epi64(t, 63), _mm256_add_epi64(t, t));
+	}
+
+	[[gnu::target("avx2")]] inline void permutation(__m256i & a, __m256i & b, __m256i & c, __m256i & d) noexcept {
+		mix(a, b, c, d);
+
+		// diagonals become columns
+		b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+		c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+		d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+
+		mix(a, b, c, d);
+
+		b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+		c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+		d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+	}
+
+	inline auto as_m256(uint64_t * words) noexcept -> __m256i * {
+		return reinterpret_cast<__m256i *>(words);
+	}
+
+	inline auto as_m256(const uint64_t * words) noexcept -> const __m256i * {
+		return reinterpret_cast<const __m256i *>(words);
+	}
+
+	inline auto as_m512(uint64_t * words) noexcept -> __m512i * {
+		return reinterpret_cast<__m512i *>(words);
+	}
+
+	inline auto as_m512(const uint64_t * words) noexcept -> const __m512i * {
+		return reinterpret_cast<const __m512i *>(words);
+	}
+
+	[[gnu::target("avx2")]] inline void compress_avx2(const block & x, const block & y, block & out, bool xor_out) noexcept {
+		__m256i s[32];
+		__m256i r[32];
+
+		for (size_t i = 0; i != 32u; ++i) {
+			s[i] = _mm256_xor_si256(_mm256_load_si256(as_m256(x.words.data() + i * 4u)), _mm256_load_si256(as_m256(y.words.data() + i * 4u)));
+			r[i] = xor_out ? _mm256_xor_si256(s[i], _mm256_load_si256(as_m256(out.words.data() + i * 4u))) : s[i];
+		}
+
+		for (size_t i = 0; i != 32u; i += 4u) {
+			permutation(s[i], s[i + 1u], s[i + 2u], s[i + 3u]);
+		}
+
+		for (size_t j = 0; j != 4u; ++j) {
+			__m256i low[4];
+			__m256i high[4];
+
+			for (size_t k = 0; k != 4u; ++k) {
+				low[k] = _mm256_permute2x128_si256(s[8u * k + j], s[8u * k + 4u + j], 0x20);
+				high[k] = _mm256_permute2x128_si256(s[8u * k + j], s[8u * k + 4u + j], 0x31);
+			}
+
+			permutation(low[0], low[1], low[2], low[3]);
+			permutation(high[0], high[1], high[2], high[3]);
+
+			for (size_t k = 0; k != 4u; ++k) {
+				s[8u * k + j] = _mm256_permute2x128_si256(low[k], high[k], 0x20);
+				s[8u * k + 4u + j] = _mm256_permute2x128_si256(low[k], high[k], 0x31);
+			}
+		}
+
+		for (size_t i = 0; i != 32u; ++i) {
+			_mm256_store_si256(as_m256(out.words.data() + i * 4u), _mm256_xor_si256(s[i], r[i]));
+		}
+	}
+
+	// two permutations at once in 512-bit registers (each 256-bit half is one of them), rotations are native
+	[[gnu::target("avx512f")]] inline auto blamka(__m512i x, __m512i y) noexcept -> __m512i {
+		const __m512i product = _mm512_mul_epu32(x, y);
+		return _mm512_add_epi64(_mm512_add_epi64(x, y), _mm512_add_epi64(product, product));
+	}
+
+	[[gnu::target("avx512f")]] inline void mix(__m512i & a, __m512i & b, __m512i & c, __m512i & d) noexcept {
+		a = blamka(a, b);
+		d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 32);
+		c = blamka(c, d);
+		b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 24);
+		a = blamka(a, b);
+		d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 16);
+		c = blamka(c, d);
+		b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 63);
+	}
+
+	[[gnu::target("avx512f")]] inline void permutation(__m512i & a, __m512i & b, __m512i & c, __m512i & d) noexcept {
+		mix(a, b, c, d);
+
+		b = _mm512_permutex_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+		c = _mm512_permutex_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+		d = _mm512_permutex_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+
+		mix(a, b, c, d);
+
+		b = _mm512_permutex_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+		c = _mm512_permutex_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+		d = _mm512_permutex_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+	}
+
+	// 128-bit lanes 0, 2, 1, 3 (it's its own inverse)
+	[[gnu::target("avx512f")]] inline auto interleave(__m512i x) noexcept -> __m512i {
+		return _mm512_shuffle_i64x2(x, x, 0xD8);
+	}
+
+	// four words of columns 2j and 2j+1 in rows 2k and 2k+1
+	[[gnu::target("avx512f")]] inline auto gather(const block & w, size_t j, size_t k) noexcept -> __m512i {
+		const __m256i first = _mm256_load_si256(as_m256(w.words.data() + 32u * k + 4u * j));
+		const __m256i second = _mm256_load_si256(as_m256(w.words.data() + 32u * k + 16u + 4u * j));
+		return interleave(_mm512_inserti64x4(_mm512_castsi256_si512(first), second, 1));
+	}
+
+	[[gnu::target("avx512f")]] inline void scatter(block & w, size_t j, size_t k, __m512i v) noexcept {
+		const __m512i t = interleave(v);
+		_mm256_store_si256(as_m256(w.words.data() + 32u * k + 4u * j), _mm512_castsi512_si256(t));
+		_mm256_store_si256(as_m256(w.words.data() + 32u * k + 16u + 4u * j), _mm512_extracti64x4_epi64(t, 1));
+	}
+
+	// rows are permuted in pairs (row r in lower and r + 1 in upper half), columns 2j and 2j+1 together,
+	// between the two passes the block is kept in `w`
+	[[gnu::target("avx512f")]] inline void compress_avx512(const block & x, const block & y, block & out, bool xor_out) noexcept {
+		block w;
+		__m512i r[16];
+
+		for (size_t i = 0; i != 16u; ++i) {
+			const __m512i s = _mm512_xor_si512(_mm512_load_si512(as_m512(x.words.data() + i * 8u)), _mm512_load_si512(as_m512(y.words.data() + i * 8u)));
+			r[i] = xor_out ? _mm512_xor_si512(s, _mm512_load_si512(as_m512(out.words.data() + i * 8u))) : s;
+			_mm512_store_si512(as_m512(w.words.data() + i * 8u), s);
+		}
+
+		for (size_t row = 0; row != 8u; row += 2u) {
+			uint64_t * const words = w.words.data() + row * 16u;
+
+			const __m512i ab0 = _mm512_load_si512(as_m512(words));
+			const __m512i cd0 = _mm512_load_si512(as_m512(words + 8u));
+			const __m512i ab1 = _mm512_load_si512(as_m512(words + 16u));
+			const __m512i cd1 = _mm512_load_si512(as_m512(words + 24u));
+
+			__m512i a = _mm512_shuffle_i64x2(ab0, ab1, 0x44);
+			__m512i b = _mm512_shuffle_i64x2(ab0, ab1, 0xEE);
+			__m512i c = _mm512_shuffle_i64x2(cd0, cd1, 0x44);
+			__m512i d = _mm512_shuffle_i64x2(cd0, cd1, 0xEE);
+
+			permutation(a, b, c, d);
+
+			_mm512_store_si512(as_m512(words), _mm512_shuffle_i64x2(a, b, 0x44));
+			_mm512_store_si512(as_m512(words + 8u), _mm512_shuffle_i64x2(c, d, 0x44));
+			_mm512_store_si512(as_m512(words + 16u), _mm512_shuffle_i64x2(a, b, 0xEE));
+			_mm512_store_si512(as_m512(words + 24u), _mm512_shuffle_i64x2(c, d, 0xEE));
+		}
+
+		for (size_t j = 0; j != 4u; ++j) {
+			__m512i a = gather(w, j, 0u);
+			__m512i b = gather(w, j, 1u);
+			__m512i c = gather(w, j, 2u);
+			__m512i d = gather(w, j, 3u);
+
+			permutation(a, b, c, d);
+
+			scatter(w, j, 0u, a);
+			scatter(w, j, 1u, b);
+			scatter(w, j, 2u, c);
+			scatter(w, j, 3u, d);
+		}
+
+		for (size_t i = 0; i != 16u; ++i) {
+			_mm512_store_si512(as_m512(out.words.data() + i * 8u), _mm512_xor_si512(_mm512_load_si512(as_m512(w.words.data() + i * 8u)), r[i]));
+		}
+	}
+
+} // namespace x86
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+constexpr auto kernel_available(kernel k) noexcept -> bool {
+	if (k == kernel::portable) {
+		return true;
+	}
+
+	if (std::is_constant_evaluated()) {
+		return false;
+	}
+
+#ifdef CTHASH_ARGON2_X86_KERNELS
+	if (k == kernel::avx2) {
+		return __builtin_cpu_supports("avx2");
+	} else if (k == kernel::avx512) {
+		return __builtin_cpu_supports("avx512f");
+	}
+#endif
+
+	return false;
+}
+
+constexpr auto best_kernel() noexcept -> kernel {
+	for (const auto k: {kernel::avx512, kernel::avx2}) {
+		if (kernel_available(k)) {
+			return k;
+		}
+	}
+
+	return kernel::portable;
+}
+
+constexpr auto name_of(kernel k) noexcept -> const char * {
+	constexpr auto names = std::array{"portable", "avx2", "avx512"};
+	return names[static_cast<size_t>(k)];
+}
+
+// `k` must be available (only portable kernel is used during constant evaluation)
+constexpr void compress(kernel k, const block & x, const block & y, block & out, bool xor_out) noexcept {
+	if (std::is_constant_evaluated()) {
+		compress_portable(x, y, out, xor_out);
+		return;
+	}
+
+#ifdef CTHASH_ARGON2_X86_KERNELS
+	if (k == kernel::avx512) {
+		x86::compress_avx512(x, y, out, xor_out);
+		return;
+	} else if (k == kernel::avx2) {
+		x86::compress_avx2(x, y, out, xor_out);
+		return;
+	}
+#else
+	static_cast<void>(k);
+#endif
+
+	compress_portable(x, y, out, xor_out);
+}
+
+} // namespace cthash::argon2
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef CTHASH_BLAKE2_BLAKE2B_HPP
+#define CTHASH_BLAKE2_BLAKE2B_HPP
+
+#include "../simple.hpp"
+#include "../value.hpp"
+#include "../internal/assert.hpp"
+#include "../internal/bit.hpp"
+#include "../internal/concepts.hpp"
+#include "../internal/convert.hpp"
+#include "../internal/deduce.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <span>
+#include <string_view>
+#include <cstdint>
+
+namespace cthash {
+
+namespace blake2 {
+
+	// same as SHA-512
+	static constexpr auto initial_values = std::array<uint64_t, 8>{0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull, 0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull};
+
+	// order of message words in each round (rounds 10 and 11 repeat the first two)
+	static constexpr auto sigma = std::array<std::array<uint8_t, 16>, 10>{{
+		{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+		{14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+		{11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+		{7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+		{9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+		{2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+		{12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+		{13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+		{6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+		{10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+	}};
+
+	[[gnu::always_inline]] constexpr void mix(std::array<uint64_t, 16> & v, size_t a, size_t b, size_t c, size_t d, uint64_t x, uint64_t y) noexcept {
+		v[a] = v[a] + v[b] + x;
+		v[d] = std::rotr(v[d] xor v[a], 32);
+		v[c] = v[c] + v[d];
+		v[b] = std::rotr(v[b] xor v[c], 24);
+		v[a] = v[a] + v[b] + y;
+		v[d] = std::rotr(v[d] xor v[a], 16);
+		v[c] = v[c] + v[d];
+		v[b] = std::rotr(v[b] xor v[c], 63);
+	}
+
+	// BLAKE2b (RFC 7693) without key, length of digest (1 to 64 bytes) is chosen at runtime as Argon2 needs it
+	struct blake2b_state {
+		static constexpr size_t block_size = 128u;
+
+		std::array<uint64_t, 8> hash{initial_values};
+		std::array<std::byte, block_size> block{};
+		uint64_t length{0u}; // bytes already compressed
+		size_t block_used{0u};
+		size_t digest_length;
+
+		explicit constexpr blake2b_state(size_t digest_bytes) noexcept: digest_length{digest_bytes} {
+			CTHASH_ASSERT(digest_bytes >= 1u && digest_bytes <= 64u);
+
+			// parameter block: digest length, no key, fanout and depth 1
+			hash[0] ^= 0x01010000ull ^ static_cast<uint64_t>(digest_bytes);
+		}
+
+		// `counter` is number of bytes hashed including this block, the last block is marked
+		constexpr void compress(std::span<const std::byte, block_size> in, uint64_t counter, bool last) noexcept {
+			std::array<uint64_t, 16> m{};
+			for (size_t i = 0; i != m.size(); ++i) {
+				m[i] = cast_from_le_bytes<uint64_t>(in.subspan(i * 8u).template first<8>());
+			}
+
+			std::array<uint64_t, 16> v{};
+			std::copy(hash.begin(), hash.end(), v.begin());
+			std::copy(initial_values.begin(), initial_values.end(), v.begin() + 8);
+			v[12] ^= counter;
+			v[14] = last ? ~v[14] : v[14];
+
+			for (size_t round = 0; round != 12u; ++round) {
+				const auto & s = sigma[round % sigma.size()];
+
+				mix(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+				mix(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+				mix(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+				mix(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+
+				mix(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+				mix(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+				mix(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+				mix(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+			}
+
+			for (size_t i = 0; i != hash.size(); ++i) {
+				hash[i] ^= v[i] xor v[i + 8u];
+			}
+		}
+
+		// the last block must be compressed with the final flag, so a full block waits in the buffer for more input
+		template <byte_like Byte> constexpr void update(std::span<const Byte> input) noexcept {
+			while (not input.empty()) {
+				if (block_used == block_size) {
+					length += block_size;
+					compress(block, length, false);
+					block_used = 0u;
+				}
+
+				const auto part = input.first(std::min(input.size(), block_size - block_used));
+				byte_copy(part.begin(), part.end(), block.begin() + static_cast<std::ptrdiff_t>(block_used));
+				block_used += part.size();
+				input = input.subspan(part.size());
+			}
+		}
+
+		constexpr void final(std::span<std::byte> out) const noexcept {
+			CTHASH_ASSERT(out.size() == digest_length);
+
+			auto copy = *this;
+			std::fill(copy.block.begin() + static_cast<std::ptrdiff_t>(block_used), copy.block.end(), std::byte{0});
+			copy.compress(copy.block, length + block_used, true);
+
+			for (size_t i = 0; i != out.size(); ++i) {
+				out[i] = static_cast<std::byte>(copy.hash[i / 8u] >> ((i % 8u) * 8u));
+			}
+		}
+	};
+
+} // namespace blake2
+
+template <size_t Bits> struct blake2b {
+	static_assert(Bits % 8u == 0u && Bits >= 8u && Bits <= 512u);
+
+	struct tag {
+		static constexpr size_t digest_length = Bits / 8u;
+	};
+
+	using digest_span_t = std::span<std::byte, Bits / 8u>;
+
+	blake2::blake2b_state state{Bits / 8u};
+
+	template <byte_like Byte> constexpr blake2b & update(std::span<const Byte> input) noexcept {
+		state.update(input);
+		return *this;
+	}
+
+	template <one_byte_char CharT> constexpr blake2b & update(std::basic_string_view<CharT> input) noexcept {
+		return update(std::span<const CharT>(input.data(), input.size()));
+	}
+
+	template <string_literal T> constexpr blake2b & update(const T & input) noexcept {
+		return update(std::span(std::data(input), std::size(input) - 1u));
+	}
+
+	// intermediate state (chaining value, length and block) so hashing can be resumed later
+	static constexpr size_t midstate_size = sizeof(state.hash) + sizeof(uint64_t) + sizeof(state.block);
+
+	// last bytes of midstate are the block, only first `pending()` of them are used
+	static constexpr size_t midstate_buffer_size = sizeof(state.block);
+
+	constexpr size_t pending() const noexcept {
+		return state.block_used;
+	}
+
+	constexpr auto midstate() const noexcept -> std::array<std::byte, midstate_size> {
+		std::array<std::byte, midstate_size> out{};
+		const auto view = std::span<std::byte, midstate_size>(out);
+
+		for (size_t i = 0; i != state.hash.size(); ++i) {
+			unwrap_littleendian_number<uint64_t>{view.subspan(i * 8u).template first<8>()} = state.hash[i];
+		}
+
+		unwrap_littleendian_number<uint64_t>{view.template subspan<sizeof(state.hash), 8>()} = state.length + state.block_used;
+		std::copy(state.block.begin(), state.block.end(), out.begin() + sizeof(state.hash) + 8u);
+		return out;
+	}
+
+	constexpr bool restore(std::span<const std::byte, midstate_size> in) noexcept {
+		for (size_t i = 0; i != state.hash.size(); ++i) {
+			state.hash[i] = cast_from_le_bytes<uint64_t>(in.subspan(i * 8u).template first<8>());
+		}
+
+		// the last (even full) block of input is never compressed before more input comes
+		const auto total = cast_from_le_bytes<uint64_t>(in.template subspan<sizeof(state.hash), 8>());
+		state.block_used = (total == 0u) ? 0u : static_cast<size_t>((total - 1u) % state.block_size + 1u);
+		state.length = total - state.block_used;
+
+		const auto stored_block = in.template last<sizeof(state.block)>();
+		std::copy(stored_block.begin(), stored_block.end(), state.block.begin());
+		return true;
+	}
+
+	constexpr void final(digest_span_t out) const noexcept {
+		state.final(out);
+	}
+
+	constexpr auto final() const noexcept -> tagged_hash_value<tag> {
+		tagged_hash_value<tag> output;
+		this->final(output);
+		return output;
+	}
+};
+
+using blake2b_256 = blake2b<256>;
+using blake2b_256_value = tagged_hash_value<blake2b_256::tag>;
+
+using blake2b_512 = blake2b<512>;
+using blake2b_512_value = tagged_hash_value<blake2b_512::tag>;
+
+namespace literals {
+
+	template <internal::fixed_string Value>
+	consteval auto operator""_blake2b_256() {
+		return blake2b_256_value(Value);
+	}
+
+	template <internal::fixed_string Value>
+	consteval auto operator""_blake2b_512() {
+		return blake2b_512_value(Value);
+	}
+
+} // namespace literals
+
+} // namespace cthash
+
+#endif
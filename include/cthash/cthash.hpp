@@ -1,6 +1,9 @@
 #ifndef CTHASH_CTHASH_HPP
 #define CTHASH_CTHASH_HPP
 
+// SHA-1 (only for compatibility)
+#include "sha1.hpp"
+
 // SHA-2 family
 #include "sha2/sha224.hpp"
 #include "sha2/sha256.hpp"
@@ -16,6 +19,12 @@
 #include "sha3/shake128.hpp"
 #include "sha3/shake256.hpp"
 
+// BLAKE2b
+#include "blake2/blake2b.hpp"
+
+// Argon2id (password hashing / key derivation) isn't included, as its SIMD kernels would slow down compilation
+// of everything which includes this header, include "argon2/argon2id.hpp" for it
+
 // xxhash (non-crypto fast hash)
 #include "xxhash.hpp"
 
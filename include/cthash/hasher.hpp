@@ -62,9 +62,13 @@ template <typename Config> struct internal_hasher {
 			w[static_cast<size_t>(i)] = cast_from_bytes<staging_item_t>(chunk.subspan(static_cast<size_t>(i) * sizeof(staging_item_t)).template first<sizeof(staging_item_t)>());
 		}
 
-		// fill the rest (generify)
+		// fill the rest (generify), config can provide its own message expansion
 		for (int i = int(first_part_size); i != int(staging_size); ++i) {
-			w[static_cast<size_t>(i)] = w[static_cast<size_t>(i - 16)] + config.sigma_0(w[static_cast<size_t>(i - 15)]) + w[static_cast<size_t>(i - 7)] + config.sigma_1(w[static_cast<size_t>(i - 2)]);
+			if constexpr (requires { config.staging_item(w, size_t{}); }) {
+				w[static_cast<size_t>(i)] = config.staging_item(w, static_cast<size_t>(i));
+			} else {
+				w[static_cast<size_t>(i)] = w[static_cast<size_t>(i - 16)] + config.sigma_0(w[static_cast<size_t>(i - 15)]) + w[static_cast<size_t>(i - 7)] + config.sigma_1(w[static_cast<size_t>(i - 2)]);
+			}
 		}
 
 		return w;
@@ -165,6 +169,37 @@ template <typename Config> struct internal_hasher {
 		rounds(w, hash);
 	}
 
+	// intermediate state (hash, length and unprocessed part of block) so hashing can be resumed later
+	static constexpr size_t midstate_bytes = sizeof(state_value_t) + sizeof(length_t) + block_size_bytes;
+	using midstate_value_t = std::array<std::byte, midstate_bytes>;
+	using midstate_view_t = std::span<const std::byte, midstate_bytes>;
+
+	constexpr auto export_midstate() const noexcept -> midstate_value_t {
+		midstate_value_t out{};
+		const auto view = std::span<std::byte, midstate_bytes>(out);
+
+		for (int i = 0; i != (int)hash.size(); ++i) {
+			unwrap_bigendian_number<state_item_t>{view.subspan(static_cast<size_t>(i) * sizeof(state_item_t)).template first<sizeof(state_item_t)>()} = hash[static_cast<size_t>(i)];
+		}
+
+		unwrap_bigendian_number<length_t>{view.template subspan<sizeof(state_value_t), sizeof(length_t)>()} = total_length;
+		std::copy_n(block.data(), block_used, out.data() + sizeof(state_value_t) + sizeof(length_t));
+
+		return out;
+	}
+
+	constexpr void import_midstate(midstate_view_t in) noexcept {
+		for (int i = 0; i != (int)hash.size(); ++i) {
+			hash[static_cast<size_t>(i)] = cast_from_bytes<state_item_t>(in.subspan(static_cast<size_t>(i) * sizeof(state_item_t)).template first<sizeof(state_item_t)>());
+		}
+
+		total_length = cast_from_bytes<length_t>(in.template subspan<sizeof(state_value_t), sizeof(length_t)>());
+		block_used = static_cast<unsigned>(total_length % block_size_bytes);
+
+		const auto stored_block = in.template subspan<sizeof(state_value_t) + sizeof(length_t)>();
+		std::copy(stored_block.begin(), stored_block.end(), block.begin());
+	}
+
 	[[gnu::always_inline]] constexpr void write_result_into(digest_span_t out) noexcept
 	requires(digest_bytes % sizeof(state_item_t) == 0u)
 	{
@@ -245,6 +280,25 @@ template <typename Config> struct hasher: private internal_hasher<Config> {
 	constexpr length_t size() const noexcept {
 		return super::total_length;
 	}
+
+	// serialized intermediate state, hashing can continue in other hasher after restore
+	static constexpr size_t midstate_size = super::midstate_bytes;
+
+	// last bytes of midstate are unprocessed part of block, only first `pending()` of them are used
+	static constexpr size_t midstate_buffer_size = super::block_size_bytes;
+
+	constexpr size_t pending() const noexcept {
+		return super::block_used;
+	}
+
+	constexpr auto midstate() const noexcept {
+		return super::export_midstate();
+	}
+
+	constexpr bool restore(std::span<const std::byte, midstate_size> in) noexcept {
+		super::import_midstate(in);
+		return true;
+	}
 };
 
 } // namespace cthash
@@ -0,0 +1,73 @@
+#ifndef CTHASH_SHA1_HPP
+#define CTHASH_SHA1_HPP
+
+#include "sha2/common.hpp"
+
+namespace cthash {
+
+// SHA-1 is broken for collision resistance, it's here only for compatibility (git object IDs, ...)
+struct sha1_config {
+	using length_type = uint64_t;
+	static constexpr size_t length_size_bits = 64;
+
+	static constexpr size_t block_bits = 512u;
+
+	static constexpr auto initial_values = std::array<uint32_t, 5>{0x67452301ul, 0xefcdab89ul, 0x98badcfeul, 0x10325476ul, 0xc3d2e1f0ul};
+
+	// one constant for each group of 20 rounds
+	static constexpr auto constants = [] {
+		std::array<uint32_t, 80> out{};
+
+		for (size_t i = 0; i != out.size(); ++i) {
+			out[i] = std::array<uint32_t, 4>{0x5a827999ul, 0x6ed9eba1ul, 0x8f1bbcdcul, 0xca62c1d6ul}[i / 20u];
+		}
+
+		return out;
+	}();
+
+	// message expansion differs from SHA-2
+	template <typename Staging> [[gnu::always_inline]] static constexpr auto staging_item(const Staging & w, size_t i) noexcept -> uint32_t {
+		return std::rotl(w[i - 3u] xor w[i - 8u] xor w[i - 14u] xor w[i - 16u], 1);
+	}
+
+	// rounds
+	[[gnu::always_inline]] static constexpr void rounds(std::span<const uint32_t, 80> w, std::array<uint32_t, 5> & state) noexcept {
+		auto [a, b, c, d, e] = state;
+
+		for (size_t i = 0; i != constants.size(); ++i) {
+			const uint32_t f = (i < 20u) ? sha2::choice(b, c, d) : ((i >= 40u && i < 60u) ? sha2::majority(b, c, d) : (b xor c xor d));
+			const uint32_t temp = std::rotl(a, 5) + f + e + constants[i] + w[i];
+
+			e = d;
+			d = c;
+			c = std::rotl(b, 30);
+			b = a;
+			a = temp;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+};
+
+static_assert(not cthash::internal::digest_length_provided<sha1_config>);
+static_assert(cthash::internal::digest_bytes_length_of<sha1_config> == 20u);
+
+using sha1 = hasher<sha1_config>;
+using sha1_value = tagged_hash_value<sha1_config>;
+
+namespace literals {
+
+	template <internal::fixed_string Value>
+	consteval auto operator""_sha1() {
+		return sha1_value(Value);
+	}
+
+} // namespace literals
+
+} // namespace cthash
+
+#endif
@@ -142,6 +142,45 @@ template <typename Config> struct basic_keccak_hasher {
 		}
 	}
 
+	// intermediate state (keccak state and position in current block) so hashing can be resumed later
+	static constexpr size_t midstate_size = sizeof(keccak::state_1600) + 1u;
+
+	// unprocessed input is already absorbed into the state, so no part of midstate is a buffer
+	static constexpr size_t midstate_buffer_size = 0u;
+
+	constexpr size_t pending() const noexcept {
+		return 0u;
+	}
+
+	constexpr auto midstate() const noexcept -> std::array<std::byte, midstate_size> {
+		using value_t = keccak::state_1600::value_type;
+
+		std::array<std::byte, midstate_size> out{};
+		const auto view = std::span<std::byte, midstate_size>(out);
+
+		for (int i = 0; i != (int)internal_state.size(); ++i) {
+			unwrap_littleendian_number<value_t>{view.subspan(static_cast<size_t>(i) * sizeof(value_t)).template first<sizeof(value_t)>()} = internal_state[static_cast<size_t>(i)];
+		}
+
+		out.back() = static_cast<std::byte>(position);
+		return out;
+	}
+
+	constexpr bool restore(std::span<const std::byte, midstate_size> in) noexcept {
+		using value_t = keccak::state_1600::value_type;
+
+		if (static_cast<size_t>(in.back()) >= rate) {
+			return false;
+		}
+
+		for (int i = 0; i != (int)internal_state.size(); ++i) {
+			internal_state[static_cast<size_t>(i)] = cast_from_le_bytes<value_t>(in.subspan(static_cast<size_t>(i) * sizeof(value_t)).template first<sizeof(value_t)>());
+		}
+
+		position = static_cast<uint8_t>(in.back());
+		return true;
+	}
+
 	// pad the message
 	constexpr void xor_padding_block() noexcept {
 		CTHASH_ASSERT(position < rate);
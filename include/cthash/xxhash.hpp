@@ -8,6 +8,7 @@
 #include "internal/concepts.hpp"
 #include "internal/convert.hpp"
 #include "internal/deduce.hpp"
+#include <algorithm>
 #include <array>
 #include <span>
 #include <string_view>
@@ -161,7 +162,7 @@ template <size_t Bits> struct xxhash {
 		const auto buffer_remaining = std::span(buffer).subspan(buffer_usage());
 
 		// everything we insert here is counting as part of input (even if we process it later)
-		length += static_cast<uint8_t>(input.size());
+		length += static_cast<value_type>(input.size());
 
 		// if there is remaining data from previous...
 		if (buffer_remaining.size() != buffer.size()) {
@@ -212,6 +213,44 @@ template <size_t Bits> struct xxhash {
 		return update_and_final(std::span(std::data(input), std::size(input) - 1u));
 	}
 
+	// intermediate state (seed, length, accumulators and buffer) so hashing can be resumed later
+	static constexpr size_t midstate_size = sizeof(value_type) * 2u + sizeof(acc_array) + sizeof(buffer);
+
+	// last bytes of midstate are the buffer, only first `pending()` of them are used
+	static constexpr size_t midstate_buffer_size = sizeof(buffer);
+
+	constexpr size_t pending() const noexcept {
+		return buffer_usage();
+	}
+
+	constexpr auto midstate() const noexcept -> std::array<std::byte, midstate_size> {
+		std::array<std::byte, midstate_size> out{};
+		const auto view = std::span<std::byte, midstate_size>(out);
+
+		unwrap_littleendian_number<value_type>{view.template subspan<0, sizeof(value_type)>()} = seed;
+		unwrap_littleendian_number<value_type>{view.template subspan<sizeof(value_type), sizeof(value_type)>()} = length;
+
+		for (int i = 0; i != (int)internal_state.size(); ++i) {
+			unwrap_littleendian_number<value_type>{view.subspan((2u + static_cast<size_t>(i)) * sizeof(value_type)).template first<sizeof(value_type)>()} = internal_state[static_cast<size_t>(i)];
+		}
+
+		std::copy(buffer.begin(), buffer.end(), out.begin() + sizeof(value_type) * 2u + sizeof(acc_array));
+		return out;
+	}
+
+	constexpr bool restore(std::span<const std::byte, midstate_size> in) noexcept {
+		seed = get_le_number_from<value_type, 0>(in);
+		length = get_le_number_from<value_type, 1>(in);
+
+		for (int i = 0; i != (int)internal_state.size(); ++i) {
+			internal_state[static_cast<size_t>(i)] = cast_from_le_bytes<value_type>(in.subspan((2u + static_cast<size_t>(i)) * sizeof(value_type)).template first<sizeof(value_type)>());
+		}
+
+		const auto stored_buffer = in.template last<sizeof(buffer)>();
+		std::copy(stored_buffer.begin(), stored_buffer.end(), buffer.begin());
+		return true;
+	}
+
 	constexpr auto converge_conditionaly() const noexcept -> value_type {
 		// step 1 shortcut for short input
 		if (length < buffer.size()) {
@@ -258,6 +297,87 @@ using xxhash32_value = tagged_hash_value<xxhash32::tag>;
 using xxhash64 = cthash::xxhash<64>;
 using xxhash64_value = tagged_hash_value<xxhash64::tag>;
 
+// segmented xxhash64: input is split into segments of `SegmentSize` bytes (the last one can be shorter), each of them
+// is hashed by xxhash64 and digest is xxhash64 of their digests (8 bytes each, as xxhash64 outputs them),
+// segments are independent so they can be hashed in parallel and added in order with `add_segment`
+template <size_t SegmentSize = 1024u * 1024u> struct segmented_xxhash64 {
+	static_assert(SegmentSize > 0u);
+
+	struct tag {
+		static constexpr size_t digest_length = 8u;
+	};
+
+	static constexpr size_t segment_size = SegmentSize;
+
+	xxhash64 outer{};
+	xxhash64 segment{};
+
+	constexpr size_t segment_usage() const noexcept {
+		return static_cast<size_t>(segment.length);
+	}
+
+	constexpr segmented_xxhash64 & add_segment(const xxhash64_value & digest) noexcept {
+		outer.update(std::span<const std::byte>(digest.data(), digest.size()));
+		return *this;
+	}
+
+	template <byte_like Byte> constexpr segmented_xxhash64 & update(std::span<const Byte> input) noexcept {
+		while (not input.empty()) {
+			const auto part = input.first(std::min(input.size(), segment_size - segment_usage()));
+			segment.update(part);
+			input = input.subspan(part.size());
+
+			if (segment_usage() == segment_size) {
+				add_segment(segment.final());
+				segment = xxhash64{};
+			}
+		}
+
+		return *this;
+	}
+
+	template <one_byte_char CharT> constexpr segmented_xxhash64 & update(std::basic_string_view<CharT> input) noexcept {
+		return update(std::span<const CharT>(input.data(), input.size()));
+	}
+
+	template <string_literal T> constexpr segmented_xxhash64 & update(const T & input) noexcept {
+		return update(std::span(std::data(input), std::size(input) - 1u));
+	}
+
+	// intermediate state is state of both hashers
+	static constexpr size_t midstate_size = xxhash64::midstate_size * 2u;
+
+	constexpr auto midstate() const noexcept -> std::array<std::byte, midstate_size> {
+		std::array<std::byte, midstate_size> out{};
+		const auto first = outer.midstate();
+		const auto second = segment.midstate();
+		std::copy(first.begin(), first.end(), out.begin());
+		std::copy(second.begin(), second.end(), out.begin() + xxhash64::midstate_size);
+		return out;
+	}
+
+	constexpr bool restore(std::span<const std::byte, midstate_size> in) noexcept {
+		return outer.restore(in.template first<xxhash64::midstate_size>()) && segment.restore(in.template last<xxhash64::midstate_size>());
+	}
+
+	constexpr auto final() const noexcept -> tagged_hash_value<tag> {
+		auto copy = outer;
+
+		// unfinished segment (empty input has no segment at all)
+		if (segment_usage() != 0u) {
+			const auto last = segment.final();
+			copy.update(std::span<const std::byte>(last.data(), last.size()));
+		}
+
+		const auto digest = copy.final();
+		tagged_hash_value<tag> output;
+		std::copy(digest.begin(), digest.end(), output.begin());
+		return output;
+	}
+};
+
+using segmented_xxhash64_value = tagged_hash_value<segmented_xxhash64<>::tag>;
+
 namespace literals {
 
 	template <internal::fixed_string Value>
@@ -270,6 +390,11 @@ namespace literals {
 		return xxhash64_value(Value);
 	}
 
+	template <internal::fixed_string Value>
+	consteval auto operator""_xxh64_seg() {
+		return segmented_xxhash64_value(Value);
+	}
+
 } // namespace literals
 
 } // namespace cthash
@@ -0,0 +1,202 @@
+#include "../internal/support.hpp"
+#include <cthash/argon2/argon2id.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// RFC 9106 section 5.3
+constexpr auto password = array_of<32>(std::byte{0x01});
+constexpr auto salt = array_of<16>(std::byte{0x02});
+constexpr auto secret = array_of<8>(std::byte{0x03});
+constexpr auto associated_data = array_of<12>(std::byte{0x04});
+
+constexpr auto rfc_parameters = cthash::argon2::parameters{.passes = 3u, .memory_kib = 32u, .lanes = 4u, .tag_length = 32u, .secret = secret, .associated_data = associated_data};
+constexpr auto rfc_tag = std::array<uint8_t, 32>{0x0d, 0x64, 0x0d, 0xf5, 0x8d, 0x78, 0x76, 0x6c, 0x08, 0xc0, 0x37, 0xa3, 0x4a, 0x8b, 0x53, 0xc9, 0xd0, 0x1e, 0xf0, 0x45, 0x2d, 0x75, 0xb6, 0x5e, 0xb5, 0x25, 0x20, 0xe9, 0x6b, 0x01, 0xe6, 0x59};
+
+// true when `Fn()` is a constant expression
+template <auto Fn> concept constant_evaluable = requires { typename std::integral_constant<bool, (Fn(), true)>; };
+
+// Argon2id with 8 blocks of memory and 16 bytes of tag
+constexpr auto small_argon2id(cthash::argon2::parameters params) {
+	std::array<cthash::argon2::block, 8> memory{};
+	std::array<std::byte, 16> out{};
+	return cthash::argon2id(out, password, salt, params, memory);
+}
+
+auto as_bytes(const std::array<uint8_t, 32> & in) {
+	std::array<std::byte, 32> out{};
+	std::ranges::transform(in, out.begin(), [](uint8_t v) { return std::byte{v}; });
+	return out;
+}
+
+} // namespace
+
+TEST_CASE("argon2id memory size") {
+	REQUIRE(cthash::argon2::memory_blocks(rfc_parameters) == 32u);
+	REQUIRE(cthash::argon2::memory_blocks({.memory_kib = 100u, .lanes = 3u}) == 96u);
+	REQUIRE(cthash::argon2::memory_blocks({.memory_kib = 19u * 1024u, .lanes = 1u}) == 19u * 1024u);
+}
+
+TEST_CASE("argon2id parameters are validated") {
+	STATIC_REQUIRE(cthash::argon2::valid(rfc_parameters, 32u, 16u));
+	STATIC_REQUIRE(cthash::argon2::valid({.passes = 1u, .memory_kib = 8u, .lanes = 1u, .tag_length = 4u}, 4u, 16u));
+
+	STATIC_REQUIRE(not cthash::argon2::valid(rfc_parameters, 16u, 16u));
+	STATIC_REQUIRE(not cthash::argon2::valid({.passes = 0u, .memory_kib = 32u, .lanes = 1u, .tag_length = 32u}, 32u, 16u));
+	STATIC_REQUIRE(not cthash::argon2::valid({.passes = 1u, .memory_kib = 32u, .lanes = 0u, .tag_length = 32u}, 32u, 16u));
+	STATIC_REQUIRE(not cthash::argon2::valid({.passes = 1u, .memory_kib = 32u, .lanes = 4u, .tag_length = 3u}, 3u, 16u));
+	STATIC_REQUIRE(not cthash::argon2::valid({.passes = 1u, .memory_kib = 31u, .lanes = 4u, .tag_length = 32u}, 32u, 16u));
+	STATIC_REQUIRE(not cthash::argon2::valid({.passes = 1u, .memory_kib = 0xFFFF'FFFFu, .lanes = 0x100'0000u, .tag_length = 32u}, 32u, 16u));
+
+	// RFC 9106 requires salt of at least 8 bytes
+	STATIC_REQUIRE(cthash::argon2::valid(rfc_parameters, 32u, 8u));
+	STATIC_REQUIRE(not cthash::argon2::valid(rfc_parameters, 32u, 7u));
+	STATIC_REQUIRE(not cthash::argon2::valid(rfc_parameters, 32u, 0u));
+
+	STATIC_REQUIRE(cthash::argon2::memory_blocks({.memory_kib = 32u, .lanes = 0u}) == 0u);
+}
+
+TEST_CASE("argon2id rejects invalid parameters") {
+	STATIC_REQUIRE(constant_evaluable<[] { return small_argon2id({.passes = 1u, .memory_kib = 8u, .lanes = 1u, .tag_length = 16u}); }>);
+	STATIC_REQUIRE(not constant_evaluable<[] { return small_argon2id({.passes = 1u, .memory_kib = 8u, .lanes = 0u, .tag_length = 16u}); }>);
+	STATIC_REQUIRE(not constant_evaluable<[] { return small_argon2id({.passes = 1u, .memory_kib = 8u, .lanes = 1u, .tag_length = 32u}); }>);
+	STATIC_REQUIRE(not constant_evaluable<[] { return small_argon2id({.passes = 1u, .memory_kib = 16u, .lanes = 1u, .tag_length = 16u}); }>);
+
+	std::vector<cthash::argon2::block> memory(cthash::argon2::memory_blocks(rfc_parameters));
+	std::array<std::byte, 32> tag{};
+
+	REQUIRE(not cthash::argon2id(std::span(tag).first(16u), password, salt, rfc_parameters, memory));
+	REQUIRE(not cthash::argon2id(tag, password, salt, rfc_parameters, std::span(memory).first(16u)));
+	REQUIRE(not cthash::argon2id(tag, password, salt, {.passes = 1u, .memory_kib = 32u, .lanes = 0u, .tag_length = 32u}, {}));
+	REQUIRE(not cthash::argon2id(tag, password, std::span(salt).first(7u), rfc_parameters, memory));
+	REQUIRE(not cthash::argon2id(tag, password, std::span<const std::byte>{}, rfc_parameters, memory));
+	REQUIRE(tag == std::array<std::byte, 32>{});
+}
+
+TEST_CASE("argon2id RFC 9106 test vector") {
+	std::vector<cthash::argon2::block> memory(cthash::argon2::memory_blocks(rfc_parameters));
+	std::array<std::byte, 32> tag{};
+
+	REQUIRE(cthash::argon2id(tag, password, salt, rfc_parameters, memory));
+	REQUIRE(tag == as_bytes(rfc_tag));
+}
+
+TEST_CASE("argon2id RFC 9106 test vector with every kernel") {
+	for (const auto k: {cthash::argon2::kernel::portable, cthash::argon2::kernel::avx2, cthash::argon2::kernel::avx512}) {
+		if (not cthash::argon2::kernel_available(k)) {
+			continue;
+		}
+
+		std::vector<cthash::argon2::block> memory(cthash::argon2::memory_blocks(rfc_parameters));
+		std::array<std::byte, 32> tag{};
+
+		cthash::argon2id(tag, password, salt, rfc_parameters, memory, cthash::argon2::sequential_lanes{}, k);
+		REQUIRE(tag == as_bytes(rfc_tag));
+	}
+}
+
+TEST_CASE("argon2id lanes in any order") {
+	// segments of one slice are independent, so lanes can be filled in reverse
+	const auto reversed = [](uint32_t lanes, auto && fn) {
+		for (uint32_t lane = lanes; lane != 0u; --lane) {
+			fn(lane - 1u);
+		}
+	};
+
+	std::vector<cthash::argon2::block> memory(cthash::argon2::memory_blocks(rfc_parameters));
+	std::array<std::byte, 32> tag{};
+
+	cthash::argon2id(tag, password, salt, rfc_parameters, memory, reversed);
+	REQUIRE(tag == as_bytes(rfc_tag));
+}
+
+TEST_CASE("argon2id in constant evaluation") {
+	// the smallest memory (8 blocks of one lane) and one pass fit into limits of constant evaluation
+	constexpr auto params = cthash::argon2::parameters{.passes = 1u, .memory_kib = 8u, .lanes = 1u, .tag_length = 16u};
+
+	constexpr auto tag = [&] {
+		std::array<cthash::argon2::block, 8> memory{};
+		std::array<std::byte, 16> out{};
+		cthash::argon2id(out, password, salt, params, memory);
+		return out;
+	}();
+
+	std::vector<cthash::argon2::block> memory(cthash::argon2::memory_blocks(params));
+	std::array<std::byte, 16> runtime_tag{};
+	cthash::argon2id(runtime_tag, password, salt, params, memory);
+
+	REQUIRE(tag == runtime_tag);
+}
+
+TEST_CASE("argon2 compression kernels are same") {
+	cthash::argon2::block x{};
+	cthash::argon2::block y{};
+	cthash::argon2::block previous{};
+
+	uint64_t state = 0x2545F4914F6CDD1Du;
+	const auto next = [&] {
+		state ^= state << 13u;
+		state ^= state >> 7u;
+		state ^= state << 17u;
+		return state;
+	};
+
+	for (int round = 0; round != 16; ++round) {
+		for (size_t i = 0; i != 128u; ++i) {
+			x.words[i] = next();
+			y.words[i] = next();
+			previous.words[i] = next();
+		}
+
+		const bool xor_out = (round % 2) == 1;
+
+		auto expected = previous;
+		cthash::argon2::compress(cthash::argon2::kernel::portable, x, y, expected, xor_out);
+
+		for (const auto k: {cthash::argon2::kernel::avx2, cthash::argon2::kernel::avx512}) {
+			if (not cthash::argon2::kernel_available(k)) {
+				continue;
+			}
+
+			auto out = previous;
+			cthash::argon2::compress(k, x, y, out, xor_out);
+			REQUIRE(out.words == expected.words);
+
+			// output can be the second input (as when addresses are generated)
+			auto in_place = y;
+			cthash::argon2::compress(k, x, in_place, in_place, false);
+			auto separate = previous;
+			cthash::argon2::compress(cthash::argon2::kernel::portable, x, y, separate, false);
+			REQUIRE(in_place.words == separate.words);
+		}
+	}
+}
+
+TEST_CASE("argon2 long hash") {
+	// H' with output up to 64 bytes is BLAKE2b of its length and input
+	std::array<std::byte, 32> short_output{};
+	cthash::argon2::long_hash(short_output, {std::as_bytes(std::span{"abc", 3u})});
+
+	auto h = cthash::blake2::blake2b_state{32u};
+	h.update(std::span<const std::byte>(cthash::argon2::le32(32u)));
+	h.update(std::span<const char>("abc", 3u));
+	std::array<std::byte, 32> expected{};
+	h.final(expected);
+
+	REQUIRE(short_output == expected);
+
+	// longer outputs start with the first half of BLAKE2b-512
+	std::array<std::byte, 100> long_output{};
+	cthash::argon2::long_hash(long_output, {std::as_bytes(std::span{"abc", 3u})});
+
+	auto first = cthash::blake2::blake2b_state{64u};
+	first.update(std::span<const std::byte>(cthash::argon2::le32(100u)));
+	first.update(std::span<const char>("abc", 3u));
+	std::array<std::byte, 64> v1{};
+	first.final(v1);
+
+	REQUIRE(std::ranges::equal(std::span(long_output).first(32u), std::span(v1).first(32u)));
+}
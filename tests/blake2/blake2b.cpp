@@ -0,0 +1,57 @@
+#include "../internal/support.hpp"
+#include <cthash/blake2/blake2b.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cthash::literals;
+
+TEST_CASE("blake2b-512 empty input") {
+	constexpr auto v1 = cthash::blake2b_512{}.final();
+	auto v2 = cthash::blake2b_512{}.final();
+	REQUIRE(v1 == v2);
+	REQUIRE(v1 == "786a02f742015903c6c6fd852552d272912f4740e15847618a86e217f71f5419d25e1031afee585313896444934eb04b903a685b1448b755d56f701afe9be2ce"_blake2b_512);
+}
+
+TEST_CASE("blake2b-512 basics") {
+	constexpr auto v1 = cthash::blake2b_512{}.update("abc").final();
+	auto v2 = cthash::blake2b_512{}.update(runtime_pass("abc")).final();
+	REQUIRE(v1 == v2);
+	REQUIRE(v1 == "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d17d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923"_blake2b_512);
+
+	constexpr auto v3 = cthash::blake2b_512{}.update("hello there!").final();
+	REQUIRE(v3 == "66333407d74aa7d34e760f01dcda6805ce0dd261fcfb2b62d6bbcfa0693446191e43ebebc62beddf11c309810a9444e36b001d0f440f5dd3a0735359ff1c68b0"_blake2b_512);
+}
+
+TEST_CASE("blake2b-256 basics") {
+	constexpr auto v1 = cthash::blake2b_256{}.update("hello there!").final();
+	REQUIRE(v1 == "d5c026659526ddbd5afebb0d01bdac6491526a4b0a36e39688249b8b345f884f"_blake2b_256);
+}
+
+TEST_CASE("blake2b-512 more blocks in pieces") {
+	constexpr auto input = array_of<1000>(std::byte(0xEF));
+	const auto expected = "51bf26a78167e681841d468e1ec122f5de676d479f57401fcae04e261313c7d9d748925a8d10df0a9f4cf7a6857189986a4bb1db18ea3289c7ba2e7d02e7ea3e"_blake2b_512;
+
+	constexpr auto v1 = cthash::blake2b_512{}.update(std::span<const std::byte>(input)).final();
+	REQUIRE(v1 == expected);
+
+	// block boundaries in every position
+	for (size_t split: {1u, 127u, 128u, 129u, 256u, 999u}) {
+		auto h = cthash::blake2b_512{};
+		h.update(std::span(input).first(split));
+		h.update(std::span(input).subspan(split));
+		REQUIRE(h.final() == expected);
+	}
+}
+
+TEST_CASE("blake2b-512 midstate") {
+	constexpr auto input = array_of<1000>(std::byte(0xEF));
+
+	for (size_t split: {0u, 1u, 128u, 129u, 256u, 1000u}) {
+		const auto state = cthash::blake2b_512{}.update(std::span(input).first(split)).midstate();
+
+		auto h = cthash::blake2b_512{};
+		REQUIRE(h.restore(state));
+		REQUIRE(h.pending() == (split == 0u ? 0u : (split - 1u) % 128u + 1u));
+		h.update(std::span(input).subspan(split));
+		REQUIRE(h.final() == cthash::blake2b_512{}.update(std::span<const std::byte>(input)).final());
+	}
+}
@@ -0,0 +1,79 @@
+#include <cthash/sha2/sha256.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <unistd.h>
+
+// runs `checksum` tool built from this tree (only when its path is known)
+#ifdef CTHASH_CHECKSUM_PATH
+
+// digests by path, failures of a file which is being rewritten are expected, so exit status is ignored
+static auto digests_of(const std::string & arguments) -> std::map<std::string, std::string> {
+	const auto command = std::string(CTHASH_CHECKSUM_PATH) + " " + arguments + " 2>/dev/null";
+	FILE * out = popen(command.c_str(), "r");
+	REQUIRE(out != nullptr);
+
+	std::map<std::string, std::string> result;
+	std::array<char, 512> buffer;
+	while (std::fgets(buffer.data(), static_cast<int>(buffer.size()), out) != nullptr) {
+		auto line = std::istringstream{buffer.data()};
+		std::string digest, path;
+		line >> digest >> path;
+		result.emplace(path, digest);
+	}
+
+	pclose(out);
+	return result;
+}
+
+static void write_file(const std::filesystem::path & path, const std::string & content) {
+	std::ofstream{path, std::ios::binary | std::ios::trunc} << content;
+}
+
+TEST_CASE("checksum of a batch with a file which changes while it's read", "[checksum]") {
+	const auto dir = std::filesystem::temp_directory_path() / ("cthash-batch-test-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+
+	std::map<std::string, std::string> expected;
+	for (int i = 0; i != 40; ++i) {
+		const auto path = dir / ("f" + std::to_string(i));
+		const auto content = std::string(static_cast<size_t>(50 + i * 13), static_cast<char>('a' + i % 26));
+		write_file(path, content);
+
+		std::ostringstream digest;
+		digest << cthash::sha256{}.update(content).final();
+		expected.emplace(path.string(), digest.str());
+	}
+
+	// its size flips, so it's often read with different size than directory walk has seen and it's hashed again on its own
+	std::atomic<bool> done{false};
+	auto flipper = std::thread([&] {
+		for (bool small = true; not done; small = not small) {
+			write_file(dir / "flip", std::string(small ? 100u : 3100u, 'x'));
+		}
+	});
+
+	// other members of the batch must not be hashed from data it was read over
+	size_t wrong = 0u;
+	for (int run = 0; run != 300; ++run) {
+		for (const auto & [path, digest]: digests_of("-r -j 1 --io=read sha-256 " + dir.string())) {
+			if (const auto it = expected.find(path); it != expected.end() && digest != it->second) {
+				++wrong;
+			}
+		}
+	}
+
+	done = true;
+	flipper.join();
+	REQUIRE(wrong == 0u);
+	std::filesystem::remove_all(dir);
+}
+
+#endif
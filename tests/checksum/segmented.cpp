@@ -0,0 +1,75 @@
+#include <cthash/xxhash.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+// runs `checksum` tool built from this tree (only when its path is known)
+#ifdef CTHASH_CHECKSUM_PATH
+
+static auto run_checksum(const std::string & arguments) -> std::string {
+	const auto command = std::string(CTHASH_CHECKSUM_PATH) + " " + arguments + " 2>/dev/null";
+	FILE * out = popen(command.c_str(), "r");
+	REQUIRE(out != nullptr);
+
+	std::string result;
+	std::array<char, 256> buffer;
+	while (std::fgets(buffer.data(), static_cast<int>(buffer.size()), out) != nullptr) {
+		result += buffer.data();
+	}
+
+	REQUIRE(pclose(out) == 0);
+	return result.substr(0, result.find_first_of(" \n"));
+}
+
+static auto content_of_size(size_t n) {
+	std::vector<std::byte> out(n);
+	for (size_t i = 0; i != n; ++i) {
+		out[i] = static_cast<std::byte>(i * 7u + i / 4096u);
+	}
+	return out;
+}
+
+static void write_file(const std::filesystem::path & path, std::span<const std::byte> content) {
+	std::ofstream{path, std::ios::binary | std::ios::trunc}.write(reinterpret_cast<const char *>(content.data()), static_cast<std::streamsize>(content.size()));
+}
+
+static auto expected_of(std::span<const std::byte> content) {
+	std::ostringstream out;
+	out << cthash::segmented_xxhash64<>{}.update(content).final();
+	return out.str();
+}
+
+TEST_CASE("checksum xxhash64-seg of files shorter and longer than a segment", "[checksum]") {
+	const auto dir = std::filesystem::temp_directory_path() / ("cthash-test-" + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	const auto file = dir / "input";
+
+	// read in batches, mapped and shorter than one segment, and with whole segments hashed by helpers
+	for (size_t size: {0u, 100u, 65537u, 300'000u, 1024u * 1024u - 1u, 1024u * 1024u, 2621447u}) {
+		const auto content = content_of_size(size);
+		write_file(file, content);
+
+		for (const auto * options: {"", "-j 4 ", "-j 4 --io=read "}) {
+			REQUIRE(run_checksum(std::string(options) + "xxhash64-seg " + file.string()) == expected_of(content));
+		}
+	}
+
+	// appended data are resumed from the middle of a segment, less than one whole segment follows it
+	const auto cache = dir / "cache";
+	const auto content = content_of_size(2'200'000u);
+	write_file(file, std::span(content).first(1'100'000u));
+	REQUIRE(run_checksum("-j 4 --cache=" + cache.string() + " --resume xxhash64-seg " + file.string()) == expected_of(std::span(content).first(1'100'000u)));
+	write_file(file, content);
+	REQUIRE(run_checksum("-j 4 --cache=" + cache.string() + " --resume xxhash64-seg " + file.string()) == expected_of(content));
+
+	std::filesystem::remove_all(dir);
+}
+
+#endif
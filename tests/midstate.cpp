@@ -0,0 +1,79 @@
+#include "internal/support.hpp"
+#include <cthash/cthash.hpp>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cthash::literals;
+
+template <typename Hasher> constexpr auto resumed_hash(std::string_view first, std::string_view second) {
+	const auto state = Hasher{}.update(first).midstate();
+
+	auto h = Hasher{};
+	h.restore(state);
+	return h.update(second).final();
+}
+
+TEST_CASE("midstate (constexpr)") {
+	STATIC_REQUIRE(resumed_hash<cthash::sha256>("hello ", "there!") == "c69509590d81db2f37f9d75480c8efedf79a77933db5a8319e52e13bfd9874a3"_sha256);
+	STATIC_REQUIRE(resumed_hash<cthash::sha3_256>("hello ", "there!") == "c7fd85f649fba4bd6fb605038ae8530cf2239152bbbcb9d91d260cc2a90a9fea"_sha3_256);
+	STATIC_REQUIRE(resumed_hash<cthash::xxhash64>("hello ", "there") == "08f296af889a203c"_xxh64);
+}
+
+TEMPLATE_TEST_CASE("midstate resumes hashing at any position", "[midstate]", cthash::sha1, cthash::sha224, cthash::sha256, cthash::sha384, cthash::sha512, cthash::sha512t<256>, cthash::sha3_256, cthash::sha3_512, cthash::xxhash32, cthash::xxhash64) {
+	std::array<std::byte, 1000> input{};
+
+	for (int i = 0; i != (int)input.size(); ++i) {
+		input[static_cast<size_t>(i)] = static_cast<std::byte>(i * 7);
+	}
+
+	const auto expected = TestType{}.update(runtime_pass(input)).final();
+
+	for (size_t split: {size_t{0}, size_t{1}, size_t{63}, size_t{64}, size_t{65}, size_t{135}, size_t{136}, size_t{137}, size_t{999}, size_t{1000}}) {
+		const auto state = TestType{}.update(std::span(runtime_pass(input)).first(split)).midstate();
+
+		auto h = TestType{};
+		REQUIRE(h.restore(state));
+		REQUIRE(h.update(std::span(runtime_pass(input)).subspan(split)).final() == expected);
+	}
+}
+
+TEMPLATE_TEST_CASE("midstate buffer contains only pending bytes", "[midstate]", cthash::sha1, cthash::sha256, cthash::sha512, cthash::sha3_256, cthash::xxhash32, cthash::xxhash64) {
+	std::array<std::byte, 1000> input{};
+
+	for (int i = 0; i != (int)input.size(); ++i) {
+		input[static_cast<size_t>(i)] = static_cast<std::byte>(i * 7);
+	}
+
+	const auto expected = TestType{}.update(runtime_pass(input)).final();
+
+	for (size_t split: {size_t{0}, size_t{1}, size_t{63}, size_t{64}, size_t{65}, size_t{135}, size_t{136}, size_t{137}, size_t{999}, size_t{1000}}) {
+		const auto h = TestType{}.update(std::span(runtime_pass(input)).first(split));
+		REQUIRE(h.pending() <= TestType::midstate_buffer_size);
+
+		// unused part of buffer doesn't matter
+		auto state = h.midstate();
+		const auto buffer = std::span(state).last(TestType::midstate_buffer_size);
+		std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(h.pending()), buffer.end(), std::byte{0xAA});
+
+		auto r = TestType{};
+		REQUIRE(r.restore(state));
+		REQUIRE(r.pending() == h.pending());
+		REQUIRE(r.update(std::span(runtime_pass(input)).subspan(split)).final() == expected);
+	}
+}
+
+TEST_CASE("shake midstate") {
+	const auto state = cthash::shake128{}.update("hello ").midstate();
+
+	auto h = cthash::shake128{};
+	REQUIRE(h.restore(state));
+	REQUIRE(h.update("there!").final<1024>() == cthash::shake128{}.update("hello there!").final<1024>());
+}
+
+TEST_CASE("keccak midstate with invalid position is rejected") {
+	auto state = cthash::sha3_256{}.update("hello").midstate();
+	state.back() = std::byte{200};
+
+	auto h = cthash::sha3_256{};
+	REQUIRE_FALSE(h.restore(state));
+}
@@ -0,0 +1,43 @@
+#include "internal/support.hpp"
+#include <cthash/sha1.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cthash::literals;
+
+TEST_CASE("sha1 basics") {
+	constexpr auto v1 = cthash::sha1{}.update("").final();
+	auto v1r = cthash::sha1{}.update(runtime_pass("")).final();
+	REQUIRE(v1 == "da39a3ee5e6b4b0d3255bfef95601890afd80709"_sha1);
+	REQUIRE(v1 == v1r);
+
+	constexpr auto v2 = cthash::sha1{}.update("abc").final();
+	auto v2r = cthash::sha1{}.update(runtime_pass("abc")).final();
+	REQUIRE(v2 == "a9993e364706816aba3e25717850c26c9cd0d89d"_sha1);
+	REQUIRE(v2 == v2r);
+
+	constexpr auto v3 = cthash::sha1{}.update("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq").final();
+	auto v3r = cthash::sha1{}.update(runtime_pass("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")).final();
+	REQUIRE(v3 == "84983e441c3bd26ebaae4aa1f95129e5e54670f1"_sha1);
+	REQUIRE(v3 == v3r);
+
+	constexpr auto v4 = cthash::sha1{}.update(array_of_zeros<64>()).final();
+	auto v4r = cthash::sha1{}.update(runtime_pass(array_of_zeros<64>())).final();
+	REQUIRE(v4 == "c8d7d0ef0eedfa82d2ea1aa592845b9a6d4b02b7"_sha1);
+	REQUIRE(v4 == v4r);
+
+	constexpr auto v5 = cthash::sha1{}.update(array_of_zeros<120>()).final();
+	auto v5r = cthash::sha1{}.update(runtime_pass(array_of_zeros<120>())).final();
+	REQUIRE(v5 == "b110a88a11436b215220486c1081dec2fb0f389a"_sha1);
+	REQUIRE(v5 == v5r);
+}
+
+TEST_CASE("sha1 million of a") {
+	auto h = cthash::sha1{};
+	const auto block = std::string(1000u, 'a');
+
+	for (int i = 0; i != 1000; ++i) {
+		h.update(runtime_pass(block));
+	}
+
+	REQUIRE(h.final() == "34aa973cd4c4daa4f61eeb2bdbad27316534016f"_sha1);
+}
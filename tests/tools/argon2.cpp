@@ -0,0 +1,40 @@
+#include "../../tools/argon2.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+TEST_CASE("argon2 context derives with parallel lanes", "[argon2]") {
+	// same tag as from sequential lanes
+	const auto password = std::array<std::byte, 32>{};
+	const auto salt = std::array<std::byte, 16>{};
+	const auto params = cthash::argon2::parameters{.passes = 2u, .memory_kib = 64u, .lanes = 4u, .tag_length = 32u};
+
+	std::vector<cthash::argon2::block> memory(cthash::argon2::memory_blocks(params));
+	std::array<std::byte, 32> expected{};
+	REQUIRE(cthash::argon2id(expected, password, salt, params, memory));
+
+	auto context = cthash::tools::argon2_context{3u};
+	std::array<std::byte, 32> tag{};
+	REQUIRE(context.derive(tag, password, salt, params));
+	REQUIRE(tag == expected);
+
+	// memory kept for later derivations doesn't keep blocks derived from the password
+	const auto kept = context.memory.as_span<cthash::argon2::block>().first(memory.size());
+	REQUIRE(std::ranges::all_of(kept, [](const cthash::argon2::block & b) { return std::ranges::all_of(b.words, [](uint64_t w) { return w == 0u; }); }));
+}
+
+TEST_CASE("argon2 context rejects invalid parameters", "[argon2]") {
+	const auto password = std::array<std::byte, 8>{};
+	const auto salt = std::array<std::byte, 16>{};
+	auto context = cthash::tools::argon2_context{2u};
+	std::array<std::byte, 32> tag{};
+
+	REQUIRE(not context.derive(tag, password, salt, {.passes = 1u, .memory_kib = 64u, .lanes = 0u, .tag_length = 32u}));
+	REQUIRE(not context.derive(tag, password, salt, {.passes = 0u, .memory_kib = 64u, .lanes = 1u, .tag_length = 32u}));
+	REQUIRE(not context.derive(std::span(tag).first(3u), password, salt, {.passes = 1u, .memory_kib = 64u, .lanes = 1u, .tag_length = 3u}));
+	REQUIRE(not context.derive(tag, password, salt, {.passes = 1u, .memory_kib = 31u, .lanes = 4u, .tag_length = 32u}));
+	REQUIRE(not context.derive(tag, password, salt, {.passes = 1u, .memory_kib = 64u, .lanes = 1u, .tag_length = 16u}));
+	REQUIRE(not context.derive(tag, password, std::span(salt).first(7u), {.passes = 1u, .memory_kib = 64u, .lanes = 1u, .tag_length = 32u}));
+	REQUIRE(tag == std::array<std::byte, 32>{});
+}
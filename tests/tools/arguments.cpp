@@ -0,0 +1,49 @@
+#include "../../tools/arguments.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+
+TEST_CASE("numbers in arguments", "[arguments]") {
+	REQUIRE(cthash::tools::parse_number<uint64_t>("0") == uint64_t{0});
+	REQUIRE(cthash::tools::parse_number<uint64_t>("4096") == uint64_t{4096});
+	REQUIRE(cthash::tools::parse_number<uint64_t>("18446744073709551615") == UINT64_MAX);
+
+	REQUIRE(not cthash::tools::parse_number<uint64_t>(""));
+	REQUIRE(not cthash::tools::parse_number<uint64_t>("abc"));
+	REQUIRE(not cthash::tools::parse_number<uint64_t>("12abc"));
+	REQUIRE(not cthash::tools::parse_number<uint64_t>("-1"));
+	REQUIRE(not cthash::tools::parse_number<uint64_t>("18446744073709551616"));
+
+	REQUIRE(cthash::tools::parse_number<double>("0.5") == 0.5);
+	REQUIRE(not cthash::tools::parse_number<double>("10k"));
+	REQUIRE(not cthash::tools::parse_number<double>(""));
+}
+
+TEST_CASE("number of jobs in arguments", "[arguments]") {
+	char program[] = "tool";
+	char attached[] = "-j4";
+	char separate[] = "-j";
+	char value[] = "12";
+	char zero[] = "-j0";
+	char invalid[] = "-jx";
+
+	char * argv[] = {program, attached, separate, value, zero, invalid, separate};
+	const int argc = 7;
+
+	int i = 1;
+	REQUIRE(cthash::tools::jobs_argument(argv[i], i, argc, argv) == size_t{4});
+	REQUIRE(i == 1);
+
+	i = 2;
+	REQUIRE(cthash::tools::jobs_argument(argv[i], i, argc, argv) == size_t{12});
+	REQUIRE(i == 3);
+
+	i = 4;
+	REQUIRE(not cthash::tools::jobs_argument(argv[i], i, argc, argv));
+
+	i = 5;
+	REQUIRE(not cthash::tools::jobs_argument(argv[i], i, argc, argv));
+
+	// "-j" as the last argument has no value
+	i = 6;
+	REQUIRE(not cthash::tools::jobs_argument(argv[i], i, argc, argv));
+}
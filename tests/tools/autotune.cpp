@@ -0,0 +1,47 @@
+#include "../../tools/autotune.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+TEST_CASE("tuning file keeps settings of each key", "[autotune]") {
+	const auto path = std::filesystem::temp_directory_path() / ("cthash-tuning-test-" + std::to_string(::getpid()));
+	std::filesystem::remove(path);
+
+	const auto file = cthash::tools::tuning_file{path};
+	const auto sha256 = cthash::tools::tuning_file::key{"Some\tCPU", "sha-256", 4u};
+	const auto sha3 = cthash::tools::tuning_file::key{"Some\tCPU", "sha3-256", 4u};
+
+	REQUIRE(not file.load(sha256));
+
+	const auto first = cthash::tools::tuning{.small_file_limit = 8192u, .min_parallel_segments = 4u, .read_large = true, .min_multi_buffer_batch = 3u};
+	const auto second = cthash::tools::tuning{.small_file_limit = 4096u, .min_parallel_segments = UINT64_MAX, .read_large = false, .min_multi_buffer_batch = UINT64_MAX};
+
+	REQUIRE(file.store(sha256, first));
+	REQUIRE(file.store(sha3, second));
+	REQUIRE(file.load(sha256) == first);
+	REQUIRE(file.load(sha3) == second);
+
+	// storing again replaces the line
+	REQUIRE(file.store(sha256, second));
+	REQUIRE(file.load(sha256) == second);
+	REQUIRE(file.load(sha3) == second);
+
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("tuning file without multi-buffer batch", "[autotune]") {
+	const auto path = std::filesystem::temp_directory_path() / ("cthash-tuning-old-" + std::to_string(::getpid()));
+	const auto key = cthash::tools::tuning_file::key{"CPU", "sha-256", 1u};
+
+	std::ofstream{path} << key.prefix() << "16384\t2\tread\n";
+
+	const auto loaded = cthash::tools::tuning_file{path}.load(key);
+	REQUIRE(loaded);
+	REQUIRE(loaded->small_file_limit == 16384u);
+	REQUIRE(loaded->min_parallel_segments == 2u);
+	REQUIRE(loaded->read_large);
+	REQUIRE(loaded->min_multi_buffer_batch == cthash::tools::tuning{}.min_multi_buffer_batch);
+
+	std::filesystem::remove(path);
+}
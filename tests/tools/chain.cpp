@@ -0,0 +1,162 @@
+#include "../../tools/chain.hpp"
+#include <cthash/sha2/sha256.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using chain = cthash::tools::hash_chain<32>;
+
+static auto bytes_of(std::string_view in) {
+	return std::as_bytes(std::span(in.data(), in.size()));
+}
+
+static auto digest_of(std::span<const std::byte> record) -> chain::digest {
+	const auto d = cthash::sha256{}.update(record).final();
+	chain::digest out;
+	std::copy(d.begin(), d.end(), out.begin());
+	return out;
+}
+
+static auto hex_of(const chain::digest & d) {
+	constexpr std::string_view alphabet = "0123456789abcdef";
+	std::string out;
+	for (const auto b: d) {
+		out += alphabet[static_cast<unsigned>(b) >> 4u];
+		out += alphabet[static_cast<unsigned>(b) & 0xFu];
+	}
+	return out;
+}
+
+// log of `count` correctly linked records (each ends with a newline)
+static auto log_of(size_t count) {
+	std::string out;
+	chain::digest previous{};
+
+	for (size_t i = 0; i != count; ++i) {
+		const auto record = hex_of(previous) + " record " + std::to_string(i);
+		previous = digest_of(bytes_of(record));
+		out += record + "\n";
+	}
+
+	return out;
+}
+
+struct parsed_log {
+	std::vector<std::span<const std::byte>> records{};
+	std::vector<chain::digest> links{};
+	std::vector<chain::digest> digests{};
+
+	explicit parsed_log(std::string_view log) {
+		chain::split(bytes_of(log), true, records);
+
+		// malformed link can't match anything (as in verify-chain)
+		auto broken = chain::digest{};
+		broken.fill(std::byte{0xFF});
+
+		for (const auto record: records) {
+			links.push_back(chain::parse_link(record).value_or(broken));
+			digests.push_back(digest_of(record));
+		}
+	}
+
+	auto first_break() const {
+		return chain::first_break(chain::digest{}, links, digests);
+	}
+};
+
+TEST_CASE("links of records", "[chain]") {
+	const auto d = digest_of(bytes_of("something"));
+	const auto link = hex_of(d);
+
+	REQUIRE(chain::parse_link(bytes_of(link + " payload")) == d);
+	REQUIRE(chain::parse_link(bytes_of(link + " ")) == d);
+
+	// digest written in upper case is the same link
+	auto upper = link;
+	for (auto & c: upper) {
+		c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	}
+	REQUIRE(upper != link);
+	REQUIRE(chain::parse_link(bytes_of(upper + " payload")) == d);
+
+	REQUIRE(not chain::parse_link(bytes_of("")));
+	REQUIRE(not chain::parse_link(bytes_of(link)));
+	REQUIRE(not chain::parse_link(bytes_of(link.substr(1u) + " payload")));
+	REQUIRE(not chain::parse_link(bytes_of(link + "payload")));
+	REQUIRE(not chain::parse_link(bytes_of("g" + link.substr(1u) + " payload")));
+	REQUIRE(not chain::parse_link(bytes_of(link.substr(0u, 63u) + "  payload")));
+}
+
+TEST_CASE("records of a log", "[chain]") {
+	std::vector<std::span<const std::byte>> records;
+
+	chain::split(bytes_of(""), true, records);
+	REQUIRE(records.empty());
+
+	chain::split(bytes_of("a\nbc\n\nd"), false, records);
+	REQUIRE(records.size() == 3u);
+	REQUIRE(records[1].size() == 2u);
+	REQUIRE(records[2].empty());
+
+	// final record without newline belongs to the log only at its end
+	records.clear();
+	chain::split(bytes_of("a\nbc\n\nd"), true, records);
+	REQUIRE(records.size() == 4u);
+	REQUIRE(records[3].size() == 1u);
+	REQUIRE(static_cast<char>(records[3][0]) == 'd');
+}
+
+TEST_CASE("breaks of a log", "[chain]") {
+	SECTION("empty log") {
+		REQUIRE(not parsed_log{""}.first_break());
+	}
+
+	SECTION("correct log") {
+		for (const size_t count: {1u, 2u, 64u, 65u, 66u, 129u, 300u}) {
+			REQUIRE(not parsed_log{log_of(count)}.first_break());
+		}
+	}
+
+	SECTION("final record without newline") {
+		auto log = log_of(100u);
+		log.pop_back();
+		const auto parsed = parsed_log{log};
+		REQUIRE(parsed.records.size() == 100u);
+		REQUIRE(not parsed.first_break());
+	}
+
+	SECTION("changed record") {
+		// blocks of 64 records start at the second one
+		for (const size_t changed: {0u, 1u, 62u, 63u, 64u, 65u, 127u, 128u, 199u}) {
+			auto log = log_of(200u);
+			const auto at = log.find("record " + std::to_string(changed) + "\n");
+			log[at] = 'R';
+
+			// next record doesn't link to it anymore (the last one has no next record)
+			const auto expected = (changed + 1u == 200u) ? std::optional<size_t>{} : std::optional<size_t>{changed + 1u};
+			REQUIRE(parsed_log{log}.first_break() == expected);
+		}
+	}
+
+	SECTION("first of two breaks in one block") {
+		auto log = log_of(200u);
+		log[log.find("record 70\n")] = 'R';
+		log[log.find("record 80\n")] = 'R';
+		REQUIRE(parsed_log{log}.first_break() == size_t{71u});
+	}
+
+	SECTION("malformed link") {
+		auto log = log_of(100u);
+		// last digit of the link of the last record in the first block
+		log[log.find("record 64\n") - 2u] = 'x';
+		REQUIRE(parsed_log{log}.first_break() == size_t{64u});
+
+		auto first = log_of(10u);
+		first[0] = 'x';
+		REQUIRE(parsed_log{first}.first_break() == size_t{0u});
+	}
+}
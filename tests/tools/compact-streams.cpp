@@ -0,0 +1,135 @@
+#include "../../tools/compact-streams.hpp"
+#include <cthash/sha2/sha256.hpp>
+#include <cthash/sha3/sha3-256.hpp>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace {
+
+auto random_bytes(std::mt19937 & rng, size_t size) {
+	std::vector<std::byte> out(size);
+	for (auto & b: out) {
+		b = static_cast<std::byte>(rng());
+	}
+	return out;
+}
+
+} // namespace
+
+TEMPLATE_TEST_CASE("compact streams give same digests as plain hashers", "[compact-streams]", cthash::sha256, cthash::sha3_256) {
+	using streams_type = cthash::tools::compact_streams<TestType>;
+
+	auto rng = std::mt19937{7u};
+	streams_type streams{};
+
+	// plain hasher next to each handle (handles are reused after they are finished)
+	std::vector<std::optional<TestType>> expected{};
+	std::vector<bool> open{};
+
+	const auto open_stream = [&] {
+		const auto h = streams.open();
+		if (h >= expected.size()) {
+			expected.resize(h + 1u);
+			open.resize(h + 1u);
+		}
+		REQUIRE(not open[h]);
+		expected[h].emplace();
+		open[h] = true;
+		return h;
+	};
+
+	for (size_t i = 0; i != 200u; ++i) {
+		open_stream();
+	}
+
+	// updates of random streams with lengths which fill every size class of pending bytes and cross blocks
+	for (size_t step = 0; step != 20'000u; ++step) {
+		const auto h = static_cast<typename streams_type::handle>(rng() % expected.size());
+
+		// closed handle is reused by the next opened stream
+		if (not open[h]) {
+			open_stream();
+			continue;
+		}
+
+		if (rng() % 16u == 0u) {
+			const auto digest = streams.finish(h).final();
+			REQUIRE(digest == expected[h]->final());
+			open[h] = false;
+			continue;
+		}
+
+		const size_t length = (rng() % 4u == 0u) ? rng() % 400u : rng() % 20u;
+		const auto data = random_bytes(rng, length);
+		streams.update(h, data);
+		expected[h]->update(data);
+	}
+
+	size_t still_open = 0u;
+	for (size_t h = 0; h != expected.size(); ++h) {
+		if (open[h]) {
+			REQUIRE(streams.finish(static_cast<typename streams_type::handle>(h)).final() == expected[h]->final());
+			++still_open;
+		}
+	}
+
+	REQUIRE(still_open != 0u);
+	REQUIRE(streams.size() == 0u);
+}
+
+TEST_CASE("compact streams reuse slab slots", "[compact-streams]") {
+	using streams_type = cthash::tools::compact_streams<cthash::sha256>;
+	streams_type streams{};
+
+	const auto five = std::vector<std::byte>(5u, std::byte{1});
+	const auto forty = std::vector<std::byte>(40u, std::byte{2});
+	const auto rest = std::vector<std::byte>(64u - 5u - 40u, std::byte{3});
+
+	const auto a = streams.open();
+	const auto b = streams.open();
+	streams.update(a, five);
+	streams.update(b, five);
+
+	// both have few pending bytes, so they are in the smallest slab
+	REQUIRE(streams.partial_class[a] == 0u);
+	REQUIRE(streams.partial_class[b] == 0u);
+	REQUIRE(streams.partial[a] != streams.partial[b]);
+	REQUIRE(streams.slabs[0].chunks.size() == 1u);
+
+	// `a` moves to a larger slab and its small slot is taken by the next stream which needs one
+	const auto slot_of_a = streams.partial[a];
+	streams.update(a, forty);
+	REQUIRE(streams.partial_class[a] == 2u);
+
+	const auto c = streams.open();
+	streams.update(c, five);
+	REQUIRE(streams.partial_class[c] == 0u);
+	REQUIRE(streams.partial[c] == slot_of_a);
+
+	// whole block has no pending bytes, so nothing is attached
+	streams.update(a, rest);
+	REQUIRE(streams.partial[a] == cthash::tools::partial_block_slab::none);
+
+	// handle of finished stream is reused and its slot is freed
+	const auto slot_of_b = streams.partial[b];
+	const auto digest_b = streams.finish(b).final();
+	REQUIRE(digest_b == cthash::sha256{}.update(five).final());
+
+	const auto d = streams.open();
+	REQUIRE(d == b);
+	streams.update(d, five);
+	REQUIRE(streams.partial[d] == slot_of_b);
+	REQUIRE(streams.finish(d).final() == digest_b);
+
+	// many open and finished streams don't grow memory
+	const size_t bytes = streams.bytes();
+	for (size_t i = 0; i != 10'000u; ++i) {
+		const auto h = streams.open();
+		streams.update(h, forty);
+		streams.close(h);
+	}
+	REQUIRE(streams.bytes() == bytes);
+}
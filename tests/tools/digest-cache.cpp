@@ -0,0 +1,165 @@
+#include "../../tools/digest-cache.hpp"
+#include <cthash/sha2/sha256.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+
+// removed when the test ends
+struct temporary_path {
+	std::string path;
+
+	explicit temporary_path(std::string_view name): path{(std::filesystem::temp_directory_path() / (std::string(name) + "-" + std::to_string(::getpid()))).string()} {
+		std::filesystem::remove(path);
+	}
+
+	~temporary_path() {
+		std::filesystem::remove(path);
+	}
+};
+
+auto metadata_of(uint64_t inode) -> cthash::tools::file_metadata {
+	return {.device = 1u, .inode = inode, .size = 1000u + inode, .mtime_ns = 1'700'000'000'000'000'000 + static_cast<int64_t>(inode), .ctime_ns = 1'700'000'000'000'000'000};
+}
+
+auto digest_of(std::string_view content) -> cthash::tools::digest_value {
+	return cthash::tools::digest_value{cthash::sha256{}.update(content).final()};
+}
+
+} // namespace
+
+TEST_CASE("digest cache keeps records between runs", "[digest-cache]") {
+	const auto file = temporary_path{"cthash-digest-cache-round-trip"};
+	const auto midstate = std::vector<std::byte>(40u, std::byte{0x5A});
+
+	{
+		cthash::tools::digest_cache cache{file.path};
+		REQUIRE(cache.size() == 0u);
+		cache.store(metadata_of(1u), "sha-256", digest_of("one"));
+		cache.store(metadata_of(2u), "sha-256", digest_of("two"), midstate, 0x1234u);
+		cache.store(metadata_of(1u), "sha3-256", digest_of("other algorithm"));
+		REQUIRE(cache.flush());
+	}
+
+	cthash::tools::digest_cache cache{file.path};
+	REQUIRE(cache.size() == 3u);
+	REQUIRE(cache.lookup(metadata_of(1u), "sha-256") == digest_of("one"));
+	REQUIRE(cache.lookup(metadata_of(1u), "sha3-256") == digest_of("other algorithm"));
+	REQUIRE(not cache.lookup(metadata_of(3u), "sha-256"));
+
+	const auto entry = cache.find(metadata_of(2u), "sha-256");
+	REQUIRE(entry);
+	REQUIRE(entry->digest == digest_of("two"));
+	REQUIRE(entry->midstate == midstate);
+	REQUIRE(entry->fingerprint == 0x1234u);
+}
+
+TEST_CASE("digest cache ignores torn and corrupted records", "[digest-cache]") {
+	const auto file = temporary_path{"cthash-digest-cache-torn"};
+
+	{
+		cthash::tools::digest_cache cache{file.path};
+		cache.store(metadata_of(1u), "sha-256", digest_of("one"));
+		cache.store(metadata_of(2u), "sha-256", digest_of("two"));
+		REQUIRE(cache.flush());
+	}
+
+	SECTION("truncated") {
+		std::filesystem::resize_file(file.path, std::filesystem::file_size(file.path) - 3u);
+	}
+
+	SECTION("corrupted") {
+		std::FILE * f = std::fopen(file.path.c_str(), "r+b");
+		REQUIRE(f != nullptr);
+		REQUIRE(std::fseek(f, -20, SEEK_END) == 0);
+		std::fputc(0xFF, f);
+		std::fclose(f);
+	}
+
+	{
+		cthash::tools::digest_cache cache{file.path};
+		REQUIRE(cache.size() == 1u);
+		REQUIRE(cache.lookup(metadata_of(1u), "sha-256") == digest_of("one"));
+		REQUIRE(not cache.lookup(metadata_of(2u), "sha-256"));
+
+		// next writer replaces the broken tail
+		cache.store(metadata_of(3u), "sha-256", digest_of("three"));
+		REQUIRE(cache.flush());
+	}
+
+	cthash::tools::digest_cache cache{file.path};
+	REQUIRE(cache.size() == 2u);
+	REQUIRE(cache.lookup(metadata_of(1u), "sha-256") == digest_of("one"));
+	REQUIRE(cache.lookup(metadata_of(3u), "sha-256") == digest_of("three"));
+}
+
+TEST_CASE("digest cache compaction keeps only latest records", "[digest-cache]") {
+	const auto file = temporary_path{"cthash-digest-cache-compact"};
+
+	{
+		cthash::tools::digest_cache cache{file.path};
+		for (int round = 0; round != 10; ++round) {
+			for (uint64_t inode = 1u; inode != 5u; ++inode) {
+				cache.store(metadata_of(inode), "sha-256", digest_of(std::to_string(round * 10u + inode)));
+			}
+			REQUIRE(cache.flush());
+		}
+	}
+
+	const auto before = std::filesystem::file_size(file.path);
+
+	{
+		cthash::tools::digest_cache cache{file.path};
+		REQUIRE(cache.size() == 4u);
+		REQUIRE(cache.compact());
+	}
+
+	// ten versions of each record became one
+	REQUIRE(std::filesystem::file_size(file.path) < before / 5u);
+
+	cthash::tools::digest_cache cache{file.path};
+	REQUIRE(cache.size() == 4u);
+	for (uint64_t inode = 1u; inode != 5u; ++inode) {
+		REQUIRE(cache.lookup(metadata_of(inode), "sha-256") == digest_of(std::to_string(90u + inode)));
+	}
+}
+
+TEST_CASE("digest cache misses files which changed", "[digest-cache]") {
+	const auto file = temporary_path{"cthash-digest-cache-changed"};
+
+	cthash::tools::digest_cache cache{file.path};
+	cache.store(metadata_of(1u), "sha-256", digest_of("one"));
+	REQUIRE(cache.lookup(metadata_of(1u), "sha-256") == digest_of("one"));
+
+	// any part of metadata which isn't in the key makes the record stale (it's still found for resuming)
+	auto grown = metadata_of(1u);
+	grown.size += 1u;
+	auto written = metadata_of(1u);
+	written.mtime_ns += 1;
+	auto changed = metadata_of(1u);
+	changed.ctime_ns += 1;
+
+	for (const auto & md: {grown, written, changed}) {
+		REQUIRE(not cache.lookup(md, "sha-256"));
+		REQUIRE(cache.find(md, "sha-256"));
+	}
+
+	// old content of a grown file is compared by its sampled fingerprint
+	auto content = std::vector<std::byte>(100'000u, std::byte{1});
+	const auto fingerprint = cthash::tools::sampled_fingerprint(content, 90'000u);
+	REQUIRE(cthash::tools::sampled_fingerprint(content, 90'000u) == fingerprint);
+	REQUIRE(cthash::tools::sampled_fingerprint(content, 90'001u) != fingerprint);
+
+	content[89'999u] = std::byte{2};
+	REQUIRE(cthash::tools::sampled_fingerprint(content, 90'000u) != fingerprint);
+
+	// bytes after the old end don't matter
+	content[89'999u] = std::byte{1};
+	content[95'000u] = std::byte{2};
+	REQUIRE(cthash::tools::sampled_fingerprint(content, 90'000u) == fingerprint);
+}
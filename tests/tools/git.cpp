@@ -0,0 +1,129 @@
+#include "../../tools/git.hpp"
+#include <cthash/sha1.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static auto bytes(std::initializer_list<unsigned> in) {
+	std::vector<std::byte> out;
+	for (const unsigned v: in) {
+		out.push_back(static_cast<std::byte>(v));
+	}
+	return out;
+}
+
+static auto bytes(std::string_view in) {
+	std::vector<std::byte> out;
+	for (const char c: in) {
+		out.push_back(static_cast<std::byte>(c));
+	}
+	return out;
+}
+
+// zlib stream of "hello, hello, hello"
+static const auto hello_zlib = bytes({0x78, 0x9c, 0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0xc8, 0x40, 0xa2, 0x00, 0x44, 0x28, 0x06, 0xd5});
+
+static auto entry_with(std::vector<std::byte> header) {
+	header.insert(header.end(), hello_zlib.begin(), hello_zlib.end());
+	return header;
+}
+
+TEST_CASE("git object id", "[git]") {
+	using namespace cthash::literals;
+
+	// `git hash-object` of "hello\n"
+	REQUIRE(cthash::tools::git_object_id<cthash::sha1>("blob", bytes("hello\n")) == "ce013625030ba8dba906f756967f9e9ca394464a"_sha1);
+
+	// type of any length is hashed as it is
+	const auto type = std::string(100u, 't');
+	const auto expected = cthash::sha1{}.update(type).update(" 5").update(bytes({0})).update(bytes("hello")).final();
+	REQUIRE(cthash::tools::git_object_id<cthash::sha1>(type, bytes("hello")) == expected);
+}
+
+TEST_CASE("pack entry is parsed and inflated", "[git]") {
+	// blob of 19 bytes
+	const auto pack = entry_with(bytes({0xb3, 0x01}));
+	const auto entry = cthash::tools::pack_entry::parse(pack, 0u, 20u);
+
+	REQUIRE(entry.has_value());
+	REQUIRE(entry->type == cthash::tools::git_object_type::blob);
+	REQUIRE(entry->size == 19u);
+	REQUIRE(entry->data_offset == 2u);
+
+	std::vector<std::byte> out;
+	REQUIRE(cthash::tools::zlib_inflate(std::span(pack).subspan(2u), out, entry->size) == hello_zlib.size());
+	REQUIRE(out == bytes("hello, hello, hello"));
+}
+
+TEST_CASE("truncated pack entry header is rejected", "[git]") {
+	REQUIRE_FALSE(cthash::tools::pack_entry::parse(bytes({0xb3}), 0u, 20u).has_value());
+	REQUIRE_FALSE(cthash::tools::pack_entry::parse(bytes({0xb3, 0x81}), 0u, 20u).has_value());
+
+	// ref-delta without whole name of its base
+	REQUIRE_FALSE(cthash::tools::pack_entry::parse(bytes({0x73, 0x01, 0x02, 0x03}), 0u, 20u).has_value());
+}
+
+TEST_CASE("pack entry with size which its data can't hold is rejected", "[git]") {
+	const auto pack = entry_with(bytes({0x9f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x0f}));
+	REQUIRE_FALSE(cthash::tools::pack_entry::parse(pack, 0u, 20u).has_value());
+}
+
+TEST_CASE("inflate doesn't reserve untrusted limit", "[git]") {
+	std::vector<std::byte> out;
+	REQUIRE(cthash::tools::zlib_inflate(hello_zlib, out, SIZE_MAX / 2u) == hello_zlib.size());
+	REQUIRE(out == bytes("hello, hello, hello"));
+	REQUIRE(out.capacity() < 1024u);
+
+	// output is limited
+	REQUIRE_FALSE(cthash::tools::zlib_inflate(hello_zlib, out, 10u).has_value());
+}
+
+TEST_CASE("stored block is inflated after a compressed one", "[git]") {
+	// fixed Huffman block with "hello, hello, hello", empty stored block of sync flush and final stored block " stored"
+	const auto stream = bytes({0x78, 0x9c, 0xca, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0xc8, 0x40, 0xa2, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x01, 0x07, 0x00, 0xf8, 0xff, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x7e, 0x11, 0x09, 0x86});
+
+	std::vector<std::byte> out;
+	REQUIRE(cthash::tools::zlib_inflate(stream, out, 100u) == stream.size());
+	REQUIRE(out == bytes("hello, hello, hello stored"));
+
+	// stored data are cut short
+	REQUIRE_FALSE(cthash::tools::zlib_inflate(std::span(stream).first(26u), out, 100u).has_value());
+}
+
+TEST_CASE("delta is applied", "[git]") {
+	const auto base = bytes("hello");
+	// sizes of base and result, copy of 5 bytes from base and insert of 5 bytes
+	const auto delta = bytes({5, 10, 0x90, 5, 5, 'w', 'o', 'r', 'l', 'd'});
+
+	std::vector<std::byte> out;
+	REQUIRE(cthash::tools::apply_delta(base, delta, out));
+	REQUIRE(out == bytes("helloworld"));
+}
+
+TEST_CASE("delta with long copies is applied", "[git]") {
+	std::vector<std::byte> base(0x30000u);
+	for (size_t i = 0; i != base.size(); ++i) {
+		base[i] = static_cast<std::byte>(i * 7u);
+	}
+
+	// whole base copied by one instruction of two bytes (only the highest byte of size is present)
+	const auto delta = bytes({0x80, 0x80, 0x0C, 0x80, 0x80, 0x0C, 0xC0, 0x03});
+
+	std::vector<std::byte> out;
+	REQUIRE(cthash::tools::apply_delta(base, delta, out));
+	REQUIRE(out == base);
+}
+
+TEST_CASE("delta with oversized result is rejected", "[git]") {
+	const auto base = bytes("hello");
+	const auto delta = bytes({5, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f, 0x90, 5});
+
+	std::vector<std::byte> out;
+	REQUIRE_FALSE(cthash::tools::apply_delta(base, delta, out));
+
+	// size which instructions could produce, but they don't
+	const auto short_delta = bytes({5, 0x80, 0x80, 0x04, 0x90, 5});
+	REQUIRE_FALSE(cthash::tools::apply_delta(base, short_delta, out));
+	REQUIRE(out.capacity() < 1024u);
+}
@@ -0,0 +1,263 @@
+#include "../../tools/mmr.hpp"
+#include <cthash/sha2/sha256.hpp>
+#include <cthash/sha3/sha3-256.hpp>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <csignal>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+// removed when the test ends
+struct temporary_path {
+	std::string path;
+
+	explicit temporary_path(std::string_view name): path{(std::filesystem::temp_directory_path() / (std::string(name) + "-" + std::to_string(::getpid()))).string()} {
+		std::filesystem::remove(path);
+	}
+
+	~temporary_path() {
+		std::filesystem::remove(path);
+	}
+};
+
+auto random_entries(size_t count) {
+	auto rng = std::mt19937{11u};
+	std::vector<std::vector<std::byte>> out(count);
+
+	for (auto & entry: out) {
+		entry.resize(rng() % 200u);
+		for (auto & b: entry) {
+			b = static_cast<std::byte>(rng());
+		}
+	}
+
+	return out;
+}
+
+auto spans_of(const std::vector<std::vector<std::byte>> & entries) {
+	return std::vector<std::span<const std::byte>>(entries.begin(), entries.end());
+}
+
+} // namespace
+
+TEMPLATE_TEST_CASE("mmr batch appends give same roots as single appends", "[mmr]", cthash::sha256, cthash::sha3_256) {
+	using mmr = cthash::tools::merkle_mountain_range<TestType>;
+
+	const auto single_file = temporary_path{"cthash-mmr-single"};
+	const auto batch_file = temporary_path{"cthash-mmr-batch"};
+	const auto entries = random_entries(5000u);
+	const auto inputs = spans_of(entries);
+
+	mmr single{single_file.path};
+	mmr batch{batch_file.path};
+	REQUIRE(single.valid());
+	REQUIRE(batch.valid());
+	REQUIRE(single.root() == batch.root());
+
+	// few leaves against hashes computed by hand
+	REQUIRE(single.append(inputs[0]));
+	REQUIRE(single.root() == mmr::hash_leaf(inputs[0]));
+	REQUIRE(single.append(inputs[1]));
+	REQUIRE(single.append(inputs[2]));
+	REQUIRE(single.root() == mmr::hash_bag(mmr::hash_node(mmr::hash_leaf(inputs[0]), mmr::hash_leaf(inputs[1])), mmr::hash_leaf(inputs[2])));
+
+	auto rng = std::mt19937{3u};
+	cthash::tools::thread_pool pool{2u};
+	std::vector<typename mmr::digest> roots{single.root()};
+
+	for (size_t i = 3u; i != inputs.size(); ++i) {
+		REQUIRE(single.append(inputs[i]));
+		roots.push_back(single.root());
+	}
+
+	// batches of random sizes (some larger than a chunk of one task), with and without a pool
+	size_t done = 0u;
+	while (done != inputs.size()) {
+		const size_t count = std::min<size_t>(inputs.size() - done, (rng() % 4u == 0u) ? rng() % 3000u : rng() % 20u);
+		REQUIRE(batch.append(std::span(inputs).subspan(done, count), (rng() % 2u) ? &pool : nullptr));
+		done += count;
+
+		REQUIRE(batch.size() == done);
+		if (done >= 3u) {
+			REQUIRE(batch.root() == roots[done - 3u]);
+		}
+	}
+
+	REQUIRE(batch.root() == single.root());
+}
+
+TEMPLATE_TEST_CASE("mmr proofs", "[mmr]", cthash::sha256, cthash::sha3_256) {
+	using mmr = cthash::tools::merkle_mountain_range<TestType>;
+
+	const auto file = temporary_path{"cthash-mmr-proofs"};
+	const auto entries = random_entries(300u);
+	const auto inputs = spans_of(entries);
+
+	mmr range{file.path};
+	REQUIRE(range.valid());
+
+	std::vector<typename mmr::digest> roots{range.root()};
+	for (const auto entry: inputs) {
+		REQUIRE(range.append(entry));
+		roots.push_back(range.root());
+	}
+
+	const auto root = range.root();
+
+	SECTION("inclusion") {
+		for (uint64_t i = 0; i != inputs.size(); ++i) {
+			const auto proof = range.prove(i);
+			REQUIRE(proof);
+			REQUIRE(mmr::verify(root, inputs[i], *proof));
+
+			// other entry, other root and other position are rejected
+			REQUIRE(not mmr::verify(root, inputs[(i + 1u) % inputs.size()], *proof));
+			REQUIRE(not mmr::verify(roots[i], inputs[i], *proof));
+
+			auto moved = *proof;
+			moved.leaf_index ^= 1u;
+			REQUIRE(not mmr::verify(root, inputs[i], moved));
+
+			if (not proof->path.empty()) {
+				auto tampered = *proof;
+				tampered.path.back().data()[0] ^= std::byte{1};
+				REQUIRE(not mmr::verify(root, inputs[i], tampered));
+
+				auto shortened = *proof;
+				shortened.path.pop_back();
+				REQUIRE(not mmr::verify(root, inputs[i], shortened));
+			}
+
+			auto tampered_peak = *proof;
+			tampered_peak.peaks.front().data()[0] ^= std::byte{1};
+			REQUIRE(not mmr::verify(root, inputs[i], tampered_peak));
+		}
+
+		REQUIRE(not range.prove(inputs.size()));
+	}
+
+	SECTION("consistency") {
+		for (uint64_t old_leaves = 0; old_leaves <= inputs.size(); ++old_leaves) {
+			const auto proof = range.prove_consistency(old_leaves);
+			REQUIRE(proof);
+			REQUIRE(mmr::verify(roots[old_leaves], root, *proof));
+
+			if (old_leaves != inputs.size()) {
+				REQUIRE(not mmr::verify(roots[old_leaves + 1u], root, *proof));
+			}
+
+			if (not proof->old_peaks.empty()) {
+				auto tampered = *proof;
+				tampered.old_peaks.back().data()[0] ^= std::byte{1};
+				REQUIRE(not mmr::verify(roots[old_leaves], root, tampered));
+			}
+
+			for (size_t p = 0; p != proof->paths.size(); ++p) {
+				if (not proof->paths[p].empty()) {
+					auto tampered = *proof;
+					tampered.paths[p].front().data()[0] ^= std::byte{1};
+					REQUIRE(not mmr::verify(roots[old_leaves], root, tampered));
+				}
+			}
+		}
+
+		REQUIRE(not range.prove_consistency(inputs.size() + 1u));
+	}
+}
+
+TEMPLATE_TEST_CASE("mmr is reopened from its file", "[mmr]", cthash::sha256, cthash::sha3_256) {
+	using mmr = cthash::tools::merkle_mountain_range<TestType>;
+
+	const auto file = temporary_path{"cthash-mmr-reopen"};
+	const auto entries = random_entries(1500u);
+	const auto inputs = spans_of(entries);
+
+	typename mmr::digest root{};
+	typename mmr::inclusion_proof proof{};
+
+	{
+		mmr range{file.path};
+		REQUIRE(range.valid());
+		REQUIRE(range.append(std::span(inputs).first(1000u)));
+		REQUIRE(range.sync());
+		root = range.root();
+		proof = *range.prove(123u);
+	}
+
+	mmr reopened{file.path};
+	REQUIRE(reopened.valid());
+	REQUIRE(reopened.size() == 1000u);
+	REQUIRE(reopened.root() == root);
+	REQUIRE(reopened.prove(123u)->path == proof.path);
+
+	// appends continue where the previous process stopped
+	REQUIRE(reopened.append(std::span(inputs).subspan(1000u)));
+
+	const auto other = temporary_path{"cthash-mmr-reopen-all"};
+	mmr all{other.path};
+	REQUIRE(all.append(inputs));
+	REQUIRE(reopened.root() == all.root());
+}
+
+TEST_CASE("mmr stays usable when its file can't grow", "[mmr]") {
+	using mmr = cthash::tools::merkle_mountain_range<cthash::sha256>;
+
+	const auto file = temporary_path{"cthash-mmr-grow"};
+	const auto entries = random_entries(1500u);
+	const auto inputs = spans_of(entries);
+
+	mmr range{file.path};
+	REQUIRE(range.valid());
+	REQUIRE(range.append(std::span(inputs).first(500u)));
+	const auto root = range.root();
+
+	// file size limit makes `ftruncate` fail (with EFBIG instead of SIGXFSZ)
+	rlimit old_limit;
+	REQUIRE(getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+	const auto old_handler = std::signal(SIGXFSZ, SIG_IGN);
+
+	rlimit limit = old_limit;
+	limit.rlim_cur = static_cast<rlim_t>(std::filesystem::file_size(file.path));
+	REQUIRE(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+	const bool grown = range.append(std::span(inputs).subspan(500u));
+
+	REQUIRE(setrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+	std::signal(SIGXFSZ, old_handler);
+
+	REQUIRE(not grown);
+	REQUIRE(range.valid());
+	REQUIRE(range.size() == 500u);
+	REQUIRE(range.root() == root);
+
+	const auto proof = range.prove(123u);
+	REQUIRE(proof);
+	REQUIRE(mmr::verify(root, inputs[123u], *proof));
+	REQUIRE(range.prove_consistency(100u));
+
+	// growth works again once the limit is gone
+	REQUIRE(range.append(std::span(inputs).subspan(500u)));
+
+	const auto other = temporary_path{"cthash-mmr-grow-all"};
+	mmr all{other.path};
+	REQUIRE(all.append(inputs));
+	REQUIRE(range.root() == all.root());
+}
+
+TEST_CASE("mmr rejects file with other digest size", "[mmr]") {
+	const auto file = temporary_path{"cthash-mmr-digest-size"};
+	{
+		cthash::tools::merkle_mountain_range<cthash::sha256> range{file.path};
+		REQUIRE(range.valid());
+		REQUIRE(range.append(std::span<const std::byte>{}));
+	}
+
+	REQUIRE(not cthash::tools::merkle_mountain_range<cthash::sha224>{file.path}.valid());
+}
@@ -0,0 +1,36 @@
+#include "../../tools/multi-buffer.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+template <typename Hasher> static void check_lanes(size_t count) {
+	// lengths around block boundaries (and where padding needs another block) next to longer ones
+	std::vector<std::vector<std::byte>> contents;
+	for (size_t i = 0; i != count; ++i) {
+		const size_t length = (i % 3u == 0u) ? (i * 37u) % 300u : (i % 130u);
+		auto & c = contents.emplace_back(length);
+		for (size_t j = 0; j != length; ++j) {
+			c[j] = static_cast<std::byte>(i * 31u + j * 7u);
+		}
+	}
+
+	std::vector<std::span<const std::byte>> inputs(contents.begin(), contents.end());
+	std::vector<size_t> seen(count);
+
+	cthash::tools::multi_buffer<Hasher>::hash(inputs, [&](size_t i, auto digest) {
+		++seen[i];
+		const auto expected = Hasher{}.update(inputs[i]).final();
+		REQUIRE(std::ranges::equal(digest, std::span<const std::byte>(expected)));
+	});
+
+	REQUIRE(std::ranges::all_of(seen, [](size_t n) { return n == 1u; }));
+}
+
+TEST_CASE("multi-buffer sha256 is same as sha256", "[multi-buffer]") {
+	for (size_t count: {0u, 1u, 2u, 8u, 9u, 200u}) {
+		check_lanes<cthash::sha256>(count);
+	}
+}
+
+TEST_CASE("multi-buffer sha224 is same as sha224", "[multi-buffer]") {
+	check_lanes<cthash::sha224>(77u);
+}
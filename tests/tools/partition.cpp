@@ -0,0 +1,108 @@
+#include "../../tools/partition.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static auto random_keys(size_t count) {
+	auto rng = std::mt19937_64{7u};
+	std::vector<uint64_t> out(count);
+	for (auto & k: out) {
+		k = rng();
+	}
+	return out;
+}
+
+// reference value hashed as 8 bytes of the key
+static auto expected_hash(uint64_t key, uint64_t seed) {
+	const auto digest = cthash::xxhash64{seed}.update(std::span(reinterpret_cast<const std::byte *>(&key), sizeof(uint64_t))).final();
+	return cthash::cast_from_bytes<uint64_t>(std::span<const std::byte, 8>(digest.data(), 8u));
+}
+
+template <typename F> static void check_hashes(F && hash_keys) {
+	// lengths which aren't multiples of lanes leave a tail for scalar code
+	for (const size_t count: {0u, 1u, 3u, 4u, 8u, 13u, 64u, 1001u}) {
+		const auto keys = random_keys(count);
+
+		for (const uint64_t seed: {uint64_t{0u}, uint64_t{42u}, ~uint64_t{0u}}) {
+			std::vector<uint64_t> out(count);
+			hash_keys(keys, out, seed);
+
+			for (size_t i = 0; i != count; ++i) {
+				REQUIRE(out[i] == expected_hash(keys[i], seed));
+			}
+		}
+	}
+}
+
+TEST_CASE("xxhash64 of keys is same as xxhash64", "[partition]") {
+	check_hashes([](std::span<const uint64_t> keys, std::span<uint64_t> out, uint64_t seed) {
+		for (size_t i = 0; i != keys.size(); ++i) {
+			out[i] = cthash::tools::partition_detail::xxhash64_key(keys[i], seed);
+		}
+	});
+
+	check_hashes([](std::span<const uint64_t> keys, std::span<uint64_t> out, uint64_t seed) { cthash::tools::xxhash64_keys(keys, out, seed); });
+}
+
+#ifdef CTHASH_TOOLS_PARTITION_X86
+// kernels are called directly, only those which the CPU can run
+TEST_CASE("xxhash64 of keys in AVX2 lanes is same as xxhash64", "[partition]") {
+	if (__builtin_cpu_supports("avx2")) {
+		check_hashes(cthash::tools::partition_detail::xxhash64_keys_avx2);
+	}
+}
+
+TEST_CASE("xxhash64 of keys in AVX-512 lanes is same as xxhash64", "[partition]") {
+	if (__builtin_cpu_supports("avx512dq")) {
+		check_hashes(cthash::tools::partition_detail::xxhash64_keys_avx512);
+	}
+}
+#endif
+
+static auto naive(std::span<const uint64_t> keys, unsigned bits) {
+	std::vector<std::vector<uint32_t>> out(size_t{1} << bits);
+	for (size_t i = 0; i != keys.size(); ++i) {
+		const auto h = expected_hash(keys[i], 0u);
+		out[(bits == 0u) ? 0u : static_cast<size_t>(h >> (64u - bits))].push_back(static_cast<uint32_t>(i));
+	}
+	return out;
+}
+
+static void check_partitions(std::span<const uint64_t> keys, unsigned bits, const cthash::tools::partition_tuning & tuning) {
+	const auto expected = naive(keys, bits);
+	REQUIRE(cthash::tools::partition_single_pass(keys, bits, tuning) == expected);
+
+	// rows of each partition stay in order
+	const auto two = cthash::tools::partition_two_pass(keys, bits, tuning);
+	REQUIRE(two.count() == expected.size());
+	REQUIRE(two.rows.size() == keys.size());
+	for (size_t p = 0; p != expected.size(); ++p) {
+		REQUIRE(std::ranges::equal(two.partition(p), expected[p]));
+	}
+}
+
+TEST_CASE("partitioning with one round", "[partition]") {
+	const auto keys = random_keys(10'000u);
+	const auto tuning = cthash::tools::partition_tuning{};
+
+	for (const unsigned bits: {0u, 1u, 4u, 8u}) {
+		REQUIRE(bits <= tuning.buffered_bits(keys.size() * sizeof(uint32_t)));
+		check_partitions(keys, bits, tuning);
+	}
+}
+
+TEST_CASE("partitioning with second round", "[partition]") {
+	// tiny cache and TLB allow only two bits to be written at once, rest is split by second round (and without
+	// write-combining in single pass)
+	const auto tuning = cthash::tools::partition_tuning{.l1_bytes = 1024u, .l2_bytes = 256u, .tlb_entries = 2u, .stlb_entries = 4u, .page_bytes = 4096u};
+	REQUIRE(tuning.buffered_bits(0u) == 2u);
+
+	for (const size_t count: {0u, 1u, 100u, 10'000u}) {
+		const auto keys = random_keys(count);
+
+		for (const unsigned bits: {3u, 6u, 10u}) {
+			check_partitions(keys, bits, tuning);
+		}
+	}
+}
@@ -0,0 +1,206 @@
+#include "../../tools/smt.hpp"
+#include <cthash/sha2/sha256.hpp>
+#include <cthash/sha3/sha3-256.hpp>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+// root of the full tree of depth 256 computed level by level without any shortcut of the tree itself
+template <typename Hasher> struct naive_tree {
+	using digest = cthash::tools::smt_digest<Hasher>;
+	using key_type = std::array<std::byte, 32>;
+	using entries = std::vector<std::pair<key_type, std::vector<std::byte>>>;
+
+	std::vector<digest> empty = [] {
+		std::vector<digest> out(257u);
+		for (size_t level = 256u; level-- != 0u;) {
+			out[level] = node(out[level + 1u], out[level + 1u]);
+		}
+		return out;
+	}();
+
+	static auto node(const digest & left, const digest & right) -> digest {
+		const auto prefix = std::array{std::byte{0x01}};
+		return Hasher{}.update(std::span<const std::byte>(prefix)).update(std::span<const std::byte>(left)).update(std::span<const std::byte>(right)).final();
+	}
+
+	static auto leaf(const key_type & key, std::span<const std::byte> value) -> digest {
+		const auto prefix = std::array{std::byte{0x00}};
+		return Hasher{}.update(std::span<const std::byte>(prefix)).update(std::span<const std::byte>(key)).update(value).final();
+	}
+
+	// `sorted` are all entries below the node at `level`
+	auto subtree(unsigned level, std::span<const typename entries::value_type> sorted) const -> digest {
+		if (sorted.empty()) {
+			return empty[level];
+		} else if (level == 256u) {
+			return leaf(sorted.front().first, sorted.front().second);
+		}
+
+		const auto middle = std::ranges::partition_point(sorted, [level](const auto & e) { return ((std::to_integer<unsigned>(e.first[level / 8u]) >> (7u - level % 8u)) & 1u) == 0u; });
+		const auto index = static_cast<size_t>(middle - sorted.begin());
+		return node(subtree(level + 1u, sorted.first(index)), subtree(level + 1u, sorted.subspan(index)));
+	}
+
+	auto root(const std::map<key_type, std::vector<std::byte>> & model) const -> digest {
+		const auto sorted = entries(model.begin(), model.end());
+		return subtree(0u, sorted);
+	}
+};
+
+auto random_key(std::mt19937 & rng) {
+	std::array<std::byte, 32> out{};
+	for (auto & b: out) {
+		b = static_cast<std::byte>(rng());
+	}
+	return out;
+}
+
+} // namespace
+
+TEMPLATE_TEST_CASE("sparse merkle tree has same root as the full tree", "[smt]", cthash::sha256, cthash::sha3_256) {
+	using tree_type = cthash::tools::sparse_merkle_tree<TestType>;
+	using key_type = typename tree_type::key_type;
+
+	const naive_tree<TestType> naive{};
+	REQUIRE(tree_type{}.root() == naive.empty[0]);
+
+	auto rng = std::mt19937{5u};
+
+	// keys are mostly reused (so writes replace and erase existing leaves), some of them differ only in the last bits
+	std::vector<key_type> keys;
+	for (size_t i = 0; i != 40u; ++i) {
+		keys.push_back(random_key(rng));
+	}
+	for (size_t i = 0; i != 8u; ++i) {
+		auto near = keys[i];
+		near[31] ^= static_cast<std::byte>(1u << (i % 8u));
+		keys.push_back(near);
+	}
+
+	tree_type tree{};
+	std::map<key_type, std::vector<std::byte>> model{};
+	cthash::tools::thread_pool pool{2u};
+
+	for (size_t round = 0; round != 60u; ++round) {
+		std::vector<std::vector<std::byte>> values;
+		std::vector<typename tree_type::write> batch;
+
+		const size_t count = 1u + rng() % 40u;
+		values.reserve(count);
+
+		for (size_t i = 0; i != count; ++i) {
+			const auto key = (rng() % 8u == 0u) ? random_key(rng) : keys[rng() % keys.size()];
+			const bool erase = (rng() % 4u == 0u);
+
+			auto & value = values.emplace_back(rng() % 50u);
+			for (auto & b: value) {
+				b = static_cast<std::byte>(rng());
+			}
+
+			batch.push_back({.key = key, .value = value, .erase = erase});
+
+			// later writes of the same key win
+			if (erase) {
+				model.erase(key);
+			} else {
+				model[key] = value;
+			}
+		}
+
+		tree.update(batch, (round % 2u) ? &pool : nullptr);
+
+		REQUIRE(tree.size() == model.size());
+		REQUIRE(tree.root() == naive.root(model));
+
+		for (const auto & [key, value]: model) {
+			const auto found = tree.find(key);
+			REQUIRE(found);
+			REQUIRE(std::ranges::equal(*found, value));
+		}
+	}
+
+	// erasing everything gives the empty tree
+	std::vector<typename tree_type::write> erases;
+	for (const auto & entry: model) {
+		erases.push_back({.key = entry.first, .value = {}, .erase = true});
+	}
+
+	tree.update(erases, &pool);
+	REQUIRE(tree.size() == 0u);
+	REQUIRE(tree.root() == naive.empty[0]);
+}
+
+TEMPLATE_TEST_CASE("sparse merkle tree proofs", "[smt]", cthash::sha256, cthash::sha3_256) {
+	using tree_type = cthash::tools::sparse_merkle_tree<TestType>;
+	using key_type = typename tree_type::key_type;
+
+	auto rng = std::mt19937{9u};
+	tree_type tree{};
+
+	std::vector<key_type> present;
+	std::vector<std::vector<std::byte>> values;
+	std::vector<typename tree_type::write> batch;
+
+	for (size_t i = 0; i != 100u; ++i) {
+		present.push_back(random_key(rng));
+		values.emplace_back(1u + i % 30u, static_cast<std::byte>(i));
+	}
+
+	// a pair of keys which differ only in the last bit
+	present.push_back(present[0]);
+	present.back()[31] ^= std::byte{1};
+	values.emplace_back(3u, std::byte{0xAB});
+
+	for (size_t i = 0; i != present.size(); ++i) {
+		batch.push_back({.key = present[i], .value = values[i]});
+	}
+
+	tree.update(batch);
+	const auto root = tree.root();
+
+	for (size_t i = 0; i != present.size(); ++i) {
+		const auto proof = tree.prove(present[i]);
+		REQUIRE(tree_type::verify(root, present[i], values[i], proof));
+
+		// other value and absence are rejected
+		REQUIRE(not tree_type::verify(root, present[i], values[(i + 1u) % values.size()], proof));
+		REQUIRE(not tree_type::verify(root, present[i], std::nullopt, proof));
+
+		auto tampered = proof;
+		tampered.siblings.front().data()[0] ^= std::byte{1};
+		REQUIRE(not tree_type::verify(root, present[i], values[i], tampered));
+
+		auto shortened = proof;
+		shortened.siblings.pop_back();
+		REQUIRE(not tree_type::verify(root, present[i], values[i], shortened));
+	}
+
+	for (size_t i = 0; i != 100u; ++i) {
+		auto absent = random_key(rng);
+		if (i % 10u == 0u) {
+			// next to a present key
+			absent = present[i];
+			absent[31] ^= std::byte{2};
+		}
+
+		const auto proof = tree.prove(absent);
+		REQUIRE(tree_type::verify(root, absent, std::nullopt, proof));
+		REQUIRE(not tree_type::verify(root, absent, values[0], proof));
+
+		if (not proof.siblings.empty()) {
+			auto tampered = proof;
+			tampered.siblings.back().data()[0] ^= std::byte{1};
+			REQUIRE(not tree_type::verify(root, absent, std::nullopt, tampered));
+		}
+	}
+
+	// proofs in the empty tree
+	const auto empty = tree_type{};
+	REQUIRE(tree_type::verify(empty.root(), present[0], std::nullopt, empty.prove(present[0])));
+	REQUIRE(not tree_type::verify(empty.root(), present[0], values[0], empty.prove(present[0])));
+}
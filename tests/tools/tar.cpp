@@ -0,0 +1,273 @@
+#include "../../tools/tar.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct member_record {
+	std::string path;
+	std::string link_target;
+	char type;
+	std::string data;
+};
+
+struct collector {
+	std::vector<member_record> members{};
+
+	void begin(const cthash::tools::tar_member & member) {
+		members.push_back({member.path, member.link_target, member.type, {}});
+	}
+
+	void data(std::span<const std::byte> in) {
+		members.back().data.append(reinterpret_cast<const char *>(in.data()), in.size());
+	}
+
+	void end() { }
+};
+
+// archive is built block by block, headers get the checksum when they are added
+struct archive_builder {
+	std::string out{};
+
+	static void put(std::string & block, size_t offset, std::string_view value) {
+		block.replace(offset, value.size(), value);
+	}
+
+	static auto octal(uint64_t value, size_t width) -> std::string {
+		std::string digits(width - 1u, '0');
+		for (size_t i = width - 1u; i != 0u; --i, value >>= 3u) {
+			digits[i - 1u] = static_cast<char>('0' + (value & 7u));
+		}
+		return digits;
+	}
+
+	auto header(std::string_view name, uint64_t size, char type, std::string_view link = {}, bool gnu = false) -> std::string {
+		std::string block(cthash::tools::tar_reader::block_size, '\0');
+		put(block, 0u, name);
+		put(block, 100u, "0000644");
+		put(block, 124u, octal(size, 12u));
+		block[156u] = type;
+		put(block, 157u, link);
+		put(block, 257u, gnu ? std::string_view("ustar  ", 8u) : std::string_view("ustar\0" "00", 8u));
+
+		unsigned sum = 0u;
+		put(block, 148u, "        ");
+		for (const char c: block) {
+			sum += static_cast<unsigned char>(c);
+		}
+		put(block, 148u, octal(sum, 7u));
+		return block;
+	}
+
+	void content(std::string_view data) {
+		out += data;
+		out.append(cthash::tools::tar_reader::padding_of(data.size()), '\0');
+	}
+
+	auto member(std::string_view name, std::string_view data, char type = '0', std::string_view link = {}) -> archive_builder & {
+		out += header(name, data.size(), type, link);
+		content(data);
+		return *this;
+	}
+
+	auto pax(std::initializer_list<std::pair<std::string_view, std::string_view>> records) -> archive_builder & {
+		std::string data;
+		for (const auto & [key, value]: records) {
+			// length counts itself, so the number of its digits is found by trying
+			const size_t rest = key.size() + value.size() + 3u;
+			size_t length = rest + 1u;
+			while (std::to_string(length).size() + rest != length) {
+				++length;
+			}
+			data += std::to_string(length) + ' ' + std::string(key) + '=' + std::string(value) + '\n';
+		}
+		out += header("PaxHeader", data.size(), 'x');
+		content(data);
+		return *this;
+	}
+
+	auto gnu_long(char type, std::string_view value) -> archive_builder & {
+		const auto data = std::string(value) + '\0';
+		out += header("././@LongLink", data.size(), type, {}, true);
+		content(data);
+		return *this;
+	}
+
+	auto finish() -> std::string {
+		out.append(2u * cthash::tools::tar_reader::block_size, '\0');
+		return out;
+	}
+};
+
+auto bytes_of(std::string_view in) {
+	return std::span<const std::byte>(reinterpret_cast<const std::byte *>(in.data()), in.size());
+}
+
+// feeds archive in pieces of `piece` bytes (the last one can be shorter)
+auto parse(std::string_view archive, size_t piece, cthash::tools::tar_reader & reader) -> std::vector<member_record> {
+	collector c{};
+	for (size_t pos = 0u; pos < archive.size(); pos += piece) {
+		if (not reader.feed(bytes_of(archive.substr(pos, piece)), c)) {
+			break;
+		}
+	}
+	return c.members;
+}
+
+auto parse(std::string_view archive, size_t piece = SIZE_MAX) -> std::vector<member_record> {
+	cthash::tools::tar_reader reader{};
+	auto out = parse(archive, piece, reader);
+	REQUIRE(reader.complete());
+	return out;
+}
+
+} // namespace
+
+TEST_CASE("tar members are parsed", "[tar]") {
+	const auto archive = archive_builder{}.member("a.txt", "hello").member("dir/", "", '5').member("b.bin", std::string(1000u, 'x')).member("hard", "", '1', "a.txt").finish();
+	const auto members = parse(archive);
+
+	REQUIRE(members.size() == 4u);
+	REQUIRE(members[0].path == "a.txt");
+	REQUIRE(members[0].data == "hello");
+	REQUIRE(members[1].type == '5');
+	REQUIRE(members[2].data == std::string(1000u, 'x'));
+	REQUIRE(members[3].type == '1');
+	REQUIRE(members[3].link_target == "a.txt");
+	REQUIRE(members[3].data.empty());
+
+	REQUIRE(cthash::tools::tar_member{.path = {}, .link_target = {}, .type = '0', .size = 0u}.regular());
+	REQUIRE(cthash::tools::tar_member{.path = {}, .link_target = {}, .type = '1', .size = 0u}.hardlink());
+	REQUIRE(not cthash::tools::tar_member{.path = {}, .link_target = {}, .type = '1', .size = 0u}.regular());
+}
+
+TEST_CASE("tar pax records override path and size", "[tar]") {
+	const auto long_path = std::string(150u, 'p') + "/" + std::string(120u, 'q');
+
+	// the header says 3 bytes, pax record says 600
+	auto builder = archive_builder{};
+	builder.pax({{"path", long_path}, {"size", "600"}, {"mtime", "1.5"}});
+	builder.out += builder.header("short", 3u, '0');
+	builder.content(std::string(600u, 'd'));
+	builder.pax({{"linkpath", long_path}});
+	builder.member("link", "", '1', "ignored");
+	builder.member("next", "abc");
+
+	const auto members = parse(builder.finish());
+
+	REQUIRE(members.size() == 3u);
+	REQUIRE(members[0].path == long_path);
+	REQUIRE(members[0].data == std::string(600u, 'd'));
+	REQUIRE(members[1].link_target == long_path);
+	REQUIRE(members[2].path == "next");
+	REQUIRE(members[2].data == "abc");
+}
+
+TEST_CASE("tar GNU long names", "[tar]") {
+	const auto long_name = std::string(300u, 'n');
+	const auto long_link = std::string(200u, 'l');
+
+	const auto archive = archive_builder{}.gnu_long('L', long_name).member("trimmed", "data").gnu_long('K', long_link).gnu_long('L', long_name + "2").member("trimmed2", "", '1', "trimmed-link").member("plain", "x").finish();
+	const auto members = parse(archive);
+
+	REQUIRE(members.size() == 3u);
+	REQUIRE(members[0].path == long_name);
+	REQUIRE(members[0].data == "data");
+	REQUIRE(members[1].path == long_name + "2");
+	REQUIRE(members[1].link_target == long_link);
+	REQUIRE(members[2].path == "plain");
+}
+
+TEST_CASE("tar header with bad checksum is rejected", "[tar]") {
+	auto archive = archive_builder{}.member("a", "hello").member("b", "world").finish();
+	archive[512u + 512u + 10u] ^= 1; // name of the second member
+
+	cthash::tools::tar_reader reader{};
+	const auto members = parse(archive, SIZE_MAX, reader);
+
+	REQUIRE(members.size() == 1u);
+	REQUIRE(reader.current == cthash::tools::tar_reader::state::error);
+	REQUIRE(reader.error == "invalid header checksum");
+}
+
+TEST_CASE("tar pax numbers which overflow are rejected", "[tar]") {
+	const auto rejected = [](std::string_view records, std::string_view error) {
+		auto builder = archive_builder{};
+		builder.out += builder.header("PaxHeader", records.size(), 'x');
+		builder.content(records);
+		builder.member("a", "hello");
+
+		cthash::tools::tar_reader reader{};
+		const auto members = parse(builder.finish(), SIZE_MAX, reader);
+
+		REQUIRE(members.empty());
+		REQUIRE(reader.current == cthash::tools::tar_reader::state::error);
+		REQUIRE(reader.error == error);
+	};
+
+	// 2^64 + 28 would wrap around to the real length of the record
+	rejected("18446744073709551644 path=x\n", "invalid pax record");
+	rejected("11 size=-1\n", "invalid pax size");
+	rejected("14 size=0x100\n", "invalid pax size");
+	// 2^64 + 1 would wrap around to a size of one byte
+	rejected("29 size=18446744073709551617\n", "invalid pax size");
+
+	// the largest size is still a number (but the archive has no such content)
+	auto builder = archive_builder{};
+	builder.pax({{"size", "18446744073709551615"}});
+	builder.out += builder.header("large", 0u, '0');
+
+	cthash::tools::tar_reader reader{};
+	parse(builder.finish(), SIZE_MAX, reader);
+	REQUIRE(reader.error.empty());
+	REQUIRE(not reader.complete());
+}
+
+TEST_CASE("tar truncated archive isn't complete", "[tar]") {
+	const auto archive = archive_builder{}.member("a", std::string(700u, 'a')).finish();
+
+	cthash::tools::tar_reader reader{};
+	parse(std::string_view(archive).substr(0u, 800u), SIZE_MAX, reader);
+	REQUIRE(not reader.complete());
+}
+
+TEST_CASE("tar fed in pieces of any size", "[tar]") {
+	auto builder = archive_builder{};
+	builder.pax({{"path", std::string(130u, 'x')}}).member("a", std::string(513u, 'a'));
+	builder.gnu_long('L', std::string(101u, 'y')).member("b", "");
+	builder.member("c", std::string(1024u, 'c'));
+	const auto archive = builder.finish();
+
+	const auto expected = parse(archive);
+	REQUIRE(expected.size() == 3u);
+
+	const auto same = [&](const std::vector<member_record> & members) {
+		if (members.size() != expected.size()) {
+			return false;
+		}
+		for (size_t i = 0; i != members.size(); ++i) {
+			if (members[i].path != expected[i].path || members[i].data != expected[i].data || members[i].type != expected[i].type) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	for (size_t piece = 1u; piece <= 1100u; ++piece) {
+		INFO("piece " << piece);
+		REQUIRE(same(parse(archive, piece)));
+	}
+
+	// and split into two pieces at every position
+	for (size_t split = 1u; split != archive.size(); ++split) {
+		INFO("split at " << split);
+		cthash::tools::tar_reader reader{};
+		collector c{};
+		REQUIRE(reader.feed(bytes_of(std::string_view(archive).substr(0u, split)), c));
+		REQUIRE(reader.feed(bytes_of(std::string_view(archive).substr(split)), c));
+		REQUIRE(reader.complete());
+		REQUIRE(same(c.members));
+	}
+}
@@ -0,0 +1,43 @@
+#include "../../tools/thread-pool.hpp"
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <vector>
+
+TEST_CASE("chunks cover all indices once", "[thread-pool]") {
+	cthash::tools::thread_pool pool{3u};
+
+	for (const size_t count: {0u, 1u, 7u, 100u, 1000u}) {
+		for (const size_t chunk: {1u, 3u, 64u, 5000u}) {
+			std::vector<std::atomic<unsigned>> seen(count);
+			std::atomic<bool> oversized{false};
+
+			// assertions aren't thread safe, so workers only record what they saw
+			cthash::tools::for_each_chunk(&pool, count, chunk, [&](size_t begin, size_t end) {
+				if (end - begin > chunk) {
+					oversized = true;
+				}
+				for (size_t i = begin; i != end; ++i) {
+					++seen[i];
+				}
+			});
+
+			REQUIRE(not oversized);
+			for (const auto & s: seen) {
+				REQUIRE(s.load() == 1u);
+			}
+		}
+	}
+}
+
+TEST_CASE("chunks can be run from a worker of the same pool", "[thread-pool]") {
+	// the only worker runs the outer task, so the inner chunks are all done by it
+	cthash::tools::thread_pool pool{1u};
+	std::atomic<size_t> sum{0u};
+
+	pool.submit([&](size_t) {
+		cthash::tools::for_each_index(&pool, 100u, 10u, [&](size_t i) { sum += i; });
+	});
+
+	pool.wait();
+	REQUIRE(sum.load() == 4950u);
+}
@@ -0,0 +1,23 @@
+#include "../../tools/throttle.hpp"
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("sizes of rate limits", "[throttle]") {
+	REQUIRE(cthash::tools::parse_size("0") == 0.0);
+	REQUIRE(cthash::tools::parse_size("512") == 512.0);
+	REQUIRE(cthash::tools::parse_size("1.5K") == 1536.0);
+	REQUIRE(cthash::tools::parse_size("5M") == 5.0 * 1024.0 * 1024.0);
+	REQUIRE(cthash::tools::parse_size("2g") == 2.0 * 1024.0 * 1024.0 * 1024.0);
+	REQUIRE(cthash::tools::parse_size("1T") == 1024.0 * 1024.0 * 1024.0 * 1024.0);
+
+	REQUIRE(not cthash::tools::parse_size(""));
+	REQUIRE(not cthash::tools::parse_size("M"));
+	REQUIRE(not cthash::tools::parse_size("-5M"));
+	REQUIRE(not cthash::tools::parse_size(" 5M"));
+	REQUIRE(not cthash::tools::parse_size("5M "));
+	REQUIRE(not cthash::tools::parse_size("5MB"));
+	REQUIRE(not cthash::tools::parse_size("nan"));
+	REQUIRE(not cthash::tools::parse_size("inf"));
+	REQUIRE(not cthash::tools::parse_size("infinity"));
+	REQUIRE(not cthash::tools::parse_size("1e400"));
+	REQUIRE(not cthash::tools::parse_size("1e308T"));
+}
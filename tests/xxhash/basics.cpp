@@ -192,6 +192,13 @@ TEST_CASE("xxhash_fnc basics", "[xxh]") {
 			REQUIRE(h2.final() == "bd6f22acc408272d"_xxh64);
 		}
 	}
+
+	SECTION("single update with more than 255 bytes") {
+		const auto arr = array_of<1000>(std::byte(0x01));
+
+		REQUIRE(cthash::xxhash<32>{}.update(runtime_pass(arr)).final() == cthash::simple<cthash::xxhash<32>>(runtime_pass(arr)));
+		REQUIRE(cthash::xxhash<64>{}.update(runtime_pass(arr)).final() == cthash::simple<cthash::xxhash<64>>(runtime_pass(arr)));
+	}
 }
 
 TEST_CASE("xxhash_fnc benchmarks", "[xxh]") {
@@ -0,0 +1,71 @@
+#include "../internal/support.hpp"
+#include <cthash/xxhash.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+using namespace cthash::literals;
+
+static auto pattern(size_t n) {
+	std::vector<std::byte> out(n);
+	for (size_t i = 0; i != n; ++i) {
+		out[i] = static_cast<std::byte>(i * 7u + 3u);
+	}
+	return out;
+}
+
+TEST_CASE("segmented xxhash64 basics", "[xxh-seg]") {
+	// empty input has no segments
+	constexpr auto v1 = cthash::segmented_xxhash64<>{}.update("").final();
+	REQUIRE(v1 == "ef46db3751d8e999"_xxh64_seg);
+
+	// one segment: xxhash64 of xxhash64("abc") = 44bc2cf5ad770999
+	constexpr auto v2 = cthash::segmented_xxhash64<>{}.update("abc").final();
+	auto v2r = cthash::segmented_xxhash64<>{}.update(runtime_pass("abc")).final();
+	REQUIRE(v2 == "f755aa496c52f6df"_xxh64_seg);
+	REQUIRE(v2 == v2r);
+
+	const auto digest = "44bc2cf5ad770999"_xxh64;
+	REQUIRE(cthash::xxhash64{}.update(std::span<const std::byte>(digest.data(), digest.size())).final() == "f755aa496c52f6df"_xxh64);
+}
+
+TEST_CASE("segmented xxhash64 of more segments", "[xxh-seg]") {
+	const auto in = pattern(3u * 1024u * 1024u + 5u);
+
+	REQUIRE(cthash::segmented_xxhash64<>{}.update(std::span(in)).final() == "cead428acacd2529"_xxh64_seg);
+	REQUIRE(cthash::segmented_xxhash64<>{}.update(std::span(in).first(1024u * 1024u)).final() == "775616a5b82b579f"_xxh64_seg);
+}
+
+TEST_CASE("segmented xxhash64 doesn't depend on how input is split", "[xxh-seg]") {
+	const auto in = pattern(1000u);
+	const auto expected = cthash::segmented_xxhash64<64>{}.update(std::span(in)).final();
+
+	for (size_t step: {1u, 7u, 63u, 64u, 65u, 333u}) {
+		auto h = cthash::segmented_xxhash64<64>{};
+		for (size_t pos = 0; pos < in.size(); pos += step) {
+			h.update(std::span(in).subspan(pos, std::min(step, in.size() - pos)));
+		}
+		REQUIRE(h.final() == expected);
+	}
+
+	// segments hashed elsewhere and added in order
+	auto combined = cthash::segmented_xxhash64<64>{};
+	size_t pos = 0;
+	for (; pos + 64u <= in.size(); pos += 64u) {
+		combined.add_segment(cthash::xxhash64{}.update(std::span(in).subspan(pos, 64u)).final());
+	}
+	combined.update(std::span(in).subspan(pos));
+	REQUIRE(combined.final() == expected);
+
+	// midstate in the middle of segment
+	auto first = cthash::segmented_xxhash64<64>{};
+	first.update(std::span(in).first(500u));
+	auto second = cthash::segmented_xxhash64<64>{};
+	REQUIRE(second.restore(first.midstate()));
+	second.update(std::span(in).subspan(500u));
+	REQUIRE(second.final() == expected);
+}
+
+TEST_CASE("segmented xxhash64 with small segments", "[xxh-seg]") {
+	const auto in = pattern(100u);
+	REQUIRE(cthash::segmented_xxhash64<16>{}.update(std::span(in)).final() == "86efb903fb82aa8c"_xxh64_seg);
+}
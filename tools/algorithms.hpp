@@ -0,0 +1,232 @@
+#ifndef CTHASH_TOOLS_ALGORITHMS_HPP
+#define CTHASH_TOOLS_ALGORITHMS_HPP
+
+#include "multi-buffer.hpp"
+#include <cthash/cthash.hpp>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace cthash::tools {
+
+// digest of any supported algorithm (longest is shake-*/2048)
+struct digest_value {
+	static constexpr size_t capacity = 256u;
+
+	std::array<std::byte, capacity> buffer{};
+	size_t length{0u};
+
+	constexpr digest_value() noexcept = default;
+
+	template <typename Value> explicit constexpr digest_value(const Value & value) noexcept: length{value.size()} {
+		static_assert(sizeof(Value) <= capacity);
+		std::copy(value.begin(), value.end(), buffer.begin());
+	}
+
+	explicit digest_value(std::span<const std::byte> in) noexcept: length{std::min(in.size(), capacity)} {
+		std::copy_n(in.data(), length, buffer.begin());
+	}
+
+	auto get_span() const noexcept {
+		return std::span<const std::byte>(buffer.data(), length);
+	}
+
+	friend bool operator==(const digest_value & lhs, const digest_value & rhs) noexcept {
+		return std::ranges::equal(lhs.get_span(), rhs.get_span());
+	}
+
+	template <typename CharT, typename Traits> friend auto & operator<<(std::basic_ostream<CharT, Traits> & os, const digest_value & val) {
+		const auto s = val.get_span();
+		return internal::push_to_stream_as<internal::byte_hexdec_value>(s.begin(), s.end(), os);
+	}
+};
+
+// type erased streaming hasher, so the tools can select algorithm at runtime
+struct streaming_hasher {
+	virtual ~streaming_hasher() = default;
+	virtual void update(std::span<const std::byte> in) noexcept = 0;
+	virtual digest_value final() noexcept = 0;
+
+	// serialized intermediate state (see `midstate()` of each hasher)
+	virtual std::vector<std::byte> midstate() const = 0;
+	virtual bool restore(std::span<const std::byte> in) noexcept = 0;
+
+	// algorithms made of independent segments (zero size for others): segment can be hashed by other hasher
+	// from `create_segment()` and its digest added in order when no partial segment is pending
+	virtual size_t segment_size() const noexcept {
+		return 0u;
+	}
+
+	virtual std::unique_ptr<streaming_hasher> create_segment() const {
+		return nullptr;
+	}
+
+	virtual void add_segment(const digest_value &) noexcept { }
+};
+
+template <typename Hasher> auto midstate_of(const Hasher & h) -> std::vector<std::byte> {
+	const auto r = h.midstate();
+	return std::vector<std::byte>(r.begin(), r.end());
+}
+
+template <typename Hasher> bool restore_into(Hasher & h, std::span<const std::byte> in) noexcept {
+	if (in.size() != Hasher::midstate_size) {
+		return false;
+	}
+
+	return h.restore(in.first<Hasher::midstate_size>());
+}
+
+template <typename Hasher> struct fixed_streaming_hasher final: streaming_hasher {
+	Hasher hasher{};
+
+	void update(std::span<const std::byte> in) noexcept override {
+		hasher.update(in);
+	}
+
+	digest_value final() noexcept override {
+		return digest_value{hasher.final()};
+	}
+
+	std::vector<std::byte> midstate() const override {
+		return midstate_of(hasher);
+	}
+
+	bool restore(std::span<const std::byte> in) noexcept override {
+		return restore_into(hasher, in);
+	}
+};
+
+template <typename Hasher> struct segmented_streaming_hasher final: streaming_hasher {
+	Hasher hasher{};
+
+	void update(std::span<const std::byte> in) noexcept override {
+		hasher.update(in);
+	}
+
+	digest_value final() noexcept override {
+		return digest_value{hasher.final()};
+	}
+
+	std::vector<std::byte> midstate() const override {
+		return midstate_of(hasher);
+	}
+
+	bool restore(std::span<const std::byte> in) noexcept override {
+		return restore_into(hasher, in);
+	}
+
+	size_t segment_size() const noexcept override {
+		return Hasher::segment_size;
+	}
+
+	std::unique_ptr<streaming_hasher> create_segment() const override {
+		return std::make_unique<fixed_streaming_hasher<decltype(hasher.segment)>>();
+	}
+
+	void add_segment(const digest_value & digest) noexcept override {
+		decltype(hasher.segment.final()) value;
+		std::copy_n(digest.get_span().begin(), std::min(value.size(), digest.length), value.begin());
+		hasher.add_segment(value);
+	}
+};
+
+template <typename Hasher, size_t Bits> struct variable_streaming_hasher final: streaming_hasher {
+	Hasher hasher{};
+
+	void update(std::span<const std::byte> in) noexcept override {
+		hasher.update(in);
+	}
+
+	digest_value final() noexcept override {
+		return digest_value{hasher.template final<Bits>()};
+	}
+
+	std::vector<std::byte> midstate() const override {
+		return midstate_of(hasher);
+	}
+
+	bool restore(std::span<const std::byte> in) noexcept override {
+		return restore_into(hasher, in);
+	}
+};
+
+struct algorithm {
+	std::string_view name;
+	std::unique_ptr<streaming_hasher> (*create)();
+	// digests of many small inputs at once (see multi-buffer.hpp), only some algorithms have it
+	void (*hash_many)(std::span<const std::span<const std::byte>> inputs, std::span<digest_value> out){nullptr};
+
+	template <typename Hasher> static void hash_lanes(std::span<const std::span<const std::byte>> inputs, std::span<digest_value> out) {
+		multi_buffer<Hasher>::hash(inputs, [&](size_t i, auto digest) { out[i] = digest_value{std::span<const std::byte>(digest)}; });
+	}
+
+	template <typename Hasher> static constexpr auto of(std::string_view name) noexcept -> algorithm {
+		if constexpr (requires { Hasher::segment_size; }) {
+			return {name, +[]() -> std::unique_ptr<streaming_hasher> { return std::make_unique<segmented_streaming_hasher<Hasher>>(); }};
+		} else if constexpr (requires { multi_buffer<Hasher>::lanes; }) {
+			return {name, +[]() -> std::unique_ptr<streaming_hasher> { return std::make_unique<fixed_streaming_hasher<Hasher>>(); }, &hash_lanes<Hasher>};
+		} else {
+			return {name, +[]() -> std::unique_ptr<streaming_hasher> { return std::make_unique<fixed_streaming_hasher<Hasher>>(); }};
+		}
+	}
+
+	template <typename Hasher, size_t Bits> static constexpr auto of(std::string_view name) noexcept -> algorithm {
+		return {name, +[]() -> std::unique_ptr<streaming_hasher> { return std::make_unique<variable_streaming_hasher<Hasher, Bits>>(); }};
+	}
+
+	auto digest_of(std::span<const std::byte> in) const -> digest_value {
+		const auto h = create();
+		h->update(in);
+		return h->final();
+	}
+};
+
+inline const auto algorithms = std::array{
+	algorithm::of<cthash::sha1>("sha-1"),
+	algorithm::of<cthash::sha224>("sha-224"),
+	algorithm::of<cthash::sha256>("sha-256"),
+	algorithm::of<cthash::sha384>("sha-384"),
+	algorithm::of<cthash::sha512>("sha-512"),
+	algorithm::of<cthash::sha512t<224>>("sha-512/224"),
+	algorithm::of<cthash::sha512t<256>>("sha-512/256"),
+	algorithm::of<cthash::sha3_224>("sha3-224"),
+	algorithm::of<cthash::sha3_256>("sha3-256"),
+	algorithm::of<cthash::sha3_384>("sha3-384"),
+	algorithm::of<cthash::sha3_512>("sha3-512"),
+	algorithm::of<cthash::shake128, 32>("shake-128/32"),
+	algorithm::of<cthash::shake128, 64>("shake-128/64"),
+	algorithm::of<cthash::shake128, 128>("shake-128/128"),
+	algorithm::of<cthash::shake128, 256>("shake-128/256"),
+	algorithm::of<cthash::shake128, 512>("shake-128/512"),
+	algorithm::of<cthash::shake128, 1024>("shake-128/1024"),
+	algorithm::of<cthash::shake128, 2048>("shake-128/2048"),
+	algorithm::of<cthash::shake256, 32>("shake-256/32"),
+	algorithm::of<cthash::shake256, 64>("shake-256/64"),
+	algorithm::of<cthash::shake256, 128>("shake-256/128"),
+	algorithm::of<cthash::shake256, 256>("shake-256/256"),
+	algorithm::of<cthash::shake256, 512>("shake-256/512"),
+	algorithm::of<cthash::shake256, 1024>("shake-256/1024"),
+	algorithm::of<cthash::shake256, 2048>("shake-256/2048"),
+	algorithm::of<cthash::xxhash32>("xxhash32"),
+	algorithm::of<cthash::xxhash64>("xxhash64"),
+	algorithm::of<cthash::segmented_xxhash64<>>("xxhash64-seg"),
+};
+
+inline auto find_algorithm(std::string_view name) noexcept -> const algorithm * {
+	const auto it = std::ranges::find(algorithms, name, &algorithm::name);
+
+	if (it == algorithms.end()) {
+		return nullptr;
+	}
+
+	return &*it;
+}
+
+} // namespace cthash::tools
+
+#endif
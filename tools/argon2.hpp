@@ -0,0 +1,91 @@
+#ifndef CTHASH_TOOLS_ARGON2_HPP
+#define CTHASH_TOOLS_ARGON2_HPP
+
+#include "huge-pages.hpp"
+#include "thread-pool.hpp"
+#include <cthash/argon2/argon2id.hpp>
+#include <latch>
+#include <memory>
+#include <span>
+#include <cstdint>
+#include <string.h>
+
+namespace cthash::tools {
+
+// Argon2id with lanes in parallel: segments of all lanes in a slice are filled by the pool's workers and by the
+// calling thread, which waits for all of them (a barrier) before the next slice. Memory is mapped with huge pages
+// and kept for following derivations which need no more of it (it's cleared after each of them).
+struct argon2_context {
+	std::unique_ptr<thread_pool> pool{};
+	huge_page_memory memory{};
+	argon2::kernel compression{argon2::best_kernel()};
+
+	// with `threads` equal to 1 everything runs on the calling thread
+	explicit argon2_context(size_t threads = thread_pool::default_size()) {
+		if (threads > 1u) {
+			pool = std::make_unique<thread_pool>(threads - 1u);
+		}
+	}
+
+	auto threads() const noexcept -> size_t {
+		return pool ? pool->size() + 1u : 1u;
+	}
+
+	auto reserve(const argon2::parameters & params) -> std::span<argon2::block> {
+		const size_t bytes = argon2::memory_blocks(params) * sizeof(argon2::block);
+
+		if (memory.size < bytes) {
+			memory = huge_page_memory{};
+			memory = huge_page_memory{bytes};
+		}
+
+		if (not memory) {
+			return {};
+		}
+
+		return memory.as_span<argon2::block>().first(argon2::memory_blocks(params));
+	}
+
+	void for_each_lane(uint32_t lanes, auto && fn) {
+		if (not pool || lanes == 1u) {
+			argon2::sequential_lanes{}(lanes, fn);
+			return;
+		}
+
+		std::latch done{static_cast<std::ptrdiff_t>(lanes - 1u)};
+
+		for (uint32_t lane = 1u; lane != lanes; ++lane) {
+			pool->submit([&, lane](size_t) {
+				fn(lane);
+				done.count_down();
+			});
+		}
+
+		fn(0u);
+		done.wait();
+	}
+
+	// false when `params` aren't valid for `tag` and `salt` or memory for them can't be mapped
+	auto derive(std::span<std::byte> tag, std::span<const std::byte> password, std::span<const std::byte> salt, const argon2::parameters & params) -> bool {
+		if (not argon2::valid(params, tag.size(), salt.size())) {
+			return false;
+		}
+
+		const auto blocks = reserve(params);
+
+		if (blocks.empty()) {
+			return false;
+		}
+
+		const bool derived = cthash::argon2id(tag, password, salt, params, blocks, [this](uint32_t lanes, auto && fn) { for_each_lane(lanes, fn); }, compression);
+
+		// blocks are derived from the password, they mustn't stay in memory kept for later (explicit_bzero isn't
+		// removed as a dead store)
+		explicit_bzero(blocks.data(), blocks.size_bytes());
+		return derived;
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CTHASH_TOOLS_ARGUMENTS_HPP
+#define CTHASH_TOOLS_ARGUMENTS_HPP
+
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <cstddef>
+
+namespace cthash::tools {
+
+// whole `in` must be a decimal number which fits into T
+template <typename T> auto parse_number(std::string_view in) noexcept -> std::optional<T> {
+	T value{};
+	const auto [end, error] = std::from_chars(in.data(), in.data() + in.size(), value);
+
+	if (in.empty() || error != std::errc{} || end != in.data() + in.size()) {
+		return std::nullopt;
+	}
+
+	return value;
+}
+
+// number of jobs from "-jN" or "-j N" (then `i` is moved to the value), nothing when it isn't a positive number
+inline auto jobs_argument(std::string_view arg, int & i, int argc, char ** argv) noexcept -> std::optional<size_t> {
+	const auto value = (arg.size() > 2u) ? arg.substr(2) : ((i + 1 != argc) ? std::string_view(argv[++i]) : std::string_view{});
+	const auto jobs = parse_number<size_t>(value);
+
+	if (not jobs || *jobs == 0u) {
+		return std::nullopt;
+	}
+
+	return jobs;
+}
+
+} // namespace cthash::tools
+
+#endif
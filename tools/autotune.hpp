@@ -0,0 +1,344 @@
+#ifndef CTHASH_TOOLS_AUTOTUNE_HPP
+#define CTHASH_TOOLS_AUTOTUNE_HPP
+
+#include "algorithms.hpp"
+#include "mapped-file.hpp"
+#include "sparse.hpp"
+#include "thread-pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cthash::tools {
+
+// Settings of checksum's I/O paths which depend on the machine and the hash function. They are calibrated with
+// short measurements of each path on a scratch file which is in page cache (so they reflect CPU cost of the paths,
+// not speed of the device) and stored in a small text file, one line per CPU model, hash function and number
+// of workers, so later processes start with tuned settings and without calibration.
+struct tuning {
+	// files up to this size are read into worker's buffer in batches, larger ones are mapped
+	uint64_t small_file_limit{64u * 1024u};
+	// with fewer whole segments (of segmented hash functions) a file is hashed only by its worker
+	uint64_t min_parallel_segments{1u};
+	// larger files are read in windows with `pread` instead of being mapped
+	bool read_large{false};
+	// batches of small files with fewer inputs are hashed one by one instead of in lanes of multi-buffer kernel
+	// (for hash functions which have it)
+	uint64_t min_multi_buffer_batch{2u};
+
+	friend bool operator==(const tuning &, const tuning &) noexcept = default;
+};
+
+// $XDG_CACHE_HOME/cthash/tuning or ~/.cache/cthash/tuning
+inline auto default_tuning_path() -> std::optional<std::filesystem::path> {
+	if (const char * cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+		return std::filesystem::path(cache) / "cthash" / "tuning";
+	} else if (const char * home = std::getenv("HOME"); home && *home) {
+		return std::filesystem::path(home) / ".cache" / "cthash" / "tuning";
+	}
+	return std::nullopt;
+}
+
+// lines are `model<TAB>algorithm<TAB>workers<TAB>small-file-limit<TAB>min-parallel-segments<TAB>mmap|read<TAB>min-multi-buffer-batch`
+// (the last value is missing in files written by older versions, then its default is used)
+struct tuning_file {
+	std::filesystem::path path;
+
+	struct key {
+		std::string model;
+		std::string algorithm;
+		size_t workers;
+
+		auto prefix() const -> std::string {
+			// tabs and newlines would break the line format
+			auto clean = model;
+			std::ranges::replace_if(clean, [](char c) { return c == '\t' || c == '\n'; }, ' ');
+			return clean + '\t' + algorithm + '\t' + std::to_string(workers) + '\t';
+		}
+	};
+
+	auto load(const key & k) const -> std::optional<tuning> {
+		std::ifstream in{path};
+		const auto prefix = k.prefix();
+
+		for (std::string line; std::getline(in, line);) {
+			if (not line.starts_with(prefix)) {
+				continue;
+			}
+
+			std::istringstream values{line.substr(prefix.size())};
+			tuning out{};
+			std::string io;
+
+			if (values >> out.small_file_limit >> out.min_parallel_segments >> io && (io == "mmap" || io == "read")) {
+				out.read_large = (io == "read");
+
+				if (uint64_t batch; values >> batch) {
+					out.min_multi_buffer_batch = batch;
+				}
+
+				return out;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	// the file is rewritten (other lines are kept) and renamed over the old one, so readers never see half of it
+	auto store(const key & k, const tuning & t) const -> bool {
+		const auto prefix = k.prefix();
+		std::vector<std::string> lines;
+
+		{
+			std::ifstream in{path};
+			for (std::string line; std::getline(in, line);) {
+				if (not line.starts_with(prefix)) {
+					lines.push_back(std::move(line));
+				}
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		const auto temporary = std::filesystem::path(path).concat(".tmp" + std::to_string(::getpid()));
+		{
+			std::ofstream out{temporary, std::ios::trunc};
+			for (const auto & line: lines) {
+				out << line << '\n';
+			}
+			out << prefix << t.small_file_limit << '\t' << t.min_parallel_segments << '\t' << (t.read_large ? "read" : "mmap") << '\t' << t.min_multi_buffer_batch << '\n';
+
+			if (not out.flush()) {
+				std::filesystem::remove(temporary, ec);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporary, path, ec);
+		return not ec;
+	}
+};
+
+// digests computed only to be timed mustn't be optimized away
+inline volatile std::byte digest_sink{};
+
+inline void keep_digest(const digest_value & digest) noexcept {
+	digest_sink = digest.get_span()[0];
+}
+
+// the shortest of `repeats` runs of `fn` in seconds
+template <typename Fn> auto fastest_of(size_t repeats, Fn && fn) -> double {
+	double best = 0.0;
+
+	for (size_t i = 0; i != repeats; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = (i == 0u) ? t : std::min(best, t);
+	}
+
+	return best;
+}
+
+// measurements are sized by speed of the hash function, so calibration takes few hundred milliseconds with any,
+// scratch file is created in `scratch_directory` and removed, without it nothing is calibrated
+inline auto calibrate(const algorithm & alg, size_t workers, const std::filesystem::path & scratch_directory) -> std::optional<tuning> {
+	constexpr size_t file_size = 16u * 1024u * 1024u;
+	constexpr size_t repeats = 3u;
+
+	std::vector<std::byte> buffer(file_size);
+	uint64_t state = 0x2545F4914F6CDD1Du;
+	for (auto & b: buffer) {
+		state ^= state << 13u;
+		state ^= state >> 7u;
+		state ^= state << 17u;
+		b = static_cast<std::byte>(state);
+	}
+
+	auto name = (scratch_directory / "cthash-tune-XXXXXX").string();
+	const int fd = mkstemp(name.data());
+
+	if (fd < 0) {
+		return std::nullopt;
+	}
+
+	const bool written = write(fd, buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size());
+	close(fd);
+
+	if (not written) {
+		unlink(name.c_str());
+		return std::nullopt;
+	}
+
+	// scratch file which can't be opened again (removed or replaced by someone) makes the measurements useless
+	bool readable = true;
+
+	const auto via_read = [&](size_t size) {
+		const int f = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+		if (f < 0) {
+			readable = false;
+			return;
+		}
+		for (size_t done = 0u; done < size;) {
+			const auto r = pread(f, buffer.data() + done, size - done, static_cast<off_t>(done));
+			if (r <= 0) {
+				break;
+			}
+			done += static_cast<size_t>(r);
+		}
+		close(f);
+		keep_digest(alg.digest_of(std::span<const std::byte>(buffer).first(size)));
+	};
+
+	const auto via_mmap = [&](size_t size) {
+		const auto f = input_file(name.c_str());
+		if (not f.valid()) {
+			readable = false;
+			return;
+		}
+		const auto m = mapped_file(f.fd, size);
+		keep_digest(alg.digest_of(m.get_span()));
+		static_cast<void>(find_extents(f.fd, size));
+	};
+
+	// bytes hashed in `seconds`
+	const double rate = static_cast<double>(buffer.size() / 16u) / fastest_of(1u, [&] { keep_digest(alg.digest_of(std::span<const std::byte>(buffer).first(buffer.size() / 16u))); });
+	const auto bytes_in = [&](double seconds) { return static_cast<size_t>(rate * seconds); };
+
+	tuning out{};
+
+	// the largest size up to which reading is faster than mapping for every measured size
+	out.small_file_limit = 4096u;
+	for (size_t size = 4096u; size <= 1024u * 1024u; size *= 2u) {
+		const size_t count = std::max<size_t>(1u, bytes_in(0.002) / size);
+		const double read = fastest_of(repeats, [&] { for (size_t i = 0; i != count; ++i) { via_read(size); } });
+		const double map = fastest_of(repeats, [&] { for (size_t i = 0; i != count; ++i) { via_mmap(size); } });
+
+		if (read > map) {
+			break;
+		}
+		out.small_file_limit = size;
+	}
+
+	const size_t large = std::clamp<size_t>(bytes_in(0.01), 1024u * 1024u, file_size) / 4096u * 4096u;
+	out.read_large = fastest_of(repeats, [&] { via_read(large); }) < fastest_of(repeats, [&] { via_mmap(large); });
+	unlink(name.c_str());
+
+	if (not readable) {
+		return std::nullopt;
+	}
+
+	// the smallest batch of small files (4 KiB each) which is hashed clearly faster in lanes of multi-buffer kernel
+	// than one by one (with few inputs most lanes are idle)
+	if (alg.hash_many != nullptr) {
+		constexpr size_t input_size = 4096u;
+		constexpr size_t most = 32u;
+		out.min_multi_buffer_batch = UINT64_MAX;
+
+		std::vector<std::span<const std::byte>> inputs;
+		for (size_t i = 0; i != most; ++i) {
+			inputs.push_back(std::span<const std::byte>(buffer).subspan(i * input_size, input_size));
+		}
+		std::vector<digest_value> digests(most);
+
+		for (size_t count = 2u; count <= most; ++count) {
+			const auto batch = std::span<const std::span<const std::byte>>(inputs).first(count);
+			const size_t loops = std::max<size_t>(1u, bytes_in(0.001) / (count * input_size));
+
+			const double one_by_one = fastest_of(repeats, [&] {
+				for (size_t l = 0; l != loops; ++l) {
+					for (const auto in: batch) {
+						keep_digest(alg.digest_of(in));
+					}
+				}
+			});
+
+			const double lanes = fastest_of(repeats, [&] {
+				for (size_t l = 0; l != loops; ++l) {
+					alg.hash_many(batch, std::span(digests).first(count));
+					keep_digest(digests[0]);
+				}
+			});
+
+			if (lanes < 0.9 * one_by_one) {
+				out.min_multi_buffer_batch = count;
+				break;
+			}
+		}
+	}
+
+	// the smallest number of segments which is hashed clearly faster by all workers than by one (a single segment
+	// is always hashed by one)
+	const auto prototype = alg.create();
+	const size_t segment = prototype->segment_size();
+
+	if (segment != 0u && workers > 1u) {
+		const size_t most = file_size / segment;
+		out.min_parallel_segments = UINT64_MAX;
+
+		thread_pool pool{workers};
+
+		for (size_t count = 2u; count <= most; count *= 2u) {
+			const auto input = std::span<const std::byte>(buffer).first(count * segment);
+
+			const double sequential = fastest_of(repeats, [&] {
+				const auto h = alg.create();
+				h->update(input);
+				keep_digest(h->final());
+			});
+
+			const double parallel = fastest_of(repeats, [&] {
+				std::atomic<size_t> next{0u};
+				std::atomic<size_t> done{0u};
+
+				const auto take = [&](size_t) {
+					for (size_t i; (i = next++) < count;) {
+						const auto s = prototype->create_segment();
+						s->update(input.subspan(i * segment, segment));
+						keep_digest(s->final());
+
+						if (++done == count) {
+							done.notify_all();
+						}
+					}
+				};
+
+				for (size_t i = 1u; i < std::min(workers, count); ++i) {
+					pool.submit(take);
+				}
+
+				take(0u);
+
+				for (size_t d; (d = done.load()) != count;) {
+					done.wait(d);
+				}
+
+				// helpers which found nothing to take still reference `next`
+				pool.wait();
+			});
+
+			if (parallel < 0.9 * sequential) {
+				out.min_parallel_segments = count;
+				break;
+			}
+		}
+	}
+
+	return out;
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef CTHASH_TOOLS_CHAIN_HPP
+#define CTHASH_TOOLS_CHAIN_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+// record of hash-linked log is one line: hex digest of the previous record (without its newline), space and payload,
+// the first record links to zeros
+template <size_t DigestSize> struct hash_chain {
+	// digests are compared in 8 byte words
+	static_assert(DigestSize % 8u == 0u);
+
+	using digest = std::array<std::byte, DigestSize>;
+	static constexpr size_t link_length = DigestSize * 2u + 1u;
+
+	static constexpr auto hex_value(std::byte c) noexcept -> int {
+		const auto v = static_cast<char>(c);
+		if (v >= '0' && v <= '9') {
+			return v - '0';
+		} else if (v >= 'a' && v <= 'f') {
+			return v - 'a' + 10;
+		} else if (v >= 'A' && v <= 'F') {
+			return v - 'A' + 10;
+		}
+		return -1;
+	}
+
+	// link at the beginning of the record, nothing when it's malformed
+	static auto parse_link(std::span<const std::byte> record) noexcept -> std::optional<digest> {
+		if (record.size() < link_length || static_cast<char>(record[link_length - 1u]) != ' ') {
+			return std::nullopt;
+		}
+
+		digest out;
+
+		for (size_t i = 0; i != DigestSize; ++i) {
+			const int hi = hex_value(record[i * 2u]);
+			const int lo = hex_value(record[i * 2u + 1u]);
+
+			if ((hi | lo) < 0) {
+				return std::nullopt;
+			}
+
+			out[i] = static_cast<std::byte>((hi << 4) | lo);
+		}
+
+		return out;
+	}
+
+	// records of `in` which end with a newline (or end of input when `last` is set), newlines are not part of records
+	static void split(std::span<const std::byte> in, bool last, std::vector<std::span<const std::byte>> & out) {
+		const auto * pos = in.data();
+		const auto * const end = in.data() + in.size();
+
+		while (pos != end) {
+			const auto * nl = static_cast<const std::byte *>(std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+
+			if (nl == nullptr) {
+				if (last) {
+					out.emplace_back(pos, end);
+				}
+				return;
+			}
+
+			out.emplace_back(pos, nl);
+			pos = nl + 1;
+		}
+	}
+
+	static bool same(const digest & lhs, const digest & rhs) noexcept {
+		// whole digest is compared at once without early exit, so the loop over records vectorizes
+		uint64_t diff = 0u;
+		for (size_t i = 0; i != DigestSize; i += 8u) {
+			uint64_t a;
+			uint64_t b;
+			std::memcpy(&a, lhs.data() + i, 8u);
+			std::memcpy(&b, rhs.data() + i, 8u);
+			diff |= a ^ b;
+		}
+		return diff == 0u;
+	}
+
+	// index of the first record whose link doesn't match digest of the record before it (`previous` for the first one)
+	static auto first_break(const digest & previous, std::span<const digest> links, std::span<const digest> digests) noexcept -> std::optional<size_t> {
+		if (links.empty()) {
+			return std::nullopt;
+		}
+
+		if (not same(links[0], previous)) {
+			return 0u;
+		}
+
+		// blocks are checked without branching on each record, only a block with a break is scanned again
+		constexpr size_t block = 64u;
+
+		for (size_t start = 1u; start < links.size(); start += block) {
+			const size_t stop = std::min(start + block, links.size());
+			bool all = true;
+
+			for (size_t i = start; i != stop; ++i) {
+				all &= same(links[i], digests[i - 1u]);
+			}
+
+			if (not all) {
+				for (size_t i = start; i != stop; ++i) {
+					if (not same(links[i], digests[i - 1u])) {
+						return i;
+					}
+				}
+			}
+		}
+
+		return std::nullopt;
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef CTHASH_TOOLS_COMPACT_STREAMS_HPP
+#define CTHASH_TOOLS_COMPACT_STREAMS_HPP
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+template <typename Hasher> concept compactable_hasher = requires(const Hasher & h) {
+	{ Hasher::midstate_size };
+	{ Hasher::midstate_buffer_size };
+	{ h.pending() };
+	{ h.midstate() };
+};
+
+// unprocessed parts of blocks of many streams in slots of one size, slots are reused through a free list and the slab
+// grows in chunks so their addresses are stable
+struct partial_block_slab {
+	static constexpr uint32_t none = UINT32_MAX;
+	static constexpr size_t slots_per_chunk = 4096u;
+
+	size_t slot_size{0u};
+	std::vector<std::unique_ptr<std::byte[]>> chunks{};
+	std::vector<uint32_t> free_slots{};
+
+	auto attach() -> uint32_t {
+		if (not free_slots.empty()) {
+			const uint32_t slot = free_slots.back();
+			free_slots.pop_back();
+			return slot;
+		}
+
+		const auto first = static_cast<uint32_t>(chunks.size() * slots_per_chunk);
+		chunks.push_back(std::make_unique<std::byte[]>(slot_size * slots_per_chunk));
+
+		// lower slots are handed out first
+		for (size_t i = slots_per_chunk - 1u; i != 0u; --i) {
+			free_slots.push_back(first + static_cast<uint32_t>(i));
+		}
+
+		return first;
+	}
+
+	void release(uint32_t slot) {
+		free_slots.push_back(slot);
+	}
+
+	auto get(uint32_t slot) noexcept -> std::span<std::byte> {
+		return std::span<std::byte>(chunks[slot / slots_per_chunk].get() + (slot % slots_per_chunk) * slot_size, slot_size);
+	}
+
+	auto bytes() const noexcept -> size_t {
+		return chunks.size() * slot_size * slots_per_chunk + free_slots.capacity() * sizeof(uint32_t);
+	}
+};
+
+// many long-lived streams hashed by `Hasher` stored at their minimal size: only the part of midstate which isn't
+// a buffer (chaining state and length) is kept per stream in one array, unprocessed part of block is in a shared slab
+// and it's attached only while the stream has pending bytes, a full hasher exists only during `update`
+// (it's not thread-safe, use one set of streams per thread or guard it)
+template <compactable_hasher Hasher> struct compact_streams {
+	using handle = uint32_t;
+
+	static constexpr size_t buffer_size = Hasher::midstate_buffer_size;
+	static constexpr size_t state_size = Hasher::midstate_size - buffer_size;
+
+	// pending bytes go to the smallest slab whose slots fit them, so a stream with few pending bytes stays small
+	static constexpr size_t granule = 16u;
+	static constexpr size_t size_classes = (buffer_size + granule - 1u) / granule;
+	static constexpr uint8_t no_class = UINT8_MAX;
+	static_assert(size_classes < no_class);
+
+	std::vector<std::byte> states{};
+	std::vector<uint32_t> partial{}; // slot in slab for each stream
+	std::vector<uint8_t> partial_class{}; // and which slab it is
+	std::vector<handle> closed{};
+	std::array<partial_block_slab, size_classes> slabs = make_slabs(std::make_index_sequence<size_classes>{});
+
+	auto open() -> handle {
+		const auto initial = Hasher{}.midstate();
+
+		if (not closed.empty()) {
+			const handle h = closed.back();
+			closed.pop_back();
+			std::copy_n(initial.begin(), state_size, state_of(h).begin());
+			return h;
+		}
+
+		const auto h = static_cast<handle>(partial.size());
+		states.insert(states.end(), initial.begin(), initial.begin() + state_size);
+		partial.push_back(partial_block_slab::none);
+		partial_class.push_back(no_class);
+		return h;
+	}
+
+	void update(handle h, std::span<const std::byte> in) {
+		auto hasher = load(h);
+		hasher.update(in);
+		store(h, hasher);
+	}
+
+	// hasher with the state of the stream, stream is closed (call `final()` on the result)
+	auto finish(handle h) -> Hasher {
+		auto hasher = load(h);
+		close(h);
+		return hasher;
+	}
+
+	void close(handle h) {
+		detach(h);
+		closed.push_back(h);
+	}
+
+	auto size() const noexcept -> size_t {
+		return partial.size() - closed.size();
+	}
+
+	// memory used by all streams (without unused capacity of vectors)
+	auto bytes() const noexcept -> size_t {
+		size_t out = states.size() + partial.size() * (sizeof(uint32_t) + sizeof(uint8_t)) + closed.size() * sizeof(handle);
+		for (const auto & slab: slabs) {
+			out += slab.bytes();
+		}
+		return out;
+	}
+
+private:
+	template <size_t... Class> static auto make_slabs(std::index_sequence<Class...>) -> std::array<partial_block_slab, size_classes> {
+		return {partial_block_slab{.slot_size = std::min((Class + 1u) * granule, buffer_size)}...};
+	}
+
+	auto state_of(handle h) noexcept -> std::span<std::byte, state_size> {
+		return std::span<std::byte, state_size>(states.data() + static_cast<size_t>(h) * state_size, state_size);
+	}
+
+	void detach(handle h) {
+		// keccak absorbs every byte into its state right away, so there is never anything attached
+		if constexpr (size_classes != 0u) {
+			if (partial_class[h] != no_class) {
+				slabs[partial_class[h]].release(std::exchange(partial[h], partial_block_slab::none));
+				partial_class[h] = no_class;
+			}
+		}
+	}
+
+	auto load(handle h) -> Hasher {
+		std::array<std::byte, Hasher::midstate_size> midstate{};
+		const auto state = state_of(h);
+		std::copy(state.begin(), state.end(), midstate.begin());
+
+		if constexpr (size_classes != 0u) {
+			if (partial_class[h] != no_class) {
+				const auto buffer = slabs[partial_class[h]].get(partial[h]);
+				std::copy(buffer.begin(), buffer.end(), midstate.begin() + state_size);
+			}
+		}
+
+		Hasher hasher{};
+		hasher.restore(midstate);
+		return hasher;
+	}
+
+	void store(handle h, const Hasher & hasher) {
+		const auto midstate = hasher.midstate();
+		std::copy_n(midstate.begin(), state_size, state_of(h).begin());
+
+		if constexpr (size_classes != 0u) {
+			const size_t pending = hasher.pending();
+
+			if (pending == 0u) {
+				detach(h);
+				return;
+			}
+
+			const auto needed = static_cast<uint8_t>((pending - 1u) / granule);
+
+			if (partial_class[h] != needed) {
+				detach(h);
+				partial[h] = slabs[needed].attach();
+				partial_class[h] = needed;
+			}
+
+			std::copy_n(midstate.begin() + state_size, pending, slabs[needed].get(partial[h]).begin());
+		}
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
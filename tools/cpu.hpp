@@ -0,0 +1,102 @@
+#ifndef CTHASH_TOOLS_CPU_HPP
+#define CTHASH_TOOLS_CPU_HPP
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace cthash::tools {
+
+// name of the CPU as reported by the system ("unknown" when it's not available)
+inline auto cpu_model() -> std::string {
+#ifdef __linux__
+	std::ifstream cpuinfo{"/proc/cpuinfo"};
+	std::string line;
+
+	while (std::getline(cpuinfo, line)) {
+		// x86 has "model name", arm64 only "CPU part" (so it's at least something)
+		for (const std::string_view key: {"model name", "CPU part"}) {
+			if (line.starts_with(key)) {
+				if (const auto colon = line.find(':'); colon != std::string::npos) {
+					return line.substr(line.find_first_not_of(" \t", colon + 1u));
+				}
+			}
+		}
+	}
+#endif
+	return "unknown";
+}
+
+// timestamp counter: it counts reference cycles at constant rate (not core cycles which change with frequency),
+// on other architectures there is no counter and `available` is false
+struct cycle_counter {
+#if defined(__x86_64__) || defined(__i386__)
+	static constexpr bool available = true;
+
+	static auto now() noexcept -> uint64_t {
+		return __rdtsc();
+	}
+
+	// waits for previous instructions to finish, so it can end a measured region
+	static auto now_serialized() noexcept -> uint64_t {
+		unsigned aux;
+		return __rdtscp(&aux);
+	}
+
+	// fenced on both sides, so a short region (single call) isn't overlapped with code around it
+	static auto begin() noexcept -> uint64_t {
+		_mm_lfence();
+		const uint64_t out = __rdtsc();
+		_mm_lfence();
+		return out;
+	}
+
+	static auto end() noexcept -> uint64_t {
+		unsigned aux;
+		const uint64_t out = __rdtscp(&aux);
+		_mm_lfence();
+		return out;
+	}
+#else
+	static constexpr bool available = false;
+
+	static auto now() noexcept -> uint64_t {
+		return 0u;
+	}
+
+	static auto now_serialized() noexcept -> uint64_t {
+		return 0u;
+	}
+
+	static auto begin() noexcept -> uint64_t {
+		return 0u;
+	}
+
+	static auto end() noexcept -> uint64_t {
+		return 0u;
+	}
+#endif
+
+	// rate of the counter measured against steady clock (once, it takes ~20 ms)
+	static auto ticks_per_second() -> double {
+		static const double rate = [] {
+			using clock = std::chrono::steady_clock;
+			const auto start = clock::now();
+			const uint64_t start_ticks = now();
+			while (clock::now() - start < std::chrono::milliseconds{20}) { }
+			const uint64_t end_ticks = now_serialized();
+			return static_cast<double>(end_ticks - start_ticks) / std::chrono::duration<double>(clock::now() - start).count();
+		}();
+		return rate;
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
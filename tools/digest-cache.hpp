@@ -0,0 +1,422 @@
+#ifndef CTHASH_TOOLS_DIGEST_CACHE_HPP
+#define CTHASH_TOOLS_DIGEST_CACHE_HPP
+
+#include "algorithms.hpp"
+#include "mapped-file.hpp"
+#include <cthash/xxhash.hpp>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cthash::tools {
+
+// Persistent cache of digests keyed by (device, inode, algorithm) and validated by size, mtime and ctime.
+//
+// The file is a small header followed by append-only sequence of records. Each record ends with xxhash64
+// of its content, so a torn record (crashed or concurrently running writer) is recognized and ignored.
+// For the same key the latest record wins. Readers only map the file, writers serialize their appends
+// with flock(LOCK_EX), and compaction writes a new file and renames it over the old one, so readers
+// which already mapped the old file still see a consistent snapshot.
+//
+// Optionally a record contains serialized midstate of the hasher after the whole file was processed
+// together with fingerprint of sampled blocks, so a file which only grew can be hashed from that point.
+//
+// Records are stored in native endianness, the cache is not meant to be shared between machines.
+
+// fingerprint of few blocks evenly spread over first `length` bytes (last block ends exactly at `length`)
+inline auto sampled_fingerprint(std::span<const std::byte> content, uint64_t length) noexcept -> uint64_t {
+	constexpr size_t samples = 8u;
+	constexpr size_t sample_size = 4096u;
+
+	const auto prefix = content.first(static_cast<size_t>(std::min<uint64_t>(length, content.size())));
+	auto h = cthash::xxhash64{length};
+
+	if (prefix.size() <= samples * sample_size) {
+		h.update(prefix);
+	} else {
+		const size_t step = (prefix.size() - sample_size) / (samples - 1u);
+
+		for (size_t i = 0; i != samples - 1u; ++i) {
+			h.update(prefix.subspan(i * step, sample_size));
+		}
+
+		h.update(prefix.last(sample_size));
+	}
+
+	const auto r = h.final();
+	return cast_from_bytes<uint64_t>(std::span<const std::byte, sizeof(uint64_t)>(r));
+}
+
+struct digest_cache {
+	static constexpr auto magic = std::array<char, 8>{'C', 'T', 'H', 'C', 'A', 'C', 'H', 'E'};
+	static constexpr uint32_t version = 2u;
+
+	struct file_header {
+		std::array<char, 8> magic;
+		uint32_t version;
+		uint32_t header_size;
+	};
+
+	using algorithm_name = std::array<char, 24>;
+
+	struct record_header {
+		static constexpr uint32_t expected_magic = 0x52485443u; // "CTHR"
+
+		uint32_t magic;
+		uint32_t length; // whole record including checksum, aligned to 8 bytes
+		file_metadata metadata;
+		algorithm_name algorithm;
+		uint32_t digest_length;
+		uint32_t midstate_length; // zero if the record can't be used for resuming
+		uint64_t fingerprint;	  // of sampled blocks of the file (see `sampled_fingerprint`)
+	};
+
+	static_assert(sizeof(file_header) == 16u);
+	static_assert(sizeof(record_header) % 8u == 0u);
+
+	static constexpr size_t checksum_size = sizeof(uint64_t);
+
+	struct entry {
+		file_metadata metadata;
+		digest_value digest;
+		std::vector<std::byte> midstate{};
+		uint64_t fingerprint{0u};
+	};
+
+	struct key {
+		uint64_t device;
+		uint64_t inode;
+		algorithm_name algorithm;
+
+		friend bool operator==(const key &, const key &) noexcept = default;
+	};
+
+	struct key_hash {
+		size_t operator()(const key & k) const noexcept {
+			const auto name = std::hash<std::string_view>{}(std::string_view(k.algorithm.data()));
+			return static_cast<size_t>((k.device * xxhash_types<64>::primes[0]) ^ (k.inode * xxhash_types<64>::primes[1])) ^ name;
+		}
+	};
+
+	static auto name_of(std::string_view algorithm) noexcept -> algorithm_name {
+		algorithm_name r{};
+		std::copy_n(algorithm.data(), std::min(algorithm.size(), r.size() - 1u), r.data());
+		return r;
+	}
+
+	static auto record_checksum(std::span<const std::byte> content) noexcept -> std::array<std::byte, checksum_size> {
+		return cthash::xxhash64{}.update(content).final();
+	}
+
+	// returns length of valid record at the beginning of `in` (or zero if there is none)
+	static auto valid_record_length(std::span<const std::byte> in) noexcept -> size_t {
+		if (in.size() < sizeof(record_header)) {
+			return 0u;
+		}
+
+		record_header hdr;
+		std::memcpy(&hdr, in.data(), sizeof(hdr));
+
+		if (hdr.magic != record_header::expected_magic || hdr.length % 8u != 0u || hdr.length > in.size()) {
+			return 0u;
+		}
+
+		if (hdr.digest_length > digest_value::capacity || (sizeof(record_header) + size_t{hdr.digest_length} + size_t{hdr.midstate_length} + checksum_size) > hdr.length) {
+			return 0u;
+		}
+
+		const auto content = in.first(hdr.length - checksum_size);
+		const auto expected = record_checksum(content);
+
+		if (not std::ranges::equal(expected, in.subspan(content.size(), checksum_size))) {
+			return 0u;
+		}
+
+		return hdr.length;
+	}
+
+	// calls `cb(record)` for each valid record and returns end of last valid record
+	template <typename CB> static auto scan(std::span<const std::byte> file, CB && cb) noexcept -> size_t {
+		file_header hdr;
+
+		if (file.size() < sizeof(hdr)) {
+			return 0u;
+		}
+
+		std::memcpy(&hdr, file.data(), sizeof(hdr));
+
+		if (hdr.magic != magic || hdr.version != version || hdr.header_size != sizeof(file_header)) {
+			return 0u;
+		}
+
+		size_t offset = sizeof(file_header);
+
+		while (const size_t length = valid_record_length(file.subspan(offset))) {
+			cb(file.subspan(offset, length));
+			offset += length;
+		}
+
+		return offset;
+	}
+
+	static auto header_of(std::span<const std::byte> record) noexcept -> record_header {
+		record_header hdr;
+		std::memcpy(&hdr, record.data(), sizeof(hdr));
+		return hdr;
+	}
+
+	static auto key_of(const record_header & hdr) noexcept -> key {
+		return {hdr.metadata.device, hdr.metadata.inode, hdr.algorithm};
+	}
+
+	// state
+	std::string path;
+	std::unique_ptr<input_file> file;
+	std::unique_ptr<mapped_file> mapping;
+	std::unordered_map<key, std::span<const std::byte>, key_hash> index;
+	std::vector<std::unique_ptr<std::byte[]>> owned;
+	std::vector<std::byte> pending;
+	mutable std::mutex mutex{}; // lookups and stores can come from multiple threads
+
+	explicit digest_cache(std::string p): path{std::move(p)} {
+		file = std::make_unique<input_file>(path.c_str());
+
+		if (not file->valid()) {
+			// cache doesn't exist yet
+			return;
+		}
+
+		mapping = std::make_unique<mapped_file>(*file);
+
+		scan(mapping->get_span(), [&](std::span<const std::byte> record) {
+			index.insert_or_assign(key_of(header_of(record)), record);
+		});
+	}
+
+	digest_cache(const digest_cache &) = delete;
+	digest_cache(digest_cache &&) = delete;
+
+	~digest_cache() {
+		flush();
+	}
+
+	auto size() const -> size_t {
+		std::lock_guard lock{mutex};
+		return index.size();
+	}
+
+	auto find(const file_metadata & md, std::string_view algorithm) const -> std::optional<entry> {
+		std::lock_guard lock{mutex};
+		const auto it = index.find(key{md.device, md.inode, name_of(algorithm)});
+
+		if (it == index.end()) {
+			return std::nullopt;
+		}
+
+		const auto hdr = header_of(it->second);
+		const auto payload = it->second.subspan(sizeof(record_header));
+		const auto stored_midstate = payload.subspan(hdr.digest_length, hdr.midstate_length);
+
+		return entry{hdr.metadata, digest_value{payload.first(hdr.digest_length)}, std::vector<std::byte>(stored_midstate.begin(), stored_midstate.end()), hdr.fingerprint};
+	}
+
+	// returns digest only if the file wasn't modified since it was stored
+	auto lookup(const file_metadata & md, std::string_view algorithm) const -> std::optional<digest_value> {
+		if (auto e = find(md, algorithm); e && e->metadata == md) {
+			return e->digest;
+		}
+
+		return std::nullopt;
+	}
+
+	void store(const file_metadata & md, std::string_view algorithm, const digest_value & digest, std::span<const std::byte> midstate = {}, uint64_t fingerprint = 0u) {
+		const size_t content_length = sizeof(record_header) + digest.length + midstate.size();
+		const size_t length = ((content_length + 7u) & ~size_t{7u}) + checksum_size;
+
+		auto record = std::make_unique<std::byte[]>(length);
+		std::fill_n(record.get(), length, std::byte{0});
+
+		const auto hdr = record_header{
+			.magic = record_header::expected_magic,
+			.length = static_cast<uint32_t>(length),
+			.metadata = md,
+			.algorithm = name_of(algorithm),
+			.digest_length = static_cast<uint32_t>(digest.length),
+			.midstate_length = static_cast<uint32_t>(midstate.size()),
+			.fingerprint = fingerprint,
+		};
+
+		std::memcpy(record.get(), &hdr, sizeof(hdr));
+		std::ranges::copy(digest.get_span(), record.get() + sizeof(hdr));
+		std::ranges::copy(midstate, record.get() + sizeof(hdr) + digest.length);
+
+		const auto checksum = record_checksum(std::span<const std::byte>(record.get(), length - checksum_size));
+		std::ranges::copy(checksum, record.get() + length - checksum_size);
+
+		const auto view = std::span<const std::byte>(record.get(), length);
+
+		std::lock_guard lock{mutex};
+		pending.insert(pending.end(), view.begin(), view.end());
+		index.insert_or_assign(key_of(hdr), view);
+		owned.emplace_back(std::move(record));
+	}
+
+	// open cache file for writing and lock it, retries if the file was replaced by compaction meanwhile
+	static auto open_locked(const std::string & path) noexcept -> int {
+		for (;;) {
+			const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+			if (fd == input_file::invalid) {
+				return input_file::invalid;
+			}
+
+			if (flock(fd, LOCK_EX) != 0) {
+				close(fd);
+				return input_file::invalid;
+			}
+
+			struct stat locked, current;
+
+			if (fstat(fd, &locked) == 0 && stat(path.c_str(), &current) == 0 && locked.st_ino == current.st_ino && locked.st_dev == current.st_dev) {
+				return fd;
+			}
+
+			close(fd);
+		}
+	}
+
+	static auto size_of(int fd) noexcept -> size_t {
+		struct stat st;
+		return (fstat(fd, &st) == 0) ? static_cast<size_t>(st.st_size) : 0u;
+	}
+
+	static bool write_all(int fd, std::span<const std::byte> data) noexcept {
+		while (not data.empty()) {
+			const auto r = write(fd, data.data(), data.size());
+
+			if (r < 0) {
+				return false;
+			}
+
+			data = data.subspan(static_cast<size_t>(r));
+		}
+
+		return true;
+	}
+
+	static auto new_file_header() noexcept -> file_header {
+		return {magic, version, sizeof(file_header)};
+	}
+
+	// append pending records to the cache file
+	bool flush() {
+		std::lock_guard lock{mutex};
+
+		if (pending.empty()) {
+			return true;
+		}
+
+		const int fd = open_locked(path);
+
+		if (fd == input_file::invalid) {
+			return false;
+		}
+
+		bool ok = true;
+
+		{
+			// find where valid content ends (and drop torn tail of crashed writer)
+			const auto map = mapped_file(fd, size_of(fd));
+			size_t valid_end = scan(map.get_span(), [](auto) {});
+
+			if (valid_end == 0u) {
+				const auto hdr = new_file_header();
+				ok = ftruncate(fd, 0) == 0 && write_all(fd, std::as_bytes(std::span(&hdr, 1)));
+				valid_end = sizeof(file_header);
+			} else if (valid_end != map.get_span().size()) {
+				ok = ftruncate(fd, static_cast<off_t>(valid_end)) == 0;
+			}
+
+			ok = ok && lseek(fd, static_cast<off_t>(valid_end), SEEK_SET) >= 0 && write_all(fd, pending);
+		}
+
+		close(fd);
+
+		if (ok) {
+			pending.clear();
+		}
+
+		return ok;
+	}
+
+	// rewrite the cache file with only latest record for each key
+	bool compact() {
+		if (not flush()) {
+			return false;
+		}
+
+		const int fd = open_locked(path);
+
+		if (fd == input_file::invalid) {
+			return false;
+		}
+
+		const auto tmp_path = path + ".compact." + std::to_string(getpid());
+		bool ok = false;
+
+		{
+			const auto map = mapped_file(fd, size_of(fd));
+
+			std::unordered_map<key, std::span<const std::byte>, key_hash> latest;
+			scan(map.get_span(), [&](std::span<const std::byte> record) {
+				latest.insert_or_assign(key_of(header_of(record)), record);
+			});
+
+			// keep original order of records
+			std::vector<std::span<const std::byte>> records;
+			records.reserve(latest.size());
+			for (const auto & [k, record]: latest) {
+				records.emplace_back(record);
+			}
+			std::ranges::sort(records, {}, [](std::span<const std::byte> r) { return r.data(); });
+
+			const int out = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+			if (out != input_file::invalid) {
+				const auto hdr = new_file_header();
+				ok = write_all(out, std::as_bytes(std::span(&hdr, 1)));
+
+				for (const auto & record: records) {
+					ok = ok && write_all(out, record);
+				}
+
+				ok = ok && fsync(out) == 0;
+				ok = (close(out) == 0) && ok;
+				ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+
+				if (not ok) {
+					unlink(tmp_path.c_str());
+				}
+			}
+		}
+
+		close(fd);
+		return ok;
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
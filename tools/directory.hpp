@@ -0,0 +1,187 @@
+#ifndef CTHASH_TOOLS_DIRECTORY_HPP
+#define CTHASH_TOOLS_DIRECTORY_HPP
+
+#include "io-uring.hpp"
+#include "mapped-file.hpp"
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace cthash::tools {
+
+enum class entry_type { regular, directory, other, unknown };
+
+struct entry_status {
+	entry_type type;
+	file_metadata metadata;
+};
+
+// owned descriptor of an opened directory
+struct directory {
+	int fd{input_file::invalid};
+
+	directory(int parent, const char * name): fd{openat(parent, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)} { }
+
+	directory(const directory &) = delete;
+	directory(directory &&) = delete;
+
+	~directory() {
+		if (fd != input_file::invalid) {
+			close(fd);
+		}
+	}
+
+	bool valid() const noexcept {
+		return fd != input_file::invalid;
+	}
+};
+
+constexpr auto type_of_mode(mode_t mode) noexcept -> entry_type {
+	if (S_ISREG(mode)) {
+		return entry_type::regular;
+	} else if (S_ISDIR(mode)) {
+		return entry_type::directory;
+	} else {
+		return entry_type::other;
+	}
+}
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+// ask only for what we need, it's cheaper on network filesystems
+constexpr unsigned statx_mask = STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME | STATX_CTIME;
+constexpr int statx_flags = AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT;
+
+inline auto status_of(const struct statx & stx) noexcept -> entry_status {
+	return entry_status{
+		.type = type_of_mode(stx.stx_mode),
+		.metadata = {
+			.device = static_cast<uint64_t>(makedev(stx.stx_dev_major, stx.stx_dev_minor)),
+			.inode = static_cast<uint64_t>(stx.stx_ino),
+			.size = static_cast<uint64_t>(stx.stx_size),
+			.mtime_ns = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1'000'000'000 + static_cast<int64_t>(stx.stx_mtime.tv_nsec),
+			.ctime_ns = static_cast<int64_t>(stx.stx_ctime.tv_sec) * 1'000'000'000 + static_cast<int64_t>(stx.stx_ctime.tv_nsec),
+		},
+	};
+}
+#endif
+
+// stat of directory entry (symlinks are not followed)
+inline auto stat_at(int dirfd, const char * name) noexcept -> std::optional<entry_status> {
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+	struct statx stx;
+
+	if (statx(dirfd, name, statx_flags, statx_mask, &stx) != 0) {
+		return std::nullopt;
+	}
+
+	return status_of(stx);
+#else
+	struct stat st;
+
+	if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+		return std::nullopt;
+	}
+
+	return entry_status{type_of_mode(st.st_mode), file_metadata::from_stat(st)};
+#endif
+}
+
+// stat of many entries of one directory, with `ring` all of them are done with one syscall,
+// `cb(i, status)` is called for each of `names`
+template <typename CB> void stat_all(io_ring * ring, int dirfd, std::span<const std::string> names, CB && cb) {
+#if defined(CTHASH_TOOLS_IO_URING) && defined(STATX_BASIC_STATS)
+	std::vector<struct statx> out(names.size());
+
+	for_each_operation(
+		ring, names.size(),
+		[&](io_ring & r, size_t i) { r.statx(dirfd, names[i].c_str(), statx_flags, statx_mask, &out[i], i); },
+		[&](size_t i) { return (statx(dirfd, names[i].c_str(), statx_flags, statx_mask, &out[i]) == 0) ? 0 : -errno; },
+		[&](size_t i, int result) { cb(i, (result == 0) ? std::optional{status_of(out[i])} : std::nullopt); });
+#else
+	for (size_t i = 0; i != names.size(); ++i) {
+		cb(i, stat_at(dirfd, names[i].c_str()));
+	}
+#endif
+}
+
+// calls `cb(name, type)` for each entry of directory (except "." and "..")
+template <typename CB> bool for_each_entry(int dirfd, CB && cb) {
+	const auto is_dot_or_dotdot = [](std::string_view name) { return name == "." || name == ".."; };
+
+#ifdef __linux__
+	// layout of `struct linux_dirent64` (it has flexible array member, so it's not declared here)
+	constexpr size_t reclen_offset = 16u;
+	constexpr size_t type_offset = 18u;
+	constexpr size_t name_offset = 19u;
+
+	// big buffer so even large directories are read with few syscalls
+	alignas(8) std::array<char, 64u * 1024u> buffer;
+
+	for (;;) {
+		const auto r = syscall(SYS_getdents64, dirfd, buffer.data(), buffer.size());
+
+		if (r < 0) {
+			return false;
+		} else if (r == 0) {
+			return true;
+		}
+
+		for (size_t offset = 0; offset < static_cast<size_t>(r);) {
+			const char * entry = buffer.data() + offset;
+
+			unsigned short reclen;
+			std::memcpy(&reclen, entry + reclen_offset, sizeof(reclen));
+			offset += reclen;
+
+			const auto name = std::string_view(entry + name_offset);
+
+			if (is_dot_or_dotdot(name)) {
+				continue;
+			}
+
+			switch (static_cast<unsigned char>(entry[type_offset])) {
+			case DT_REG: cb(name, entry_type::regular); break;
+			case DT_DIR: cb(name, entry_type::directory); break;
+			case DT_UNKNOWN: cb(name, entry_type::unknown); break;
+			default: cb(name, entry_type::other); break;
+			}
+		}
+	}
+#else
+	// fdopendir takes ownership of descriptor
+	DIR * dir = fdopendir(dup(dirfd));
+
+	if (dir == nullptr) {
+		return false;
+	}
+
+	while (const dirent * entry = readdir(dir)) {
+		const auto name = std::string_view(entry->d_name);
+
+		if (not is_dot_or_dotdot(name)) {
+			cb(name, entry_type::unknown);
+		}
+	}
+
+	closedir(dir);
+	return true;
+#endif
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef CTHASH_TOOLS_GIT_HPP
+#define CTHASH_TOOLS_GIT_HPP
+
+#include "inflate.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+enum class git_object_type : uint8_t {
+	commit = 1,
+	tree = 2,
+	blob = 3,
+	tag = 4,
+	ofs_delta = 6,
+	ref_delta = 7,
+};
+
+constexpr auto git_type_name(git_object_type type) noexcept -> std::string_view {
+	switch (type) {
+	case git_object_type::commit: return "commit";
+	case git_object_type::tree: return "tree";
+	case git_object_type::blob: return "blob";
+	case git_object_type::tag: return "tag";
+	case git_object_type::ofs_delta: return "ofs-delta";
+	case git_object_type::ref_delta: return "ref-delta";
+	}
+	return "unknown";
+}
+
+// object id is digest of "<type> <length>\0" followed by the content, type is hashed from its string and the rest of
+// the header from a small buffer (which fits any length), so nothing is copied
+template <typename Hasher> auto git_object_id(std::string_view type, std::span<const std::byte> content) noexcept {
+	// space, decimal length and terminating zero
+	std::array<char, std::numeric_limits<size_t>::digits10 + 4u> header;
+	header[0] = ' ';
+
+	const auto [length_end, ec] = std::to_chars(header.data() + 1, header.data() + header.size() - 1, content.size());
+	// it fits any length, so `to_chars` fails only in theory
+	const auto header_end = (ec == std::errc{}) ? length_end : header.data() + 1;
+	*header_end = '\0';
+
+	auto h = Hasher{};
+	h.update(std::span(reinterpret_cast<const std::byte *>(type.data()), type.size()));
+	h.update(std::span(reinterpret_cast<const std::byte *>(header.data()), static_cast<size_t>(header_end + 1 - header.data())));
+	h.update(content);
+	return h.final();
+}
+
+// CRC-32 (as used by zlib and pack index)
+inline auto crc32(std::span<const std::byte> in, uint32_t crc = 0u) noexcept -> uint32_t {
+	static constexpr auto table = [] {
+		std::array<uint32_t, 256> out{};
+		for (uint32_t i = 0; i != out.size(); ++i) {
+			uint32_t c = i;
+			for (int k = 0; k != 8; ++k) {
+				c = (c & 1u) ? (0xEDB88320u ^ (c >> 1u)) : (c >> 1u);
+			}
+			out[i] = c;
+		}
+		return out;
+	}();
+
+	crc = ~crc;
+	for (const std::byte v: in) {
+		crc = table[(crc ^ static_cast<uint32_t>(v)) & 0xFFu] ^ (crc >> 8u);
+	}
+	return ~crc;
+}
+
+inline auto read_be32(std::span<const std::byte> in) noexcept -> uint32_t {
+	return (static_cast<uint32_t>(in[0]) << 24u) | (static_cast<uint32_t>(in[1]) << 16u) | (static_cast<uint32_t>(in[2]) << 8u) | static_cast<uint32_t>(in[3]);
+}
+
+// version 2 of pack index (.idx): fanout, sorted names, CRC-32 of entries, offsets and checksums
+struct pack_index {
+	size_t hash_size{0u};
+	size_t count{0u};
+	std::span<const std::byte> fanout{};
+	std::span<const std::byte> names{};
+	std::span<const std::byte> crcs{};
+	std::span<const std::byte> offsets{};
+	std::span<const std::byte> large_offsets{};
+	std::span<const std::byte> pack_checksum{};
+	std::span<const std::byte> checksum{};
+	std::span<const std::byte> checksummed{}; // everything except the trailing checksum
+
+	static auto parse(std::span<const std::byte> in, size_t hash_size) -> std::optional<pack_index> {
+		constexpr auto magic = std::array{std::byte{0xFF}, std::byte{'t'}, std::byte{'O'}, std::byte{'c'}};
+		constexpr size_t header_size = 8u + 256u * 4u;
+
+		if (in.size() < header_size + 2u * hash_size || not std::ranges::equal(in.first(4u), magic) || read_be32(in.subspan(4u)) != 2u) {
+			return std::nullopt;
+		}
+
+		pack_index out;
+		out.hash_size = hash_size;
+		out.fanout = in.subspan(8u, 256u * 4u);
+
+		// fanout is cumulative count of names by their first byte
+		for (size_t i = 1; i != 256u; ++i) {
+			if (read_be32(out.fanout.subspan(i * 4u)) < read_be32(out.fanout.subspan((i - 1u) * 4u))) {
+				return std::nullopt;
+			}
+		}
+
+		out.count = read_be32(out.fanout.subspan(255u * 4u));
+
+		const size_t fixed = header_size + out.count * (hash_size + 4u + 4u) + 2u * hash_size;
+
+		if (in.size() < fixed || (in.size() - fixed) % 8u != 0u) {
+			return std::nullopt;
+		}
+
+		auto rest = in.subspan(header_size);
+		out.names = rest.first(out.count * hash_size);
+		out.crcs = rest.subspan(out.names.size(), out.count * 4u);
+		out.offsets = rest.subspan(out.names.size() + out.crcs.size(), out.count * 4u);
+		out.large_offsets = in.subspan(fixed - 2u * hash_size, in.size() - fixed);
+		out.pack_checksum = in.last(2u * hash_size).first(hash_size);
+		out.checksum = in.last(hash_size);
+		out.checksummed = in.first(in.size() - hash_size);
+		return out;
+	}
+
+	auto name(size_t i) const noexcept -> std::span<const std::byte> {
+		return names.subspan(i * hash_size, hash_size);
+	}
+
+	auto crc(size_t i) const noexcept -> uint32_t {
+		return read_be32(crcs.subspan(i * 4u));
+	}
+
+	// offsets with the highest bit set point into table of 64-bit offsets
+	auto offset(size_t i) const noexcept -> std::optional<uint64_t> {
+		const uint32_t v = read_be32(offsets.subspan(i * 4u));
+
+		if ((v & 0x8000'0000u) == 0u) {
+			return v;
+		}
+
+		const size_t large = v & 0x7FFF'FFFFu;
+
+		if ((large + 1u) * 8u > large_offsets.size()) {
+			return std::nullopt;
+		}
+
+		const auto p = large_offsets.subspan(large * 8u);
+		return (static_cast<uint64_t>(read_be32(p)) << 32u) | read_be32(p.subspan(4u));
+	}
+
+	// position of the name (found by its first byte in fanout and binary search)
+	auto find(std::span<const std::byte> id) const noexcept -> std::optional<size_t> {
+		const auto first = static_cast<size_t>(id[0]);
+		size_t lo = (first == 0u) ? 0u : read_be32(fanout.subspan((first - 1u) * 4u));
+		size_t hi = read_be32(fanout.subspan(first * 4u));
+
+		while (lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2u;
+			const auto candidate = name(mid);
+			const auto cmp = std::lexicographical_compare_three_way(candidate.begin(), candidate.end(), id.begin(), id.end());
+
+			if (cmp == 0) {
+				return mid;
+			} else if (cmp < 0) {
+				lo = mid + 1u;
+			} else {
+				hi = mid;
+			}
+		}
+
+		return std::nullopt;
+	}
+};
+
+// header of one entry in pack, data (zlib stream) start at `data_offset`
+struct pack_entry {
+	git_object_type type;
+	uint64_t size;
+	uint64_t data_offset;
+	uint64_t base_offset{0u};                  // for ofs-delta
+	std::span<const std::byte> base_name{};    // for ref-delta
+
+	bool delta() const noexcept {
+		return type == git_object_type::ofs_delta || type == git_object_type::ref_delta;
+	}
+
+	static auto parse(std::span<const std::byte> pack, uint64_t offset, size_t hash_size) noexcept -> std::optional<pack_entry> {
+		auto pos = offset;
+
+		const auto next = [&]() -> std::optional<uint8_t> {
+			if (pos >= pack.size()) {
+				return std::nullopt;
+			}
+			return static_cast<uint8_t>(pack[pos++]);
+		};
+
+		auto c = next();
+		if (not c) {
+			return std::nullopt;
+		}
+
+		// type in bits 4-6 of first byte, size is little-endian varint (first 4 bits in the first byte)
+		const auto type = static_cast<git_object_type>((*c >> 4u) & 7u);
+		uint64_t size = *c & 0x0Fu;
+		unsigned shift = 4u;
+
+		while (*c & 0x80u) {
+			if (not(c = next()) || shift > 57u) {
+				return std::nullopt;
+			}
+			size |= static_cast<uint64_t>(*c & 0x7Fu) << shift;
+			shift += 7u;
+		}
+
+		pack_entry out{type, size, 0u};
+
+		switch (type) {
+		case git_object_type::commit:
+		case git_object_type::tree:
+		case git_object_type::blob:
+		case git_object_type::tag:
+			break;
+		case git_object_type::ofs_delta: {
+			// big-endian varint where each continuation adds one (so encoding is unique)
+			if (not(c = next())) {
+				return std::nullopt;
+			}
+
+			uint64_t distance = *c & 0x7Fu;
+
+			while (*c & 0x80u) {
+				if (not(c = next()) || distance >= (uint64_t{1} << 56u)) {
+					return std::nullopt;
+				}
+				distance = ((distance + 1u) << 7u) | (*c & 0x7Fu);
+			}
+
+			if (distance == 0u || distance > offset) {
+				return std::nullopt;
+			}
+
+			out.base_offset = offset - distance;
+			break;
+		}
+		case git_object_type::ref_delta:
+			if (pos + hash_size > pack.size()) {
+				return std::nullopt;
+			}
+			out.base_name = pack.subspan(pos, hash_size);
+			pos += hash_size;
+			break;
+		default:
+			return std::nullopt;
+		}
+
+		// size of the object is from untrusted header, its zlib stream (rest of the entry) must be able to hold it
+		if (out.size > max_inflated_size(static_cast<size_t>(pack.size() - pos))) {
+			return std::nullopt;
+		}
+
+		out.data_offset = pos;
+		return out;
+	}
+};
+
+// applies git delta (sizes of base and result followed by copy and insert instructions) to `base`
+inline bool apply_delta(std::span<const std::byte> base, std::span<const std::byte> delta, std::vector<std::byte> & out) {
+	size_t pos = 0u;
+
+	const auto varint = [&]() -> std::optional<uint64_t> {
+		uint64_t value = 0u;
+		for (unsigned shift = 0u; pos < delta.size() && shift < 64u; shift += 7u) {
+			const auto c = static_cast<uint8_t>(delta[pos++]);
+			value |= static_cast<uint64_t>(c & 0x7Fu) << shift;
+			if ((c & 0x80u) == 0u) {
+				return value;
+			}
+		}
+		return std::nullopt;
+	};
+
+	const auto base_size = varint();
+	const auto result_size = varint();
+
+	// two bytes of instructions (a copy with only the highest byte of size) copy at most 0xFF0000 bytes, longer copies
+	// copy less per byte, so larger results are rejected early (each instruction is checked against the size below)
+	if (not base_size || not result_size || *base_size != base.size() || *result_size / (0xFF0000u / 2u) > delta.size() - pos) {
+		return false;
+	}
+
+	// size of result is from untrusted delta, so only as much as base and delta together is reserved
+	out.clear();
+	out.reserve(static_cast<size_t>(std::min<uint64_t>(*result_size, base.size() + delta.size())));
+
+	while (pos < delta.size()) {
+		const auto op = static_cast<uint8_t>(delta[pos++]);
+
+		if (op & 0x80u) {
+			// copy from base: bits 0-3 select bytes of offset, bits 4-6 bytes of size
+			uint64_t from = 0u;
+			uint64_t size = 0u;
+
+			for (unsigned i = 0; i != 7u; ++i) {
+				if ((op & (1u << i)) == 0u) {
+					continue;
+				}
+
+				if (pos == delta.size()) {
+					return false;
+				}
+
+				const auto v = static_cast<uint64_t>(delta[pos++]);
+
+				if (i < 4u) {
+					from |= v << (8u * i);
+				} else {
+					size |= v << (8u * (i - 4u));
+				}
+			}
+
+			if (size == 0u) {
+				size = 0x10000u;
+			}
+
+			if (from + size > base.size() || out.size() + size > *result_size) {
+				return false;
+			}
+
+			const auto part = base.subspan(static_cast<size_t>(from), static_cast<size_t>(size));
+			out.insert(out.end(), part.begin(), part.end());
+		} else if (op != 0u) {
+			// insert next `op` bytes of delta
+			if (pos + op > delta.size() || out.size() + op > *result_size) {
+				return false;
+			}
+
+			out.insert(out.end(), delta.begin() + static_cast<std::ptrdiff_t>(pos), delta.begin() + static_cast<std::ptrdiff_t>(pos + op));
+			pos += op;
+		} else {
+			// reserved instruction
+			return false;
+		}
+	}
+
+	return out.size() == *result_size;
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef CTHASH_TOOLS_HISTOGRAM_HPP
+#define CTHASH_TOOLS_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+// log-linear histogram (like HdrHistogram): values below 128 have own buckets, above that each power of two
+// is split into 64 buckets, so any recorded value is known within 1.6 % and memory doesn't depend on range or count
+struct latency_histogram {
+	static constexpr unsigned sub_bits = 7u;
+	static constexpr uint64_t linear = uint64_t{1} << sub_bits;
+	static constexpr uint64_t half = linear / 2u;
+
+	std::vector<uint64_t> buckets = std::vector<uint64_t>(linear + (64u - sub_bits) * half, 0u);
+	uint64_t total{0u};
+	uint64_t minimum{UINT64_MAX};
+	uint64_t maximum{0u};
+
+	static constexpr auto index_of(uint64_t value) noexcept -> size_t {
+		if (value < linear) {
+			return static_cast<size_t>(value);
+		}
+
+		const auto shift = static_cast<unsigned>(std::bit_width(value)) - sub_bits;
+		return static_cast<size_t>(linear + (shift - 1u) * half + ((value >> shift) - half));
+	}
+
+	// highest value which falls into the bucket
+	static constexpr auto value_of(size_t index) noexcept -> uint64_t {
+		if (index < linear) {
+			return index;
+		}
+
+		const auto shift = static_cast<unsigned>((index - linear) / half) + 1u;
+		const uint64_t mantissa = (index - linear) % half + half;
+		return ((mantissa + 1u) << shift) - 1u;
+	}
+
+	void record(uint64_t value) noexcept {
+		++buckets[index_of(value)];
+		++total;
+		minimum = std::min(minimum, value);
+		maximum = std::max(maximum, value);
+	}
+
+	// smallest value which is not exceeded by `percentile` % of recorded values
+	auto percentile(double percentile) const noexcept -> uint64_t {
+		if (total == 0u) {
+			return 0u;
+		}
+
+		const auto rank = std::max<uint64_t>(static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5), 1u);
+		uint64_t seen = 0u;
+
+		for (size_t i = 0; i != buckets.size(); ++i) {
+			seen += buckets[i];
+			if (seen >= rank) {
+				return std::min(value_of(i), maximum);
+			}
+		}
+
+		return maximum;
+	}
+
+	// calls `fn(value, count, cumulative fraction)` for each non-empty bucket in order
+	template <typename Fn> void for_each_bucket(Fn && fn) const {
+		uint64_t seen = 0u;
+
+		for (size_t i = 0; i != buckets.size(); ++i) {
+			if (buckets[i] != 0u) {
+				seen += buckets[i];
+				fn(std::min(value_of(i), maximum), buckets[i], static_cast<double>(seen) / static_cast<double>(total));
+			}
+		}
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
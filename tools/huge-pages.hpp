@@ -0,0 +1,136 @@
+#ifndef CTHASH_TOOLS_HUGE_PAGES_HPP
+#define CTHASH_TOOLS_HUGE_PAGES_HPP
+
+#include <fstream>
+#include <span>
+#include <string>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace cthash::tools {
+
+// anonymous memory for large working sets (like Argon2's) backed by huge pages when the system has them, so random
+// accesses over it don't miss TLB on every block: explicit huge pages (reserved in vm.nr_hugepages) first, then
+// transparent ones (a mapping aligned to 2 MiB and advised), otherwise ordinary pages
+struct huge_page_memory {
+	static constexpr size_t huge_page_size = 2u * 1024u * 1024u;
+
+	enum class backing { none, explicit_huge_pages, transparent_huge_pages, regular_pages };
+
+	void * pointer{nullptr};
+	size_t mapped_size{0u};
+	size_t size{0u};
+	backing kind{backing::none};
+
+	huge_page_memory() noexcept = default;
+
+	explicit huge_page_memory(size_t bytes) noexcept: size{bytes} {
+		if (bytes == 0u) {
+			return;
+		}
+
+		const size_t rounded = (bytes + huge_page_size - 1u) / huge_page_size * huge_page_size;
+
+#ifdef MAP_HUGETLB
+		if (void * p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0); p != MAP_FAILED) {
+			pointer = p;
+			mapped_size = rounded;
+			kind = backing::explicit_huge_pages;
+			return;
+		}
+#endif
+
+		// one more huge page of address space, so an aligned start can be chosen and the rest unmapped
+		void * p = mmap(nullptr, rounded + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (p == MAP_FAILED) {
+			size = 0u;
+			return;
+		}
+
+		const auto start = reinterpret_cast<uintptr_t>(p);
+		const auto aligned = (start + huge_page_size - 1u) / huge_page_size * huge_page_size;
+		const size_t before = aligned - start;
+		const size_t after = huge_page_size - before;
+
+		if (before != 0u) {
+			munmap(p, before);
+		}
+		if (after != 0u) {
+			munmap(reinterpret_cast<void *>(aligned + rounded), after);
+		}
+
+		pointer = reinterpret_cast<void *>(aligned);
+		mapped_size = rounded;
+		kind = backing::regular_pages;
+
+#ifdef MADV_HUGEPAGE
+		if (madvise(pointer, mapped_size, MADV_HUGEPAGE) == 0) {
+			kind = backing::transparent_huge_pages;
+		}
+#endif
+	}
+
+	huge_page_memory(huge_page_memory && other) noexcept: pointer{std::exchange(other.pointer, nullptr)}, mapped_size{std::exchange(other.mapped_size, 0u)}, size{std::exchange(other.size, 0u)}, kind{std::exchange(other.kind, backing::none)} { }
+
+	huge_page_memory & operator=(huge_page_memory && other) noexcept {
+		std::swap(pointer, other.pointer);
+		std::swap(mapped_size, other.mapped_size);
+		std::swap(size, other.size);
+		std::swap(kind, other.kind);
+		return *this;
+	}
+
+	~huge_page_memory() noexcept {
+		if (pointer != nullptr) {
+			munmap(pointer, mapped_size);
+		}
+	}
+
+	explicit operator bool() const noexcept {
+		return pointer != nullptr;
+	}
+
+	template <typename T> auto as_span() const noexcept -> std::span<T> {
+		return {static_cast<T *>(pointer), size / sizeof(T)};
+	}
+
+	static constexpr auto name_of(backing b) noexcept -> const char * {
+		switch (b) {
+		case backing::explicit_huge_pages: return "hugetlb";
+		case backing::transparent_huge_pages: return "thp";
+		case backing::regular_pages: return "regular";
+		default: return "none";
+		}
+	}
+};
+
+// transparent huge pages are enabled (always or for advised memory)
+inline auto transparent_huge_pages_available() -> bool {
+	std::ifstream in{"/sys/kernel/mm/transparent_hugepage/enabled"};
+	std::string mode;
+	std::getline(in, mode);
+
+	return in && mode.find("[never]") == std::string::npos;
+}
+
+// asks for transparent huge pages in whole huge pages of `[data, data + bytes)`, it must be called before the memory
+// is touched (it does nothing for small ranges and where it isn't supported)
+inline void advise_huge_pages([[maybe_unused]] void * data, [[maybe_unused]] size_t bytes) noexcept {
+#ifdef MADV_HUGEPAGE
+	constexpr size_t huge_page_size = huge_page_memory::huge_page_size;
+	const auto start = reinterpret_cast<uintptr_t>(data);
+	const auto begin = (start + huge_page_size - 1u) / huge_page_size * huge_page_size;
+	const auto end = (start + bytes) / huge_page_size * huge_page_size;
+
+	if (end > begin) {
+		madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE);
+	}
+#endif
+}
+
+} // namespace cthash::tools
+
+#endif
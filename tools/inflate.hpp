@@ -0,0 +1,467 @@
+#ifndef CTHASH_TOOLS_INFLATE_HPP
+#define CTHASH_TOOLS_INFLATE_HPP
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+// minimal inflater of zlib streams (RFC 1950 and 1951), enough for git objects
+namespace inflate_detail {
+
+	struct bit_reader {
+		std::span<const std::byte> in;
+		size_t position{0u};
+		uint64_t bits{0u};
+		unsigned available{0u};
+
+		bool need(unsigned n) noexcept {
+			while (available < n) {
+				if (position == in.size()) {
+					return false;
+				}
+
+				bits |= static_cast<uint64_t>(in[position++]) << available;
+				available += 8u;
+			}
+
+			return true;
+		}
+
+		// loads as many bits as possible (up to 56)
+		void fill() noexcept {
+			while (available <= 48u && position != in.size()) {
+				bits |= static_cast<uint64_t>(in[position++]) << available;
+				available += 8u;
+			}
+		}
+
+		void drop(unsigned n) noexcept {
+			bits >>= n;
+			available -= n;
+		}
+
+		auto take(unsigned n) noexcept -> std::optional<uint32_t> {
+			if (not need(n)) {
+				return std::nullopt;
+			}
+
+			const auto value = static_cast<uint32_t>(bits & ((uint64_t{1} << n) - 1u));
+			drop(n);
+			return value;
+		}
+
+		// stored blocks start at byte boundary
+		void align() noexcept {
+			drop(available % 8u);
+		}
+
+		// appends `n` whole bytes of a stored block (after `align()`) to `out` directly from input, bytes which were
+		// already loaded into the bit buffer are taken from input again
+		auto copy_bytes(size_t n, std::vector<std::byte> & out) -> bool {
+			position -= available / 8u;
+			bits = 0u;
+			available = 0u;
+
+			if (in.size() - position < n) {
+				return false;
+			}
+
+			const auto data = in.subspan(position, n);
+			out.insert(out.end(), data.begin(), data.end());
+			position += n;
+			return true;
+		}
+
+		// number of bytes consumed by the stream so far (whole bytes which were loaded but not used are returned)
+		auto consumed() const noexcept -> size_t {
+			return position - available / 8u;
+		}
+	};
+
+	constexpr unsigned max_bits = 15u;
+	constexpr unsigned fast_bits = 10u;
+
+	// canonical Huffman code, short codes are decoded with a table, long ones bit by bit
+	struct huffman {
+		std::array<uint16_t, max_bits + 1u> count{};
+		std::array<uint16_t, 288> symbol{};
+		std::array<uint16_t, 1u << fast_bits> fast{}; // (length << 9) | symbol, zero if the code is longer
+
+		bool build(std::span<const uint8_t> lengths) noexcept {
+			count.fill(0u);
+			fast.fill(0u);
+
+			for (const uint8_t len: lengths) {
+				++count[len];
+			}
+
+			count[0] = 0u;
+
+			// over-subscribed set of lengths is invalid (incomplete one is allowed)
+			int left = 1;
+			for (unsigned len = 1u; len <= max_bits; ++len) {
+				left = left * 2 - count[len];
+				if (left < 0) {
+					return false;
+				}
+			}
+
+			std::array<uint16_t, max_bits + 2u> offsets{};
+			for (unsigned len = 1u; len <= max_bits; ++len) {
+				offsets[len + 1u] = static_cast<uint16_t>(offsets[len] + count[len]);
+			}
+
+			std::array<uint32_t, max_bits + 1u> next_code{};
+			uint32_t code = 0u;
+			for (unsigned len = 1u; len <= max_bits; ++len) {
+				code = (code + count[len - 1u]) << 1u;
+				next_code[len] = code;
+			}
+
+			for (size_t sym = 0; sym != lengths.size(); ++sym) {
+				const unsigned len = lengths[sym];
+
+				if (len == 0u) {
+					continue;
+				}
+
+				symbol[offsets[len]++] = static_cast<uint16_t>(sym);
+
+				const uint32_t c = next_code[len]++;
+
+				if (len <= fast_bits) {
+					// codes are stored from their most significant bit, table is indexed by stream order
+					uint32_t reversed = 0u;
+					for (unsigned i = 0; i != len; ++i) {
+						reversed |= ((c >> i) & 1u) << (len - 1u - i);
+					}
+
+					for (uint32_t i = reversed; i < fast.size(); i += (1u << len)) {
+						fast[i] = static_cast<uint16_t>((len << 9u) | sym);
+					}
+				}
+			}
+
+			return true;
+		}
+
+		auto decode(bit_reader & br) const noexcept -> std::optional<unsigned> {
+			br.fill();
+
+			if (br.available >= fast_bits) {
+				if (const uint16_t entry = fast[br.bits & ((1u << fast_bits) - 1u)]; entry != 0u) {
+					br.drop(entry >> 9u);
+					return entry & 0x1FFu;
+				}
+			}
+
+			// slow path: walk the canonical code bit by bit
+			int code = 0;
+			int first = 0;
+			int index = 0;
+
+			for (unsigned len = 1u; len <= max_bits; ++len) {
+				const auto bit = br.take(1u);
+
+				if (not bit) {
+					return std::nullopt;
+				}
+
+				code |= static_cast<int>(*bit);
+				const int n = count[len];
+
+				if (code - n < first) {
+					return symbol[static_cast<size_t>(index + (code - first))];
+				}
+
+				index += n;
+				first = (first + n) << 1;
+				code <<= 1;
+			}
+
+			return std::nullopt;
+		}
+	};
+
+	constexpr auto length_base = std::array<uint16_t, 29>{3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	constexpr auto length_extra = std::array<uint8_t, 29>{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	constexpr auto distance_base = std::array<uint16_t, 30>{1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+	constexpr auto distance_extra = std::array<uint8_t, 30>{0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+	inline bool codes(bit_reader & br, std::vector<std::byte> & out, size_t limit, const huffman & lit, const huffman & dist) {
+		for (;;) {
+			const auto sym = lit.decode(br);
+
+			if (not sym) {
+				return false;
+			}
+
+			if (*sym < 256u) {
+				if (out.size() == limit) {
+					return false;
+				}
+				out.push_back(static_cast<std::byte>(*sym));
+				continue;
+			}
+
+			if (*sym == 256u) {
+				return true;
+			}
+
+			const unsigned li = *sym - 257u;
+
+			if (li >= length_base.size()) {
+				return false;
+			}
+
+			const auto len_extra = br.take(length_extra[li]);
+			const auto dsym = dist.decode(br);
+
+			if (not len_extra || not dsym || *dsym >= distance_base.size()) {
+				return false;
+			}
+
+			const auto dist_extra = br.take(distance_extra[*dsym]);
+
+			if (not dist_extra) {
+				return false;
+			}
+
+			const size_t length = length_base[li] + *len_extra;
+			const size_t distance = distance_base[*dsym] + *dist_extra;
+
+			if (distance > out.size() || out.size() + length > limit) {
+				return false;
+			}
+
+			// source can overlap with destination (that's how runs are encoded)
+			const size_t from = out.size() - distance;
+			for (size_t i = 0; i != length; ++i) {
+				out.push_back(out[from + i]);
+			}
+		}
+	}
+
+	inline auto fixed_tables() -> const std::pair<huffman, huffman> & {
+		static const auto tables = [] {
+			std::array<uint8_t, 288> lengths{};
+			std::fill(lengths.begin(), lengths.begin() + 144, uint8_t{8});
+			std::fill(lengths.begin() + 144, lengths.begin() + 256, uint8_t{9});
+			std::fill(lengths.begin() + 256, lengths.begin() + 280, uint8_t{7});
+			std::fill(lengths.begin() + 280, lengths.end(), uint8_t{8});
+
+			std::array<uint8_t, 30> distances{};
+			distances.fill(5u);
+
+			std::pair<huffman, huffman> out;
+			out.first.build(lengths);
+			out.second.build(distances);
+			return out;
+		}();
+
+		return tables;
+	}
+
+	inline bool dynamic(bit_reader & br, std::vector<std::byte> & out, size_t limit) {
+		constexpr auto order = std::array<uint8_t, 19>{16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+		const auto hlit = br.take(5u);
+		const auto hdist = br.take(5u);
+		const auto hclen = br.take(4u);
+
+		if (not hlit || not hdist || not hclen || *hlit > 29u || *hdist > 29u) {
+			return false;
+		}
+
+		const size_t nlen = *hlit + 257u;
+		const size_t ndist = *hdist + 1u;
+
+		std::array<uint8_t, 19> code_lengths{};
+		for (size_t i = 0; i != *hclen + 4u; ++i) {
+			const auto v = br.take(3u);
+			if (not v) {
+				return false;
+			}
+			code_lengths[order[i]] = static_cast<uint8_t>(*v);
+		}
+
+		huffman code_lengths_code;
+		if (not code_lengths_code.build(code_lengths)) {
+			return false;
+		}
+
+		std::array<uint8_t, 320> lengths{};
+
+		for (size_t i = 0; i < nlen + ndist;) {
+			const auto sym = code_lengths_code.decode(br);
+
+			if (not sym) {
+				return false;
+			}
+
+			if (*sym < 16u) {
+				lengths[i++] = static_cast<uint8_t>(*sym);
+				continue;
+			}
+
+			// 16 repeats previous length 3-6 times, 17 and 18 repeat zero 3-10 and 11-138 times
+			uint8_t value = 0u;
+			const unsigned extra = (*sym == 16u) ? 2u : (*sym == 17u) ? 3u : 7u;
+			const uint32_t minimum = (*sym == 18u) ? 11u : 3u;
+
+			if (*sym == 16u) {
+				if (i == 0u) {
+					return false;
+				}
+				value = lengths[i - 1u];
+			}
+
+			const auto repeat = br.take(extra);
+
+			if (not repeat || i + *repeat + minimum > nlen + ndist) {
+				return false;
+			}
+
+			for (uint32_t r = 0; r != *repeat + minimum; ++r) {
+				lengths[i++] = value;
+			}
+		}
+
+		// end-of-block code must be present
+		if (lengths[256] == 0u) {
+			return false;
+		}
+
+		huffman lit;
+		huffman dist;
+
+		if (not lit.build(std::span(lengths).first(nlen)) || not dist.build(std::span(lengths).subspan(nlen, ndist))) {
+			return false;
+		}
+
+		return codes(br, out, limit, lit, dist);
+	}
+
+	inline auto adler32(std::span<const std::byte> in) noexcept -> uint32_t {
+		constexpr uint32_t mod = 65521u;
+		// largest number of bytes before sums can overflow
+		constexpr size_t run = 5552u;
+
+		uint32_t a = 1u;
+		uint32_t b = 0u;
+
+		while (not in.empty()) {
+			const auto part = in.first(std::min(in.size(), run));
+
+			for (const std::byte v: part) {
+				a += static_cast<uint32_t>(v);
+				b += a;
+			}
+
+			a %= mod;
+			b %= mod;
+			in = in.subspan(part.size());
+		}
+
+		return (b << 16u) | a;
+	}
+
+} // namespace inflate_detail
+
+// the best ratio of deflate: one length code of 258 bytes with its distance can be coded in two bits
+constexpr size_t max_deflate_ratio = 1032u;
+
+// upper bound of inflated size of `compressed` bytes of zlib stream
+constexpr auto max_inflated_size(size_t compressed) noexcept -> size_t {
+	return (compressed > SIZE_MAX / max_deflate_ratio) ? SIZE_MAX : compressed * max_deflate_ratio;
+}
+
+// inflates zlib stream into `out` (at most `limit` bytes), returns number of consumed bytes of input
+inline auto zlib_inflate(std::span<const std::byte> in, std::vector<std::byte> & out, size_t limit) -> std::optional<size_t> {
+	using namespace inflate_detail;
+
+	// `limit` can come from untrusted header, so only usual ratio of the input is reserved (`out` grows past it)
+	out.clear();
+	out.reserve(std::min(limit, in.size() * 4u));
+
+	if (in.size() < 2u) {
+		return std::nullopt;
+	}
+
+	const auto cmf = static_cast<unsigned>(in[0]);
+	const auto flg = static_cast<unsigned>(in[1]);
+
+	// deflate method, no preset dictionary and valid header check
+	if ((cmf & 0x0Fu) != 8u || (flg & 0x20u) != 0u || ((cmf << 8u) | flg) % 31u != 0u) {
+		return std::nullopt;
+	}
+
+	auto br = bit_reader{in.subspan(2u)};
+
+	for (bool last = false; not last;) {
+		const auto header = br.take(3u);
+
+		if (not header) {
+			return std::nullopt;
+		}
+
+		last = (*header & 1u) != 0u;
+
+		switch (*header >> 1u) {
+		case 0u: {
+			br.align();
+			const auto len = br.take(16u);
+			const auto nlen = br.take(16u);
+
+			if (not len || not nlen || (*len ^ 0xFFFFu) != *nlen || out.size() + *len > limit) {
+				return std::nullopt;
+			}
+
+			// stored data are copied from input at once
+			if (not br.copy_bytes(*len, out)) {
+				return std::nullopt;
+			}
+			break;
+		}
+		case 1u:
+			if (not codes(br, out, limit, fixed_tables().first, fixed_tables().second)) {
+				return std::nullopt;
+			}
+			break;
+		case 2u:
+			if (not dynamic(br, out, limit)) {
+				return std::nullopt;
+			}
+			break;
+		default:
+			return std::nullopt;
+		}
+	}
+
+	br.align();
+	const auto checksum = br.take(32u);
+
+	if (not checksum) {
+		return std::nullopt;
+	}
+
+	// checksum is stored big-endian
+	const uint32_t c = *checksum;
+	const uint32_t expected = (c >> 24u) | ((c >> 8u) & 0xFF00u) | ((c << 8u) & 0xFF0000u) | (c << 24u);
+
+	if (adler32(out) != expected) {
+		return std::nullopt;
+	}
+
+	return 2u + br.consumed();
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef CTHASH_TOOLS_IO_URING_HPP
+#define CTHASH_TOOLS_IO_URING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <span>
+#include <vector>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define CTHASH_TOOLS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace cthash::tools {
+
+// Minimal io_uring (called directly with syscalls, same as getdents64 in directory.hpp): operations are prepared,
+// submitted all at once with one syscall, which also waits for all of their completions. It's used for batches of
+// openat, statx, read and close of small files, which would otherwise cost a syscall each. When the kernel doesn't
+// support it (older than 5.6, disabled or filtered by seccomp) the ring isn't `valid()` and callers use the syscalls.
+struct io_ring {
+#ifdef CTHASH_TOOLS_IO_URING
+	int fd{-1};
+	unsigned capacity{0u};
+	unsigned prepared{0u};
+
+	// shared with the kernel
+	void * rings{MAP_FAILED}; // both submission and completion ring (one mapping)
+	size_t rings_size{0u};
+	io_uring_sqe * sqes{static_cast<io_uring_sqe *>(MAP_FAILED)};
+	size_t sqes_size{0u};
+
+	unsigned * sq_tail{nullptr};
+	unsigned sq_mask{0u};
+	unsigned * sq_array{nullptr};
+	unsigned * cq_head{nullptr};
+	unsigned * cq_tail{nullptr};
+	unsigned cq_mask{0u};
+	io_uring_cqe * cqes{nullptr};
+
+	explicit io_ring(unsigned entries) {
+		io_uring_params params{};
+
+		fd = static_cast<int>(syscall(SYS_io_uring_setup, entries, &params));
+
+		if (fd < 0) {
+			return;
+		}
+
+		// openat, statx and close came in 5.6 together with this feature, single mapping in 5.4
+		constexpr unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS;
+
+		if ((params.features & required) != required) {
+			release();
+			return;
+		}
+
+		rings_size = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+		rings = mmap(nullptr, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+
+		if (rings == MAP_FAILED || sqes == MAP_FAILED) {
+			release();
+			return;
+		}
+
+		const auto at = [](void * base, uint32_t offset) {
+			return reinterpret_cast<unsigned *>(static_cast<char *>(base) + offset);
+		};
+
+		sq_tail = at(rings, params.sq_off.tail);
+		sq_mask = *at(rings, params.sq_off.ring_mask);
+		sq_array = at(rings, params.sq_off.array);
+		cq_head = at(rings, params.cq_off.head);
+		cq_tail = at(rings, params.cq_off.tail);
+		cq_mask = *at(rings, params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(rings) + params.cq_off.cqes);
+
+		capacity = params.sq_entries;
+	}
+
+	io_ring(const io_ring &) = delete;
+	io_ring(io_ring &&) = delete;
+
+	~io_ring() {
+		release();
+	}
+
+	bool valid() const noexcept {
+		return capacity != 0u;
+	}
+
+	// number of operations which can be prepared before `run`
+	auto free() const noexcept -> unsigned {
+		return capacity - prepared;
+	}
+
+	void openat(int dirfd, const char * name, int flags, uint64_t user_data) noexcept {
+		auto & sqe = prepare(IORING_OP_OPENAT, dirfd, user_data);
+		sqe.addr = reinterpret_cast<uintptr_t>(name);
+		sqe.open_flags = static_cast<uint32_t>(flags);
+	}
+
+	void statx(int dirfd, const char * name, int flags, unsigned mask, struct statx * out, uint64_t user_data) noexcept {
+		auto & sqe = prepare(IORING_OP_STATX, dirfd, user_data);
+		sqe.addr = reinterpret_cast<uintptr_t>(name);
+		sqe.len = mask;
+		sqe.off = reinterpret_cast<uintptr_t>(out);
+		sqe.statx_flags = static_cast<uint32_t>(flags);
+	}
+
+	void read(int file, std::span<std::byte> out, uint64_t offset, uint64_t user_data) noexcept {
+		auto & sqe = prepare(IORING_OP_READ, file, user_data);
+		sqe.addr = reinterpret_cast<uintptr_t>(out.data());
+		sqe.len = static_cast<uint32_t>(out.size());
+		sqe.off = offset;
+	}
+
+	void close(int file, uint64_t user_data) noexcept {
+		prepare(IORING_OP_CLOSE, file, user_data);
+	}
+
+	// submits prepared operations, waits for all of them and calls `cb(user_data, result)` for each (result is
+	// same as return value of the syscall, or negative errno), false when the ring itself fails
+	template <typename CB> bool run(CB && cb) {
+		const unsigned expected = prepared;
+		unsigned submitted = 0u;
+		unsigned completed = 0u;
+
+		std::atomic_ref<unsigned>{*sq_tail}.store(*sq_tail + prepared, std::memory_order_release);
+		prepared = 0u;
+
+		while (completed != expected) {
+			const auto r = syscall(SYS_io_uring_enter, fd, expected - submitted, 1u, IORING_ENTER_GETEVENTS, nullptr, 0u);
+
+			if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				// state of the ring isn't known anymore, so it's not used again
+				release();
+				return false;
+			}
+
+			submitted += (r > 0) ? static_cast<unsigned>(r) : 0u;
+
+			unsigned head = *cq_head;
+			const unsigned tail = std::atomic_ref<unsigned>{*cq_tail}.load(std::memory_order_acquire);
+
+			for (; head != tail; ++head, ++completed) {
+				const auto & cqe = cqes[head & cq_mask];
+				cb(cqe.user_data, cqe.res);
+			}
+
+			std::atomic_ref<unsigned>{*cq_head}.store(head, std::memory_order_release);
+		}
+
+		return true;
+	}
+
+private:
+	auto prepare(uint8_t opcode, int target, uint64_t user_data) noexcept -> io_uring_sqe & {
+		const unsigned index = (*sq_tail + prepared) & sq_mask;
+		++prepared;
+
+		auto & sqe = sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = opcode;
+		sqe.fd = target;
+		sqe.user_data = user_data;
+		sq_array[index] = index;
+		return sqe;
+	}
+
+	void release() noexcept {
+		if (sqes != MAP_FAILED) {
+			munmap(sqes, sqes_size);
+			sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+		}
+
+		if (rings != MAP_FAILED) {
+			munmap(rings, rings_size);
+			rings = MAP_FAILED;
+		}
+
+		if (fd >= 0) {
+			::close(fd);
+		}
+
+		fd = -1;
+		capacity = 0u;
+	}
+#else
+	explicit io_ring(unsigned) { }
+
+	bool valid() const noexcept {
+		return false;
+	}
+
+	auto free() const noexcept -> unsigned {
+		return 0u;
+	}
+
+	void openat(int, const char *, int, uint64_t) noexcept { }
+	void read(int, std::span<std::byte>, uint64_t, uint64_t) noexcept { }
+	void close(int, uint64_t) noexcept { }
+
+	template <typename CB> bool run(CB &&) {
+		return false;
+	}
+#endif
+};
+
+// does an operation for each of `count` items: `submit(ring, i)` prepares it in the ring and `call(i)` does it with
+// a syscall (without usable ring or after the ring failed), `done(i, result)` is called for each of them
+template <typename Submit, typename Call, typename Done> void for_each_operation(io_ring * ring, size_t count, Submit && submit, Call && call, Done && done) {
+	std::vector<bool> finished(count, false);
+
+	for (size_t first = 0u; ring != nullptr && ring->valid() && first != count;) {
+		const size_t last = std::min(count, first + ring->free());
+
+		for (size_t i = first; i != last; ++i) {
+			submit(*ring, i);
+		}
+
+		const bool ok = ring->run([&](uint64_t i, int result) {
+			finished[i] = true;
+			done(static_cast<size_t>(i), result);
+		});
+
+		// operations without completion could have been done by the kernel already, so they fail instead of being
+		// repeated (which could leak a descriptor from openat or close a descriptor reused by another thread)
+		for (size_t i = first; not ok && i != last; ++i) {
+			if (not finished[i]) {
+				finished[i] = true;
+				done(i, -EIO);
+			}
+		}
+
+		first = last;
+	}
+
+	for (size_t i = 0; i != count; ++i) {
+		if (not finished[i]) {
+			done(i, call(i));
+		}
+	}
+}
+
+} // namespace cthash::tools
+
+#endif
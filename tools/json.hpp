@@ -0,0 +1,29 @@
+#ifndef CTHASH_TOOLS_JSON_HPP
+#define CTHASH_TOOLS_JSON_HPP
+
+#include <ostream>
+#include <string_view>
+
+namespace cthash::tools {
+
+inline void write_json_string(std::ostream & os, std::string_view in) {
+	constexpr auto hex = std::string_view{"0123456789abcdef"};
+
+	os << '"';
+
+	for (const char c: in) {
+		if (c == '"' || c == '\\') {
+			os << '\\' << c;
+		} else if (static_cast<unsigned char>(c) < 0x20u) {
+			os << "\\u00" << hex[static_cast<unsigned char>(c) >> 4u] << hex[static_cast<unsigned char>(c) & 0xFu];
+		} else {
+			os << c;
+		}
+	}
+
+	os << '"';
+}
+
+} // namespace cthash::tools
+
+#endif
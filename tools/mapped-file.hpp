@@ -0,0 +1,111 @@
+#ifndef CTHASH_TOOLS_MAPPED_FILE_HPP
+#define CTHASH_TOOLS_MAPPED_FILE_HPP
+
+#include <span>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cthash::tools {
+
+// identity and version of file content as seen by the filesystem
+struct file_metadata {
+	uint64_t device{0u};
+	uint64_t inode{0u};
+	uint64_t size{0u};
+	int64_t mtime_ns{0};
+	int64_t ctime_ns{0};
+
+	static auto from_stat(const struct stat & st) noexcept -> file_metadata {
+#ifdef __APPLE__
+		const auto & mtime = st.st_mtimespec;
+		const auto & ctime = st.st_ctimespec;
+#else
+		const auto & mtime = st.st_mtim;
+		const auto & ctime = st.st_ctim;
+#endif
+		return {
+			.device = static_cast<uint64_t>(st.st_dev),
+			.inode = static_cast<uint64_t>(st.st_ino),
+			.size = static_cast<uint64_t>(st.st_size),
+			.mtime_ns = static_cast<int64_t>(mtime.tv_sec) * 1'000'000'000 + static_cast<int64_t>(mtime.tv_nsec),
+			.ctime_ns = static_cast<int64_t>(ctime.tv_sec) * 1'000'000'000 + static_cast<int64_t>(ctime.tv_nsec),
+		};
+	}
+
+	friend bool operator==(const file_metadata &, const file_metadata &) noexcept = default;
+};
+
+struct input_file {
+	static constexpr int invalid = -1;
+
+	int fd{invalid};
+	file_metadata metadata{};
+
+	explicit input_file(const char * path): input_file(AT_FDCWD, path) { }
+
+	input_file(int dirfd, const char * path): fd{openat(dirfd, path, O_RDONLY | O_CLOEXEC)} {
+		struct stat st;
+
+		if (fd != invalid && fstat(fd, &st) == 0) {
+			metadata = file_metadata::from_stat(st);
+		}
+	}
+
+	input_file(const input_file &) = delete;
+	input_file(input_file &&) = delete;
+
+	~input_file() {
+		if (fd != invalid) {
+			close(fd);
+		}
+	}
+
+	bool valid() const noexcept {
+		return fd != invalid;
+	}
+};
+
+struct mapped_file {
+	size_t sz{0};
+	void * ptr{nullptr};
+
+	static void * map(int fd, size_t sz, uint64_t offset = 0u) noexcept {
+		// mmap can't map empty files
+		if (sz == 0u) {
+			return nullptr;
+		}
+
+		void * r = mmap(nullptr, sz, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+		return (r != MAP_FAILED) ? r : nullptr;
+	}
+
+	mapped_file(int fd, size_t size): sz{size}, ptr{map(fd, sz)} { }
+	// window of `size` bytes from `offset` (which must be multiple of page size)
+	mapped_file(int fd, size_t size, uint64_t offset): sz{size}, ptr{map(fd, sz, offset)} { }
+	explicit mapped_file(const input_file & f): mapped_file(f.fd, static_cast<size_t>(f.metadata.size)) { }
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file(mapped_file &&) = delete;
+
+	~mapped_file() {
+		if (ptr) {
+			munmap(ptr, sz);
+		}
+	}
+
+	bool valid() const noexcept {
+		return ptr != nullptr || sz == 0u;
+	}
+
+	auto get_span() const noexcept {
+		return std::span<const std::byte>(reinterpret_cast<const std::byte *>(ptr), ptr ? sz : 0u);
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef CTHASH_TOOLS_MMR_HPP
+#define CTHASH_TOOLS_MMR_HPP
+
+#include "multi-buffer.hpp"
+#include "thread-pool.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cthash::tools {
+
+// Merkle Mountain Range: append-only accumulator of log entries, a list of perfect binary trees (mountains) whose
+// sizes are the set bits of number of leaves. Nodes are numbered in post-order and stored in a mapped file, so
+// appending writes only new nodes (one merge per append on average) and proofs read only the nodes on their paths.
+// Peaks are kept in memory together with bags of their prefixes (bag of peaks 0..i), so the root after an append
+// costs one more hash: only peaks at the end are replaced by an append.
+//
+// Hashes are domain separated: leaf is H(0x00 || entry), node H(0x01 || left || right) and bag of peaks is folded
+// from the left as H(0x02 || bag || peak). Root of an empty range is H() of nothing.
+//
+// The file is a header followed by digests of nodes (native endianness), number of leaves in the header is written
+// after nodes of an append, so a crashed append is not visible. One writer at a time, proofs must not run
+// concurrently with appends (the mapping can move).
+template <typename Hasher> struct merkle_mountain_range {
+	using digest = decltype(Hasher{}.final());
+	static constexpr size_t digest_size = digest::digest_length;
+
+	static constexpr auto magic = std::array<char, 8>{'C', 'T', 'H', 'M', 'M', 'R', '0', '1'};
+
+	struct file_header {
+		std::array<char, 8> magic;
+		uint64_t digest_size;
+		uint64_t leaves;
+	};
+
+	// nodes start at a cache line
+	static constexpr size_t nodes_offset = 64u;
+	static_assert(sizeof(file_header) <= nodes_offset);
+
+	// nodes (positions) for `leaves` leaves
+	static constexpr auto node_count(uint64_t leaves) noexcept -> uint64_t {
+		return 2u * leaves - static_cast<uint64_t>(std::popcount(leaves));
+	}
+
+	// position of node at `height` covering leaves [index * 2^height, (index + 1) * 2^height): it's the last node
+	// written when its last leaf was appended, except for its ancestors completed at the same time
+	static constexpr auto position(unsigned height, uint64_t index) noexcept -> uint64_t {
+		const uint64_t end = (index + 1u) << height;
+		return node_count(end) - 1u - static_cast<uint64_t>(std::countr_zero(index + 1u));
+	}
+
+	// (height, index) of each peak from the left
+	static constexpr auto mountains(uint64_t leaves) noexcept -> std::vector<std::pair<unsigned, uint64_t>> {
+		std::vector<std::pair<unsigned, uint64_t>> out;
+
+		for (unsigned height = 64u; height-- != 0u;) {
+			if ((leaves >> height) & 1u) {
+				out.emplace_back(height, (leaves >> height) - 1u);
+			}
+		}
+
+		return out;
+	}
+
+	static auto hash_leaf(std::span<const std::byte> entry) noexcept -> digest {
+		return Hasher{}.update(std::span<const std::byte>(prefix<0x00>)).update(entry).final();
+	}
+
+	static auto hash_node(const digest & left, const digest & right) noexcept -> digest {
+		return Hasher{}.update(std::span<const std::byte>(prefix<0x01>)).update(std::span<const std::byte>(left)).update(std::span<const std::byte>(right)).final();
+	}
+
+	static auto hash_bag(const digest & bag, const digest & peak) noexcept -> digest {
+		return Hasher{}.update(std::span<const std::byte>(prefix<0x02>)).update(std::span<const std::byte>(bag)).update(std::span<const std::byte>(peak)).final();
+	}
+
+	static auto bag_of(std::span<const digest> peaks) noexcept -> digest {
+		if (peaks.empty()) {
+			return Hasher{}.final();
+		}
+
+		digest out = peaks.front();
+		for (const auto & peak: peaks.subspan(1u)) {
+			out = hash_bag(out, peak);
+		}
+		return out;
+	}
+
+	// siblings from a node up to its peak (bottom up) with peaks of the whole range
+	struct inclusion_proof {
+		uint64_t leaves;
+		uint64_t leaf_index;
+		std::vector<digest> path;
+		std::vector<digest> peaks;
+	};
+
+	// peaks of the old range, each with its path up to a peak of the new range
+	struct consistency_proof {
+		uint64_t old_leaves;
+		uint64_t new_leaves;
+		std::vector<digest> old_peaks;
+		std::vector<std::vector<digest>> paths;
+		std::vector<digest> new_peaks;
+	};
+
+	// node with `index` in its level hashed with siblings from `path` up to its peak
+	static auto climb(digest node, uint64_t index, std::span<const digest> path) noexcept -> digest {
+		for (const auto & sibling: path) {
+			node = (index & 1u) ? hash_node(sibling, node) : hash_node(node, sibling);
+			index >>= 1u;
+		}
+		return node;
+	}
+
+	// which peak (of mountains of `leaves`) covers node (`height`, `index`) and the height of that peak
+	static constexpr auto peak_of(uint64_t leaves, unsigned height, uint64_t index) noexcept -> std::optional<std::pair<size_t, unsigned>> {
+		const uint64_t first_leaf = index << height;
+		uint64_t start = 0u;
+		size_t i = 0u;
+
+		for (const auto & [h, q]: mountains(leaves)) {
+			const uint64_t end = start + (uint64_t{1} << h);
+			if (first_leaf >= start && first_leaf < end) {
+				return (h >= height) ? std::optional{std::pair{i, h}} : std::nullopt;
+			}
+			start = end;
+			++i;
+		}
+
+		return std::nullopt;
+	}
+
+	static auto verify(const digest & root, std::span<const std::byte> entry, const inclusion_proof & proof) noexcept -> bool {
+		return verify_leaf(root, hash_leaf(entry), proof);
+	}
+
+	static auto verify_leaf(const digest & root, const digest & leaf, const inclusion_proof & proof) noexcept -> bool {
+		const auto peak = peak_of(proof.leaves, 0u, proof.leaf_index);
+
+		if (proof.leaf_index >= proof.leaves || not peak || proof.peaks.size() != mountains(proof.leaves).size() || proof.path.size() != peak->second) {
+			return false;
+		}
+
+		return climb(leaf, proof.leaf_index, proof.path) == proof.peaks[peak->first] && bag_of(proof.peaks) == root;
+	}
+
+	static auto verify(const digest & old_root, const digest & new_root, const consistency_proof & proof) noexcept -> bool {
+		const auto old_mountains = mountains(proof.old_leaves);
+		const auto new_mountains = mountains(proof.new_leaves);
+
+		if (proof.old_leaves > proof.new_leaves || proof.old_peaks.size() != old_mountains.size() || proof.paths.size() != old_mountains.size() || proof.new_peaks.size() != new_mountains.size()) {
+			return false;
+		}
+
+		if (bag_of(proof.old_peaks) != old_root || bag_of(proof.new_peaks) != new_root) {
+			return false;
+		}
+
+		for (size_t i = 0; i != old_mountains.size(); ++i) {
+			const auto [height, index] = old_mountains[i];
+			const auto peak = peak_of(proof.new_leaves, height, index);
+
+			if (not peak || proof.paths[i].size() != peak->second - height || climb(proof.old_peaks[i], index, proof.paths[i]) != proof.new_peaks[peak->first]) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// state
+	std::string path;
+	int fd{-1};
+	std::byte * mapping{nullptr};
+	size_t mapped_size{0u};
+	uint64_t leaves{0u};
+	std::vector<digest> peaks{};
+	std::vector<digest> bags{};
+
+	// opens (or creates) the file, nothing is usable when `valid()` is false
+	explicit merkle_mountain_range(std::string p): path{std::move(p)} {
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+		if (fd < 0) {
+			return;
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close_file();
+			return;
+		}
+
+		const auto size = static_cast<size_t>(st.st_size);
+
+		if (size == 0u) {
+			if (not remap(nodes_offset + 1024u * digest_size)) {
+				return;
+			}
+			const auto hdr = file_header{.magic = magic, .digest_size = digest_size, .leaves = 0u};
+			std::memcpy(mapping, &hdr, sizeof(hdr));
+			return;
+		}
+
+		if (size < nodes_offset || not remap(size)) {
+			close_file();
+			return;
+		}
+
+		file_header hdr;
+		std::memcpy(&hdr, mapping, sizeof(hdr));
+
+		if (hdr.magic != magic || hdr.digest_size != digest_size || nodes_offset + node_count(hdr.leaves) * digest_size > size) {
+			close_file();
+			return;
+		}
+
+		leaves = hdr.leaves;
+		rebuild_peaks(0u);
+	}
+
+	merkle_mountain_range(const merkle_mountain_range &) = delete;
+	merkle_mountain_range(merkle_mountain_range &&) = delete;
+
+	~merkle_mountain_range() {
+		close_file();
+	}
+
+	auto valid() const noexcept -> bool {
+		return fd >= 0 && mapping != nullptr;
+	}
+
+	auto size() const noexcept -> uint64_t {
+		return leaves;
+	}
+
+	auto root() const noexcept -> digest {
+		return bags.empty() ? Hasher{}.final() : bags.back();
+	}
+
+	auto node(uint64_t pos) const noexcept -> digest {
+		digest out;
+		std::memcpy(out.data(), mapping + nodes_offset + pos * digest_size, digest_size);
+		return out;
+	}
+
+	auto node(unsigned height, uint64_t index) const noexcept -> digest {
+		return node(position(height, index));
+	}
+
+	void store(uint64_t pos, const digest & d) noexcept {
+		std::memcpy(mapping + nodes_offset + pos * digest_size, d.data(), digest_size);
+	}
+
+	void store(uint64_t pos, std::span<const std::byte, digest_size> d) noexcept {
+		std::memcpy(mapping + nodes_offset + pos * digest_size, d.data(), digest_size);
+	}
+
+	auto append(std::span<const std::byte> entry) -> bool {
+		const auto one = std::array{entry};
+		return append(std::span<const std::span<const std::byte>>(one));
+	}
+
+	// new leaves are hashed first, then new nodes level by level (all of one level are independent, so they are hashed
+	// at once in lanes of multi-buffer kernel when Hasher has it), with `pool` large levels are split between its
+	// workers and the calling thread
+	auto append(std::span<const std::span<const std::byte>> entries, thread_pool * pool = nullptr) -> bool {
+		if (entries.empty()) {
+			return true;
+		}
+
+		const uint64_t old_leaves = leaves;
+		const uint64_t new_leaves = leaves + entries.size();
+
+		if (not reserve(nodes_offset + node_count(new_leaves) * digest_size)) {
+			return false;
+		}
+
+		// nodes hashed by one task
+		constexpr size_t chunk = 1024u;
+
+		for_each_chunk(pool, entries.size(), chunk, [&](size_t begin, size_t end) {
+			if constexpr (has_multi_buffer<Hasher>) {
+				const auto size = [&](size_t i) { return 1u + entries[begin + i].size(); };
+				const auto write = [&](size_t i, std::byte * out) {
+					out[0] = prefix<0x00>[0];
+					std::ranges::copy(entries[begin + i], out + 1);
+				};
+
+				hash_assembled<Hasher>(end - begin, size, write, [&](size_t i, std::span<const std::byte, digest_size> d) { store(position(0u, old_leaves + begin + i), d); });
+			} else {
+				for (size_t i = begin; i != end; ++i) {
+					store(position(0u, old_leaves + i), hash_leaf(entries[i]));
+				}
+			}
+		});
+
+		// a new node needs a new right child, so the first level without new nodes ends the batch
+		for (unsigned height = 1u;; ++height) {
+			const uint64_t first = old_leaves >> height;
+			const uint64_t last = new_leaves >> height;
+
+			if (first >= last) {
+				break;
+			}
+
+			for_each_chunk(pool, static_cast<size_t>(last - first), chunk, [&, height, first](size_t begin, size_t end) {
+				if constexpr (has_multi_buffer<Hasher>) {
+					const auto size = [](size_t) { return 1u + 2u * digest_size; };
+					const auto write = [&](size_t i, std::byte * out) {
+						const uint64_t index = first + begin + i;
+						out[0] = prefix<0x01>[0];
+						std::memcpy(out + 1, mapping + nodes_offset + position(height - 1u, 2u * index) * digest_size, digest_size);
+						std::memcpy(out + 1 + digest_size, mapping + nodes_offset + position(height - 1u, 2u * index + 1u) * digest_size, digest_size);
+					};
+
+					hash_assembled<Hasher>(end - begin, size, write, [&](size_t i, std::span<const std::byte, digest_size> d) { store(position(height, first + begin + i), d); });
+				} else {
+					for (size_t i = begin; i != end; ++i) {
+						const uint64_t index = first + i;
+						store(position(height, index), hash_node(node(height - 1u, 2u * index), node(height - 1u, 2u * index + 1u)));
+					}
+				}
+			});
+		}
+
+		leaves = new_leaves;
+		std::memcpy(mapping + offsetof(file_header, leaves), &leaves, sizeof(leaves));
+
+		// peaks which cover only old leaves (with their bags) stay
+		size_t kept = 0u;
+		for (const auto & [height, index]: mountains(new_leaves)) {
+			if (((index + 1u) << height) > old_leaves) {
+				break;
+			}
+			++kept;
+		}
+
+		rebuild_peaks(kept);
+		return true;
+	}
+
+	// writes nodes and the header to the device
+	auto sync() const noexcept -> bool {
+		return msync(mapping, mapped_size, MS_SYNC) == 0;
+	}
+
+	auto prove(uint64_t leaf_index) const -> std::optional<inclusion_proof> {
+		const auto peak = peak_of(leaves, 0u, leaf_index);
+
+		if (leaf_index >= leaves || not peak) {
+			return std::nullopt;
+		}
+
+		return inclusion_proof{.leaves = leaves, .leaf_index = leaf_index, .path = path_to_peak(0u, leaf_index, peak->second), .peaks = peaks};
+	}
+
+	// proves that range of `old_leaves` leaves is a prefix of the current one
+	auto prove_consistency(uint64_t old_leaves) const -> std::optional<consistency_proof> {
+		if (old_leaves > leaves) {
+			return std::nullopt;
+		}
+
+		consistency_proof out{.old_leaves = old_leaves, .new_leaves = leaves, .old_peaks = {}, .paths = {}, .new_peaks = peaks};
+
+		for (const auto & [height, index]: mountains(old_leaves)) {
+			const auto peak = peak_of(leaves, height, index);
+			out.old_peaks.push_back(node(height, index));
+			out.paths.push_back(path_to_peak(height, index, peak->second));
+		}
+
+		return out;
+	}
+
+private:
+	template <uint8_t Value> static constexpr auto prefix = std::array{std::byte{Value}};
+
+	auto path_to_peak(unsigned height, uint64_t index, unsigned peak_height) const -> std::vector<digest> {
+		std::vector<digest> out;
+
+		for (; height != peak_height; ++height, index >>= 1u) {
+			out.push_back(node(height, index ^ 1u));
+		}
+
+		return out;
+	}
+
+	// peaks from `first` on are read from the file and their bags recomputed
+	void rebuild_peaks(size_t first) {
+		peaks.resize(first);
+		bags.resize(first);
+
+		const auto all = mountains(leaves);
+
+		for (size_t i = first; i != all.size(); ++i) {
+			peaks.push_back(node(all[i].first, all[i].second));
+			bags.push_back(bags.empty() ? peaks.back() : hash_bag(bags.back(), peaks.back()));
+		}
+	}
+
+	// capacity grows twice, so remapping is amortized too
+	auto reserve(size_t bytes) -> bool {
+		return bytes <= mapped_size || remap(std::max(bytes, mapped_size * 2u));
+	}
+
+	// the old mapping stays valid until the new one exists, so a failed growth keeps the range usable
+	auto remap(size_t bytes) -> bool {
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) < bytes && ftruncate(fd, static_cast<off_t>(bytes)) != 0)) {
+			return false;
+		}
+
+		void * p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		if (p == MAP_FAILED) {
+			return false;
+		}
+
+		if (mapping != nullptr) {
+			munmap(mapping, mapped_size);
+		}
+
+		mapping = static_cast<std::byte *>(p);
+		mapped_size = bytes;
+		return true;
+	}
+
+	void close_file() noexcept {
+		if (mapping != nullptr) {
+			munmap(mapping, mapped_size);
+			mapping = nullptr;
+		}
+
+		if (fd >= 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
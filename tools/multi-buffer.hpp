@@ -0,0 +1,245 @@
+#ifndef CTHASH_TOOLS_MULTI_BUFFER_HPP
+#define CTHASH_TOOLS_MULTI_BUFFER_HPP
+
+#include <cthash/sha2/sha224.hpp>
+#include <cthash/sha2/sha256.hpp>
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CTHASH_TOOLS_MULTI_BUFFER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cthash::tools {
+
+// Multi-buffer SHA-256 (and SHA-224): many independent inputs are hashed at once, each of 8 lanes of AVX2 registers
+// compresses blocks of another input, and a lane whose input is finished takes the next one, so inputs of different
+// lengths keep all lanes busy. It pays off for small inputs (files of few KiB), where one hasher per input can't
+// use more than one lane. Without AVX2 the inputs are hashed one by one.
+template <typename Config> struct sha2_lanes {
+	static constexpr size_t lanes = 8u;
+	static constexpr size_t block_size = 64u;
+	static constexpr size_t digest_size = cthash::internal::digest_bytes_length_of<Config>;
+
+	// state of all lanes, word `w` of lane `l` is in `words[w][l]` (so one word of all lanes is one register)
+	struct alignas(32) state {
+		std::array<std::array<uint32_t, lanes>, 8> words;
+	};
+
+	// blocks of one input: its whole blocks are read from the input, rest and padding (one or two blocks) from `tail`
+	struct lane {
+		std::span<const std::byte> input{};
+		size_t index{0u};
+		size_t block{0u};
+		size_t blocks{0u};
+		bool active{false};
+		alignas(32) std::array<std::byte, 2u * block_size> tail{};
+
+		void start(std::span<const std::byte> in, size_t position) noexcept {
+			input = in;
+			index = position;
+			block = 0u;
+			active = true;
+
+			const size_t whole = in.size() / block_size;
+			const size_t rest = in.size() % block_size;
+			const size_t tail_blocks = (rest + 9u <= block_size) ? 1u : 2u;
+			blocks = whole + tail_blocks;
+
+			tail = {};
+			std::copy_n(in.data() + whole * block_size, rest, tail.begin());
+			tail[rest] = std::byte{0x80};
+
+			const uint64_t bits = static_cast<uint64_t>(in.size()) * 8u;
+			for (size_t i = 0; i != 8u; ++i) {
+				tail[tail_blocks * block_size - 1u - i] = static_cast<std::byte>(bits >> (i * 8u));
+			}
+		}
+
+		auto next() noexcept -> const std::byte * {
+			const size_t whole = input.size() / block_size;
+			const size_t b = block++;
+			return (b < whole) ? input.data() + b * block_size : tail.data() + (b - whole) * block_size;
+		}
+
+		bool finished() const noexcept {
+			return block == blocks;
+		}
+	};
+
+	static auto available() noexcept -> bool {
+#ifdef CTHASH_TOOLS_MULTI_BUFFER_X86
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+	// calls `out(i, digest)` for each of `inputs` (in order in which they are finished)
+	template <typename Out> static void hash(std::span<const std::span<const std::byte>> inputs, Out && out) {
+#ifdef CTHASH_TOOLS_MULTI_BUFFER_X86
+		// with only one input there is nothing to run in parallel
+		if (inputs.size() > 1u && available()) {
+			hash_lanes(inputs, out);
+			return;
+		}
+#endif
+		for (size_t i = 0; i != inputs.size(); ++i) {
+			const auto digest = cthash::hasher<Config>{}.update(inputs[i]).final();
+			out(i, std::span<const std::byte, digest_size>(digest));
+		}
+	}
+
+#ifdef CTHASH_TOOLS_MULTI_BUFFER_X86
+	template <int N> [[gnu::target("avx2"), gnu::always_inline]] static inline auto rotr(__m256i x) noexcept -> __m256i {
+		return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+	}
+
+	// word `i` of each lane's block in big-endian
+	[[gnu::target("avx2"), gnu::always_inline]] static inline auto load_word(const std::array<const std::byte *, lanes> & blocks, size_t i) noexcept -> __m256i {
+		std::array<uint32_t, lanes> w;
+		for (size_t l = 0; l != lanes; ++l) {
+			std::memcpy(&w[l], blocks[l] + i * 4u, 4u);
+		}
+
+		const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		return _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(w.data())), swap);
+	}
+
+	[[gnu::target("avx2")]] static void compress(state & st, const std::array<const std::byte *, lanes> & blocks) noexcept {
+		__m256i v[8];
+		for (size_t i = 0; i != 8u; ++i) {
+			v[i] = _mm256_load_si256(reinterpret_cast<const __m256i *>(st.words[i].data()));
+		}
+
+		auto [a, b, c, d, e, f, g, h] = v;
+		__m256i w[16];
+
+		for (size_t t = 0; t != 64u; ++t) {
+			if (t < 16u) {
+				w[t] = load_word(blocks, t);
+			} else {
+				const __m256i w15 = w[(t - 15u) % 16u];
+				const __m256i w2 = w[(t - 2u) % 16u];
+				const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr<7>(w15), rotr<18>(w15)), _mm256_srli_epi32(w15, 3));
+				const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr<17>(w2), rotr<19>(w2)), _mm256_srli_epi32(w2, 10));
+				w[t % 16u] = _mm256_add_epi32(_mm256_add_epi32(w[t % 16u], s0), _mm256_add_epi32(w[(t - 7u) % 16u], s1));
+			}
+
+			const __m256i sum_e = _mm256_xor_si256(_mm256_xor_si256(rotr<6>(e), rotr<11>(e)), rotr<25>(e));
+			const __m256i choice = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+			const __m256i k = _mm256_set1_epi32(static_cast<int>(Config::constants[t]));
+			const __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(h, sum_e), _mm256_add_epi32(choice, k)), w[t % 16u]);
+
+			const __m256i sum_a = _mm256_xor_si256(_mm256_xor_si256(rotr<2>(a), rotr<13>(a)), rotr<22>(a));
+			const __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+			const __m256i t2 = _mm256_add_epi32(sum_a, majority);
+
+			h = g;
+			g = f;
+			f = e;
+			e = _mm256_add_epi32(d, t1);
+			d = c;
+			c = b;
+			b = a;
+			a = _mm256_add_epi32(t1, t2);
+		}
+
+		const __m256i result[8] = {a, b, c, d, e, f, g, h};
+		for (size_t i = 0; i != 8u; ++i) {
+			_mm256_store_si256(reinterpret_cast<__m256i *>(st.words[i].data()), _mm256_add_epi32(v[i], result[i]));
+		}
+	}
+
+	template <typename Out> static void hash_lanes(std::span<const std::span<const std::byte>> inputs, Out & out) {
+		// idle lanes compress this block and their results are ignored
+		alignas(32) static constexpr std::array<std::byte, block_size> idle{};
+
+		state st{};
+		std::array<lane, lanes> ls{};
+		size_t next_input = 0u;
+		size_t active = 0u;
+
+		const auto take_next = [&](size_t l) {
+			if (next_input == inputs.size()) {
+				ls[l].active = false;
+				return;
+			}
+
+			ls[l].start(inputs[next_input], next_input);
+			++next_input;
+			++active;
+
+			for (size_t i = 0; i != 8u; ++i) {
+				st.words[i][l] = Config::initial_values[i];
+			}
+		};
+
+		for (size_t l = 0; l != lanes; ++l) {
+			take_next(l);
+		}
+
+		std::array<const std::byte *, lanes> blocks;
+
+		while (active != 0u) {
+			for (size_t l = 0; l != lanes; ++l) {
+				blocks[l] = ls[l].active ? ls[l].next() : idle.data();
+			}
+
+			compress(st, blocks);
+
+			for (size_t l = 0; l != lanes; ++l) {
+				if (not ls[l].active || not ls[l].finished()) {
+					continue;
+				}
+
+				std::array<std::byte, 32> digest;
+				for (size_t i = 0; i != digest.size(); ++i) {
+					digest[i] = static_cast<std::byte>(st.words[i / 4u][l] >> (24u - (i % 4u) * 8u));
+				}
+
+				out(ls[l].index, std::span<const std::byte, digest_size>(digest.data(), digest_size));
+				--active;
+				take_next(l);
+			}
+		}
+	}
+#endif
+};
+
+// inputs of these hashers can be hashed with `multi_buffer<Hasher>::hash` (others have no specialization)
+template <typename Hasher> struct multi_buffer { };
+template <> struct multi_buffer<cthash::sha224>: sha2_lanes<cthash::sha224_config> { };
+template <> struct multi_buffer<cthash::sha256>: sha2_lanes<cthash::sha256_config> { };
+
+template <typename Hasher> concept has_multi_buffer = requires { multi_buffer<Hasher>::lanes; };
+
+// inputs assembled from more parts (like a prefix and digests of children): each of `count` inputs has `size(i)`
+// bytes which `write(i, out)` puts into one shared buffer, then all of them are hashed at once and `done(i, digest)`
+// is called in order of completion
+template <typename Hasher> void hash_assembled(size_t count, auto && size, auto && write, auto && done) requires has_multi_buffer<Hasher> {
+	std::vector<size_t> offsets(count + 1u, 0u);
+	for (size_t i = 0; i != count; ++i) {
+		offsets[i + 1u] = offsets[i] + size(i);
+	}
+
+	std::vector<std::byte> buffer(offsets.back());
+	std::vector<std::span<const std::byte>> inputs(count);
+
+	for (size_t i = 0; i != count; ++i) {
+		write(i, buffer.data() + offsets[i]);
+		inputs[i] = std::span<const std::byte>(buffer).subspan(offsets[i], offsets[i + 1u] - offsets[i]);
+	}
+
+	multi_buffer<Hasher>::hash(inputs, done);
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef CTHASH_TOOLS_NUMA_HPP
+#define CTHASH_TOOLS_NUMA_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace cthash::tools {
+
+// "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+inline auto parse_cpu_list(std::string_view in) -> std::vector<unsigned> {
+	std::vector<unsigned> out;
+
+	while (not in.empty()) {
+		const auto comma = in.find(',');
+		const auto item = in.substr(0, comma);
+		in = (comma == std::string_view::npos) ? std::string_view{} : in.substr(comma + 1u);
+
+		const auto dash = item.find('-');
+		const auto first = static_cast<unsigned>(std::strtoul(std::string(item.substr(0, dash)).c_str(), nullptr, 10));
+		const auto last = (dash == std::string_view::npos) ? first : static_cast<unsigned>(std::strtoul(std::string(item.substr(dash + 1u)).c_str(), nullptr, 10));
+
+		for (unsigned cpu = first; cpu <= last; ++cpu) {
+			out.push_back(cpu);
+		}
+	}
+
+	return out;
+}
+
+inline auto read_first_line(const std::string & path) -> std::optional<std::string> {
+	auto in = std::ifstream(path);
+	std::string line;
+
+	if (not std::getline(in, line)) {
+		return std::nullopt;
+	}
+
+	return line;
+}
+
+struct numa_node {
+	int id;
+	std::vector<unsigned> cpus;
+};
+
+// memory nodes with their CPUs as seen in sysfs, machine without NUMA is one node with all CPUs
+struct numa_topology {
+	std::vector<numa_node> nodes{};
+
+	static auto detect() -> numa_topology {
+		numa_topology out;
+
+#ifdef __linux__
+		if (const auto online = read_first_line("/sys/devices/system/node/online")) {
+			for (const unsigned id: parse_cpu_list(*online)) {
+				const auto cpus = read_first_line("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+
+				// memory-only nodes have no CPUs to run workers on
+				if (cpus && not cpus->empty()) {
+					out.nodes.push_back({static_cast<int>(id), parse_cpu_list(*cpus)});
+				}
+			}
+		}
+#endif
+
+		if (out.nodes.empty()) {
+			numa_node all{0, {}};
+			for (unsigned cpu = 0; cpu != std::max(std::thread::hardware_concurrency(), 1u); ++cpu) {
+				all.cpus.push_back(cpu);
+			}
+			out.nodes.push_back(std::move(all));
+		}
+
+		return out;
+	}
+
+	auto size() const noexcept -> size_t {
+		return nodes.size();
+	}
+
+	// index of node for worker `i` of `n`, workers are split between nodes proportionally to their CPUs
+	auto node_of_worker(size_t i, size_t n) const noexcept -> size_t {
+		size_t total = 0u;
+		for (const auto & node: nodes) {
+			total += node.cpus.size();
+		}
+
+		const size_t position = (i * total) / std::max(n, size_t{1});
+		size_t seen = 0u;
+
+		for (size_t idx = 0; idx != nodes.size(); ++idx) {
+			seen += nodes[idx].cpus.size();
+			if (position < seen) {
+				return idx;
+			}
+		}
+
+		return nodes.size() - 1u;
+	}
+
+	// index of node with given id (sysfs numbering can have gaps)
+	auto index_of(int id) const noexcept -> std::optional<size_t> {
+		for (size_t idx = 0; idx != nodes.size(); ++idx) {
+			if (nodes[idx].id == id) {
+				return idx;
+			}
+		}
+
+		return std::nullopt;
+	}
+};
+
+// lets the calling thread run only on given CPUs
+inline bool pin_current_thread(const std::vector<unsigned> & cpus) noexcept {
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (const unsigned cpu: cpus) {
+		if (cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+		}
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpus;
+	return false;
+#endif
+}
+
+// node of block device (from sysfs), remembered per device
+struct device_nodes {
+	const numa_topology & topology;
+
+	std::mutex mutex{};
+	std::unordered_map<uint64_t, std::optional<size_t>> known{};
+
+	explicit device_nodes(const numa_topology & t): topology{t} { }
+
+	auto lookup(uint64_t device) -> std::optional<size_t> {
+		if (topology.size() < 2u) {
+			return std::nullopt;
+		}
+
+		std::lock_guard lock{mutex};
+
+		if (const auto it = known.find(device); it != known.end()) {
+			return it->second;
+		}
+
+		return known[device] = discover(device);
+	}
+
+	auto discover([[maybe_unused]] uint64_t device) const -> std::optional<size_t> {
+#ifdef __linux__
+		const auto base = "/sys/dev/block/" + std::to_string(major(static_cast<dev_t>(device))) + ":" + std::to_string(minor(static_cast<dev_t>(device)));
+
+		// partitions don't have `device` link, their disk (parent directory) has
+		for (const auto * path: {"/device/numa_node", "/../device/numa_node"}) {
+			if (const auto line = read_first_line(base + path)) {
+				const int id = std::atoi(line->c_str());
+				// -1 means the device is not attached to any specific node
+				return (id >= 0) ? topology.index_of(id) : std::nullopt;
+			}
+		}
+#endif
+
+		return std::nullopt;
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,490 @@
+#ifndef CTHASH_TOOLS_PARTITION_HPP
+#define CTHASH_TOOLS_PARTITION_HPP
+
+#include "huge-pages.hpp"
+#include <cthash/internal/assert.hpp>
+#include <cthash/xxhash.hpp>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CTHASH_TOOLS_PARTITION_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace cthash::tools {
+
+namespace partition_detail {
+
+	using xxhash64_config = cthash::xxhash_types<64>;
+
+	constexpr auto xxhash64_key(uint64_t key, uint64_t seed) noexcept -> uint64_t {
+		using config = xxhash64_config;
+		const uint64_t start = seed + config::primes[4] + sizeof(uint64_t);
+		return config::avalanche((std::rotl(start ^ config::round(0u, key), 27u) * config::primes[0]) + config::primes[3]);
+	}
+
+#ifdef CTHASH_TOOLS_PARTITION_X86
+
+// some GCC versions warn about `_mm512_undefined_*` (self-initialized) used inside of AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+	// baseline x86-64 has no 64-bit vector multiplication: AVX2 composes it from three 32x32 bit products (the
+	// high half of the constant is known), AVX-512DQ has it as one instruction
+	template <uint64_t C> [[gnu::target("avx2"), gnu::always_inline]] inline auto mul_avx2(__m256i x) noexcept -> __m256i {
+		const auto lo = _mm256_set1_epi64x(static_cast<int64_t>(C & 0xFFFF'FFFFu));
+		const auto hi = _mm256_set1_epi64x(static_cast<int64_t>(C >> 32u));
+		const auto cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), lo), _mm256_mul_epu32(x, hi));
+		return _mm256_add_epi64(_mm256_mul_epu32(x, lo), _mm256_slli_epi64(cross, 32));
+	}
+
+	template <int N> [[gnu::target("avx2"), gnu::always_inline]] inline auto rotl_avx2(__m256i x) noexcept -> __m256i {
+		return _mm256_or_si256(_mm256_slli_epi64(x, N), _mm256_srli_epi64(x, 64 - N));
+	}
+
+	template <int N> [[gnu::target("avx2"), gnu::always_inline]] inline auto shift_xor_avx2(__m256i x) noexcept -> __m256i {
+		return _mm256_xor_si256(x, _mm256_srli_epi64(x, N));
+	}
+
+	[[gnu::target("avx2")]] inline void xxhash64_keys_avx2(std::span<const uint64_t> keys, std::span<uint64_t> out, uint64_t seed) noexcept {
+		using config = xxhash64_config;
+		constexpr size_t lanes = 4u;
+		const auto start = _mm256_set1_epi64x(static_cast<int64_t>(seed + config::primes[4] + sizeof(uint64_t)));
+		const auto p3 = _mm256_set1_epi64x(static_cast<int64_t>(config::primes[3]));
+
+		size_t i = 0;
+		for (; i + lanes <= keys.size(); i += lanes) {
+			auto acc = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys.data() + i));
+			acc = mul_avx2<config::primes[0]>(rotl_avx2<31>(mul_avx2<config::primes[1]>(acc)));
+			acc = _mm256_add_epi64(mul_avx2<config::primes[0]>(rotl_avx2<27>(_mm256_xor_si256(start, acc))), p3);
+			acc = mul_avx2<config::primes[1]>(shift_xor_avx2<33>(acc));
+			acc = mul_avx2<config::primes[2]>(shift_xor_avx2<29>(acc));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(out.data() + i), shift_xor_avx2<32>(acc));
+		}
+
+		for (; i != keys.size(); ++i) {
+			out[i] = xxhash64_key(keys[i], seed);
+		}
+	}
+
+	template <int N> [[gnu::target("avx512f"), gnu::always_inline]] inline auto shift_xor_avx512(__m512i x) noexcept -> __m512i {
+		return _mm512_xor_si512(x, _mm512_srli_epi64(x, N));
+	}
+
+	[[gnu::target("avx512f,avx512dq")]] inline void xxhash64_keys_avx512(std::span<const uint64_t> keys, std::span<uint64_t> out, uint64_t seed) noexcept {
+		using config = xxhash64_config;
+		constexpr size_t lanes = 8u;
+		const auto start = _mm512_set1_epi64(static_cast<int64_t>(seed + config::primes[4] + sizeof(uint64_t)));
+		const auto p0 = _mm512_set1_epi64(static_cast<int64_t>(config::primes[0]));
+		const auto p1 = _mm512_set1_epi64(static_cast<int64_t>(config::primes[1]));
+		const auto p2 = _mm512_set1_epi64(static_cast<int64_t>(config::primes[2]));
+		const auto p3 = _mm512_set1_epi64(static_cast<int64_t>(config::primes[3]));
+
+		size_t i = 0;
+		for (; i + lanes <= keys.size(); i += lanes) {
+			auto acc = _mm512_loadu_si512(keys.data() + i);
+			acc = _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(acc, p1), 31), p0);
+			acc = _mm512_add_epi64(_mm512_mullo_epi64(_mm512_rol_epi64(_mm512_xor_si512(start, acc), 27), p0), p3);
+			acc = _mm512_mullo_epi64(shift_xor_avx512<33>(acc), p1);
+			acc = _mm512_mullo_epi64(shift_xor_avx512<29>(acc), p2);
+			_mm512_storeu_si512(out.data() + i, shift_xor_avx512<32>(acc));
+		}
+
+		for (; i != keys.size(); ++i) {
+			out[i] = xxhash64_key(keys[i], seed);
+		}
+	}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+} // namespace partition_detail
+
+// xxhash64 of each 8-byte key (as its little-endian bytes), same value as `cthash::xxhash64{seed}.update(key).final()`,
+// keys are independent, so they are hashed in lanes of AVX-512 or AVX2 (selected at runtime) when the CPU has it
+inline void xxhash64_keys(std::span<const uint64_t> keys, std::span<uint64_t> out, uint64_t seed = 0u) noexcept {
+#ifdef CTHASH_TOOLS_PARTITION_X86
+	if (__builtin_cpu_supports("avx512dq")) {
+		partition_detail::xxhash64_keys_avx512(keys, out, seed);
+		return;
+	} else if (__builtin_cpu_supports("avx2")) {
+		partition_detail::xxhash64_keys_avx2(keys, out, seed);
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i != keys.size(); ++i) {
+		out[i] = partition_detail::xxhash64_key(keys[i], seed);
+	}
+}
+
+// 4 KiB entries of first level data TLB and of second level (shared) TLB from CPUID (Intel leaf 0x18, AMD leaves
+// 0x80000005 and 0x80000006), zeros when the CPU doesn't report them
+inline auto detect_tlb_entries() noexcept -> std::pair<size_t, size_t> {
+	size_t l1 = 0u;
+	size_t l2 = 0u;
+
+#ifdef CTHASH_TOOLS_PARTITION_X86
+	unsigned a, b, c, d;
+
+	if (__get_cpuid_count(0x18u, 0u, &a, &b, &c, &d)) {
+		const unsigned last = a;
+
+		for (unsigned sub = 0u; sub <= last && __get_cpuid_count(0x18u, sub, &a, &b, &c, &d); ++sub) {
+			const unsigned type = d & 0x1Fu;
+			const unsigned level = (d >> 5u) & 0x7u;
+
+			// data, unified or load-only translations of 4 KiB pages
+			if ((type == 1u || type == 3u || type == 4u) && (b & 1u) != 0u) {
+				auto & entries = (level == 1u) ? l1 : l2;
+				entries = std::max<size_t>(entries, size_t{b >> 16u} * c);
+			}
+		}
+	} else if (__get_cpuid(0x80000006u, &a, &b, &c, &d)) {
+		l2 = (b >> 16u) & 0xFFFu;
+
+		if (__get_cpuid(0x80000005u, &a, &b, &c, &d)) {
+			l1 = (b >> 16u) & 0xFFu;
+		}
+	}
+#endif
+
+	return {l1, l2};
+}
+
+// sizes which select how many partitions can be written at once without thrashing caches and TLB
+struct partition_tuning {
+	size_t l1_bytes{32u * 1024u};
+	size_t l2_bytes{1024u * 1024u};
+	size_t tlb_entries{64u};
+	size_t stlb_entries{1536u};
+	// pages of large arrays (2 MiB when transparent huge pages can be advised)
+	size_t page_bytes{4096u};
+
+	static auto detect() -> partition_tuning {
+		partition_tuning out;
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_SIZE)
+		if (const long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE); l1 > 0) {
+			out.l1_bytes = static_cast<size_t>(l1);
+		}
+		if (const long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE); l2 > 0) {
+			out.l2_bytes = static_cast<size_t>(l2);
+		}
+#endif
+		const auto [tlb, stlb] = detect_tlb_entries();
+		if (tlb != 0u) {
+			out.tlb_entries = tlb;
+		}
+		if (stlb != 0u) {
+			out.stlb_entries = stlb;
+		}
+		if (transparent_huge_pages_available()) {
+			out.page_bytes = huge_page_memory::huge_page_size;
+		}
+		return out;
+	}
+
+	// memory which second level TLB can map at once
+	auto tlb_reach() const noexcept -> size_t {
+		return stlb_entries * page_bytes;
+	}
+
+	// without buffering each partition is a page being written, so fanout is limited by TLB
+	auto direct_bits() const noexcept -> unsigned {
+		return static_cast<unsigned>(std::bit_width(tlb_entries) - 1u);
+	}
+
+	// with write-combining buffers (one cache line of each partition) they should fit into L2, and when the output
+	// (of `output_bytes`) is larger than TLB reach, each partition which is written needs its own TLB entry
+	auto buffered_bits(size_t output_bytes = 0u) const noexcept -> unsigned {
+		const size_t lines = std::max<size_t>(l2_bytes / 64u, 2u);
+		const size_t limit = (output_bytes > tlb_reach()) ? std::min(lines, std::max<size_t>(stlb_entries, 2u)) : lines;
+		return std::clamp(static_cast<unsigned>(std::bit_width(limit) - 1u), direct_bits(), 16u);
+	}
+};
+
+// rows are identified by 32-bit indices and partitions by top bits of 32 bits of hash kept between passes,
+// so both variants support at most 2^32 rows and at most 32 bits (more bits are clamped)
+constexpr unsigned max_partition_bits = 32u;
+constexpr size_t max_partitioned_rows = size_t{1} << 32u;
+
+// row indices grouped by partition (top bits of xxhash64 of the key), partition `p` is `rows[offsets[p]..offsets[p+1])`
+struct partitioned_rows {
+	std::vector<uint32_t> rows{};
+	std::vector<size_t> offsets{};
+
+	auto count() const noexcept -> size_t {
+		return offsets.size() - 1u;
+	}
+
+	auto partition(size_t p) const noexcept -> std::span<const uint32_t> {
+		return std::span(rows).subspan(offsets[p], offsets[p + 1u] - offsets[p]);
+	}
+};
+
+namespace partition_detail {
+
+	constexpr size_t line_size = 64u;
+
+	// software write-combining: entries of each partition are collected in a cache line which is then written out
+	// at once bypassing caches, so the scatter doesn't read destination lines and touches their pages once per line
+	template <typename T> struct alignas(line_size) line {
+		static constexpr size_t capacity = line_size / sizeof(T);
+		std::array<T, capacity> items;
+	};
+
+	inline void stream_line(void * destination, const void * source) noexcept {
+#ifdef __SSE2__
+		auto * d = static_cast<__m128i *>(destination);
+		const auto * s = static_cast<const __m128i *>(source);
+		for (size_t i = 0; i != line_size / sizeof(__m128i); ++i) {
+			_mm_stream_si128(d + i, _mm_load_si128(s + i));
+		}
+#else
+		std::memcpy(destination, source, line_size);
+#endif
+	}
+
+	inline void stream_fence() noexcept {
+#ifdef __SSE2__
+		_mm_sfence();
+#endif
+	}
+
+	template <typename Bucket> auto histogram(size_t n, size_t fanout, Bucket && bucket) -> std::vector<size_t> {
+		std::vector<size_t> out(fanout, 0u);
+
+		for (size_t i = 0; i != n; ++i) {
+			++out[bucket(i)];
+		}
+
+		return out;
+	}
+
+	// one radix round: moves `entry(i)` into buckets selected by `bucket(i)`, with sizes of buckets from `position`
+	// (histogram, it can be computed together with keys) every bucket gets exact place in `out`, `offsets` receives
+	// start of each bucket (and the end)
+	template <typename T, typename Bucket, typename Entry> void scatter(size_t n, std::vector<size_t> position, Bucket && bucket, Entry && entry, std::span<T> out, std::span<size_t> offsets) {
+		using entry_line = line<T>;
+		constexpr size_t width = entry_line::capacity;
+		const size_t fanout = position.size();
+
+		size_t sum = 0u;
+		for (size_t p = 0; p != fanout; ++p) {
+			offsets[p] = sum;
+			sum += std::exchange(position[p], sum);
+		}
+		offsets[fanout] = sum;
+
+		// slot in line of each bucket matches position of its destination in a cache line, so full lines are aligned,
+		// `first` is the first slot of the (only) partial line at beginning of bucket
+		const auto lines = std::make_unique<entry_line[]>(fanout);
+		std::vector<uint8_t> filled(fanout);
+		std::vector<uint8_t> first(fanout);
+
+		for (size_t p = 0; p != fanout; ++p) {
+			const auto address = reinterpret_cast<uintptr_t>(out.data() + position[p]);
+			first[p] = filled[p] = static_cast<uint8_t>((address % line_size) / sizeof(T));
+			position[p] -= filled[p];
+		}
+
+		for (size_t i = 0; i != n; ++i) {
+			const size_t p = bucket(i);
+			const size_t slot = filled[p]++;
+			lines[p].items[slot] = entry(i);
+
+			if (slot + 1u == width) {
+				if (first[p] == 0u) {
+					stream_line(out.data() + position[p], lines[p].items.data());
+				} else {
+					std::memcpy(out.data() + position[p] + first[p], lines[p].items.data() + first[p], (width - first[p]) * sizeof(T));
+					first[p] = 0u;
+				}
+
+				position[p] += width;
+				filled[p] = 0u;
+			}
+		}
+
+		for (size_t p = 0; p != fanout; ++p) {
+			if (filled[p] > first[p]) {
+				std::memcpy(out.data() + position[p] + first[p], lines[p].items.data() + first[p], (filled[p] - first[p]) * sizeof(T));
+			}
+		}
+
+		stream_fence();
+	}
+
+} // namespace partition_detail
+
+// two-pass partitioning (histogram and scatter): output is one contiguous array, when there are more partitions
+// than write-combining buffers fitting into cache, a second radix round splits each first-level partition further
+// (only top 32 bits of each hash are kept between passes), histogram of the first round is counted while keys are
+// hashed and large temporary arrays (and the output) are backed by huge pages when the system has them, as their
+// page faults would cost more than the partitioning itself
+inline auto partition_two_pass(std::span<const uint64_t> keys, unsigned bits, const partition_tuning & tuning = partition_tuning::detect()) -> partitioned_rows {
+	CTHASH_ASSERT(keys.size() <= max_partitioned_rows);
+
+	const size_t n = keys.size();
+	bits = std::min(bits, max_partition_bits);
+
+	partitioned_rows out;
+	out.rows.reserve(n);
+	advise_huge_pages(out.rows.data(), n * sizeof(uint32_t));
+	out.rows.resize(n);
+
+	if (bits == 0u) {
+		for (size_t i = 0; i != n; ++i) {
+			out.rows[i] = static_cast<uint32_t>(i);
+		}
+		out.offsets = {0u, n};
+		return out;
+	}
+
+	const unsigned first_bits = std::min(bits, tuning.buffered_bits(n * sizeof(uint32_t)));
+	const unsigned second_bits = bits - first_bits;
+
+	const auto radix_memory = huge_page_memory{n * sizeof(uint32_t)};
+	if (not radix_memory && n != 0u) {
+		throw std::bad_alloc{};
+	}
+
+	const auto radixes = radix_memory.as_span<uint32_t>();
+	std::vector<size_t> first_counts(size_t{1} << first_bits, 0u);
+	{
+		constexpr size_t batch = 256u;
+		std::array<uint64_t, batch> hashes;
+
+		for (size_t start = 0; start < n; start += batch) {
+			const size_t count = std::min(batch, n - start);
+			xxhash64_keys(keys.subspan(start, count), hashes);
+
+			for (size_t i = 0; i != count; ++i) {
+				const auto radix = static_cast<uint32_t>(hashes[i] >> 32u);
+				radixes[start + i] = radix;
+				++first_counts[radix >> (32u - first_bits)];
+			}
+		}
+	}
+
+	out.offsets.resize((size_t{1} << bits) + 1u);
+	const auto row = [](size_t i) { return static_cast<uint32_t>(i); };
+
+	if (second_bits == 0u) {
+		partition_detail::scatter(n, std::move(first_counts), [&](size_t i) { return radixes[i] >> (32u - bits); }, row, std::span(out.rows), out.offsets);
+		return out;
+	}
+
+	// first round keeps radix of each row next to it, so it's not read from scattered places later
+	const auto first_memory = huge_page_memory{n * sizeof(uint64_t)};
+	if (not first_memory && n != 0u) {
+		throw std::bad_alloc{};
+	}
+
+	const auto first_round = first_memory.as_span<uint64_t>();
+	std::vector<size_t> first_offsets((size_t{1} << first_bits) + 1u);
+	partition_detail::scatter(n, std::move(first_counts), [&](size_t i) { return radixes[i] >> (32u - first_bits); }, [&](size_t i) { return (uint64_t{radixes[i]} << 32u) | i; }, first_round, first_offsets);
+
+	// each first-level partition is small enough to stay in cache while it's split by following bits
+	const size_t fanout = size_t{1} << second_bits;
+	const uint64_t mask = fanout - 1u;
+
+	for (size_t p = 0; p + 1u != first_offsets.size(); ++p) {
+		const size_t from = first_offsets[p];
+		const auto part = first_round.subspan(from, first_offsets[p + 1u] - from);
+		const auto bucket = [&](size_t i) { return static_cast<size_t>((part[i] >> (64u - bits)) & mask); };
+
+		partition_detail::scatter(part.size(), partition_detail::histogram(part.size(), fanout, bucket), bucket, [&](size_t i) { return static_cast<uint32_t>(part[i]); }, std::span(out.rows).subspan(from, part.size()), std::span(out.offsets).subspan(p * fanout, fanout + 1u));
+
+		for (size_t q = 0; q != fanout; ++q) {
+			out.offsets[p * fanout + q] += from;
+		}
+	}
+
+	out.offsets.back() = n;
+	return out;
+}
+
+// single-pass partitioning: keys are read once and rows go to growing per-partition buffers through write-combining lines,
+// it's cheaper when partitions are consumed separately and number of partitions fits into cache, with more partitions
+// than `tuning` allows lines would be evicted before they fill up, so rows are appended directly
+inline auto partition_single_pass(std::span<const uint64_t> keys, unsigned bits, const partition_tuning & tuning = partition_tuning::detect()) -> std::vector<std::vector<uint32_t>> {
+	using row_line = partition_detail::line<uint32_t>;
+	constexpr size_t width = row_line::capacity;
+	// hashes are computed in small batches so they stay in L1
+	constexpr size_t batch = 256u;
+
+	CTHASH_ASSERT(keys.size() <= max_partitioned_rows);
+
+	bits = std::min(bits, max_partition_bits);
+	const size_t fanout = size_t{1} << bits;
+	const unsigned shift = 64u - bits;
+	const bool buffered = bits <= tuning.buffered_bits(keys.size() * sizeof(uint32_t));
+
+	std::vector<std::vector<uint32_t>> out(fanout);
+	for (auto & part: out) {
+		part.reserve(keys.size() / fanout + width);
+	}
+
+	const auto lines = std::make_unique<row_line[]>(buffered ? fanout : 0u);
+	std::vector<uint8_t> filled(buffered ? fanout : 0u, 0u);
+	std::array<uint64_t, batch> hashes;
+
+	for (size_t start = 0; start < keys.size(); start += batch) {
+		const size_t count = std::min(batch, keys.size() - start);
+		xxhash64_keys(keys.subspan(start, count), hashes);
+
+		for (size_t i = 0; i != count; ++i) {
+			// shift by 64 bits (without partitioning) would be undefined
+			const size_t p = (bits == 0u) ? 0u : static_cast<size_t>(hashes[i] >> shift);
+
+			if (not buffered) {
+				out[p].push_back(static_cast<uint32_t>(start + i));
+				continue;
+			}
+
+			const size_t slot = filled[p]++;
+			lines[p].items[slot] = static_cast<uint32_t>(start + i);
+
+			if (slot + 1u == width) {
+				out[p].insert(out[p].end(), lines[p].items.begin(), lines[p].items.end());
+				filled[p] = 0u;
+			}
+		}
+	}
+
+	for (size_t p = 0; p != filled.size(); ++p) {
+		out[p].insert(out[p].end(), lines[p].items.begin(), lines[p].items.begin() + filled[p]);
+	}
+
+	return out;
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef CTHASH_TOOLS_PERF_COUNTERS_HPP
+#define CTHASH_TOOLS_PERF_COUNTERS_HPP
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cthash::tools {
+
+// hardware counters of the calling thread (user space only) through perf_event_open, each counter is opened
+// separately so a missing one doesn't disable the others, when the kernel multiplexes them values are scaled
+// by time they were running; without permission (perf_event_paranoid) or PMU nothing is available
+struct perf_counters {
+	enum counter : size_t { cycles, instructions, l1d_misses, llc_misses, branch_misses, dtlb_misses, count };
+	static constexpr auto names = std::array<std::string_view, count>{"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "dtlb_misses"};
+
+	using values = std::array<std::optional<double>, count>;
+
+	std::array<int, count> fds{};
+	std::string error{};
+
+	perf_counters() {
+		fds.fill(-1);
+#ifdef __linux__
+		constexpr auto cache = [](uint64_t which, uint64_t result) {
+			return which | (uint64_t{PERF_COUNT_HW_CACHE_OP_READ} << 8u) | (result << 16u);
+		};
+
+		const std::array<std::pair<uint32_t, uint64_t>, count> events{{
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+			{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+			{PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+		}};
+
+		for (size_t i = 0; i != count; ++i) {
+			perf_event_attr attr{};
+			attr.size = sizeof(attr);
+			attr.type = events[i].first;
+			attr.config = events[i].second;
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+			if (fds[i] < 0 && error.empty()) {
+				error = std::string(names[i]) + ": " + std::strerror(errno);
+				if (errno == EACCES || errno == EPERM) {
+					error += " (see /proc/sys/kernel/perf_event_paranoid)";
+				}
+			}
+		}
+#else
+		error = "hardware counters are supported only on Linux";
+#endif
+	}
+
+	perf_counters(const perf_counters &) = delete;
+	perf_counters & operator=(const perf_counters &) = delete;
+
+	~perf_counters() {
+#ifdef __linux__
+		for (const int fd: fds) {
+			if (fd >= 0) {
+				close(fd);
+			}
+		}
+#endif
+	}
+
+	auto available() const noexcept -> bool {
+		for (const int fd: fds) {
+			if (fd >= 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void start() noexcept {
+#ifdef __linux__
+		for (const int fd: fds) {
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	auto stop() noexcept -> values {
+		values out{};
+#ifdef __linux__
+		for (const int fd: fds) {
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+
+		for (size_t i = 0; i != count; ++i) {
+			// value, time enabled, time running
+			std::array<uint64_t, 3> data{};
+			if (fds[i] >= 0 && read(fds[i], data.data(), sizeof(data)) == static_cast<ssize_t>(sizeof(data)) && data[2] != 0u) {
+				out[i] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+			}
+		}
+#endif
+		return out;
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
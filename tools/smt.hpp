@@ -0,0 +1,492 @@
+#ifndef CTHASH_TOOLS_SMT_HPP
+#define CTHASH_TOOLS_SMT_HPP
+
+#include "multi-buffer.hpp"
+#include "thread-pool.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+// Sparse Merkle tree: authenticated map of 256-bit keys, a full binary tree of depth 256 where each leaf position
+// is a key. Leaf is H(0x00 || key || value), node H(0x01 || left || right) and an empty leaf is all zeros, so
+// digests of empty subtrees depend only on their level and they are computed at compile time.
+//
+// Only non-empty subtrees are stored and paths are compressed: a node is a leaf or a branch with two non-empty
+// children, placed at its own depth (256 for leaves) below a parent which can be many levels above. Each node
+// keeps its digest lifted (hashed with empty siblings) to the slot below its parent, so it's rehashed only when
+// its subtree or its parent's depth changes.
+//
+// A batch of writes is sorted, so writes which share a path prefix walk it only once, and dirty nodes are rehashed
+// level by level from the leaves; nodes of one level are independent, with a `thread_pool` they are split between
+// its workers, and with a multi-buffer kernel of the hasher they (and each step of their lifting) are hashed at once
+// in its lanes.
+
+template <typename Hasher> using smt_digest = decltype(Hasher{}.final());
+
+template <typename Hasher> constexpr auto smt_hash_node(const smt_digest<Hasher> & left, const smt_digest<Hasher> & right) noexcept -> smt_digest<Hasher> {
+	constexpr auto prefix = std::array{std::byte{0x01}};
+	return Hasher{}.update(std::span<const std::byte>(prefix)).update(std::span<const std::byte>(left)).update(std::span<const std::byte>(right)).final();
+}
+
+// digest of an empty subtree rooted at `Level` (256 is a leaf), each level is a separate constant, so each of them
+// fits into compiler's limit of constant evaluation
+template <typename Hasher, size_t Level> inline constexpr smt_digest<Hasher> smt_empty_subtree = smt_hash_node<Hasher>(smt_empty_subtree<Hasher, Level + 1u>, smt_empty_subtree<Hasher, Level + 1u>);
+template <typename Hasher> inline constexpr smt_digest<Hasher> smt_empty_subtree<Hasher, 256u> = smt_digest<Hasher>{};
+
+template <typename Hasher> inline constexpr auto smt_empty_subtrees = []<size_t... Level>(std::index_sequence<Level...>) {
+	return std::array{smt_empty_subtree<Hasher, Level>...};
+}(std::make_index_sequence<257u>());
+
+template <typename Hasher> struct sparse_merkle_tree {
+	using digest = smt_digest<Hasher>;
+	using key_type = std::array<std::byte, 32>;
+
+	static constexpr unsigned leaf_depth = 256u;
+	static constexpr const auto & empty = smt_empty_subtrees<Hasher>;
+
+	// a write of `value` or removal of the key
+	struct write {
+		key_type key;
+		std::span<const std::byte> value{};
+		bool erase{false};
+	};
+
+	// non-empty siblings on the path of a key (bottom up), `levels` marks their levels (bit of level L is in word
+	// L / 64), siblings of other levels are empty subtrees; it proves value of the key or its absence
+	struct proof {
+		std::array<uint64_t, 4> levels{};
+		std::vector<digest> siblings{};
+	};
+
+	static constexpr auto bit(const key_type & key, unsigned level) noexcept -> unsigned {
+		return (std::to_integer<unsigned>(key[level / 8u]) >> (7u - level % 8u)) & 1u;
+	}
+
+	// number of leading bits which are same (256 for same keys)
+	static constexpr auto common_prefix(const key_type & a, const key_type & b) noexcept -> unsigned {
+		for (unsigned i = 0; i != a.size(); ++i) {
+			if (const auto diff = std::to_integer<uint8_t>(a[i] ^ b[i]); diff != 0u) {
+				return i * 8u + static_cast<unsigned>(std::countl_zero(diff));
+			}
+		}
+		return leaf_depth;
+	}
+
+	static constexpr auto hash_leaf(const key_type & key, std::span<const std::byte> value) noexcept -> digest {
+		constexpr auto prefix = std::array{std::byte{0x00}};
+		return Hasher{}.update(std::span<const std::byte>(prefix)).update(std::span<const std::byte>(key)).update(value).final();
+	}
+
+	// digest of a subtree at level `from` on path of `key` hashed with empty siblings up to level `to`
+	static constexpr auto lift(digest d, const key_type & key, unsigned from, unsigned to) noexcept -> digest {
+		for (unsigned level = from; level-- > to;) {
+			d = bit(key, level) ? smt_hash_node<Hasher>(empty[level + 1u], d) : smt_hash_node<Hasher>(d, empty[level + 1u]);
+		}
+		return d;
+	}
+
+	// `value` is empty for a proof of absence
+	static auto verify(const digest & root, const key_type & key, std::optional<std::span<const std::byte>> value, const proof & p) noexcept -> bool {
+		digest d = value ? hash_leaf(key, *value) : empty[leaf_depth];
+		size_t next = 0u;
+
+		for (unsigned level = leaf_depth; level-- != 0u;) {
+			const bool stored = (p.levels[level / 64u] >> (level % 64u)) & 1u;
+
+			if (stored && next == p.siblings.size()) {
+				return false;
+			}
+
+			const auto & sibling = stored ? p.siblings[next++] : empty[level + 1u];
+			d = bit(key, level) ? smt_hash_node<Hasher>(sibling, d) : smt_hash_node<Hasher>(d, sibling);
+		}
+
+		return next == p.siblings.size() && d == root;
+	}
+
+	static constexpr uint32_t none = UINT32_MAX;
+
+	struct node {
+		key_type key{};                 // of the leaf, or of any leaf ever below the branch (for its prefix)
+		std::vector<std::byte> value{}; // only leaves
+		digest own{};                   // at `depth`
+		digest lifted{};                // at `slot`
+		std::array<uint32_t, 2> children{none, none};
+		uint16_t depth{leaf_depth};
+		uint16_t slot{0u};
+		bool dirty{false};
+		bool alive{true};
+	};
+
+	// state
+	std::vector<node> nodes{};
+	std::vector<uint32_t> free_nodes{};
+	std::vector<uint32_t> released{}; // reused only after rehashing, so no node is dirty twice in one batch
+	std::array<std::vector<uint32_t>, leaf_depth + 1u> dirty{};
+	uint32_t top{none};
+	size_t leaves{0u};
+
+	auto size() const noexcept -> size_t {
+		return leaves;
+	}
+
+	auto root() const noexcept -> digest {
+		return (top == none) ? empty[0] : nodes[top].lifted;
+	}
+
+	auto find(const key_type & key) const noexcept -> std::optional<std::span<const std::byte>> {
+		for (uint32_t n = top; n != none;) {
+			const auto & nd = nodes[n];
+
+			if (common_prefix(key, nd.key) < nd.depth) {
+				return std::nullopt;
+			} else if (nd.depth == leaf_depth) {
+				return std::span<const std::byte>(nd.value);
+			}
+
+			n = nd.children[bit(key, nd.depth)];
+		}
+
+		return std::nullopt;
+	}
+
+	void update(const write & w) {
+		update(std::span<const write>(&w, 1u));
+	}
+
+	// later writes of the same key win
+	void update(std::span<const write> batch, thread_pool * pool = nullptr) {
+		std::vector<pending> ops;
+		ops.reserve(batch.size());
+
+		for (const auto & w: batch) {
+			ops.push_back(pending{w.key, w.value, w.erase, none});
+		}
+
+		std::ranges::stable_sort(ops, {}, &pending::key);
+
+		// keep the last of each run of same keys
+		const auto last = std::ranges::unique(ops.rbegin(), ops.rend(), {}, &pending::key);
+		ops.erase(ops.begin(), last.begin().base());
+
+		top = apply(top, 0u, ops);
+		rehash(pool);
+
+		free_nodes.insert(free_nodes.end(), released.begin(), released.end());
+		released.clear();
+	}
+
+	auto prove(const key_type & key) const -> proof {
+		// (level, sibling) from the root down
+		std::vector<std::pair<unsigned, digest>> found;
+
+		for (uint32_t n = top; n != none;) {
+			const auto & nd = nodes[n];
+
+			if (const unsigned e = common_prefix(key, nd.key); e < nd.depth) {
+				// the key isn't below this node, so the node is the only non-empty sibling on the key's path
+				found.emplace_back(e, lift(nd.own, nd.key, nd.depth, e + 1u));
+				break;
+			} else if (nd.depth == leaf_depth) {
+				break;
+			}
+
+			const unsigned b = bit(key, nd.depth);
+			found.emplace_back(nd.depth, nodes[nd.children[b ^ 1u]].lifted);
+			n = nd.children[b];
+		}
+
+		proof out{};
+
+		for (auto it = found.rbegin(); it != found.rend(); ++it) {
+			out.levels[it->first / 64u] |= uint64_t{1} << (it->first % 64u);
+			out.siblings.push_back(it->second);
+		}
+
+		return out;
+	}
+
+private:
+	struct pending {
+		key_type key;
+		std::span<const std::byte> value;
+		bool erase;
+		uint32_t existing; // a leaf which stays (with its value) and only moves
+	};
+
+	auto allocate(node && nd) -> uint32_t {
+		if (not free_nodes.empty()) {
+			const uint32_t n = free_nodes.back();
+			free_nodes.pop_back();
+			nodes[n] = std::move(nd);
+			return n;
+		}
+
+		nodes.push_back(std::move(nd));
+		return static_cast<uint32_t>(nodes.size() - 1u);
+	}
+
+	void release(uint32_t n) {
+		if (nodes[n].depth == leaf_depth) {
+			--leaves;
+		}
+
+		nodes[n].alive = false;
+		nodes[n].value = {};
+		released.push_back(n);
+	}
+
+	void mark(uint32_t n) {
+		if (not nodes[n].dirty) {
+			nodes[n].dirty = true;
+			dirty[nodes[n].depth].push_back(n);
+		}
+	}
+
+	auto reslot(uint32_t n, unsigned slot) -> uint32_t {
+		if (n != none && nodes[n].slot != slot) {
+			nodes[n].slot = static_cast<uint16_t>(slot);
+			mark(n);
+		}
+		return n;
+	}
+
+	static auto split(std::span<const pending> ops, unsigned level) noexcept -> std::pair<std::span<const pending>, std::span<const pending>> {
+		const auto middle = std::ranges::partition_point(ops, [level](const pending & p) { return bit(p.key, level) == 0u; });
+		const auto index = static_cast<size_t>(middle - ops.begin());
+		return {ops.first(index), ops.subspan(index)};
+	}
+
+	// new subtree with writes from `ops` (erases are ignored as there is nothing to erase)
+	auto build(unsigned slot, std::span<const pending> ops) -> uint32_t {
+		const auto first = std::ranges::find_if(ops, [](const pending & p) { return not p.erase; });
+
+		if (first == ops.end()) {
+			return none;
+		}
+
+		const auto last = std::ranges::find_if(ops.rbegin(), ops.rend(), [](const pending & p) { return not p.erase; });
+
+		if (&*first == &*last) {
+			if (first->existing != none) {
+				return reslot(first->existing, slot);
+			}
+
+			++leaves;
+			const uint32_t n = allocate(node{.key = first->key, .value = {first->value.begin(), first->value.end()}, .depth = leaf_depth, .slot = static_cast<uint16_t>(slot)});
+			mark(n);
+			return n;
+		}
+
+		const unsigned depth = common_prefix(first->key, last->key);
+		const auto [zero, one] = split(ops, depth);
+		const uint32_t left = build(depth + 1u, zero);
+		const uint32_t right = build(depth + 1u, one);
+
+		const uint32_t n = allocate(node{.key = first->key, .children = {left, right}, .depth = static_cast<uint16_t>(depth), .slot = static_cast<uint16_t>(slot)});
+		mark(n);
+		return n;
+	}
+
+	// subtree `n` (its slot is at `slot` now) with writes from `ops`, all of them share first `slot` bits with it
+	auto apply(uint32_t n, unsigned slot, std::span<const pending> ops) -> uint32_t {
+		if (ops.empty()) {
+			return reslot(n, slot);
+		} else if (n == none) {
+			return build(slot, ops);
+		}
+
+		const auto key = nodes[n].key;
+		const unsigned depth = nodes[n].depth;
+
+		if (depth == leaf_depth) {
+			// the leaf is rebuilt together with the writes, it keeps its value unless it's written
+			const auto position = std::ranges::lower_bound(ops, key, {}, &pending::key);
+			const bool written = (position != ops.end() && position->key == key);
+
+			std::vector<pending> merged(ops.begin(), position);
+			if (written) {
+				release(n);
+			} else {
+				merged.push_back(pending{key, {}, false, n});
+			}
+			merged.insert(merged.end(), position, ops.end());
+
+			return build(slot, merged);
+		}
+
+		// ops are sorted, so the shortest common prefix with the branch is at one of the ends
+		const unsigned common = std::min(common_prefix(key, ops.front().key), common_prefix(key, ops.back().key));
+
+		if (common < depth) {
+			// some writes are outside of the branch's prefix, they go to a new branch above it
+			const auto [zero, one] = split(ops, common);
+			const unsigned side = bit(key, common);
+
+			const uint32_t other = build(common + 1u, side ? zero : one);
+
+			if (other == none) {
+				return apply(n, slot, side ? one : zero);
+			}
+
+			const uint32_t same = apply(n, common + 1u, side ? one : zero);
+
+			if (same == none) {
+				return reslot(other, slot);
+			}
+
+			const auto children = side ? std::array{other, same} : std::array{same, other};
+			const uint32_t branch = allocate(node{.key = key, .children = children, .depth = static_cast<uint16_t>(common), .slot = static_cast<uint16_t>(slot)});
+			mark(branch);
+			return branch;
+		}
+
+		const auto [zero, one] = split(ops, depth);
+		const uint32_t left = apply(nodes[n].children[0], depth + 1u, zero);
+		const uint32_t right = apply(nodes[n].children[1], depth + 1u, one);
+
+		if (left == none || right == none) {
+			// a branch with one child is compressed away
+			release(n);
+			return reslot(left == none ? right : left, slot);
+		}
+
+		auto & nd = nodes[n];
+		const bool changed = nodes[left].dirty || nodes[right].dirty || nd.children != std::array{left, right} || nd.slot != slot;
+		nd.children = {left, right};
+		nd.slot = static_cast<uint16_t>(slot);
+
+		if (changed) {
+			mark(n);
+		}
+
+		return n;
+	}
+
+	// from the leaves up, children are always deeper than their parents
+	void rehash(thread_pool * pool) {
+		for (size_t level = leaf_depth + 1u; level-- != 0u;) {
+			auto & bucket = dirty[level];
+
+			// a leaf is lifted over many levels, so leaves are split between tasks in smaller chunks
+			for_each_chunk(pool, bucket.size(), (level == leaf_depth) ? 16u : 256u, [&](size_t begin, size_t end) {
+				const auto chunk = std::span(bucket).subspan(begin, end - begin);
+
+				if constexpr (has_multi_buffer<Hasher>) {
+					rehash_in_lanes(chunk);
+				} else {
+					for (const uint32_t n: chunk) {
+						auto & nd = nodes[n];
+
+						if (not nd.alive || not nd.dirty) {
+							continue;
+						}
+
+						nd.own = (nd.depth == leaf_depth) ? hash_leaf(nd.key, nd.value) : smt_hash_node<Hasher>(nodes[nd.children[0]].lifted, nodes[nd.children[1]].lifted);
+						nd.lifted = lift(nd.own, nd.key, nd.depth, nd.slot);
+						nd.dirty = false;
+					}
+				}
+			});
+
+			bucket.clear();
+		}
+	}
+
+	// own digests of dirty nodes are hashed at once, then their lifting goes one level up in each round for all nodes
+	// which aren't at their slot yet
+	void rehash_in_lanes(std::span<const uint32_t> chunk) {
+		constexpr size_t digest_size = digest::digest_length;
+		constexpr size_t node_input = 1u + 2u * digest_size;
+
+		std::vector<uint32_t> rising;
+		for (const uint32_t n: chunk) {
+			if (nodes[n].alive && nodes[n].dirty) {
+				rising.push_back(n);
+			}
+		}
+
+		const auto own_size = [&](size_t i) {
+			const auto & nd = nodes[rising[i]];
+			return (nd.depth == leaf_depth) ? 1u + nd.key.size() + nd.value.size() : node_input;
+		};
+
+		const auto own_input = [&](size_t i, std::byte * out) {
+			const auto & nd = nodes[rising[i]];
+			if (nd.depth == leaf_depth) {
+				out[0] = std::byte{0x00};
+				std::ranges::copy(nd.key, out + 1);
+				std::ranges::copy(nd.value, out + 1 + nd.key.size());
+			} else {
+				out[0] = std::byte{0x01};
+				std::memcpy(out + 1, nodes[nd.children[0]].lifted.data(), digest_size);
+				std::memcpy(out + 1 + digest_size, nodes[nd.children[1]].lifted.data(), digest_size);
+			}
+		};
+
+		hash_assembled<Hasher>(rising.size(), own_size, own_input, [&](size_t i, std::span<const std::byte, digest_size> d) {
+			auto & nd = nodes[rising[i]];
+			std::memcpy(nd.own.data(), d.data(), digest_size);
+			nd.lifted = nd.own;
+		});
+
+		// level of each node's `lifted` digest
+		std::vector<unsigned> at(rising.size());
+		for (size_t i = 0; i != rising.size(); ++i) {
+			at[i] = nodes[rising[i]].depth;
+		}
+
+		for (;;) {
+			size_t kept = 0u;
+			for (size_t i = 0; i != rising.size(); ++i) {
+				if (at[i] != nodes[rising[i]].slot) {
+					rising[kept] = rising[i];
+					at[kept] = at[i];
+					++kept;
+				}
+			}
+
+			rising.resize(kept);
+			at.resize(kept);
+
+			if (rising.empty()) {
+				break;
+			}
+
+			const auto step_input = [&](size_t i, std::byte * out) {
+				const auto & nd = nodes[rising[i]];
+				const unsigned parent = at[i] - 1u;
+				const bool right = bit(nd.key, parent);
+
+				out[0] = std::byte{0x01};
+				std::memcpy(out + 1, (right ? empty[at[i]] : nd.lifted).data(), digest_size);
+				std::memcpy(out + 1 + digest_size, (right ? nd.lifted : empty[at[i]]).data(), digest_size);
+			};
+
+			hash_assembled<Hasher>(rising.size(), [](size_t) { return node_input; }, step_input, [&](size_t i, std::span<const std::byte, digest_size> d) {
+				std::memcpy(nodes[rising[i]].lifted.data(), d.data(), digest_size);
+			});
+
+			for (auto & level: at) {
+				--level;
+			}
+		}
+
+		for (const uint32_t n: chunk) {
+			nodes[n].dirty = false;
+		}
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
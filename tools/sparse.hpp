@@ -0,0 +1,96 @@
+#ifndef CTHASH_TOOLS_SPARSE_HPP
+#define CTHASH_TOOLS_SPARSE_HPP
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace cthash::tools {
+
+// continuous range of a file which is either data or a hole (reads as zeros)
+struct extent {
+	uint64_t offset;
+	uint64_t length;
+	bool hole;
+};
+
+// data and holes of the file in order, whole file is one data extent when the filesystem doesn't know about holes
+inline auto find_extents(int fd, uint64_t size) -> std::vector<extent> {
+	const auto everything = std::vector<extent>{{0u, size, false}};
+
+#ifdef SEEK_HOLE
+	// most files have no holes, this is the only syscall they pay for
+	if (const auto first_hole = lseek(fd, 0, SEEK_HOLE); first_hole < 0 || static_cast<uint64_t>(first_hole) >= size) {
+		return everything;
+	}
+
+	std::vector<extent> out;
+
+	for (uint64_t pos = 0u; pos < size;) {
+		const auto data = lseek(fd, static_cast<off_t>(pos), SEEK_DATA);
+
+		if (data < 0) {
+			if (errno != ENXIO) {
+				return everything;
+			}
+
+			// there is no more data until end of the file
+			out.push_back({pos, size - pos, true});
+			break;
+		}
+
+		const auto data_start = std::min(static_cast<uint64_t>(data), size);
+
+		if (data_start > pos) {
+			out.push_back({pos, data_start - pos, true});
+		}
+
+		const auto hole = lseek(fd, data, SEEK_HOLE);
+
+		if (hole < 0) {
+			return everything;
+		}
+
+		const auto data_end = std::min(static_cast<uint64_t>(hole), size);
+
+		if (data_end > data_start) {
+			out.push_back({data_start, data_end - data_start, false});
+		}
+
+		pos = std::max(data_end, data_start + 1u);
+	}
+
+	return out;
+#else
+	(void)fd;
+	return everything;
+#endif
+}
+
+// block of zeros which is fed to hashers instead of holes, it's locked in memory so it never faults
+inline auto zero_block() noexcept -> std::span<const std::byte> {
+	alignas(4096) static std::array<std::byte, 64u * 1024u> zeros{};
+	[[maybe_unused]] static const bool locked = mlock(zeros.data(), zeros.size()) == 0;
+	return zeros;
+}
+
+// calls `cb(span)` with zeros until `length` bytes were passed
+template <typename CB> void feed_zeros(uint64_t length, CB && cb) {
+	const auto zeros = zero_block();
+
+	while (length != 0u) {
+		const auto n = static_cast<size_t>(std::min<uint64_t>(length, zeros.size()));
+		cb(zeros.first(n));
+		length -= n;
+	}
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef CTHASH_TOOLS_TAR_HPP
+#define CTHASH_TOOLS_TAR_HPP
+
+#include "arguments.hpp"
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace cthash::tools {
+
+struct tar_member {
+	std::string path;
+	std::string link_target;
+	char type; // typeflag ('0' regular file, '5' directory, ...)
+	uint64_t size;
+
+	bool regular() const noexcept {
+		return type == '0' || type == '\0' || type == '7';
+	}
+
+	// another name of earlier member `link_target` (it has no data of its own)
+	bool hardlink() const noexcept {
+		return type == '1';
+	}
+};
+
+// push parser of ustar, pax and GNU tar archives, it can be fed with arbitrary pieces of the archive
+// and member data are passed to the handler as subspans of the input (only headers are copied)
+struct tar_reader {
+	static constexpr size_t block_size = 512u;
+	static constexpr size_t max_extended_header = 1024u * 1024u;
+
+	enum class state { header, extended, data, padding, end, error };
+
+	// kind of extended header which is being collected
+	enum class extended_kind { pax, pax_global, gnu_long_name, gnu_long_link };
+
+	state current{state::header};
+	std::string error{};
+
+	std::array<std::byte, block_size> header_buffer{};
+	size_t header_used{0u};
+
+	extended_kind extended{};
+	std::string extended_data{};
+
+	uint64_t remaining{0u};
+	size_t padding{0u};
+
+	// values from extended headers for next member
+	std::string next_path{};
+	std::string next_link{};
+	std::optional<uint64_t> next_size{};
+
+	// archive ended with end-of-archive marker (or at least at member boundary)
+	bool complete() const noexcept {
+		return current == state::end || (current == state::header && header_used == 0u);
+	}
+
+	// handler has `begin(const tar_member &)`, `data(std::span<const std::byte>)` and `end()`
+	template <typename Handler> bool feed(std::span<const std::byte> in, Handler && handler) {
+		while (not in.empty()) {
+			switch (current) {
+			case state::header: {
+				std::span<const std::byte, block_size> block{header_buffer};
+
+				if (header_used == 0u && in.size() >= block_size) {
+					block = in.first<block_size>();
+					in = in.subspan(block_size);
+				} else {
+					const size_t n = std::min(block_size - header_used, in.size());
+					std::copy_n(in.begin(), n, header_buffer.begin() + static_cast<ptrdiff_t>(header_used));
+					header_used += n;
+					in = in.subspan(n);
+
+					if (header_used != block_size) {
+						return true;
+					}
+
+					header_used = 0u;
+				}
+
+				process_header(block, handler);
+				break;
+			}
+			case state::extended: {
+				const size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, in.size()));
+				extended_data.append(reinterpret_cast<const char *>(in.data()), n);
+				in = in.subspan(n);
+
+				if ((remaining -= n) == 0u) {
+					process_extended();
+				}
+				break;
+			}
+			case state::data: {
+				const size_t n = static_cast<size_t>(std::min<uint64_t>(remaining, in.size()));
+				handler.data(in.first(n));
+				in = in.subspan(n);
+
+				if ((remaining -= n) == 0u) {
+					handler.end();
+					current = state::padding;
+				}
+				break;
+			}
+			case state::padding: {
+				const size_t n = std::min(padding, in.size());
+				in = in.subspan(n);
+
+				if ((padding -= n) == 0u) {
+					current = state::header;
+				}
+				break;
+			}
+			case state::end:
+				// anything after end-of-archive marker is ignored
+				return true;
+			case state::error:
+				return false;
+			}
+
+			if (current == state::padding && padding == 0u) {
+				current = state::header;
+			}
+		}
+
+		return current != state::error;
+	}
+
+	static constexpr auto padding_of(uint64_t size) noexcept -> size_t {
+		return static_cast<size_t>((block_size - size % block_size) % block_size);
+	}
+
+	// string field which is terminated by NUL or by its size
+	static auto field(std::span<const std::byte, block_size> block, size_t offset, size_t size) -> std::string_view {
+		const char * ptr = reinterpret_cast<const char *>(block.data()) + offset;
+		return std::string_view(ptr, static_cast<size_t>(std::find(ptr, ptr + size, '\0') - ptr));
+	}
+
+	// octal number (possibly surrounded by spaces and NULs) or GNU base-256 number
+	static auto number(std::span<const std::byte, block_size> block, size_t offset, size_t size) -> std::optional<uint64_t> {
+		const auto * ptr = reinterpret_cast<const unsigned char *>(block.data()) + offset;
+
+		if (ptr[0] & 0x80u) {
+			uint64_t value = ptr[0] & 0x3Fu;
+
+			for (size_t i = 1; i != size; ++i) {
+				if (value >> 56u) {
+					return std::nullopt;
+				}
+				value = (value << 8u) | ptr[i];
+			}
+
+			return value;
+		}
+
+		size_t i = 0;
+		while (i != size && ptr[i] == ' ') {
+			++i;
+		}
+
+		uint64_t value = 0u;
+
+		for (; i != size && ptr[i] >= '0' && ptr[i] <= '7'; ++i) {
+			value = (value << 3u) | static_cast<uint64_t>(ptr[i] - '0');
+		}
+
+		if (i != size && ptr[i] != ' ' && ptr[i] != '\0') {
+			return std::nullopt;
+		}
+
+		return value;
+	}
+
+	void fail(std::string_view message) {
+		current = state::error;
+		error = message;
+	}
+
+	template <typename Handler> void process_header(std::span<const std::byte, block_size> block, Handler && handler) {
+		if (std::all_of(block.begin(), block.end(), [](std::byte b) { return b == std::byte{0}; })) {
+			current = state::end;
+			return;
+		}
+
+		// checksum is computed as if the checksum field contained spaces
+		const auto expected = number(block, 148u, 8u);
+		uint64_t sum = 0u;
+
+		for (size_t i = 0; i != block_size; ++i) {
+			sum += (i >= 148u && i < 156u) ? uint64_t{' '} : static_cast<uint64_t>(block[i]);
+		}
+
+		if (not expected || *expected != sum) {
+			return fail("invalid header checksum");
+		}
+
+		const auto size = number(block, 124u, 12u);
+
+		if (not size) {
+			return fail("invalid member size");
+		}
+
+		const char type = static_cast<char>(block[156u]);
+
+		const auto begin_extended = [&](extended_kind kind) {
+			if (*size > max_extended_header) {
+				return fail("extended header is too big");
+			}
+
+			extended = kind;
+			extended_data.clear();
+			remaining = *size;
+			padding = padding_of(*size);
+			current = state::extended;
+
+			if (remaining == 0u) {
+				process_extended();
+			}
+		};
+
+		switch (type) {
+		case 'x': return begin_extended(extended_kind::pax);
+		case 'g': return begin_extended(extended_kind::pax_global);
+		case 'L': return begin_extended(extended_kind::gnu_long_name);
+		case 'K': return begin_extended(extended_kind::gnu_long_link);
+		}
+
+		// GNU format uses "ustar  " magic and it has no prefix field
+		const auto magic = field(block, 257u, 6u);
+		const bool posix = magic == "ustar" && static_cast<char>(block[262u]) == '\0';
+
+		tar_member member{};
+		member.type = type;
+		member.size = next_size.value_or(*size);
+
+		if (not next_path.empty()) {
+			member.path = std::move(next_path);
+		} else if (const auto prefix = field(block, 345u, 155u); posix && not prefix.empty()) {
+			member.path = std::string(prefix) + '/' + std::string(field(block, 0u, 100u));
+		} else {
+			member.path = std::string(field(block, 0u, 100u));
+		}
+
+		member.link_target = not next_link.empty() ? std::move(next_link) : std::string(field(block, 157u, 100u));
+
+		next_path.clear();
+		next_link.clear();
+		next_size.reset();
+
+		remaining = member.size;
+		padding = padding_of(member.size);
+
+		handler.begin(member);
+
+		if (remaining == 0u) {
+			handler.end();
+			current = state::padding;
+		} else {
+			current = state::data;
+		}
+	}
+
+	void process_extended() {
+		current = state::padding;
+
+		switch (extended) {
+		case extended_kind::gnu_long_name:
+			next_path = extended_data.substr(0, extended_data.find('\0'));
+			return;
+		case extended_kind::gnu_long_link:
+			next_link = extended_data.substr(0, extended_data.find('\0'));
+			return;
+		case extended_kind::pax_global:
+			// global records don't carry per-member values we care about
+			return;
+		case extended_kind::pax:
+			break;
+		}
+
+		// records are "<length> <key>=<value>\n" where length counts whole record
+		auto records = std::string_view(extended_data);
+
+		while (not records.empty()) {
+			const auto space = records.find(' ');
+
+			// length which doesn't fit is rejected, it must not wrap around to a small one
+			const auto length = (space == std::string_view::npos) ? std::nullopt : parse_number<size_t>(records.substr(0, space));
+
+			if (not length || *length <= space + 1u || *length > records.size() || records[*length - 1u] != '\n') {
+				return fail("invalid pax record");
+			}
+
+			const auto record = records.substr(space + 1u, *length - space - 2u);
+			records = records.substr(*length);
+
+			const auto eq = record.find('=');
+
+			if (eq == std::string_view::npos) {
+				return fail("invalid pax record");
+			}
+
+			const auto key = record.substr(0, eq);
+			const auto value = record.substr(eq + 1u);
+
+			if (key == "path") {
+				next_path = std::string(value);
+			} else if (key == "linkpath") {
+				next_link = std::string(value);
+			} else if (key == "size") {
+				const auto v = parse_number<uint64_t>(value);
+				if (not v) {
+					return fail("invalid pax size");
+				}
+				next_size = *v;
+			}
+		}
+	}
+};
+
+} // namespace cthash::tools
+
+#endif
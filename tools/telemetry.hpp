@@ -0,0 +1,176 @@
+#ifndef CTHASH_TOOLS_TELEMETRY_HPP
+#define CTHASH_TOOLS_TELEMETRY_HPP
+
+#include "json.hpp"
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <sys/resource.h>
+
+namespace cthash::tools {
+
+enum class phase { walk, open, read, hash, output, throttle, file };
+
+constexpr auto phase_names = std::array<std::string_view, 7>{"walk", "open", "read", "hash", "output", "throttle", "file"};
+
+// phases which are exclusive (time of `file` overlaps with them)
+constexpr size_t exclusive_phases = 6u;
+
+constexpr auto name_of(phase p) noexcept -> std::string_view {
+	return phase_names[static_cast<size_t>(p)];
+}
+
+struct trace_event {
+	phase kind;
+	std::string detail;
+	int64_t start_ns;
+	int64_t duration_ns;
+};
+
+// statistics of one worker thread (only the worker writes into it)
+struct worker_telemetry {
+	using clock = std::chrono::steady_clock;
+
+	clock::time_point origin{clock::now()};
+	bool tracing{false};
+
+	std::array<int64_t, phase_names.size()> phase_ns{};
+	uint64_t bytes{0u};
+	uint64_t files{0u};
+	uint64_t cached_files{0u};
+	std::vector<trace_event> events{};
+
+	auto now() const noexcept -> int64_t {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin).count();
+	}
+
+	void record(phase p, int64_t start, int64_t end, std::string_view detail) {
+		phase_ns[static_cast<size_t>(p)] += end - start;
+
+		if (tracing) {
+			events.push_back({p, std::string(detail), start, end - start});
+		}
+	}
+
+	// measures duration of its own lifetime
+	struct scope {
+		worker_telemetry & owner;
+		phase kind;
+		std::string_view detail;
+		int64_t start{owner.now()};
+
+		scope(worker_telemetry & o, phase p, std::string_view d = {}): owner{o}, kind{p}, detail{d} { }
+		scope(const scope &) = delete;
+		scope(scope &&) = delete;
+
+		~scope() {
+			owner.record(kind, start, owner.now(), detail);
+		}
+	};
+
+	auto measure(phase p, std::string_view detail = {}) -> scope {
+		return scope{*this, p, detail};
+	}
+
+	// records time which already passed (for example sleep of a throttle)
+	template <typename Duration> void account(phase p, Duration d, std::string_view detail = {}) {
+		if (d > Duration{}) {
+			const auto end = now();
+			record(p, end - std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), end, detail);
+		}
+	}
+};
+
+struct process_usage {
+	double user_seconds{0.0};
+	double system_seconds{0.0};
+	long minor_faults{0};
+	long major_faults{0};
+
+	static auto current() noexcept -> process_usage {
+		struct rusage ru;
+
+		if (getrusage(RUSAGE_SELF, &ru) != 0) {
+			return {};
+		}
+
+		const auto seconds = [](const timeval & tv) { return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6; };
+
+		return {seconds(ru.ru_utime), seconds(ru.ru_stime), ru.ru_minflt, ru.ru_majflt};
+	}
+};
+
+inline void write_stats_json(std::ostream & os, const std::vector<worker_telemetry> & workers, double wall_seconds) {
+	const auto usage = process_usage::current();
+
+	uint64_t bytes = 0u;
+	uint64_t files = 0u;
+	uint64_t cached = 0u;
+	std::array<int64_t, phase_names.size()> phases{};
+
+	for (const auto & w: workers) {
+		bytes += w.bytes;
+		files += w.files;
+		cached += w.cached_files;
+
+		for (size_t i = 0; i != phases.size(); ++i) {
+			phases[i] += w.phase_ns[i];
+		}
+	}
+
+	os << "{\n";
+	os << "  \"files\": " << files << ",\n";
+	os << "  \"cached_files\": " << cached << ",\n";
+	os << "  \"bytes\": " << bytes << ",\n";
+	os << "  \"threads\": " << workers.size() << ",\n";
+	os << "  \"wall_seconds\": " << wall_seconds << ",\n";
+	os << "  \"cpu_user_seconds\": " << usage.user_seconds << ",\n";
+	os << "  \"cpu_system_seconds\": " << usage.system_seconds << ",\n";
+	os << "  \"throughput_bytes_per_second\": " << ((wall_seconds > 0.0) ? static_cast<double>(bytes) / wall_seconds : 0.0) << ",\n";
+	os << "  \"minor_page_faults\": " << usage.minor_faults << ",\n";
+	os << "  \"major_page_faults\": " << usage.major_faults << ",\n";
+	os << "  \"phase_seconds\": {";
+
+	// summed over all threads
+	for (size_t i = 0; i != exclusive_phases; ++i) {
+		os << ((i != 0u) ? ", " : "") << '"' << phase_names[i] << "\": " << static_cast<double>(phases[i]) / 1e9;
+	}
+
+	os << "}\n";
+	os << "}\n";
+}
+
+// Chrome trace-event format (open it in chrome://tracing or https://ui.perfetto.dev)
+inline void write_chrome_trace(std::ostream & os, const std::vector<worker_telemetry> & workers) {
+	os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+	bool first = true;
+
+	for (size_t tid = 0; tid != workers.size(); ++tid) {
+		os << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid << ", \"args\": {\"name\": \"worker " << tid << "\"}}";
+		first = false;
+
+		for (const auto & ev: workers[tid].events) {
+			os << ",\n{\"name\": \"" << name_of(ev.kind) << "\", \"cat\": \"checksum\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid;
+			os << ", \"ts\": " << static_cast<double>(ev.start_ns) / 1e3 << ", \"dur\": " << static_cast<double>(ev.duration_ns) / 1e3;
+
+			if (not ev.detail.empty()) {
+				os << ", \"args\": {\"path\": ";
+				write_json_string(os, ev.detail);
+				os << "}";
+			}
+
+			os << "}";
+		}
+	}
+
+	os << "\n]}\n";
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef CTHASH_TOOLS_THREAD_POOL_HPP
+#define CTHASH_TOOLS_THREAD_POOL_HPP
+
+#include "numa.hpp"
+#include <cthash/internal/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cthash::tools {
+
+// simple pool of workers, tasks can submit other tasks and they know on which worker they run
+// with NUMA topology workers are pinned to nodes and tasks can prefer a node (idle workers still steal them)
+struct thread_pool {
+	using task = std::function<void(size_t worker)>;
+	static constexpr size_t any_node = SIZE_MAX;
+
+	std::mutex mutex{};
+	std::condition_variable has_work{};
+	std::condition_variable is_idle{};
+	std::vector<std::vector<task>> queues{}; // one per node, the last one is for tasks without preference
+	std::vector<size_t> worker_nodes{};
+	size_t queued{0u};
+	size_t running{0u};
+	bool stopping{false};
+	std::vector<std::thread> threads{};
+
+	static auto default_size() noexcept -> size_t {
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	explicit thread_pool(size_t n = default_size(), const numa_topology * topology = nullptr): queues((topology ? topology->size() : 1u) + 1u) {
+		const bool pin = topology && topology->size() > 1u;
+
+		threads.reserve(n);
+		for (size_t i = 0; i != n; ++i) {
+			const size_t node = topology ? topology->node_of_worker(i, n) : 0u;
+			worker_nodes.push_back(node);
+
+			threads.emplace_back([this, i, node, cpus = pin ? topology->nodes[node].cpus : std::vector<unsigned>{}] {
+				if (not cpus.empty()) {
+					pin_current_thread(cpus);
+				}
+				run(i, node);
+			});
+		}
+	}
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool(thread_pool &&) = delete;
+
+	~thread_pool() {
+		{
+			std::lock_guard lock{mutex};
+			stopping = true;
+		}
+
+		has_work.notify_all();
+
+		for (auto & t: threads) {
+			t.join();
+		}
+	}
+
+	auto size() const noexcept -> size_t {
+		return threads.size();
+	}
+
+	auto node_of(size_t worker) const noexcept -> size_t {
+		return worker_nodes[worker];
+	}
+
+	void submit(task t, size_t node = any_node) {
+		{
+			std::lock_guard lock{mutex};
+			queues[std::min(node, queues.size() - 1u)].emplace_back(std::move(t));
+			++queued;
+		}
+
+		if (queues.size() > 2u) {
+			// only some of workers could prefer the task, but anyone can take it
+			has_work.notify_all();
+		} else {
+			has_work.notify_one();
+		}
+	}
+
+	// wait until there is no queued or running task
+	void wait() {
+		std::unique_lock lock{mutex};
+		is_idle.wait(lock, [&] { return queued == 0u && running == 0u; });
+	}
+
+private:
+	// own node first, then tasks without preference, then steal from other nodes
+	auto take(size_t node) -> task {
+		const auto pop = [&](std::vector<task> & q) {
+			auto t = std::move(q.back());
+			q.pop_back();
+			--queued;
+			return t;
+		};
+
+		if (not queues[node].empty()) {
+			return pop(queues[node]);
+		}
+
+		if (not queues.back().empty()) {
+			return pop(queues.back());
+		}
+
+		for (auto & q: queues) {
+			if (not q.empty()) {
+				return pop(q);
+			}
+		}
+
+		return {};
+	}
+
+	void run(size_t worker, size_t node) {
+		std::unique_lock lock{mutex};
+
+		for (;;) {
+			has_work.wait(lock, [&] { return stopping || queued != 0u; });
+
+			if (queued == 0u) {
+				return;
+			}
+
+			// newest first, so walking of a directory tree is depth first and keeps less state around
+			auto current = take(node);
+			++running;
+
+			lock.unlock();
+			current(worker);
+			lock.lock();
+
+			if (--running == 0u && queued == 0u) {
+				is_idle.notify_all();
+			}
+		}
+	}
+};
+
+// calls `fn(begin, end)` for chunks of `chunk` indices covering [0, count), they run on workers of `pool` (when there
+// is one) and on the calling thread, which returns after all of them finished; chunks are taken from a shared counter
+// and the calling thread takes them too, so it finishes them alone when workers are busy (it can be one of them)
+template <typename Fn> void for_each_chunk(thread_pool * pool, size_t count, size_t chunk, Fn && fn) {
+	CTHASH_ASSERT(chunk != 0u);
+
+	const size_t chunks = (count + chunk - 1u) / chunk;
+
+	const auto run = [&](size_t c) {
+		fn(c * chunk, std::min(count, (c + 1u) * chunk));
+	};
+
+	if (pool == nullptr || chunks < 2u) {
+		for (size_t c = 0; c != chunks; ++c) {
+			run(c);
+		}
+		return;
+	}
+
+	// helpers which start after all chunks were taken may run after return, so they touch only this shared state
+	struct progress {
+		std::atomic<size_t> next{0u};
+		std::atomic<size_t> done{0u};
+	};
+
+	const auto state = std::make_shared<progress>();
+
+	const auto take = [&run, state, chunks] {
+		for (size_t c; (c = state->next++) < chunks;) {
+			run(c);
+
+			if (++state->done == chunks) {
+				state->done.notify_all();
+			}
+		}
+	};
+
+	for (size_t c = 1u; c != chunks; ++c) {
+		pool->submit([take](size_t) { take(); });
+	}
+
+	take();
+
+	for (size_t d; (d = state->done.load()) != chunks;) {
+		state->done.wait(d);
+	}
+}
+
+// calls `fn(i)` for each `i` in [0, count), split into chunks as `for_each_chunk`
+template <typename Fn> void for_each_index(thread_pool * pool, size_t count, size_t chunk, Fn && fn) {
+	for_each_chunk(pool, count, chunk, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i != end; ++i) {
+			fn(i);
+		}
+	});
+}
+
+} // namespace cthash::tools
+
+#endif
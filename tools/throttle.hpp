@@ -0,0 +1,203 @@
+#ifndef CTHASH_TOOLS_THROTTLE_HPP
+#define CTHASH_TOOLS_THROTTLE_HPP
+
+#include "arguments.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cthash::tools {
+
+using throttle_clock = std::chrono::steady_clock;
+
+// shared limiter, tokens can go into debt so big requests are smoothed over time instead of being rejected
+struct token_bucket {
+	double rate; // tokens per second (0 = unlimited)
+	double burst;
+
+	std::mutex mutex{};
+	double tokens;
+	throttle_clock::time_point last{throttle_clock::now()};
+
+	explicit token_bucket(double r = 0.0): rate{r}, burst{r}, tokens{r} { }
+
+	bool limited() const noexcept {
+		return rate > 0.0;
+	}
+
+	// takes `n` tokens and returns how long caller needs to wait before using them (`factor` scales the rate down)
+	auto reserve(double n, double factor = 1.0) -> throttle_clock::duration {
+		if (not limited()) {
+			return {};
+		}
+
+		std::lock_guard lock{mutex};
+
+		const auto now = throttle_clock::now();
+		const double effective_rate = rate * factor;
+		tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * effective_rate);
+		last = now;
+		tokens -= n;
+
+		if (tokens >= 0.0) {
+			return {};
+		}
+
+		return std::chrono::duration_cast<throttle_clock::duration>(std::chrono::duration<double>(-tokens / effective_rate));
+	}
+};
+
+// "some avg10" from pressure stall information (percentage of time some task waited on the resource)
+inline auto read_pressure(const char * path) -> std::optional<double> {
+	auto in = std::ifstream(path);
+	std::string word;
+
+	while (in >> word) {
+		if (word.starts_with("avg10=")) {
+			return std::strtod(word.c_str() + 6, nullptr);
+		}
+	}
+
+	return std::nullopt;
+}
+
+inline bool pressure_available() {
+	return read_pressure("/proc/pressure/io").has_value() || read_pressure("/proc/pressure/cpu").has_value();
+}
+
+// rate limits for bytes and I/O operations with optional adaptive backoff driven by system pressure
+struct throttle {
+	token_bucket bytes;
+	token_bucket operations;
+
+	// adaptive mode: when IO or CPU pressure is above threshold speed is halved, otherwise it slowly recovers
+	double pressure_threshold; // 0 = adaptive mode is disabled
+	static constexpr double min_factor = 1.0 / 64.0;
+	static constexpr double recovery_step = 1.0 / 16.0;
+	static constexpr auto sample_period = std::chrono::seconds{1};
+
+	std::mutex adaptive_mutex{};
+	double factor{1.0};
+	throttle_clock::time_point last_sample{};
+
+	throttle(double bytes_per_second, double operations_per_second, double threshold): bytes{bytes_per_second}, operations{operations_per_second}, pressure_threshold{threshold} { }
+
+	bool active() const noexcept {
+		return bytes.limited() || operations.limited() || pressure_threshold > 0.0;
+	}
+
+	auto current_factor() -> double {
+		if (pressure_threshold <= 0.0) {
+			return 1.0;
+		}
+
+		std::lock_guard lock{adaptive_mutex};
+		const auto now = throttle_clock::now();
+
+		if (now - last_sample >= sample_period) {
+			last_sample = now;
+			const double pressure = std::max(read_pressure("/proc/pressure/io").value_or(0.0), read_pressure("/proc/pressure/cpu").value_or(0.0));
+
+			if (pressure > pressure_threshold) {
+				factor = std::max(factor / 2.0, min_factor);
+			} else {
+				factor = std::min(factor + recovery_step, 1.0);
+			}
+		}
+
+		return factor;
+	}
+
+	// call before doing `n` bytes of I/O in `ops` operations, returns time spent waiting
+	auto acquire(uint64_t n, unsigned ops = 1u) -> throttle_clock::duration {
+		if (not active()) {
+			return {};
+		}
+
+		const double f = current_factor();
+		const auto wait = std::max(bytes.reserve(static_cast<double>(n), f), operations.reserve(static_cast<double>(ops), f));
+
+		if (wait > throttle_clock::duration{}) {
+			std::this_thread::sleep_for(wait);
+		}
+
+		return wait;
+	}
+
+	// without explicit limits adaptive mode keeps duty cycle of workers: after work which took `spent` it sleeps so only `factor` of time is used
+	auto pause_after(throttle_clock::duration spent) -> throttle_clock::duration {
+		if (pressure_threshold <= 0.0 || bytes.limited() || operations.limited()) {
+			return {};
+		}
+
+		const double f = current_factor();
+
+		if (f >= 1.0) {
+			return {};
+		}
+
+		const auto wait = std::chrono::duration_cast<throttle_clock::duration>(spent * ((1.0 - f) / f));
+		std::this_thread::sleep_for(wait);
+		return wait;
+	}
+};
+
+// lowest IO priority (idle class) and SCHED_IDLE for calling thread, threads created later inherit both
+inline bool become_idle() noexcept {
+#ifdef __linux__
+	constexpr int ioprio_class_shift = 13;
+	constexpr int ioprio_class_idle = 3;
+	constexpr int ioprio_who_process = 1;
+
+	const bool io = syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift) == 0;
+
+	sched_param param{};
+	param.sched_priority = 0;
+	const bool cpu = sched_setscheduler(0, SCHED_IDLE, &param) == 0;
+
+	return io && cpu;
+#else
+	return false;
+#endif
+}
+
+// parses number with optional K/M/G/T suffix (powers of 1024), it must be finite and not negative
+inline auto parse_size(std::string_view in) -> std::optional<double> {
+	double scale = 1.0;
+
+	if (not in.empty()) {
+		switch (in.back()) {
+		case 'T': case 't': scale *= 1024.0; [[fallthrough]];
+		case 'G': case 'g': scale *= 1024.0; [[fallthrough]];
+		case 'M': case 'm': scale *= 1024.0; [[fallthrough]];
+		case 'K': case 'k': scale *= 1024.0; in.remove_suffix(1u); break;
+		default: break;
+		}
+	}
+
+	const auto value = parse_number<double>(in);
+
+	if (not value || not std::isfinite(*value * scale) || *value < 0.0) {
+		return std::nullopt;
+	}
+
+	return *value * scale;
+}
+
+} // namespace cthash::tools
+
+#endif
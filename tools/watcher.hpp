@@ -0,0 +1,389 @@
+#ifndef CTHASH_TOOLS_WATCHER_HPP
+#define CTHASH_TOOLS_WATCHER_HPP
+
+#include "directory.hpp"
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+
+#ifdef __linux__
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#endif
+
+namespace cthash::tools {
+
+struct watch_event {
+	enum class kind {
+		written, // file was closed after write or moved into the tree
+		removed, // file or directory was deleted or moved out of the tree
+		overflow, // kernel dropped events, everything needs to be rescanned
+	};
+
+	kind what;
+	std::string path;
+	bool directory{false};
+};
+
+// source of change events for a set of directory trees
+struct watcher {
+	virtual ~watcher() = default;
+
+	// waits at most `timeout_ms` for events and appends them to `out`, returns false on error
+	virtual bool poll(std::vector<watch_event> & out, int timeout_ms) = 0;
+	virtual auto backend() const noexcept -> std::string_view = 0;
+};
+
+// calls `cb(path)` for each regular file in the tree (symlinks are not followed)
+template <typename CB> void for_each_file_in_tree(const std::string & path, CB && cb) {
+	const auto dir = directory(AT_FDCWD, path.c_str());
+
+	if (not dir.valid()) {
+		return;
+	}
+
+	const auto prefix = path.ends_with('/') ? path : (path + '/');
+
+	for_each_entry(dir.fd, [&](std::string_view name, entry_type type) {
+		auto child = prefix + std::string(name);
+
+		if (type == entry_type::unknown) {
+			const auto status = stat_at(dir.fd, child.c_str() + prefix.size());
+			type = status ? status->type : entry_type::other;
+		}
+
+		if (type == entry_type::directory) {
+			for_each_file_in_tree(child, cb);
+		} else if (type == entry_type::regular) {
+			cb(child);
+		}
+	});
+}
+
+inline bool wait_readable(int fd, int timeout_ms) noexcept {
+	pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+	return ::poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN) != 0;
+}
+
+#ifdef __linux__
+
+// one watch per directory, new directories are watched when they appear
+struct inotify_watcher final: watcher {
+	static constexpr uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+	int fd{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+	std::unordered_map<int, std::string> paths{};
+
+	explicit inotify_watcher(const std::vector<std::string> & roots) {
+		for (const auto & root: roots) {
+			add_tree(root, nullptr);
+		}
+	}
+
+	~inotify_watcher() override {
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+
+	bool valid() const noexcept {
+		return fd != -1 && not paths.empty();
+	}
+
+	// watch the tree, files already in it are reported as written (they could be written before the watch existed)
+	void add_tree(const std::string & path, std::vector<watch_event> * discovered) {
+		const int wd = inotify_add_watch(fd, path.c_str(), mask);
+
+		if (wd < 0) {
+			return;
+		}
+
+		// watches of a directory moved inside of the tree were removed when it left its old place
+		paths[wd] = path;
+
+		const auto dir = directory(AT_FDCWD, path.c_str());
+
+		if (not dir.valid()) {
+			return;
+		}
+
+		const auto prefix = path.ends_with('/') ? path : (path + '/');
+
+		for_each_entry(dir.fd, [&](std::string_view name, entry_type type) {
+			auto child = prefix + std::string(name);
+
+			if (type == entry_type::unknown) {
+				const auto status = stat_at(dir.fd, child.c_str() + prefix.size());
+				type = status ? status->type : entry_type::other;
+			}
+
+			if (type == entry_type::directory) {
+				add_tree(child, discovered);
+			} else if (type == entry_type::regular && discovered) {
+				discovered->push_back({watch_event::kind::written, std::move(child)});
+			}
+		});
+	}
+
+	// directory moved away isn't watched anymore, its watches would keep reporting files under the old path
+	void remove_tree(const std::string & path) {
+		const auto prefix = path + '/';
+
+		for (auto it = paths.begin(); it != paths.end();) {
+			if (it->second == path || it->second.starts_with(prefix)) {
+				inotify_rm_watch(fd, it->first);
+				it = paths.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	bool poll(std::vector<watch_event> & out, int timeout_ms) override {
+		if (not wait_readable(fd, timeout_ms)) {
+			return true;
+		}
+
+		alignas(inotify_event) std::array<char, 64u * 1024u> buffer;
+
+		for (;;) {
+			const auto r = read(fd, buffer.data(), buffer.size());
+
+			if (r < 0) {
+				return errno == EAGAIN || errno == EINTR;
+			}
+
+			for (size_t offset = 0; offset < static_cast<size_t>(r);) {
+				inotify_event ev;
+				std::memcpy(&ev, buffer.data() + offset, sizeof(ev));
+				const char * name = buffer.data() + offset + sizeof(ev);
+				offset += sizeof(ev) + ev.len;
+
+				if (ev.mask & IN_Q_OVERFLOW) {
+					out.push_back({watch_event::kind::overflow, {}});
+					continue;
+				}
+
+				if (ev.mask & IN_IGNORED) {
+					paths.erase(ev.wd);
+					continue;
+				}
+
+				const auto it = paths.find(ev.wd);
+
+				if (it == paths.end() || ev.len == 0u) {
+					continue;
+				}
+
+				auto path = (it->second.ends_with('/') ? it->second : (it->second + '/')) + name;
+				const bool is_dir = (ev.mask & IN_ISDIR) != 0u;
+
+				if (is_dir && (ev.mask & (IN_CREATE | IN_MOVED_TO))) {
+					add_tree(path, &out);
+				} else if (not is_dir && (ev.mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+					out.push_back({watch_event::kind::written, std::move(path)});
+				} else if (ev.mask & (IN_DELETE | IN_MOVED_FROM)) {
+					if (is_dir && (ev.mask & IN_MOVED_FROM)) {
+						remove_tree(path);
+					}
+					out.push_back({watch_event::kind::removed, std::move(path), is_dir});
+				}
+			}
+		}
+	}
+
+	auto backend() const noexcept -> std::string_view override {
+		return "inotify";
+	}
+};
+
+// one mark for whole filesystem (needs CAP_SYS_ADMIN), events are resolved to paths and filtered by watched roots
+struct fanotify_watcher final: watcher {
+	static constexpr uint64_t mask = FAN_CLOSE_WRITE | FAN_MOVED_TO | FAN_MOVED_FROM | FAN_DELETE | FAN_ONDIR;
+
+	struct root {
+		std::string real; // canonical path (as it's reported)
+		std::string given; // path as user wrote it (as it's printed)
+		int mount_fd;
+	};
+
+	int fd{fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE)};
+	std::vector<root> roots{};
+	bool marked{fd != -1};
+
+	explicit fanotify_watcher(const std::vector<std::string> & paths) {
+		for (const auto & path: paths) {
+			if (not marked) {
+				return;
+			}
+
+			char * real = realpath(path.c_str(), nullptr);
+
+			if (real == nullptr) {
+				marked = false;
+				return;
+			}
+
+			roots.push_back({real, path.ends_with('/') ? path.substr(0, path.size() - 1u) : path, open(real, O_RDONLY | O_DIRECTORY | O_CLOEXEC)});
+			std::free(real);
+
+			marked = roots.back().mount_fd != -1 && fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask, AT_FDCWD, path.c_str()) == 0;
+		}
+	}
+
+	~fanotify_watcher() override {
+		for (const auto & r: roots) {
+			if (r.mount_fd != -1) {
+				close(r.mount_fd);
+			}
+		}
+
+		if (fd != -1) {
+			close(fd);
+		}
+	}
+
+	bool valid() const noexcept {
+		return marked;
+	}
+
+	// path of directory identified by file handle (it needs to be opened, so deleted directories are not resolved)
+	auto resolve(const unsigned char * handle, size_t handle_size, std::string_view name) const -> std::optional<std::string> {
+		alignas(file_handle) std::array<unsigned char, sizeof(file_handle) + MAX_HANDLE_SZ> storage;
+
+		if (handle_size > storage.size()) {
+			return std::nullopt;
+		}
+
+		std::memcpy(storage.data(), handle, handle_size);
+
+		for (const auto & r: roots) {
+			const int dirfd = open_by_handle_at(r.mount_fd, reinterpret_cast<file_handle *>(storage.data()), O_PATH | O_CLOEXEC);
+
+			if (dirfd == -1) {
+				continue;
+			}
+
+			std::array<char, PATH_MAX> target;
+			const auto link = "/proc/self/fd/" + std::to_string(dirfd);
+			const auto len = readlink(link.c_str(), target.data(), target.size());
+			close(dirfd);
+
+			if (len <= 0) {
+				return std::nullopt;
+			}
+
+			const auto dir = std::string_view(target.data(), static_cast<size_t>(len));
+
+			for (const auto & candidate: roots) {
+				if (dir == candidate.real || (dir.starts_with(candidate.real) && dir[candidate.real.size()] == '/')) {
+					return candidate.given + std::string(dir.substr(candidate.real.size())) + '/' + std::string(name);
+				}
+			}
+
+			return std::nullopt;
+		}
+
+		return std::nullopt;
+	}
+
+	bool poll(std::vector<watch_event> & out, int timeout_ms) override {
+		if (not wait_readable(fd, timeout_ms)) {
+			return true;
+		}
+
+		alignas(fanotify_event_metadata) std::array<char, 64u * 1024u> buffer;
+
+		// layout of `struct fanotify_event_info_fid` followed by `struct file_handle` and a name
+		constexpr size_t handle_offset = 12u;
+		constexpr size_t handle_header = 8u;
+
+		for (;;) {
+			const auto r = read(fd, buffer.data(), buffer.size());
+
+			if (r < 0) {
+				return errno == EAGAIN || errno == EINTR;
+			}
+
+			for (size_t offset = 0; offset < static_cast<size_t>(r);) {
+				fanotify_event_metadata ev;
+				std::memcpy(&ev, buffer.data() + offset, sizeof(ev));
+				const char * info = buffer.data() + offset + ev.metadata_len;
+				const char * end = buffer.data() + offset + ev.event_len;
+				offset += ev.event_len;
+
+				if (ev.mask & FAN_Q_OVERFLOW) {
+					out.push_back({watch_event::kind::overflow, {}});
+					continue;
+				}
+
+				while (info + sizeof(fanotify_event_info_header) <= end) {
+					fanotify_event_info_header hdr;
+					std::memcpy(&hdr, info, sizeof(hdr));
+
+					if (hdr.len == 0u) {
+						break;
+					}
+
+					if (hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+						uint32_t handle_bytes;
+						std::memcpy(&handle_bytes, info + handle_offset, sizeof(handle_bytes));
+						const size_t handle_size = handle_header + handle_bytes;
+						const char * name = info + handle_offset + handle_size;
+
+						if (auto path = resolve(reinterpret_cast<const unsigned char *>(info + handle_offset), handle_size, name)) {
+							const bool is_dir = (ev.mask & FAN_ONDIR) != 0u;
+
+							if (is_dir && (ev.mask & FAN_MOVED_TO)) {
+								// files in moved directory don't generate events on their own
+								for_each_file_in_tree(*path, [&](std::string file) { out.push_back({watch_event::kind::written, std::move(file)}); });
+							} else if (not is_dir && (ev.mask & (FAN_CLOSE_WRITE | FAN_MOVED_TO))) {
+								out.push_back({watch_event::kind::written, std::move(*path)});
+							} else if (ev.mask & (FAN_DELETE | FAN_MOVED_FROM)) {
+								out.push_back({watch_event::kind::removed, std::move(*path), is_dir});
+							}
+						}
+					}
+
+					info += hdr.len;
+				}
+			}
+		}
+	}
+
+	auto backend() const noexcept -> std::string_view override {
+		return "fanotify";
+	}
+};
+
+#endif
+
+// fanotify where it's permitted, inotify otherwise
+inline auto make_watcher(const std::vector<std::string> & roots) -> std::unique_ptr<watcher> {
+#ifdef __linux__
+	if (auto fan = std::make_unique<fanotify_watcher>(roots); fan->valid()) {
+		return fan;
+	}
+
+	if (auto ino = std::make_unique<inotify_watcher>(roots); ino->valid()) {
+		return ino;
+	}
+#else
+	(void)roots;
+#endif
+
+	return nullptr;
+}
+
+} // namespace cthash::tools
+
+#endif
@@ -0,0 +1,161 @@
+#include "tools/algorithms.hpp"
+#include "tools/arguments.hpp"
+#include "tools/chain.hpp"
+#include "tools/mapped-file.hpp"
+#include "tools/multi-buffer.hpp"
+#include "tools/thread-pool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+
+struct options {
+	const char * path{nullptr};
+	size_t jobs{cthash::tools::thread_pool::default_size()};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options] log\n";
+	std::cerr << "verifies hash-linked log: each line starts with hex SHA-256 of the previous line (without its newline)\n";
+	std::cerr << "followed by a space, the first line links to zeros; records are hashed in parallel and links are checked after\n";
+	std::cerr << "options:\n";
+	std::cerr << "  -j N                  number of worker threads (default is number of CPUs)\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("-j")) {
+			const auto jobs = cthash::tools::jobs_argument(arg, i, argc, argv);
+			if (not jobs) {
+				std::cerr << "number of jobs must be positive number!\n";
+				return std::nullopt;
+			}
+			opts.jobs = *jobs;
+		} else if (arg.starts_with("-")) {
+			std::cerr << "unknown option '" << arg << "'!\n";
+			return std::nullopt;
+		} else if (opts.path == nullptr) {
+			opts.path = argv[i];
+		} else {
+			usage(argv[0]);
+			return std::nullopt;
+		}
+	}
+
+	if (opts.path == nullptr) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+using chain = cthash::tools::hash_chain<32>;
+
+// log is verified in windows, so memory doesn't grow with its length, only digest of the last record is carried over
+static constexpr size_t window_size = 64u * 1024u * 1024u;
+
+// records of one task, small records are cheap so they are hashed in batches (in lanes of multi-buffer SHA-256)
+static constexpr size_t batch_size = 4096u;
+
+struct chain_window {
+	std::vector<std::span<const std::byte>> records{};
+	std::vector<chain::digest> digests{};
+	std::vector<chain::digest> links{};
+	std::vector<uint8_t> malformed{};
+
+	void hash(cthash::tools::thread_pool & pool) {
+		const size_t n = records.size();
+		digests.resize(n);
+		links.resize(n);
+		malformed.assign(n, 0u);
+
+		for (size_t start = 0; start < n; start += batch_size) {
+			pool.submit([this, start, stop = std::min(start + batch_size, n)](size_t) {
+				cthash::tools::multi_buffer<cthash::sha256>::hash(std::span(records).subspan(start, stop - start), [&](size_t i, std::span<const std::byte, 32> d) {
+					std::copy(d.begin(), d.end(), digests[start + i].begin());
+				});
+
+				for (size_t i = start; i != stop; ++i) {
+					if (const auto link = chain::parse_link(records[i])) {
+						links[i] = *link;
+					} else {
+						// record which can't link to anything is reported as a break
+						links[i].fill(std::byte{0xFF});
+						malformed[i] = 1u;
+					}
+				}
+			});
+		}
+
+		pool.wait();
+	}
+};
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	const auto file = cthash::tools::input_file(opts->path);
+	const auto mapped = cthash::tools::mapped_file(file);
+
+	if (not file.valid() || not mapped.valid()) {
+		std::cerr << opts->path << ": can't read\n";
+		return 1;
+	}
+
+	const auto data = mapped.get_span();
+
+	cthash::tools::thread_pool pool{opts->jobs};
+	chain_window window;
+	chain::digest previous{};
+	uint64_t number = 0u;
+
+	for (size_t pos = 0; pos < data.size();) {
+		// window ends after a newline, record longer than window makes the window longer
+		size_t end = std::min(pos + window_size, data.size());
+
+		if (end != data.size()) {
+			const auto part = data.subspan(pos, end - pos);
+			const auto last_nl = std::find(part.rbegin(), part.rend(), std::byte{'\n'});
+
+			if (last_nl != part.rend()) {
+				end = pos + static_cast<size_t>(part.rend() - last_nl);
+			} else {
+				const auto * nl = static_cast<const std::byte *>(std::memchr(data.data() + end, '\n', data.size() - end));
+				end = (nl == nullptr) ? data.size() : static_cast<size_t>(nl - data.data()) + 1u;
+			}
+		}
+
+		window.records.clear();
+		chain::split(data.subspan(pos, end - pos), end == data.size(), window.records);
+		window.hash(pool);
+
+		if (const auto broken = chain::first_break(previous, window.links, window.digests)) {
+			const auto record = window.records[*broken];
+			std::cout << opts->path << ": chain is broken at record " << (number + *broken + 1u) << " (offset " << static_cast<size_t>(record.data() - data.data()) << "): ";
+			std::cout << (window.malformed[*broken] ? "malformed link" : "link doesn't match previous record") << "\n";
+			return 1;
+		}
+
+		if (not window.records.empty()) {
+			previous = window.digests.back();
+		}
+
+		number += window.records.size();
+		pos = end;
+	}
+
+	std::cout << opts->path << ": ok, " << number << " records, last " << cthash::tools::digest_value(previous) << "\n";
+	return 0;
+}
@@ -0,0 +1,405 @@
+#include "tools/algorithms.hpp"
+#include "tools/arguments.hpp"
+#include "tools/git.hpp"
+#include "tools/inflate.hpp"
+#include "tools/mapped-file.hpp"
+#include "tools/thread-pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+
+struct options {
+	std::vector<std::string_view> packs{};
+	size_t jobs{cthash::tools::thread_pool::default_size()};
+	bool sha256{false};
+};
+
+static void usage(const char * name) {
+	std::cerr << name << " [options] pack...\n";
+	std::cerr << "verifies git packs (.pack with its .idx): checksums of both files, CRC-32 of each entry\n";
+	std::cerr << "and id of each object after inflating and resolving deltas, objects are checked in parallel\n";
+	std::cerr << "options:\n";
+	std::cerr << "  -j N                  number of worker threads (default is number of CPUs)\n";
+	std::cerr << "  --object-format=F     sha1 (default) or sha256\n";
+}
+
+static auto parse_options(int argc, char ** argv) -> std::optional<options> {
+	options opts{};
+
+	for (int i = 1; i != argc; ++i) {
+		const auto arg = std::string_view(argv[i]);
+
+		if (arg.starts_with("-j")) {
+			const auto jobs = cthash::tools::jobs_argument(arg, i, argc, argv);
+			if (not jobs) {
+				std::cerr << "number of jobs must be positive number!\n";
+				return std::nullopt;
+			}
+			opts.jobs = *jobs;
+		} else if (arg == "--object-format=sha1") {
+			opts.sha256 = false;
+		} else if (arg == "--object-format=sha256") {
+			opts.sha256 = true;
+		} else if (arg.starts_with("-")) {
+			std::cerr << "unknown option '" << arg << "'!\n";
+			return std::nullopt;
+		} else {
+			opts.packs.emplace_back(arg);
+		}
+	}
+
+	if (opts.packs.empty()) {
+		usage(argv[0]);
+		return std::nullopt;
+	}
+
+	return opts;
+}
+
+// entry of the pack (in order of offsets)
+struct pack_object {
+	uint64_t offset;
+	uint64_t end;
+	size_t index; // position in .idx
+	cthash::tools::pack_entry entry{};
+	bool parsed{false};
+	size_t base{SIZE_MAX};
+};
+
+using content_ptr = std::shared_ptr<const std::vector<std::byte>>;
+
+// objects are verified by walking delta trees: each base object is inflated once and its content is
+// shared by all its deltas, independent trees (and siblings in a tree) are verified on different workers
+template <typename Hasher> struct pack_verifier {
+	static constexpr size_t hash_size = decltype(std::declval<Hasher &>().final()){}.size();
+
+	std::string name;
+	cthash::tools::thread_pool & pool;
+
+	cthash::tools::input_file idx_file;
+	cthash::tools::input_file pack_file;
+	cthash::tools::mapped_file idx_map;
+	cthash::tools::mapped_file pack_map;
+	std::span<const std::byte> pack{};
+	cthash::tools::pack_index index{};
+
+	std::vector<pack_object> objects{};
+	std::vector<size_t> children_start{};
+	std::vector<size_t> children{};
+
+	std::atomic<size_t> verified{0u};
+	std::atomic<size_t> deltas{0u};
+	std::atomic<size_t> longest_chain{0u};
+	std::atomic<bool> failed{false};
+	std::mutex output_mutex{};
+
+	pack_verifier(std::string_view path, cthash::tools::thread_pool & p): name{path}, pool{p}, idx_file{(base_of(path) + ".idx").c_str()}, pack_file{(base_of(path) + ".pack").c_str()}, idx_map{idx_file}, pack_map{pack_file} { }
+
+	static auto base_of(std::string_view path) -> std::string {
+		for (const auto suffix: {std::string_view{".pack"}, std::string_view{".idx"}}) {
+			if (path.ends_with(suffix)) {
+				return std::string(path.substr(0, path.size() - suffix.size()));
+			}
+		}
+		return std::string(path);
+	}
+
+	void error(std::string_view what) {
+		failed = true;
+		std::lock_guard _{output_mutex};
+		std::cerr << name << ": " << what << "\n";
+	}
+
+	void object_error(const pack_object & obj, std::string_view what) {
+		failed = true;
+		std::lock_guard _{output_mutex};
+		std::cerr << name << ": object " << cthash::tools::digest_value(index.name(obj.index)) << " at offset " << obj.offset << ": " << what << "\n";
+	}
+
+	void verify_checksum(std::span<const std::byte> content, std::span<const std::byte> expected, std::string_view what) {
+		const auto actual = Hasher{}.update(content).final();
+
+		if (not std::ranges::equal(std::span<const std::byte>(actual.data(), actual.size()), expected)) {
+			error(std::string(what) + " checksum mismatch");
+		}
+	}
+
+	bool load() {
+		if (not idx_file.valid() || not idx_map.valid()) {
+			error("can't read index");
+			return false;
+		}
+
+		if (not pack_file.valid() || not pack_map.valid()) {
+			error("can't read pack");
+			return false;
+		}
+
+		const auto parsed = cthash::tools::pack_index::parse(idx_map.get_span(), hash_size);
+
+		if (not parsed) {
+			error("index is not valid version 2 index");
+			return false;
+		}
+
+		index = *parsed;
+		pack = pack_map.get_span();
+
+		constexpr auto magic = std::array{std::byte{'P'}, std::byte{'A'}, std::byte{'C'}, std::byte{'K'}};
+
+		if (pack.size() < 12u + hash_size || not std::ranges::equal(pack.first(4u), magic)) {
+			error("not a pack");
+			return false;
+		}
+
+		if (const auto version = cthash::tools::read_be32(pack.subspan(4u)); version != 2u && version != 3u) {
+			error("unsupported pack version");
+			return false;
+		}
+
+		if (cthash::tools::read_be32(pack.subspan(8u)) != index.count) {
+			error("number of objects in pack and index differ");
+			return false;
+		}
+
+		if (not std::ranges::equal(pack.last(hash_size), index.pack_checksum)) {
+			error("pack checksum differs from the one in index");
+		}
+
+		return true;
+	}
+
+	// objects in order of offsets, their headers and links to their bases
+	bool build_graph() {
+		const uint64_t data_end = pack.size() - hash_size;
+
+		objects.reserve(index.count);
+
+		for (size_t i = 0; i != index.count; ++i) {
+			const auto offset = index.offset(i);
+
+			if (not offset || *offset < 12u || *offset >= data_end) {
+				error("index has invalid offset");
+				return false;
+			}
+
+			objects.push_back({*offset, data_end, i});
+		}
+
+		std::ranges::sort(objects, {}, &pack_object::offset);
+
+		std::vector<size_t> by_index(index.count);
+
+		for (size_t i = 0; i != objects.size(); ++i) {
+			if (i + 1u != objects.size()) {
+				if (objects[i + 1u].offset == objects[i].offset) {
+					error("index has duplicate offset");
+					return false;
+				}
+				objects[i].end = objects[i + 1u].offset;
+			}
+
+			by_index[objects[i].index] = i;
+		}
+
+		std::vector<size_t> child_count(objects.size() + 1u, 0u);
+
+		for (auto & obj: objects) {
+			const auto entry = cthash::tools::pack_entry::parse(pack.first(static_cast<size_t>(obj.end)), obj.offset, hash_size);
+
+			if (not entry) {
+				object_error(obj, "invalid entry header");
+				continue;
+			}
+
+			obj.entry = *entry;
+			obj.parsed = true;
+
+			if (entry->type == cthash::tools::git_object_type::ofs_delta) {
+				const auto it = std::ranges::lower_bound(objects, entry->base_offset, {}, &pack_object::offset);
+
+				if (it == objects.end() || it->offset != entry->base_offset) {
+					object_error(obj, "base object is not in pack");
+					continue;
+				}
+
+				obj.base = static_cast<size_t>(it - objects.begin());
+			} else if (entry->type == cthash::tools::git_object_type::ref_delta) {
+				const auto position = index.find(entry->base_name);
+
+				if (not position) {
+					object_error(obj, "base object is not in pack (thin packs are not supported)");
+					continue;
+				}
+
+				obj.base = by_index[*position];
+			}
+
+			if (obj.base != SIZE_MAX) {
+				++child_count[obj.base];
+			}
+		}
+
+		// children of each object are stored together (compressed sparse rows)
+		children_start.assign(objects.size() + 1u, 0u);
+		for (size_t i = 0; i != objects.size(); ++i) {
+			children_start[i + 1u] = children_start[i] + child_count[i];
+		}
+
+		children.resize(children_start.back());
+		auto fill = std::vector<size_t>(children_start.begin(), children_start.end() - 1);
+
+		for (size_t i = 0; i != objects.size(); ++i) {
+			if (objects[i].base != SIZE_MAX) {
+				children[fill[objects[i].base]++] = i;
+			}
+		}
+
+		return true;
+	}
+
+	// inflates, resolves and checks object and then its deltas (the last child continues on this worker)
+	void resolve(size_t current, content_ptr base, cthash::tools::git_object_type type, size_t depth) {
+		std::vector<std::byte> inflated;
+
+		for (;;) {
+			const auto & obj = objects[current];
+			const auto raw = pack.subspan(static_cast<size_t>(obj.offset), static_cast<size_t>(obj.end - obj.offset));
+
+			if (cthash::tools::crc32(raw) != index.crc(obj.index)) {
+				object_error(obj, "CRC-32 mismatch");
+			}
+
+			const auto data = pack.subspan(static_cast<size_t>(obj.entry.data_offset), static_cast<size_t>(obj.end - obj.entry.data_offset));
+			const auto consumed = cthash::tools::zlib_inflate(data, inflated, static_cast<size_t>(obj.entry.size));
+
+			if (not consumed || inflated.size() != obj.entry.size) {
+				object_error(obj, "can't inflate");
+				return;
+			}
+
+			auto content = std::make_shared<std::vector<std::byte>>();
+
+			if (obj.entry.delta()) {
+				if (not cthash::tools::apply_delta(*base, inflated, *content)) {
+					object_error(obj, "invalid delta");
+					return;
+				}
+				++deltas;
+			} else {
+				type = obj.entry.type;
+				content->swap(inflated);
+			}
+
+			const auto id = cthash::tools::git_object_id<Hasher>(cthash::tools::git_type_name(type), *content);
+
+			if (not std::ranges::equal(std::span<const std::byte>(id.data(), id.size()), index.name(obj.index))) {
+				object_error(obj, "object id mismatch");
+			}
+
+			++verified;
+
+			for (size_t seen = longest_chain.load(); depth > seen && not longest_chain.compare_exchange_weak(seen, depth);) { }
+
+			const size_t first = children_start[current];
+			const size_t last = children_start[current + 1u];
+
+			if (first == last) {
+				return;
+			}
+
+			// base content is released when its last delta is resolved
+			base = std::move(content);
+
+			for (size_t c = first; c + 1u != last; ++c) {
+				pool.submit([this, child = children[c], base, type, depth](size_t) { resolve(child, base, type, depth + 1u); });
+			}
+
+			current = children[last - 1u];
+			++depth;
+		}
+	}
+
+	void start() {
+		if (not load()) {
+			return;
+		}
+
+		// checksums of whole files are sequential, so they run next to object verification
+		pool.submit([this](size_t) { verify_checksum(pack.first(pack.size() - hash_size), pack.last(hash_size), "pack"); });
+		pool.submit([this](size_t) { verify_checksum(index.checksummed, index.checksum, "index"); });
+
+		if (not build_graph()) {
+			return;
+		}
+
+		// roots are submitted in batches, so small objects don't pay for a task each
+		constexpr size_t batch = 64u;
+		std::vector<size_t> roots;
+
+		for (size_t i = 0; i != objects.size(); ++i) {
+			if (objects[i].parsed && not objects[i].entry.delta()) {
+				roots.push_back(i);
+			}
+
+			if (roots.size() == batch || (i + 1u == objects.size() && not roots.empty())) {
+				pool.submit([this, items = std::move(roots)](size_t) {
+					for (const size_t root: items) {
+						resolve(root, nullptr, objects[root].entry.type, 0u);
+					}
+				});
+				roots.clear();
+			}
+		}
+	}
+
+	bool finish() {
+		if (not failed && verified != index.count) {
+			error(std::to_string(index.count - verified) + " objects can't be resolved (missing base or cycle of deltas)");
+		}
+
+		if (not failed) {
+			std::lock_guard _{output_mutex};
+			std::cout << name << ": ok, " << verified << " objects (" << deltas << " deltas, longest chain " << longest_chain << ")\n";
+		}
+
+		return not failed;
+	}
+};
+
+template <typename Hasher> static bool verify_all(const options & opts) {
+	cthash::tools::thread_pool pool{opts.jobs};
+	std::vector<std::unique_ptr<pack_verifier<Hasher>>> verifiers;
+
+	for (const auto path: opts.packs) {
+		verifiers.push_back(std::make_unique<pack_verifier<Hasher>>(path, pool));
+		verifiers.back()->start();
+	}
+
+	pool.wait();
+
+	bool ok = true;
+	for (auto & v: verifiers) {
+		ok &= v->finish();
+	}
+
+	return ok;
+}
+
+int main(int argc, char ** argv) {
+	const auto opts = parse_options(argc, argv);
+
+	if (not opts) {
+		return 1;
+	}
+
+	const bool ok = opts->sha256 ? verify_all<cthash::sha256>(*opts) : verify_all<cthash::sha1>(*opts);
+
+	return ok ? 0 : 1;
+}